@@ -12,10 +12,13 @@ modules="
 :graph
 :hashl
 :hash
+:chash
+:fhash
 :heap
 :listl
 :list
 :lru
+:clru
 :mempool
 :msg
 :msgq
@@ -30,10 +33,12 @@ modules="
 :gp
 :pool
 :set
+:roaring
 :statmath
 :statprint
 :treel
 :trie
+:ftrie
 :log
 :errno
 :ut
@@ -111,6 +116,7 @@ done
 # -------
 common_sources="
 lib.c
+ebr.c
 "
 
 lib_sources=
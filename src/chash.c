@@ -0,0 +1,498 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+
+#include "common.h"
+#include "ebr.h"
+#include "yhashl.h"
+#include "ychash.h"
+
+/*
+ * Buckets are singly linked lists. Bucket index and stripe index use low
+ *   bits of hash value. Number of buckets is multiple of NSTRIPES. So,
+ *   all nodes in a bucket belong to the same stripe.
+ *
+ * Writers modify bucket only with lock of the stripe. Links are published
+ *   with release-store. So, readers always see consistent lists without
+ *   lock.
+ * Resizing takes locks of all stripes, builds new table with copied
+ *   nodes, and publishes it. Readers may be still at old table. Old table
+ *   is freed with other removed memory after grace period.
+ */
+
+#define NSTRIPES 64 /* power of 2 */
+#define INIT_NBUCKETS (NSTRIPES * 4)
+#define MAX_NBUCKETS (1U << 30)
+/* Removed memories are reclaimed when this many memories are collected */
+#define RECLAIM_BATCH 256
+
+struct cnode {
+	struct cnode *next;
+	void *key;
+	void *v;
+	u32 hv32;
+};
+
+struct ctbl {
+	u32 nb; /* number of buckets. power of 2 and >= NSTRIPES */
+	struct cnode *b[];
+};
+
+/* Type of memory to be freed after grace period */
+enum {
+	R_NODE, /* node having key and value */
+	R_VALUE, /* value */
+	R_TABLE, /* table and copied nodes in it */
+};
+
+struct retired {
+	void *p;
+	int type;
+};
+
+/* Stripe takes its own cache line to avoid false sharing between stripes */
+struct stripe {
+	pthread_mutex_t m;
+	u32 sz; /* number of nodes in this stripe */
+} __attribute__((aligned(CACHELINE_SZ)));
+
+struct ychash {
+	void *mem; /* memory block of this */
+	struct ctbl *tbl;
+	struct stripe stripes[NSTRIPES];
+	void (*vfree)(void *);
+	void (*kfree)(void *);
+	int (*kcp)(const void **, const void *);
+	yhashl_keyeq_t keq;
+	yhashl_hfunc_t h;
+	u64 seed;
+	pthread_mutex_t retire_lock;
+	struct retired *rl; /* memories waiting grace period */
+	u32 rlsz;
+	u32 rlcap;
+};
+
+declare_lock(mutex, struct ychash, retire, NULL)
+
+/****************************************************************************
+ *
+ * Read-side critical section. See ebr.h
+ *
+ ****************************************************************************/
+void
+ychash_read_begin(void) {
+	ebr_read_begin();
+}
+
+void
+ychash_read_end(void) {
+	ebr_read_end();
+}
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+static void
+free_default(void *v) {
+	if (likely(v))
+		yfree(v);
+}
+
+static void
+free_noop(unused void *v) {
+	return;
+}
+
+static int
+kcp_shallow(const void **out, const void *k) {
+	*out = k;
+	return 0;
+}
+
+static int
+keq_ptr(const void *k0, const void *k1) {
+	return k0 == k1 ? 0 : 1;
+}
+
+static int
+keq_str(const void *k0, const void *k1) {
+	return strcmp((const char *)k0, (const char *)k1);
+}
+
+static void (*
+free_func(void (*f)(void *)))(void *) {
+	return f ? YCHASH_MEM_FREE == f
+			? &free_default
+			: f
+		: &free_noop;
+}
+
+static INLINE u32
+hv(const struct ychash *h, const void *key) {
+	u32 v = yhashl_hv32(h->h, h->seed, key);
+	/* Low bits are used for bucket. Mix poor hash value. */
+	return (u32)((v * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static INLINE struct stripe *
+stripe(struct ychash *h, u32 hv32) {
+	return &h->stripes[hv32 & (NSTRIPES - 1)];
+}
+
+static INLINE void
+lock_stripe(struct stripe *s) {
+	fatali0(pthread_mutex_lock(&s->m));
+}
+
+static INLINE void
+unlock_stripe(struct stripe *s) {
+	fatali0(pthread_mutex_unlock(&s->m));
+}
+
+static struct ctbl *
+tbl_alloc(u32 nb) {
+	struct ctbl *t = ymalloc(sizeof(*t) + sizeof(t->b[0]) * (size_t)nb);
+	if (unlikely(!t))
+		return NULL;
+	t->nb = nb;
+	memset(t->b, 0, sizeof(t->b[0]) * (size_t)nb);
+	return t;
+}
+
+/* Free table and nodes in it. Keys and values are NOT freed. */
+static void
+tbl_free(struct ctbl *t) {
+	u32 i;
+	struct cnode *n, *next;
+	for (i = 0; i < t->nb; i++) {
+		for (n = t->b[i]; n; n = next) {
+			next = n->next;
+			yfree(n);
+		}
+	}
+	yfree(t);
+}
+
+static void
+free_retired(struct ychash *h, const struct retired *r) {
+	struct cnode *n;
+	switch (r->type) {
+	case R_NODE:
+		n = r->p;
+		(*h->kfree)(n->key);
+		(*h->vfree)(n->v);
+		yfree(n);
+		break;
+	case R_VALUE:
+		(*h->vfree)(r->p);
+		break;
+	case R_TABLE:
+		tbl_free(r->p);
+		break;
+	default:
+		yassert(0);
+	}
+}
+
+static void
+retire(struct ychash *h, void *p, int type) {
+	struct retired *rl;
+	struct retired r = { .p = p, .type = type };
+	lock_retire(h);
+	if (unlikely(h->rlsz >= h->rlcap)) {
+		u32 cap = h->rlcap ? h->rlcap * 2 : RECLAIM_BATCH;
+		rl = ymalloc(sizeof(*rl) * cap);
+		if (unlikely(!rl)) {
+			unlock_retire(h);
+			/* Memory is leaked if this is in read-side section.
+			 * But it's very rare case.
+			 */
+			if (!ebr_in_read()) {
+				ebr_synchronize();
+				free_retired(h, &r);
+			}
+			return;
+		}
+		if (h->rl) {
+			memcpy(rl, h->rl, sizeof(*rl) * h->rlsz);
+			yfree(h->rl);
+		}
+		h->rl = rl;
+		h->rlcap = cap;
+	}
+	h->rl[h->rlsz] = r;
+	/* rlsz is read without lock at reclaim() */
+	__atomic_store_n(&h->rlsz, h->rlsz + 1, __ATOMIC_RELAXED);
+	unlock_retire(h);
+}
+
+static void
+reclaim(struct ychash *h) {
+	u32 i, rlsz;
+	struct retired *rl;
+	/* Waiting grace period in read-side section is deadlock. */
+	if (likely(__atomic_load_n(&h->rlsz, __ATOMIC_RELAXED)
+		< RECLAIM_BATCH)
+		|| ebr_in_read()
+	) { return; }
+	lock_retire(h);
+	rl = h->rl;
+	rlsz = h->rlsz;
+	h->rl = NULL;
+	h->rlcap = 0;
+	__atomic_store_n(&h->rlsz, 0, __ATOMIC_RELAXED);
+	unlock_retire(h);
+	ebr_synchronize();
+	for (i = 0; i < rlsz; i++)
+		free_retired(h, &rl[i]);
+	if (rl)
+		yfree(rl);
+}
+
+static void
+resize(struct ychash *h, u32 nb) {
+	int i;
+	u32 j, bi;
+	struct ctbl *t, *nt;
+	struct cnode *n, *nn;
+
+	for (i = 0; i < NSTRIPES; i++)
+		lock_stripe(&h->stripes[i]);
+	t = h->tbl;
+	/* Already resized by other thread */
+	if (t->nb >= nb)
+		goto out;
+	if (unlikely(!(nt = tbl_alloc(nb))))
+		goto out;
+	/* Nodes are copied, because readers may be traversing old table. */
+	for (j = 0; j < t->nb; j++) {
+		for (n = t->b[j]; n; n = n->next) {
+			if (unlikely(!(nn = ymalloc(sizeof(*nn))))) {
+				tbl_free(nt);
+				goto out;
+			}
+			*nn = *n;
+			bi = nn->hv32 & (nb - 1);
+			nn->next = nt->b[bi];
+			nt->b[bi] = nn;
+		}
+	}
+	__atomic_store_n(&h->tbl, nt, __ATOMIC_RELEASE);
+	retire(h, t, R_TABLE);
+ out:
+	for (i = NSTRIPES - 1; i >= 0; i--)
+		unlock_stripe(&h->stripes[i]);
+}
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+struct ychash *
+ychash_create(
+	void (*vfree)(void *),
+	void (*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keyeq)(const void *, const void *),
+	uint32_t (*hfunc)(const void *key)
+) {
+	int i;
+	void *mem;
+	struct ychash *h = ymalloc_cacheline(sizeof(*h), &mem);
+	if (unlikely(!h))
+		return NULL;
+	h->mem = mem;
+	if (unlikely(!(h->tbl = tbl_alloc(INIT_NBUCKETS)))) {
+		yfree(mem);
+		return NULL;
+	}
+	for (i = 0; i < NSTRIPES; i++) {
+		fatali0(pthread_mutex_init(&h->stripes[i].m, NULL));
+		h->stripes[i].sz = 0;
+	}
+	h->vfree = free_func(vfree);
+	h->kfree = free_func(keyfree);
+	h->kcp = keycopy ? keycopy : &kcp_shallow;
+	if (!keyeq || YHASHL_KEYEQ_PTR == keyeq)
+		keyeq = &keq_ptr;
+	else if (YHASHL_KEYEQ_STR == keyeq)
+		keyeq = &keq_str;
+	h->keq = keyeq;
+	if (!hfunc || YHASHL_HFUNC_PTR == hfunc)
+		hfunc = YHASHL_HFUNC_FAST_PTR;
+	else if (YHASHL_HFUNC_STR == hfunc)
+		hfunc = YHASHL_HFUNC_FAST_STR;
+	h->h = hfunc;
+	h->seed = yhashl_new_seed();
+	init_retire_lock(h);
+	h->rl = NULL;
+	h->rlsz = h->rlcap = 0;
+	return h;
+}
+
+void
+ychash_destroy(struct ychash *h) {
+	int i;
+	u32 j;
+	struct cnode *n;
+	for (j = 0; j < h->tbl->nb; j++) {
+		for (n = h->tbl->b[j]; n; n = n->next) {
+			(*h->kfree)(n->key);
+			(*h->vfree)(n->v);
+		}
+	}
+	tbl_free(h->tbl);
+	/* No one uses hash. Grace period is not required. */
+	for (j = 0; j < h->rlsz; j++)
+		free_retired(h, &h->rl[j]);
+	if (h->rl)
+		yfree(h->rl);
+	destroy_retire_lock(h);
+	for (i = 0; i < NSTRIPES; i++)
+		fatali0(pthread_mutex_destroy(&h->stripes[i].m));
+	yfree(h->mem);
+}
+
+uint32_t
+ychash_sz(const struct ychash *h) {
+	int i;
+	u32 sz = 0;
+	for (i = 0; i < NSTRIPES; i++)
+		sz += __atomic_load_n(&h->stripes[i].sz, __ATOMIC_RELAXED);
+	return sz;
+}
+
+int
+ychash_set(struct ychash *h, void *key, void *v) {
+	u32 nb;
+	bool grow;
+	void *oldv;
+	const void *kc;
+	struct cnode *n, **pb;
+	u32 hv32 = hv(h, key);
+	struct stripe *s = stripe(h, hv32);
+
+	lock_stripe(s);
+	/* Table is not changed while stripe is locked. */
+	nb = h->tbl->nb;
+	pb = &h->tbl->b[hv32 & (nb - 1)];
+	for (n = *pb; n; n = n->next) {
+		if (n->hv32 == hv32 && !(*h->keq)(key, n->key)) {
+			/* key is NOT replaced. Only value is. */
+			oldv = __atomic_exchange_n(&n->v, v, __ATOMIC_ACQ_REL);
+			unlock_stripe(s);
+			if (&free_noop != h->vfree) {
+				retire(h, oldv, R_VALUE);
+				reclaim(h);
+			}
+			return 0;
+		}
+	}
+	if (unlikely(!(n = ymalloc(sizeof(*n))))) {
+		unlock_stripe(s);
+		return -ENOMEM;
+	}
+	if (unlikely((*h->kcp)(&kc, key))) {
+		unlock_stripe(s);
+		yfree(n);
+		return -ENOMEM;
+	}
+	n->key = (void *)kc;
+	n->v = v;
+	n->hv32 = hv32;
+	n->next = *pb;
+	__atomic_store_n(pb, n, __ATOMIC_RELEASE);
+	__atomic_store_n(&s->sz, s->sz + 1, __ATOMIC_RELAXED);
+	/* Average length of bucket list is larger than 2 */
+	grow = s->sz > nb / NSTRIPES * 2 && nb < MAX_NBUCKETS;
+	unlock_stripe(s);
+	if (unlikely(grow))
+		resize(h, nb * 2);
+	reclaim(h);
+	return 1;
+}
+
+int
+ychash_remove(struct ychash *h, const void *key) {
+	struct cnode *n, **pb;
+	u32 hv32 = hv(h, key);
+	struct stripe *s = stripe(h, hv32);
+
+	lock_stripe(s);
+	pb = &h->tbl->b[hv32 & (h->tbl->nb - 1)];
+	for (; (n = *pb); pb = &n->next) {
+		if (n->hv32 == hv32 && !(*h->keq)(key, n->key)) {
+			/* Readers at 'n' can still move to next. */
+			__atomic_store_n(pb, n->next, __ATOMIC_RELEASE);
+			__atomic_store_n(&s->sz, s->sz - 1, __ATOMIC_RELAXED);
+			unlock_stripe(s);
+			retire(h, n, R_NODE);
+			reclaim(h);
+			return 1;
+		}
+	}
+	unlock_stripe(s);
+	return 0;
+}
+
+int
+ychash_get(const struct ychash *h, const void *key, void **value) {
+	int r = -ENOENT;
+	struct ctbl *t;
+	struct cnode *n;
+	u32 hv32 = hv(h, key);
+
+	ebr_read_begin();
+	t = __atomic_load_n(&h->tbl, __ATOMIC_ACQUIRE);
+	n = __atomic_load_n(&t->b[hv32 & (t->nb - 1)], __ATOMIC_ACQUIRE);
+	for (; n; n = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) {
+		if (n->hv32 == hv32 && !(*h->keq)(key, n->key)) {
+			if (value)
+				*value = __atomic_load_n(&n->v,
+					__ATOMIC_ACQUIRE);
+			r = 0;
+			break;
+		}
+	}
+	ebr_read_end();
+	return r;
+}
@@ -0,0 +1,539 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <errno.h>
+
+#include "common.h"
+#include "ebr.h"
+#include "ylistl.h"
+#include "yhashl.h"
+#include "yhash.h"
+#include "yclru.h"
+
+/*
+ * Design
+ *
+ * Each shard is same with ylru(hash + list) and has its own rwlock.
+ * Shard index uses upper bits of mixed hash value of key. Hash in a shard
+ *   uses its own hash function(seed). So, keys in a shard are still
+ *   distributed well over buckets.
+ *
+ * Read hit(YCLRU_buffered_read)
+ * Finding node in the hash doesn't modify anything. So, readers take
+ *   shared lock. Node moving to the newest position is recorded to
+ *   access buffer of the shard with atomic increment of index. Buffer is
+ *   drained(records are applied to the list) with exclusive lock, by the
+ *   reader filling the buffer(only if lock is free), or by writers before
+ *   modifying shard. Therefore, all recorded nodes are alive while they are
+ *   in the buffer.
+ *
+ * Data returned to reader is used out of lock. So, node of evicted(or
+ *   replaced) data is moved to retired list and freed after grace
+ *   period(See ebr.h). Grace period is waited out of lock, because readers
+ *   in read-side section may wait for the lock.
+ */
+
+#define DEFAULT_NSHARDS 16
+#define MAX_NSHARDS 1024
+/* Size of access buffer. power of 2 */
+#define NACCS 64
+/* Retired nodes are reclaimed when this many nodes are collected */
+#define RECLAIM_BATCH 64
+
+/* list node */
+struct lnode {
+	struct ylistl_link lk;
+	/* point key memory in internal hash - shallow copy */
+	const void *key;
+	void *data; /* cached data */
+	u32 dsz; /* data size */
+};
+
+/* Shards start at cache line boundary to avoid false sharing between them */
+struct shard {
+	pthread_rwlock_t lock;
+	struct yhash *h; /* key -> lnode */
+	struct ylistl_link head; /* the first is the newest */
+	struct ylistl_link retired; /* nodes waiting grace period */
+	u32 nretired;
+	u32 sz;
+	u32 naccs; /* number of access records. May be larger than NACCS */
+	struct lnode *accs[NACCS];
+} __attribute__((aligned(CACHELINE_SZ)));
+
+struct yclru {
+	struct shard *shards;
+	void *shards_mem; /* memory block of 'shards' */
+	u32 nshards; /* power of 2 */
+	u32 bits; /* log2(nshards) */
+	u32 maxsz; /* maximum size of a shard */
+	int opt;
+	yhashl_hfunc_t hf; /* to select shard */
+	u64 seed;
+	void (*dfree)(void *);
+	void *(*dcreate)(const void *key);
+	u32 (*dsize)(const void *);
+};
+
+static INLINE void
+rdlock(struct shard *s) {
+	fatali0(pthread_rwlock_rdlock(&s->lock));
+}
+
+static INLINE void
+wrlock(struct shard *s) {
+	fatali0(pthread_rwlock_wrlock(&s->lock));
+}
+
+static INLINE void
+unlock(struct shard *s) {
+	fatali0(pthread_rwlock_unlock(&s->lock));
+}
+
+static void
+lru_free_default(void *v) {
+	if (likely(v))
+		yfree(v);
+}
+
+static INLINE u32
+data_size(const struct yclru *c, void *d) {
+	return c->dsize ? (*c->dsize)(d) : 1;
+}
+
+static INLINE void
+data_free(const struct yclru *c, void *d) {
+	if (c->dfree)
+		(*c->dfree)(d);
+}
+
+static INLINE struct shard *
+shard(const struct yclru *c, const void *key) {
+	u64 v;
+	if (unlikely(!c->bits))
+		return c->shards;
+	v = yhashl_hv32(c->hf, c->seed, key);
+	/* Hash function given by user may be poor. */
+	return &c->shards[(v * 0x9E3779B97F4A7C15ULL) >> (64 - c->bits)];
+}
+
+static INLINE void
+sz_add(struct shard *s, u32 v) {
+	/* sz is read without lock at yclru_sz() */
+	__atomic_store_n(&s->sz, s->sz + v, __ATOMIC_RELAXED);
+}
+
+static INLINE void
+sz_sub(struct shard *s, u32 v) {
+	__atomic_store_n(&s->sz, s->sz - v, __ATOMIC_RELAXED);
+}
+
+/*
+ * Apply access records. Exclusive lock SHOULD be held.
+ */
+static void
+drain(struct shard *s) {
+	u32 i, n;
+	struct lnode *ln;
+	n = s->naccs < NACCS ? s->naccs : NACCS;
+	for (i = 0; i < n; i++) {
+		ln = s->accs[i];
+		ylistl_remove(&ln->lk);
+		ylistl_add_first(&s->head, &ln->lk);
+	}
+	s->naccs = 0;
+}
+
+/*
+ * Node is already removed from hash and list.
+ * Data in the node may be being used by readers.
+ */
+static INLINE void
+retire(const struct yclru *c, struct shard *s, struct lnode *n) {
+	if (!c->dfree) {
+		yfree(n);
+		return;
+	}
+	ylistl_add_last(&s->retired, &n->lk);
+	s->nretired++;
+}
+
+static void
+free_nodes(const struct yclru *c, struct ylistl_link *head) {
+	struct lnode *n, *tmp;
+	ylistl_foreach_item_safe(n, tmp, head, struct lnode, lk) {
+		data_free(c, n->data);
+		yfree(n);
+	}
+	ylistl_init_link(head);
+}
+
+/*
+ * Unlock shard locked exclusively, and free retired nodes if there are
+ *   enough.
+ */
+static void
+unlock_reclaim(const struct yclru *c, struct shard *s) {
+	struct ylistl_link rl;
+	/* Waiting grace period in read-side section is deadlock. */
+	if (likely(s->nretired < RECLAIM_BATCH) || ebr_in_read()) {
+		unlock(s);
+		return;
+	}
+	ylistl_replace(&s->retired, &rl);
+	ylistl_init_link(&s->retired);
+	s->nretired = 0;
+	unlock(s);
+	ebr_synchronize();
+	free_nodes(c, &rl);
+}
+
+/*
+ * Evict the oldest ones until @p dsz can be added.
+ */
+static void
+evict(const struct yclru *c, struct shard *s, u32 dsz) {
+	struct lnode *n;
+	while (unlikely(s->sz + dsz > c->maxsz)
+		&& !ylistl_is_empty(&s->head)
+	) {
+		n = containerof(s->head.prev, struct lnode, lk);
+		ylistl_remove(&n->lk);
+		sz_sub(s, n->dsz);
+		yhash_remove(s->h, n->key);
+		retire(c, s, n);
+	}
+}
+
+static void
+shard_reset(const struct yclru *c, struct shard *s) {
+	yhash_reset(s->h);
+	/* No one uses cache. Grace period is not required. */
+	free_nodes(c, &s->head);
+	free_nodes(c, &s->retired);
+	s->nretired = 0;
+	s->naccs = 0;
+	s->sz = 0;
+}
+
+static struct yclru *
+clru_create(
+	struct yhash *h, /* hash used at the first shard */
+	yhashl_hfunc_t hf,
+	u32 maxsz,
+	u32 nshards,
+	int opt,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *)
+) {
+	u32 i;
+	struct shard *s;
+	struct yclru *c;
+
+	if (unlikely(!h))
+		return NULL;
+	if (!nshards)
+		nshards = DEFAULT_NSHARDS;
+	if (nshards > MAX_NSHARDS)
+		nshards = MAX_NSHARDS;
+	if (unlikely(!(c = ymalloc(sizeof(*c)))))
+		goto fail_hash;
+	for (c->bits = 0; (1U << c->bits) < nshards; c->bits++);
+	c->nshards = 1U << c->bits;
+	if (unlikely(!(c->shards = ymalloc_cacheline(
+		sizeof(*c->shards) * c->nshards, &c->shards_mem))))
+		goto fail_clru;
+	for (i = 0; i < c->nshards; i++) {
+		s = &c->shards[i];
+		if (unlikely(!(s->h = i ? yhash_create(h) : h)))
+			goto fail_shards;
+		fatali0(pthread_rwlock_init(&s->lock, NULL));
+		ylistl_init_link(&s->head);
+		ylistl_init_link(&s->retired);
+		s->nretired = s->sz = s->naccs = 0;
+	}
+	c->maxsz = maxsz
+		? (u32)(((u64)maxsz + c->nshards - 1) / c->nshards)
+		: 0xffffffff; /* maximum unsigned u32 */
+	c->opt = opt;
+	c->hf = hf;
+	c->seed = yhashl_new_seed();
+	c->dfree = YCLRU_PREDEFINED_FREE == datafree
+		? &lru_free_default
+		: datafree;
+	c->dcreate = datacreate;
+	c->dsize = datasize;
+	return c;
+
+ fail_shards:
+	while (i-- > 1) {
+		fatali0(pthread_rwlock_destroy(&c->shards[i].lock));
+		yhash_destroy(c->shards[i].h);
+	}
+	fatali0(pthread_rwlock_destroy(&c->shards[0].lock));
+	yfree(c->shards_mem);
+ fail_clru:
+	yfree(c);
+ fail_hash:
+	yhash_destroy(h);
+	return NULL;
+}
+
+/****************************************************************************
+ *
+ * Read-side critical section. See ebr.h
+ *
+ ****************************************************************************/
+void
+yclru_read_begin(void) {
+	ebr_read_begin();
+}
+
+void
+yclru_read_end(void) {
+	ebr_read_end();
+}
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+struct yclru *
+yclrui_create(
+	u32 maxsz,
+	u32 nshards,
+	int opt,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *)
+) {
+	return clru_create(
+		yhashi_create2(NULL, YHASH_fast_hash),
+		YHASHL_HFUNC_FAST_PTR,
+		maxsz, nshards, opt, datafree, datacreate, datasize);
+}
+
+struct yclru *
+yclrus_create(
+	u32 maxsz,
+	u32 nshards,
+	int opt,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *)
+) {
+	return clru_create(
+		yhashs_create2(NULL, TRUE, YHASH_fast_hash),
+		YHASHL_HFUNC_FAST_STR,
+		maxsz, nshards, opt, datafree, datacreate, datasize);
+}
+
+struct yclru *
+yclruo_create(
+	u32 maxsz,
+	u32 nshards,
+	int opt,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *),
+	void(*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keycmp)(const void *, const void *),
+	u32 (*hfunc)(const void *key)
+) {
+	if (YCLRU_PREDEFINED_FREE == keyfree)
+		keyfree = YHASH_MEM_FREE;
+	return clru_create(
+		yhasho_create(NULL, keyfree, keycopy, keycmp, hfunc),
+		hfunc,
+		maxsz, nshards, opt, datafree, datacreate, datasize);
+}
+
+void
+yclru_reset(struct yclru *c) {
+	u32 i;
+	if (unlikely(!c))
+		return;
+	for (i = 0; i < c->nshards; i++)
+		shard_reset(c, &c->shards[i]);
+}
+
+void
+yclru_destroy(struct yclru *c) {
+	u32 i;
+	struct shard *s;
+	if (unlikely(!c))
+		return;
+	for (i = 0; i < c->nshards; i++) {
+		s = &c->shards[i];
+		shard_reset(c, s);
+		yhash_destroy(s->h);
+		fatali0(pthread_rwlock_destroy(&s->lock));
+	}
+	yfree(c->shards_mem);
+	yfree(c);
+}
+
+int
+yclru_put(struct yclru *c, const void *key, void *data) {
+	int r;
+	struct lnode *n, *nn;
+	struct shard *s;
+	u32 dsz;
+	if (unlikely(!c))
+		return -EINVAL;
+	dsz = data_size(c, data);
+	if (unlikely(dsz > c->maxsz))
+		/* too large data to be in the cache */
+		return -EINVAL;
+	if (unlikely(!(nn = ymalloc(sizeof(*nn)))))
+		return -ENOMEM;
+	s = shard(c, key);
+	wrlock(s);
+	drain(s);
+	if (!yhash_get(s->h, key, (void **)&n)) {
+		/* Node is reused. New node carries replaced data instead. */
+		ylistl_remove(&n->lk);
+		sz_sub(s, n->dsz);
+		if (likely(n->data != data)) {
+			nn->data = n->data;
+			retire(c, s, nn);
+		} else
+			yfree(nn);
+		nn = n;
+		nn->data = data;
+	} else {
+		nn->data = data;
+		if (unlikely(0 > (r = yhash_set3(
+			s->h, &nn->key, (void *)key, nn)))
+		) {
+			unlock(s);
+			yfree(nn);
+			return r;
+		}
+	}
+	nn->dsz = dsz;
+	/* 'nn' is not in the list yet. */
+	evict(c, s, dsz);
+	ylistl_add_first(&s->head, &nn->lk);
+	sz_add(s, dsz);
+	unlock_reclaim(c, s);
+	return 0;
+}
+
+int
+yclru_get(struct yclru *c, void **data, const void *key) {
+	int r;
+	u32 i;
+	void *d;
+	struct lnode *n;
+	struct shard *s;
+	if (unlikely(!c || !data))
+		return -EINVAL;
+	s = shard(c, key);
+	if (c->opt & YCLRU_buffered_read) {
+		rdlock(s);
+		if (!yhash_get(s->h, key, (void **)&n)) {
+			*data = n->data;
+			i = __atomic_fetch_add(&s->naccs, 1, __ATOMIC_RELAXED);
+			/* Record is dropped if buffer is full. */
+			if (likely(i < NACCS))
+				__atomic_store_n(&s->accs[i], n,
+					__ATOMIC_RELAXED);
+			unlock(s);
+			/* Try to drain whenever buffer is filled up. */
+			if (unlikely(NACCS - 1 == i % NACCS)
+				&& !pthread_rwlock_trywrlock(&s->lock)
+			) {
+				drain(s);
+				unlock(s);
+			}
+			return 0;
+		}
+		unlock(s);
+	} else {
+		wrlock(s);
+		if (!yhash_get(s->h, key, (void **)&n)) {
+			ylistl_remove(&n->lk);
+			ylistl_add_first(&s->head, &n->lk);
+			*data = n->data;
+			unlock(s);
+			return 0;
+		}
+		unlock(s);
+	}
+	/* Fail to find in the cache */
+	if (!c->dcreate)
+		return 1;
+	d = (*c->dcreate)(key);
+	if (unlikely(0 > (r = yclru_put(c, key, d)))) {
+		data_free(c, d);
+		return r;
+	}
+	*data = d;
+	return 0;
+}
+
+int
+yclru_remove(struct yclru *c, const void *key) {
+	struct lnode *n;
+	struct shard *s;
+	if (unlikely(!c))
+		return 0;
+	s = shard(c, key);
+	wrlock(s);
+	drain(s);
+	if (0 >= yhash_remove2(s->h, key, (void **)&n)) {
+		unlock(s);
+		return 0;
+	}
+	ylistl_remove(&n->lk);
+	sz_sub(s, n->dsz);
+	retire(c, s, n);
+	unlock_reclaim(c, s);
+	return 1;
+}
+
+u32
+yclru_sz(const struct yclru *c) {
+	u32 i, sz = 0;
+	for (i = 0; i < c->nshards; i++)
+		sz += __atomic_load_n(&c->shards[i].sz, __ATOMIC_RELAXED);
+	return sz;
+}
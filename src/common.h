@@ -87,6 +87,19 @@ EXPORT char *dstrdup(const char *, const char *, int);
 
 #endif /* CONFIG_TEST */
 
+/* Structure aligned to this doesn't share cache line with others. */
+#define CACHELINE_SZ 64
+
+/*
+ * Allocate @p sz bytes aligned to cache line. Memory block to be freed by
+ *   yfree, is stored at @p mem.
+ */
+#define ymalloc_cacheline(sz, mem)					\
+	((*(mem) = ymalloc((sz) + CACHELINE_SZ - 1))			\
+	 ? (void *)(((uintptr_t)*(mem) + CACHELINE_SZ - 1)		\
+		    & ~(uintptr_t)(CACHELINE_SZ - 1))			\
+	 : NULL)
+
 /*****************************************************************************
  *
  *
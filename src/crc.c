@@ -34,10 +34,35 @@
  * official policies, either expressed or implied, of the FreeBSD Project.
  *****************************************************************************/
 
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "lib.h"
 #include "common.h"
 #include "yut.h"
 #include "ycrc.h"
 
+/*
+ * Number of bytes consumed per one round of table-lookups: 1, 8 or 16.
+ * 'slicing-by-N' needs N tables(256 entries each) built at ylib_init.
+ * Until then, byte-wise table-lookup is used.
+ */
+#ifndef CONFIG_CRC_SLICE
+#define CONFIG_CRC_SLICE 16
+#endif
+
+#if CONFIG_CRC_SLICE != 1 && CONFIG_CRC_SLICE != 8 && CONFIG_CRC_SLICE != 16
+#error CONFIG_CRC_SLICE should be one of 1, 8 and 16.
+#endif
+
+#define MAX_SLICE 16
+
+/* Minimum bytes per thread at ycrc32_parallel */
+#define PARALLEL_MIN_CHUNK (256 * 1024)
+/* Kernels use 32bit length */
+#define KERNEL_MAX_LEN (1024 * 1024 * 1024)
+
 /*
  * Most important part of CRC library is 'Performance'. Not flexibility!.
  * Followings are just for information!.
@@ -74,10 +99,13 @@ static const s32 YCRC_24 = 0x00DF3261;
  */
 static const s32 YCRC_32 = 0xEDB88320;
 /*
- * ylib didn't support 64bit crc
  * CRC-64-ISO : X^64 + X^4 + X^3 + X + 1
+ * CRC-64-ECMA-182 : X^64 + X^62 + X^57 + X^55 + X^54 + X^53 + X^52
+ *   + X^47 + X^46 + X^45 + X^40 + X^39 + X^38 + X^37 + X^35 + X^33
+ *   + X^32 + X^31 + X^29 + X^27 + X^24 + X^23 + X^22 + X^21 + X^19
+ *   + X^17 + X^13 + X^12 + X^10 + X^9 + X^7 + X^4 + X + 1
+ * See 'CRC-64' below.
  */
-/* static const UInt64 YCRC64_ISO = 0xD800000000000000; */
 #endif
 
 
@@ -119,21 +147,6 @@ static const u16 _crc16_table[256] = {
 
 
 
-u16
-ycrc16(register u16 crc, register const u8 *data, u32 len) {
-	if (unlikely(!len || !data)) {
-		yassert(0);
-		return crc;
-	}
-
-	yut_unroll16(
-		len,
-		crc = (crc >> 8) \
-			^ _crc16_table[(crc ^ (*data++)) & 0xff];);
-	return crc;
-}
-
-
 /*
  * Simple crc32
  */
@@ -216,20 +229,588 @@ static const u32 _crc32_table[256] = {
 
 
 
+/*****************************************************************************
+ *
+ * Kernels
+ *
+ * [k][i] of slicing table is crc of byte 'i' followed by 'k' zero-bytes.
+ * So, crc of N bytes can be got by XORing N independent table-lookups,
+ *   instead of N dependent lookup-and-shift steps.
+ *
+ *****************************************************************************/
+static u32 _crc32_slice[MAX_SLICE][256];
+static u16 _crc16_slice[MAX_SLICE][256];
+
+typedef u32 (*crc32_kernel_t)(u32, const u8 *, u32);
+typedef u16 (*crc16_kernel_t)(u16, const u8 *, u32);
+
+/* Read 4 bytes as little-endian regardless of alignment. */
+static INLINE u32
+ld32le(const u8 *p) {
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+/*
+ * 4 table-lookups for 4 bytes in @wORD.
+ * First byte of @wORD(LSB) is farthest from the end. So it uses [bASE + 3].
+ */
+#define lookup4(tBL, bASE, wORD)				\
+	(tBL[(bASE) + 3][(wORD) & 0xff]				\
+		^ tBL[(bASE) + 2][((wORD) >> 8) & 0xff]		\
+		^ tBL[(bASE) + 1][((wORD) >> 16) & 0xff]	\
+		^ tBL[bASE][(wORD) >> 24])
+
 /*
  * Steps through buffer one byte at at time, calculates reflected
  * crc using table.
  */
+static u32
+crc32_slice1(register u32 crc, register const u8 *data, u32 len) {
+	yut_unroll16(
+		len,
+		crc = (crc >> 8) \
+			^ _crc32_table[(crc ^ (*data++)) & 0xff];);
+	return crc;
+}
+
+static u32
+crc32_slice8(u32 crc, const u8 *data, u32 len) {
+	u32 a, b;
+	while (len >= 8) {
+		a = ld32le(data) ^ crc;
+		b = ld32le(data + 4);
+		crc = lookup4(_crc32_slice, 4, a)
+			^ lookup4(_crc32_slice, 0, b);
+		data += 8;
+		len -= 8;
+	}
+	return len ? crc32_slice1(crc, data, len) : crc;
+}
+
+static u32
+crc32_slice16(u32 crc, const u8 *data, u32 len) {
+	u32 a, b, c, d;
+	while (len >= 16) {
+		a = ld32le(data) ^ crc;
+		b = ld32le(data + 4);
+		c = ld32le(data + 8);
+		d = ld32le(data + 12);
+		crc = lookup4(_crc32_slice, 12, a)
+			^ lookup4(_crc32_slice, 8, b)
+			^ lookup4(_crc32_slice, 4, c)
+			^ lookup4(_crc32_slice, 0, d);
+		data += 16;
+		len -= 16;
+	}
+	return len ? crc32_slice8(crc, data, len) : crc;
+}
+
+static u16
+crc16_slice1(register u16 crc, register const u8 *data, u32 len) {
+	yut_unroll16(
+		len,
+		crc = (crc >> 8) \
+			^ _crc16_table[(crc ^ (*data++)) & 0xff];);
+	return crc;
+}
+
+/* crc16 register is only 2 bytes. So, only first 2 bytes are XORed. */
+static u16
+crc16_slice8(u16 crc, const u8 *data, u32 len) {
+	u32 a, b;
+	while (len >= 8) {
+		a = ld32le(data) ^ crc;
+		b = ld32le(data + 4);
+		crc = lookup4(_crc16_slice, 4, a)
+			^ lookup4(_crc16_slice, 0, b);
+		data += 8;
+		len -= 8;
+	}
+	return len ? crc16_slice1(crc, data, len) : crc;
+}
+
+static u16
+crc16_slice16(u16 crc, const u8 *data, u32 len) {
+	u32 a, b, c, d;
+	while (len >= 16) {
+		a = ld32le(data) ^ crc;
+		b = ld32le(data + 4);
+		c = ld32le(data + 8);
+		d = ld32le(data + 12);
+		crc = lookup4(_crc16_slice, 12, a)
+			^ lookup4(_crc16_slice, 8, b)
+			^ lookup4(_crc16_slice, 4, c)
+			^ lookup4(_crc16_slice, 0, d);
+		data += 16;
+		len -= 16;
+	}
+	return len ? crc16_slice8(crc, data, len) : crc;
+}
+
+#undef lookup4
+
+static crc32_kernel_t
+crc32_kernel(int slice) {
+	switch (slice) {
+	case 8: return &crc32_slice8;
+	case 16: return &crc32_slice16;
+	default: return &crc32_slice1;
+	}
+}
+
+static crc16_kernel_t
+crc16_kernel(int slice) {
+	switch (slice) {
+	case 8: return &crc16_slice8;
+	case 16: return &crc16_slice16;
+	default: return &crc16_slice1;
+	}
+}
+
+/* Byte-wise kernel is used until slicing tables are ready. */
+static crc32_kernel_t _crc32_kernel = &crc32_slice1;
+static crc16_kernel_t _crc16_kernel = &crc16_slice1;
+
+static void
+build_slice_tables(void) {
+	int i, k;
+	u32 c32;
+	u16 c16;
+	for (i = 0; i < 256; i++) {
+		_crc32_slice[0][i] = _crc32_table[i];
+		_crc16_slice[0][i] = _crc16_table[i];
+	}
+	for (k = 1; k < MAX_SLICE; k++) {
+		for (i = 0; i < 256; i++) {
+			c32 = _crc32_slice[k - 1][i];
+			c16 = _crc16_slice[k - 1][i];
+			_crc32_slice[k][i] = (c32 >> 8)
+				^ _crc32_table[c32 & 0xff];
+			_crc16_slice[k][i] = (c16 >> 8)
+				^ _crc16_table[c16 & 0xff];
+		}
+	}
+}
+
+/*****************************************************************************
+ *
+ * GF(2) arithmetic modulo crc32 polynomial
+ *
+ * Polynomials are in reflected form like crc register: bit 31 is x^0.
+ * Appending n zero-bytes to data is same with multiplying crc register by
+ *   x^(8n) mod P. So, crc of separated pieces can be joined.
+ *
+ *****************************************************************************/
+#define CRC32_POLY 0x82F63B78 /* reflected CRC-32C */
+
+/* _x2n[k] = x^(2^k) mod P. 64bit bytes-length is 67 bits-length. */
+static u32 _x2n[64 + 3];
+
+/* a(x) * b(x) mod P */
+static u32
+gf2_multmodp(u32 a, u32 b) {
+	u32 m, p = 0;
+	for (m = (u32)1 << 31; m; m >>= 1) {
+		if (a & m) {
+			p ^= b;
+			if (!(a & (m - 1)))
+				break;
+		}
+		b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+	}
+	return p;
+}
+
+/* x^(n * 2^k) mod P */
+static u32
+gf2_xnmodp(u64 n, int k) {
+	u32 p = (u32)1 << 31; /* x^0 */
+	while (n) {
+		if (n & 1)
+			p = gf2_multmodp(_x2n[k], p);
+		n >>= 1;
+		k++;
+	}
+	return p;
+}
+
+static void
+build_x2n_table(void) {
+	int k;
+	_x2n[0] = (u32)1 << 30; /* x^1 */
+	for (k = 1; k < yut_arrsz(_x2n); k++)
+		_x2n[k] = gf2_multmodp(_x2n[k - 1], _x2n[k - 1]);
+}
+
+
+/*****************************************************************************
+ *
+ * Hardware kernels (x86-64)
+ *
+ * Polynomial of SSE4.2 'crc32' instruction is CRC-32C. And it doesn't do
+ *   pre/post-conditioning. So, it gives exactly same results with
+ *   '_crc32_table'.
+ * Latency of 'crc32' is 3 cycles but throughput is 1 cycle. So, large
+ *   buffer is split into 3 lanes calculated in parallel. And then lanes
+ *   are joined by PCLMULQDQ: carry-less product of crc and
+ *   x^(8 * lanesz - 33) is reduced by 'crc32' again.
+ *   (-33: 'crc32' on 64bit multiplies x^32 and reflected product is
+ *    x^1 shifted.)
+ *
+ *****************************************************************************/
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <x86intrin.h>
+
+#define LANE_LONG 8192
+#define LANE_SHORT 256
+
+/* [0]: x^(8 * lanesz - 33), [1]: x^(16 * lanesz - 33) */
+static u32 _klong[2];
+static u32 _kshort[2];
+
+__attribute__((target("sse4.2")))
+static u32
+crc32_sse42(u32 crc, const u8 *data, u32 len) {
+	u64 c = crc;
+	u64 v;
+	while (len >= 8) {
+		memcpy(&v, data, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+		data += 8;
+		len -= 8;
+	}
+	while (len--)
+		c = _mm_crc32_u8((u32)c, *data++);
+	return (u32)c;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static INLINE u64
+clmul(u32 a, u32 b) {
+	return _mm_cvtsi128_si64(_mm_clmulepi64_si128(
+		_mm_cvtsi32_si128((int)a), _mm_cvtsi32_si128((int)b), 0));
+}
+
+/* Calculate crc of 3 * @lane bytes. */
+__attribute__((target("sse4.2,pclmul")))
+static INLINE u32
+crc32_3lanes(u32 crc, const u8 *data, u32 lane, const u32 *k) {
+	u64 c0 = crc, c1 = 0, c2 = 0;
+	u64 v0, v1, v2;
+	const u8 *end = data + lane;
+	while (data < end) {
+		memcpy(&v0, data, sizeof(v0));
+		memcpy(&v1, data + lane, sizeof(v1));
+		memcpy(&v2, data + 2 * lane, sizeof(v2));
+		c0 = _mm_crc32_u64(c0, v0);
+		c1 = _mm_crc32_u64(c1, v1);
+		c2 = _mm_crc32_u64(c2, v2);
+		data += 8;
+	}
+	/* c0 * x^(16 * lane) + c1 * x^(8 * lane) + c2 */
+	return (u32)_mm_crc32_u64(0, clmul(c0, k[1]) ^ clmul(c1, k[0]))
+		^ (u32)c2;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static u32
+crc32_pclmul(u32 crc, const u8 *data, u32 len) {
+	while (len >= 3 * LANE_LONG) {
+		crc = crc32_3lanes(crc, data, LANE_LONG, _klong);
+		data += 3 * LANE_LONG;
+		len -= 3 * LANE_LONG;
+	}
+	while (len >= 3 * LANE_SHORT) {
+		crc = crc32_3lanes(crc, data, LANE_SHORT, _kshort);
+		data += 3 * LANE_SHORT;
+		len -= 3 * LANE_SHORT;
+	}
+	return crc32_sse42(crc, data, len);
+}
+
+/* @return NULL if CPU doesn't support it. */
+static crc32_kernel_t
+crc32_hw_kernel(void) {
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("sse4.2"))
+		return NULL;
+	if (!__builtin_cpu_supports("pclmul"))
+		return &crc32_sse42;
+	_klong[0] = gf2_xnmodp(8 * LANE_LONG - 33, 0);
+	_klong[1] = gf2_xnmodp(16 * LANE_LONG - 33, 0);
+	_kshort[0] = gf2_xnmodp(8 * LANE_SHORT - 33, 0);
+	_kshort[1] = gf2_xnmodp(16 * LANE_SHORT - 33, 0);
+	return &crc32_pclmul;
+}
+
+#undef LANE_LONG
+#undef LANE_SHORT
+
+#else /* x86-64 */
+
+static crc32_kernel_t
+crc32_hw_kernel(void) {
+	return NULL;
+}
+
+#endif /* x86-64 */
+
+/*****************************************************************************
+ *
+ * CRC-64
+ *
+ *****************************************************************************/
+/* Reflected polynomials */
+#define CRC64_ECMA_POLY 0xC96C5795D7870F42ULL
+#define CRC64_ISO_POLY 0xD800000000000000ULL
+
+/* Slicing-by-8 tables. See 'Kernels' */
+static u64 _crc64_ecma[8][256];
+static u64 _crc64_iso[8][256];
+/* Bit-wise kernel is used until tables are ready */
+static bool _crc64_ready;
+
+static INLINE u64
+ld64le(const u8 *p) {
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static u64
+crc64_bitwise(u64 poly, u64 crc, const u8 *data, u32 len) {
+	int k;
+	while (len--) {
+		crc ^= *data++;
+		for (k = 0; k < 8; k++)
+			crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+	}
+	return crc;
+}
+
+static u64
+crc64_slice8(const u64 (*t)[256], u64 crc, const u8 *data, u32 len) {
+	u64 v;
+#if CONFIG_CRC_SLICE != 1
+	while (len >= 8) {
+		v = ld64le(data) ^ crc;
+		crc = t[7][v & 0xff]
+			^ t[6][(v >> 8) & 0xff]
+			^ t[5][(v >> 16) & 0xff]
+			^ t[4][(v >> 24) & 0xff]
+			^ t[3][(v >> 32) & 0xff]
+			^ t[2][(v >> 40) & 0xff]
+			^ t[1][(v >> 48) & 0xff]
+			^ t[0][v >> 56];
+		data += 8;
+		len -= 8;
+	}
+#endif /* CONFIG_CRC_SLICE != 1 */
+	yut_unroll16(
+		len,
+		v = crc ^ *data++;
+		crc = (crc >> 8) ^ t[0][v & 0xff];);
+	return crc;
+}
+
+static void
+build_crc64_table(u64 (*t)[256], u64 poly) {
+	int i, k;
+	u8 c;
+	for (i = 0; i < 256; i++) {
+		c = (u8)i;
+		t[0][i] = crc64_bitwise(poly, 0, &c, 1);
+	}
+	for (k = 1; k < 8; k++)
+		for (i = 0; i < 256; i++)
+			t[k][i] = (t[k - 1][i] >> 8)
+				^ t[0][t[k - 1][i] & 0xff];
+}
+
+/*****************************************************************************
+ *
+ *
+ *
+ *****************************************************************************/
+u16
+ycrc16(u16 crc, const u8 *data, u32 len) {
+	if (unlikely(!len || !data)) {
+		yassert(0);
+		return crc;
+	}
+	return (*_crc16_kernel)(crc, data, len);
+}
+
 u32
-ycrc32(register u32 crc, register const u8 *data, u32 len) {
+ycrc32(u32 crc, const u8 *data, u32 len) {
 	if (unlikely(!len || !data)) {
 		yassert(0);
 		return crc;
 	}
+	return (*_crc32_kernel)(crc, data, len);
+}
 
-	yut_unroll16(
-		len,
-		crc = (crc >> 8) \
-			^ _crc32_table[(crc ^ (*data++)) & 0xff];);
+u32
+ycrc32c(u32 crc, const u8 *data, u32 len) {
+	if (unlikely(!data)) {
+		yassert(!len);
+		return crc;
+	}
+	return ~(*_crc32_kernel)(~crc, data, len);
+}
+
+u32
+ycrc32_combine(u32 crca, u32 crcb, u64 lenb) {
+	/* crca * x^(8 * lenb) + crcb */
+	return gf2_multmodp(gf2_xnmodp(lenb, 3), crca) ^ crcb;
+}
+
+/*---------------------------------------------------------------------------
+ * Parallel
+ *--------------------------------------------------------------------------*/
+struct crcjob {
+	const u8 *data;
+	u64 len;
+	u32 crc; /* crc of this chunk starting from 0 */
+	bool started; /* thread is started */
+	pthread_t thread;
+};
+
+static u32
+crc32_long(u32 crc, const u8 *data, u64 len) {
+	u32 n;
+	while (len) {
+		n = len > KERNEL_MAX_LEN ? KERNEL_MAX_LEN : (u32)len;
+		crc = (*_crc32_kernel)(crc, data, n);
+		data += n;
+		len -= n;
+	}
+	return crc;
+}
+
+static void *
+crcjob_run(void *arg) {
+	struct crcjob *j = arg;
+	j->crc = crc32_long(0, j->data, j->len);
+	return NULL;
+}
+
+u32
+ycrc32_parallel(u32 crc, const u8 *data, u64 len, int nthreads) {
+	int i;
+	u64 chunk;
+	struct crcjob *jobs;
+
+	if (unlikely(!len || !data)) {
+		yassert(0);
+		return crc;
+	}
+	if (nthreads <= 0)
+		nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > len / PARALLEL_MIN_CHUNK)
+		nthreads = (int)(len / PARALLEL_MIN_CHUNK);
+	if (nthreads <= 1
+		|| unlikely(!(jobs = ymalloc(sizeof(*jobs) * nthreads)))
+	) { return crc32_long(crc, data, len); }
+
+	chunk = len / nthreads;
+	/* jobs[0] is run at caller's thread. */
+	for (i = 1; i < nthreads; i++) {
+		jobs[i].data = data + chunk * i;
+		jobs[i].len = (i == nthreads - 1) ? len - chunk * i : chunk;
+		jobs[i].started = !pthread_create(
+			&jobs[i].thread, NULL, &crcjob_run, &jobs[i]);
+	}
+	crc = crc32_long(crc, data, chunk);
+	for (i = 1; i < nthreads; i++) {
+		if (likely(jobs[i].started))
+			fatali0(pthread_join(jobs[i].thread, NULL));
+		else
+			/* Fail to create thread. Run it here. */
+			crcjob_run(&jobs[i]);
+		crc = ycrc32_combine(crc, jobs[i].crc, jobs[i].len);
+	}
+	yfree(jobs);
 	return crc;
 }
+
+/*****************************************************************************
+ *
+ *
+ *
+ *****************************************************************************/
+u64
+ycrc64(u64 crc, const u8 *data, u32 len) {
+	if (unlikely(!data)) {
+		yassert(!len);
+		return crc;
+	}
+	return likely(_crc64_ready)
+		? crc64_slice8(_crc64_ecma, crc, data, len)
+		: crc64_bitwise(CRC64_ECMA_POLY, crc, data, len);
+}
+
+u64
+ycrc64_iso(u64 crc, const u8 *data, u32 len) {
+	if (unlikely(!data)) {
+		yassert(!len);
+		return crc;
+	}
+	return likely(_crc64_ready)
+		? crc64_slice8(_crc64_iso, crc, data, len)
+		: crc64_bitwise(CRC64_ISO_POLY, crc, data, len);
+}
+
+/*****************************************************************************
+ *
+ *
+ *
+ *****************************************************************************/
+#ifdef CONFIG_TEST
+/*
+ * These functions are used for testing and benchmarking each kernel.
+ * @slice 1, 8 or 16. Byte-wise kernel is used for other values.
+ */
+u32
+crc32_slice(int slice, u32 crc, const u8 *data, u32 len) {
+	return (*crc32_kernel(slice))(crc, data, len);
+}
+
+u16
+crc16_slice(int slice, u16 crc, const u8 *data, u32 len) {
+	return (*crc16_kernel(slice))(crc, data, len);
+}
+#endif /* CONFIG_TEST */
+
+static int
+minit(const struct ylib_config *cfg) {
+	crc32_kernel_t hwk;
+	build_slice_tables();
+	build_x2n_table();
+	_crc32_kernel = (hwk = crc32_hw_kernel())
+		? hwk
+		: crc32_kernel(CONFIG_CRC_SLICE);
+	_crc16_kernel = crc16_kernel(CONFIG_CRC_SLICE);
+	build_crc64_table(_crc64_ecma, CRC64_ECMA_POLY);
+	build_crc64_table(_crc64_iso, CRC64_ISO_POLY);
+	_crc64_ready = TRUE;
+	return 0;
+}
+
+static void
+mexit(void) {
+	_crc32_kernel = &crc32_slice1;
+	_crc16_kernel = &crc16_slice1;
+	_crc64_ready = FALSE;
+}
+
+LIB_MODULE(crc, minit, mexit);
@@ -71,6 +71,8 @@
 /** Hardware memory barrier */
 #define hwbarrier() __sync_synchronize()
 #define unused __attribute__((unused))
+/** Hint to bring memory at @p addr to cache */
+#define prefetch(addr) __builtin_prefetch(addr)
 
 #else /* __GNUC__ */
 
@@ -78,6 +80,7 @@
 #define barrier()
 #define hwbarrier()
 #define unused
+#define prefetch(addr)
 
 #endif /* __GNUC__ */
 
@@ -0,0 +1,125 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if defined(__linux__) && defined(__NR_membarrier)
+#include <linux/membarrier.h>
+#define HAVE_MEMBARRIER
+#endif
+
+#include "common.h"
+#include "ebr.h"
+
+
+__thread struct ebr_reader ebr_rdr___;
+u64 ebr_gepoch___ = 1;
+bool ebr_membarrier___;
+
+static struct ylistl_link _rdrs = { &_rdrs, &_rdrs };
+static pthread_mutex_t _rdrs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t _rdrkey;
+static pthread_once_t _rdronce = PTHREAD_ONCE_INIT;
+
+static INLINE void
+smp_mb_writer(void) {
+#ifdef HAVE_MEMBARRIER
+	if (likely(ebr_membarrier___)) {
+		fatali0((int)syscall(__NR_membarrier,
+			MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0));
+		return;
+	}
+#endif /* HAVE_MEMBARRIER */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void
+membarrier_init(void) {
+#ifdef HAVE_MEMBARRIER
+	long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+	ebr_membarrier___ = cmds > 0
+		&& (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+		&& !syscall(__NR_membarrier,
+			MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0);
+#endif /* HAVE_MEMBARRIER */
+}
+
+static void
+reader_unregister(void *arg) {
+	struct ebr_reader *r = arg;
+	fatali0(pthread_mutex_lock(&_rdrs_lock));
+	ylistl_remove(&r->lk);
+	fatali0(pthread_mutex_unlock(&_rdrs_lock));
+}
+
+static void
+reader_init(void) {
+	/* Key is used to unregister reader at thread exit. */
+	fatali0(pthread_key_create(&_rdrkey, &reader_unregister));
+	membarrier_init();
+}
+
+void
+ebr_register___(void) {
+	struct ebr_reader *r = &ebr_rdr___;
+	fatali0(pthread_once(&_rdronce, &reader_init));
+	fatali0(pthread_mutex_lock(&_rdrs_lock));
+	ylistl_add_last(&_rdrs, &r->lk);
+	fatali0(pthread_mutex_unlock(&_rdrs_lock));
+	fatali0(pthread_setspecific(_rdrkey, r));
+	r->registered = TRUE;
+}
+
+void
+ebr_synchronize(void) {
+	struct ebr_reader *r;
+	u64 re, e;
+	yassert(!ebr_in_read());
+	/* Way of memory barrier SHOULD be decided before. */
+	fatali0(pthread_once(&_rdronce, &reader_init));
+	e = __atomic_add_fetch(&ebr_gepoch___, 1, __ATOMIC_SEQ_CST);
+	/* Make readers' epochs visible. Or readers see unlinked state. */
+	smp_mb_writer();
+	fatali0(pthread_mutex_lock(&_rdrs_lock));
+	ylistl_foreach_item(r, &_rdrs, struct ebr_reader, lk) {
+		while ((re = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST))
+			&& re < e
+		) { sched_yield(); }
+	}
+	fatali0(pthread_mutex_unlock(&_rdrs_lock));
+}
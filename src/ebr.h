@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/*
+ * Epoch based reclamation shared by concurrent data structures.
+ * This is internal header.
+ *
+ * Global epoch increases at every grace period. Reader in critical
+ *   section publishes the epoch observed at the beginning of the section.
+ * After memory is unlinked, writer increases global epoch to 'e' and waits
+ *   until all readers are out of section or in section started with
+ *   epoch >= 'e'. These readers cannot see the unlinked memory.
+ *
+ * Reader needs full memory barrier between publishing epoch and reading
+ *   data structure. But, it stalls out-of-order execution of readers and is
+ *   very expensive when lookups miss cache. So, if possible, it's
+ *   replaced with compiler barrier at reader and membarrier(2) at writer
+ *   (same with liburcu).
+ *
+ * Section is not per-object. It covers all objects using this.
+ */
+
+#pragma once
+
+#include "common.h"
+#include "ylistl.h"
+
+struct ebr_reader {
+	struct ylistl_link lk;
+	u64 epoch; /* 0 if not in critical section */
+	u32 nest;
+	bool registered;
+};
+
+/* DO NOT use followings directly. */
+extern __thread struct ebr_reader ebr_rdr___;
+extern u64 ebr_gepoch___;
+/* membarrier(2) can be used. Readers doesn't need memory barrier */
+extern bool ebr_membarrier___;
+void
+ebr_register___(void);
+
+
+/**
+ * Begin read-side critical section. It can be nested.
+ * Memory unlinked after this, is not freed until @ref ebr_read_end.
+ */
+static INLINE void
+ebr_read_begin(void) {
+	struct ebr_reader *r = &ebr_rdr___;
+	if (unlikely(!r->registered))
+		ebr_register___();
+	if (likely(!r->nest++)) {
+		__atomic_store_n(&r->epoch,
+			__atomic_load_n(&ebr_gepoch___, __ATOMIC_RELAXED),
+			__ATOMIC_RELAXED);
+		/* epoch SHOULD be visible before reading data structure */
+		if (likely(ebr_membarrier___))
+			barrier();
+		else
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+}
+
+/**
+ * End read-side critical section.
+ */
+static INLINE void
+ebr_read_end(void) {
+	struct ebr_reader *r = &ebr_rdr___;
+	yassert(r->nest > 0);
+	if (likely(!--r->nest))
+		__atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Is current thread in read-side critical section?
+ * Waiting grace period in the section is deadlock.
+ */
+static INLINE bool
+ebr_in_read(void) {
+	return !!ebr_rdr___.nest;
+}
+
+/**
+ * Wait until all readers that may see unlinked memory are done.
+ * This SHOULD NOT be called in read-side critical section.
+ */
+void
+ebr_synchronize(void);
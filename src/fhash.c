@@ -0,0 +1,368 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "yhash.h"
+#include "yhashl.h"
+#include "yfhash.h"
+#include "fhash.h"
+
+#define FH_VERSION 1
+#define FH_BOM 0x01020304
+#define FH_EMPTY ((u32)-1)
+/* Max load factor: 3/4 */
+#define FH_MAXLOAD_NUM 3
+#define FH_MAXLOAD_DEN 4
+
+static const char fh_magic[8] = { 'y', 'f', 'h', 'a', 's', 'h', 0, 0 };
+
+struct yfhash {
+	const struct fhdr *hdr;
+	const struct fslot *slots;
+	const u8 *arena;
+	bool mapped; /* memory is mapped from file */
+};
+
+static INLINE u64
+align8(u64 n) {
+	return (n + 7) & ~(u64)7;
+}
+
+static INLINE u64
+entry_sz(u32 klen, u32 vlen) {
+	return sizeof(struct fentry) + align8(klen) + align8(vlen);
+}
+
+static INLINE const u8 *
+entry_value(const struct fentry *e) {
+	return e->d + align8(e->klen);
+}
+
+static INLINE u32
+fh_hash(const struct fhdr *hdr, const void *key, u32 keylen) {
+	return (u32)yhashl_fast(key, keylen, hdr->seed);
+}
+
+static void
+fh_setup(struct yfhash *fh, const void *mem) {
+	fh->hdr = mem;
+	fh->slots = (const struct fslot *)(fh->hdr + 1);
+	fh->arena = (const u8 *)(fh->slots + fh->hdr->cap);
+}
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+const void *
+yfhash_bytes_str(const void *obj, uint32_t *len) {
+	*len = (u32)strlen(obj);
+	return obj;
+}
+
+struct item {
+	const void *k, *v;
+	u32 klen, vlen;
+};
+
+struct yfhash *
+yfhash_freeze(
+	const struct yhash *h,
+	yfhash_bytes_t kbytes,
+	yfhash_bytes_t vbytes
+) {
+	int r unused;
+	u32 i, j, n, cap;
+	u64 arenasz, off;
+	void *v;
+	const void **keys = NULL;
+	struct item *items = NULL;
+	struct fhdr *hdr;
+	struct fslot *slots = NULL;
+	struct fentry *e;
+	u8 *mem = NULL, *arena;
+	struct yfhash *fh = NULL;
+
+	n = yhash_sz(h);
+	cap = 1;
+	while ((u64)cap * FH_MAXLOAD_NUM < (u64)n * FH_MAXLOAD_DEN)
+		cap <<= 1;
+	if (unlikely(!(keys = ymalloc(sizeof(*keys) * (n ? n : 1)))
+		|| !(items = ymalloc(sizeof(*items) * (n ? n : 1)))
+		|| !(fh = ymalloc(sizeof(*fh))))
+	) { goto fail; }
+	n = yhash_keys(h, keys, n);
+	arenasz = 0;
+	for (i = 0; i < n; i++) {
+		v = NULL;
+		r = yhash_get(h, keys[i], &v);
+		yassert(!r);
+		items[i].k = (*kbytes)(keys[i], &items[i].klen);
+		items[i].v = (*vbytes)(v, &items[i].vlen);
+		arenasz += entry_sz(items[i].klen, items[i].vlen);
+	}
+	/* Offset of entry is 32bit in 8 bytes unit. */
+	if (unlikely(arenasz / 8 >= FH_EMPTY))
+		goto fail;
+	mem = ymalloc(sizeof(*hdr) + sizeof(*slots) * cap + arenasz);
+	if (unlikely(!mem))
+		goto fail;
+	hdr = (struct fhdr *)mem;
+	memcpy(hdr->magic, fh_magic, sizeof(hdr->magic));
+	hdr->bom = FH_BOM;
+	hdr->version = FH_VERSION;
+	hdr->sz = n;
+	hdr->cap = cap;
+	hdr->seed = yhashl_new_seed();
+	hdr->arenasz = arenasz;
+	hdr->totalsz = sizeof(*hdr) + sizeof(*slots) * cap + arenasz;
+	slots = (struct fslot *)(hdr + 1);
+	arena = (u8 *)(slots + cap);
+	for (i = 0; i < cap; i++)
+		slots[i].off = FH_EMPTY;
+
+	/* Place items. 'off' is index of item for now. */
+	for (i = 0; i < n; i++) {
+		u32 hv32 = fh_hash(hdr, items[i].k, items[i].klen);
+		for (j = hv32 & (cap - 1);
+			FH_EMPTY != slots[j].off;
+			j = (j + 1) & (cap - 1)
+		) {
+			struct item *it = &items[slots[j].off];
+			/* Different keys SHOULD have different bytes. */
+			if (unlikely(slots[j].hv32 == hv32
+				&& it->klen == items[i].klen
+				&& !memcmp(it->k, items[i].k, it->klen))
+			) { goto fail; }
+		}
+		slots[j].hv32 = hv32;
+		slots[j].off = i;
+	}
+	/* Write entries in the order of slots. */
+	off = 0;
+	for (j = 0; j < cap; j++) {
+		struct item *it;
+		if (FH_EMPTY == slots[j].off)
+			continue;
+		it = &items[slots[j].off];
+		e = (struct fentry *)(arena + off);
+		e->klen = it->klen;
+		e->vlen = it->vlen;
+		memset(e->d, 0, entry_sz(it->klen, it->vlen) - sizeof(*e));
+		memcpy(e->d, it->k, it->klen);
+		memcpy(e->d + align8(it->klen), it->v, it->vlen);
+		slots[j].off = (u32)(off / 8);
+		off += entry_sz(it->klen, it->vlen);
+	}
+	yassert(off == arenasz);
+	fh_setup(fh, mem);
+	fh->mapped = FALSE;
+	yfree(keys);
+	yfree(items);
+	return fh;
+
+ fail:
+	if (mem)
+		yfree(mem);
+	if (fh)
+		yfree(fh);
+	if (items)
+		yfree(items);
+	if (keys)
+		yfree(keys);
+	return NULL;
+}
+
+void
+yfhash_destroy(struct yfhash *fh) {
+	if (fh->mapped)
+		munmap((void *)fh->hdr, fh->hdr->totalsz);
+	else
+		yfree((void *)fh->hdr);
+	yfree(fh);
+}
+
+u32
+yfhash_sz(const struct yfhash *fh) {
+	return fh->hdr->sz;
+}
+
+int
+yfhash_get(
+	const struct yfhash *fh,
+	const void *key,
+	uint32_t keylen,
+	const void **value,
+	uint32_t *valuelen
+) {
+	u32 i, n;
+	const struct fentry *e;
+	const struct fhdr *hdr = fh->hdr;
+	u32 mask = hdr->cap - 1;
+	u32 hv32 = fh_hash(hdr, key, keylen);
+	/* 'n' is used not to loop forever at broken file */
+	for (i = hv32 & mask, n = hdr->cap;
+		n && FH_EMPTY != fh->slots[i].off;
+		i = (i + 1) & mask, n--
+	) {
+		if (fh->slots[i].hv32 != hv32)
+			continue;
+		e = (const struct fentry *)(fh->arena + (u64)fh->slots[i].off * 8);
+		/* Entry SHOULD be in the arena even if file is broken. */
+		if (unlikely((u64)fh->slots[i].off * 8 + sizeof(*e)
+				> hdr->arenasz
+			|| (u64)fh->slots[i].off * 8
+				+ entry_sz(e->klen, e->vlen) > hdr->arenasz)
+		) { return -EINVAL; }
+		if (e->klen != keylen || memcmp(e->d, key, keylen))
+			continue;
+		if (value)
+			*value = entry_value(e);
+		if (valuelen)
+			*valuelen = e->vlen;
+		return 0;
+	}
+	return -ENOENT;
+}
+
+/****************************************************************************
+ *
+ * File
+ *
+ ****************************************************************************/
+int
+yfhash_write_fd(const struct yfhash *fh, int fd) {
+	ssize_t n;
+	const u8 *p = (const u8 *)fh->hdr;
+	u64 sz = fh->hdr->totalsz;
+	while (sz > 0) {
+		n = write(fd, p, sz);
+		if (unlikely(n < 0)) {
+			if (EINTR == errno)
+				continue;
+			if (EAGAIN == errno) {
+				/* Non-blocking fd. Wait until it's writable */
+				struct pollfd pfd;
+				pfd.fd = fd;
+				pfd.events = POLLOUT;
+				if (unlikely(0 > poll(&pfd, 1, -1)
+					     && EINTR != errno))
+					return -errno;
+				continue;
+			}
+			return -errno;
+		}
+		p += n;
+		sz -= n;
+	}
+	return 0;
+}
+
+int
+yfhash_write_file(const struct yfhash *fh, const char *path) {
+	int fd, r;
+	if (unlikely(0 > (fd = open(path,
+		O_WRONLY | O_CLOEXEC | O_CREAT | O_TRUNC,
+		0644)))
+	) { return -errno; }
+	r = yfhash_write_fd(fh, fd);
+	if (unlikely(close(fd) && !r))
+		r = -errno;
+	return r;
+}
+
+/* Only header is verified. Entries are verified when they are used. */
+static bool
+fh_verify(const struct fhdr *hdr, u64 filesz) {
+	u64 slotsz;
+	if (memcmp(hdr->magic, fh_magic, sizeof(hdr->magic))
+		|| FH_BOM != hdr->bom
+		|| FH_VERSION != hdr->version
+		|| !hdr->cap
+		|| (hdr->cap & (hdr->cap - 1))
+		|| hdr->sz >= hdr->cap
+		|| hdr->totalsz != filesz)
+	{ return FALSE; }
+	slotsz = sizeof(struct fslot) * (u64)hdr->cap;
+	/* Values from file may be crafted. Sum of them may overflow. */
+	return slotsz <= filesz - sizeof(*hdr)
+		&& hdr->arenasz == filesz - sizeof(*hdr) - slotsz;
+}
+
+int
+yfhash_map_fd(struct yfhash **out, int fd) {
+	struct stat st;
+	void *mem;
+	struct yfhash *fh;
+	if (unlikely(fstat(fd, &st)))
+		return -errno;
+	if (unlikely((u64)st.st_size < sizeof(struct fhdr)))
+		return -EINVAL;
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (unlikely(MAP_FAILED == mem))
+		return -errno;
+	if (unlikely(!fh_verify(mem, st.st_size))) {
+		munmap(mem, st.st_size);
+		return -EINVAL;
+	}
+	if (unlikely(!(fh = ymalloc(sizeof(*fh))))) {
+		munmap(mem, st.st_size);
+		return -ENOMEM;
+	}
+	fh_setup(fh, mem);
+	fh->mapped = TRUE;
+	*out = fh;
+	return 0;
+}
+
+int
+yfhash_map_file(struct yfhash **out, const char *path) {
+	int fd, r;
+	if (unlikely(0 > (fd = open(path, O_RDONLY | O_CLOEXEC))))
+		return -errno;
+	r = yfhash_map_fd(out, fd);
+	close(fd);
+	return r;
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/*
+ * Layout of frozen hash. This is internal header.
+ *
+ * Memory block(and file) layout
+ *
+ *   +----------------------+
+ *   | header               |
+ *   +----------------------+
+ *   | slot[0 .. cap)       |  packed open addressing. linear probing.
+ *   +----------------------+
+ *   | arena                |  entries. 8 bytes aligned.
+ *   +----------------------+
+ *
+ * entry: | klen(u32) | vlen(u32) | key | pad | value | pad |
+ *
+ * Entries are stored in the order of slots. So, probing sequential slots
+ *   also visits sequential entries.
+ */
+
+#pragma once
+
+#include "common.h"
+
+struct fhdr {
+	char magic[8];
+	u32 bom; /* to check byte order */
+	u32 version;
+	u32 sz; /* number of items */
+	u32 cap; /* number of slots. power of 2 */
+	u64 seed; /* for yhashl_fast */
+	u64 arenasz; /* in bytes */
+	u64 totalsz; /* in bytes. whole block including header */
+};
+
+struct fslot {
+	u32 hv32;
+	u32 off; /* offset of entry in arena. In 8 bytes unit. */
+};
+
+struct fentry {
+	u32 klen;
+	u32 vlen;
+	u8 d[]; /* key and value */
+};
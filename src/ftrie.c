@@ -0,0 +1,900 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "ytrie.h"
+#include "yftrie.h"
+
+/*
+ * Memory block(and file) layout
+ *
+ *   +----------------------+
+ *   | header               |
+ *   +----------------------+
+ *   | unit[0 .. nunits)    |  base and check of states
+ *   +----------------------+
+ *   | ninfo[0 .. nunits)   |  first child and next sibling. 8 bytes aligned.
+ *   +----------------------+
+ *   | leaf[0 .. sz)        |  in the order of key
+ *   +----------------------+
+ *   | tail                 |  suffixes of keys. 8 bytes aligned.
+ *   +----------------------+
+ *   | arena                |  values. Each value is 8 bytes aligned.
+ *   +----------------------+
+ *
+ * Label of transition by key byte 'c' is 'c + 1'. Label 0 means end of key.
+ * State 0 is root. State whose base is negative is leaf. Leaf has only one
+ *   key, and the rest of key is stored at tail of leaf '-base - 1'.
+ */
+#define FT_VERSION 1
+#define FT_BOM 0x01020304
+#define FT_FREE ((u32)-1) /* check of free unit */
+#define FT_ROOT ((u32)-2) /* check of root */
+#define FT_NLABELS 257
+/* Free unit is not tried anymore if it fails to be used this many times. */
+#define FT_MAX_FAIL 16
+/* Base SHOULD be positive s32. */
+#define FT_MAX_UNITS ((u32)INT32_MAX - FT_NLABELS)
+
+static const char ft_magic[8] = { 'y', 'f', 't', 'r', 'i', 'e', 0, 0 };
+
+struct fhdr {
+	char magic[8];
+	u32 bom; /* to check byte order */
+	u32 version;
+	u32 sz; /* number of keys(= number of leaves) */
+	u32 nunits;
+	u64 tailsz; /* in bytes. 8 bytes aligned */
+	u64 arenasz; /* in bytes */
+	u64 totalsz; /* in bytes. whole block including header */
+};
+
+struct funit {
+	s32 base;
+	u32 check; /* parent state */
+};
+
+/* 'label + 1' is stored. 0 means 'none'. */
+struct fninfo {
+	u16 child; /* first child */
+	u16 sibling; /* next sibling */
+};
+
+struct fleaf {
+	u32 toff; /* offset in tail */
+	u32 tsz;
+	u32 voff; /* offset of value in arena. In 8 bytes unit. */
+	u32 vsz;
+};
+
+struct yftrie {
+	const struct fhdr *hdr;
+	const struct funit *units;
+	const struct fninfo *ninfo;
+	const struct fleaf *leaves;
+	const u8 *tail;
+	const u8 *arena;
+	bool mapped; /* memory is mapped from file */
+};
+
+static INLINE u64
+align8(u64 n) {
+	return (n + 7) & ~(u64)7;
+}
+
+static INLINE u64
+ninfo_sz(u32 nunits) {
+	return align8(sizeof(struct fninfo) * (u64)nunits);
+}
+
+static u64
+block_sz(u32 nunits, u32 sz, u64 tailsz, u64 arenasz) {
+	return sizeof(struct fhdr)
+		+ sizeof(struct funit) * (u64)nunits
+		+ ninfo_sz(nunits)
+		+ sizeof(struct fleaf) * (u64)sz
+		+ tailsz
+		+ arenasz;
+}
+
+static void
+ft_setup(struct yftrie *ft, const void *mem) {
+	ft->hdr = mem;
+	ft->units = (const struct funit *)(ft->hdr + 1);
+	ft->ninfo = (const struct fninfo *)(ft->units + ft->hdr->nunits);
+	ft->leaves = (const struct fleaf *)
+		((const u8 *)ft->ninfo + ninfo_sz(ft->hdr->nunits));
+	ft->tail = (const u8 *)(ft->leaves + ft->hdr->sz);
+	ft->arena = ft->tail + ft->hdr->tailsz;
+}
+
+/****************************************************************************
+ *
+ * Build
+ *
+ ****************************************************************************/
+struct item {
+	u64 koff; /* offset in key buffer */
+	u32 ksz;
+	u32 depth; /* depth of leaf state */
+	const void *v;
+	u32 vsz;
+};
+
+struct frame {
+	u32 s; /* state */
+	u32 depth;
+	u32 lo, hi; /* range of items */
+};
+
+struct builder {
+	yftrie_bytes_t vbytes;
+	int err;
+	/* Keys collected from trie, in order. */
+	u8 *kb;
+	u64 kbsz, kbcap;
+	struct item *items;
+	u32 n, ncap;
+	/* Double array under construction */
+	struct funit *u;
+	struct fninfo *ni;
+	u32 *next, *prev; /* circular list of free units */
+	u8 *nfail;
+	u32 ucap;
+	u32 head; /* FT_FREE if there is no free unit */
+	u32 nfree;
+	u32 nunits; /* 1 + largest used unit */
+};
+
+static INLINE const u8 *
+item_key(const struct builder *b, u32 i) {
+	return b->kb + b->items[i].koff;
+}
+
+/* @return 0 if success. -ENOMEM if fails. */
+static int
+reserve(void **p, u64 *cap, u64 n, size_t esz) {
+	void *np;
+	u64 ncap = *cap * 2;
+	if (n <= *cap)
+		return 0;
+	if (ncap < n)
+		ncap = n;
+	if (ncap < 16)
+		ncap = 16;
+	if (unlikely(ncap * esz != (size_t)(ncap * esz)))
+		return -ENOMEM;
+	np = *p ? yrealloc(*p, ncap * esz) : ymalloc(ncap * esz);
+	if (unlikely(!np))
+		return -ENOMEM;
+	*p = np;
+	*cap = ncap;
+	return 0;
+}
+
+static int
+collect_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct builder *b = tag;
+	struct item *it;
+	u64 ncap = b->ncap;
+	if (unlikely((b->err = reserve((void **)&b->kb, &b->kbcap,
+			b->kbsz + sz, 1))
+		|| (b->err = reserve((void **)&b->items, &ncap,
+			(u64)b->n + 1, sizeof(*b->items))))
+	) { return 0; }
+	b->ncap = (u32)ncap;
+	memcpy(b->kb + b->kbsz, key, sz);
+	/* Keys SHOULD be given in strictly increasing order. */
+	if (b->n) {
+		const struct item *pit = &b->items[b->n - 1];
+		int c = memcmp(item_key(b, b->n - 1), b->kb + b->kbsz,
+			pit->ksz < sz ? pit->ksz : sz);
+		if (unlikely(c > 0 || (!c && pit->ksz >= sz))) {
+			b->err = -EINVAL;
+			return 0;
+		}
+	}
+	it = &b->items[b->n++];
+	it->koff = b->kbsz;
+	it->ksz = sz;
+	it->v = (*b->vbytes)(v, &it->vsz);
+	b->kbsz += sz;
+	return 1;
+}
+
+static int
+da_grow(struct builder *b, u64 n) {
+	int r;
+	u32 i, old = b->ucap;
+	u64 cap;
+	if (n <= b->ucap)
+		return 0;
+	if (unlikely(n > FT_MAX_UNITS))
+		return -ENOMEM;
+	cap = (u64)old * 2;
+	if (cap < n)
+		cap = n;
+	if (cap > FT_MAX_UNITS)
+		cap = FT_MAX_UNITS;
+#define grow(p) do {							\
+		u64 c__ = old;						\
+		if (unlikely(r = reserve((void **)&(p), &c__, cap,	\
+			sizeof(*(p)))))					\
+			return r;					\
+	} while (0)
+	grow(b->u);
+	grow(b->ni);
+	grow(b->next);
+	grow(b->prev);
+	grow(b->nfail);
+#undef grow
+	for (i = old; i < cap; i++) {
+		b->u[i].base = 0;
+		b->u[i].check = FT_FREE;
+		b->ni[i].child = b->ni[i].sibling = 0;
+		b->nfail[i] = 0;
+		b->next[i] = i + 1;
+		b->prev[i] = i - 1;
+	}
+	/* Link new units at the end of free list. */
+	if (FT_FREE == b->head) {
+		b->head = old;
+		b->prev[old] = (u32)cap - 1;
+		b->next[cap - 1] = old;
+	} else {
+		u32 last = b->prev[b->head];
+		b->next[last] = old;
+		b->prev[old] = last;
+		b->next[cap - 1] = b->head;
+		b->prev[b->head] = (u32)cap - 1;
+	}
+	b->nfree += (u32)cap - old;
+	b->ucap = (u32)cap;
+	return 0;
+}
+
+static void
+da_unlink(struct builder *b, u32 i) {
+	if (b->next[i] == i)
+		b->head = FT_FREE;
+	else {
+		b->next[b->prev[i]] = b->next[i];
+		b->prev[b->next[i]] = b->prev[i];
+		if (b->head == i)
+			b->head = b->next[i];
+	}
+	b->nfree--;
+}
+
+static void
+da_use(struct builder *b, u32 i, u32 parent) {
+	yassert(FT_FREE == b->u[i].check);
+	/* Unit given up by 'nfail' is not in the free list. */
+	if (b->nfail[i] < FT_MAX_FAIL)
+		da_unlink(b, i);
+	b->u[i].check = parent;
+	if (b->nunits <= i)
+		b->nunits = i + 1;
+}
+
+/*
+ * Find base where all units for @labels are free.
+ * @param labels Sorted labels
+ * @return base. -errno if fails.
+ */
+static s64
+da_find_base(struct builder *b, const u16 *labels, u32 nl) {
+	int r;
+	u32 i, e, enext, tries;
+	u64 base;
+	for (e = b->head, tries = b->nfree;
+		tries && FT_FREE != e;
+		e = enext, tries--
+	) {
+		enext = b->next[e];
+		if (e >= labels[0]) {
+			base = e - labels[0];
+			if (unlikely(r = da_grow(b, base + labels[nl - 1] + 1)))
+				return r;
+			for (i = 1; i < nl; i++)
+				if (FT_FREE != b->u[base + labels[i]].check)
+					break;
+			if (i >= nl)
+				return (s64)base;
+		}
+		if (++b->nfail[e] >= FT_MAX_FAIL) {
+			da_unlink(b, e);
+			if (FT_FREE == b->head)
+				break;
+		}
+	}
+	/* Use fresh units. */
+	base = b->ucap > labels[0] ? b->ucap - labels[0] : 0;
+	if (unlikely(r = da_grow(b, base + labels[nl - 1] + 1)))
+		return r;
+	return (s64)base;
+}
+
+static int
+da_build(struct builder *b) {
+	int r;
+	s64 base;
+	u32 i, j, k, nl, sp;
+	u16 labels[FT_NLABELS];
+	u32 rlo[FT_NLABELS + 1];
+	struct frame f, *st = NULL;
+	u64 stcap = 0;
+
+	if (unlikely(r = da_grow(b, FT_NLABELS)))
+		return r;
+	da_unlink(b, 0);
+	b->u[0].check = FT_ROOT;
+	b->nunits = 1;
+	if (!b->n)
+		return 0;
+
+	sp = 0;
+	if (unlikely(r = reserve((void **)&st, &stcap, 1, sizeof(*st))))
+		return r;
+	st[sp].s = 0;
+	st[sp].depth = 0;
+	st[sp].lo = 0;
+	st[sp].hi = b->n;
+	sp++;
+	while (sp) {
+		f = st[--sp];
+		if (f.hi - f.lo == 1) {
+			b->u[f.s].base = -(s32)f.lo - 1;
+			b->items[f.lo].depth = f.depth;
+			continue;
+		}
+		/* Group items by byte at 'depth'. */
+		nl = 0;
+		i = f.lo;
+		/* Key ending here is the first one, if exists. */
+		if (b->items[i].ksz == f.depth) {
+			labels[nl] = 0;
+			rlo[nl++] = i++;
+		}
+		while (i < f.hi) {
+			u8 c = item_key(b, i)[f.depth];
+			labels[nl] = (u16)c + 1;
+			rlo[nl++] = i;
+			for (i++; i < f.hi && item_key(b, i)[f.depth] == c; i++);
+		}
+		rlo[nl] = f.hi;
+		if (unlikely(0 > (base = da_find_base(b, labels, nl)))) {
+			r = (int)base;
+			goto done;
+		}
+		b->u[f.s].base = (s32)base;
+		b->ni[f.s].child = labels[0] + 1;
+		for (k = 0; k < nl; k++) {
+			j = (u32)base + labels[k];
+			da_use(b, j, f.s);
+			b->ni[j].sibling = k + 1 < nl ? labels[k + 1] + 1 : 0;
+		}
+		if (unlikely(r = reserve((void **)&st, &stcap,
+			(u64)sp + nl, sizeof(*st))))
+		{ goto done; }
+		/* Push in reverse order to build in the order of key. */
+		for (k = nl; k > 0; k--) {
+			st[sp].s = (u32)base + labels[k - 1];
+			st[sp].depth = labels[k - 1] ? f.depth + 1 : f.depth;
+			st[sp].lo = rlo[k - 1];
+			st[sp].hi = rlo[k];
+			sp++;
+		}
+	}
+	r = 0;
+
+ done:
+	yfree(st);
+	return r;
+}
+
+static void
+builder_clean(struct builder *b) {
+	void *ps[] = { b->kb, b->items, b->u, b->ni, b->next, b->prev,
+		b->nfail };
+	u32 i;
+	for (i = 0; i < sizeof(ps) / sizeof(ps[0]); i++)
+		if (ps[i])
+			yfree(ps[i]);
+}
+
+const void *
+yftrie_bytes_str(const void *obj, uint32_t *len) {
+	*len = (u32)strlen(obj);
+	return obj;
+}
+
+struct yftrie *
+yftrie_freeze(const struct ytrie *t, yftrie_bytes_t vbytes) {
+	u32 i;
+	u64 tailsz, arenasz, totalsz, toff, voff;
+	struct builder b;
+	struct fhdr *hdr;
+	struct funit *units;
+	struct fninfo *ninfo;
+	struct fleaf *leaves;
+	u8 *mem = NULL, *tail, *arena;
+	struct yftrie *ft = NULL;
+
+	memset(&b, 0, sizeof(b));
+	b.vbytes = vbytes;
+	b.head = FT_FREE;
+	if (ytrie_sz(t)
+		&& (0 > ytrie_iterate((struct ytrie *)t, &b,
+			(const u8 *)"", 0, &collect_cb)
+			|| b.err)
+	) { goto fail; }
+	/* Leaf index SHOULD fit in negative s32 base. */
+	if (unlikely(b.n > INT32_MAX || da_build(&b)))
+		goto fail;
+
+	tailsz = arenasz = 0;
+	for (i = 0; i < b.n; i++) {
+		tailsz += b.items[i].ksz - b.items[i].depth;
+		arenasz += align8(b.items[i].vsz);
+	}
+	tailsz = align8(tailsz);
+	/* Offsets are 32bit. Value offset is in 8 bytes unit. */
+	if (unlikely(tailsz > UINT32_MAX || arenasz / 8 > UINT32_MAX))
+		goto fail;
+	totalsz = block_sz(b.nunits, b.n, tailsz, arenasz);
+	if (unlikely(totalsz != (size_t)totalsz
+		|| !(mem = ycalloc(1, totalsz))
+		|| !(ft = ymalloc(sizeof(*ft))))
+	) { goto fail; }
+	hdr = (struct fhdr *)mem;
+	memcpy(hdr->magic, ft_magic, sizeof(hdr->magic));
+	hdr->bom = FT_BOM;
+	hdr->version = FT_VERSION;
+	hdr->sz = b.n;
+	hdr->nunits = b.nunits;
+	hdr->tailsz = tailsz;
+	hdr->arenasz = arenasz;
+	hdr->totalsz = totalsz;
+	ft_setup(ft, mem);
+	units = (struct funit *)ft->units;
+	ninfo = (struct fninfo *)ft->ninfo;
+	leaves = (struct fleaf *)ft->leaves;
+	tail = (u8 *)ft->tail;
+	arena = (u8 *)ft->arena;
+	memcpy(units, b.u, sizeof(*units) * b.nunits);
+	memcpy(ninfo, b.ni, sizeof(*ninfo) * b.nunits);
+	toff = voff = 0;
+	for (i = 0; i < b.n; i++) {
+		const struct item *it = &b.items[i];
+		leaves[i].toff = (u32)toff;
+		leaves[i].tsz = it->ksz - it->depth;
+		leaves[i].voff = (u32)(voff / 8);
+		leaves[i].vsz = it->vsz;
+		memcpy(tail + toff, item_key(&b, i) + it->depth, leaves[i].tsz);
+		memcpy(arena + voff, it->v, it->vsz);
+		toff += leaves[i].tsz;
+		voff += align8(it->vsz);
+	}
+	ft->mapped = FALSE;
+	builder_clean(&b);
+	return ft;
+
+ fail:
+	if (mem)
+		yfree(mem);
+	builder_clean(&b);
+	return NULL;
+}
+
+void
+yftrie_destroy(struct yftrie *ft) {
+	if (ft->mapped)
+		munmap((void *)ft->hdr, ft->hdr->totalsz);
+	else
+		yfree((void *)ft->hdr);
+	yfree(ft);
+}
+
+u32
+yftrie_sz(const struct yftrie *ft) {
+	return ft->hdr->sz;
+}
+
+/****************************************************************************
+ *
+ * Query
+ *
+ ****************************************************************************/
+/* @return NULL if file is broken. */
+static const struct fleaf *
+ft_leaf(const struct yftrie *ft, s32 base) {
+	const struct fleaf *l;
+	u32 i = (u32)(-(base + 1));
+	if (unlikely(i >= ft->hdr->sz))
+		return NULL;
+	l = &ft->leaves[i];
+	if (unlikely((u64)l->toff + l->tsz > ft->hdr->tailsz
+		|| (u64)l->voff * 8 + l->vsz > ft->hdr->arenasz))
+	{ return NULL; }
+	return l;
+}
+
+static INLINE const void *
+leaf_value(const struct yftrie *ft, const struct fleaf *l) {
+	return ft->arena + (u64)l->voff * 8;
+}
+
+/*
+ * @param s Non-leaf state
+ * @return Child state by @p label. FT_FREE if there isn't.
+ */
+static INLINE u32
+ft_child(const struct yftrie *ft, u32 s, u32 label) {
+	u32 c = (u32)ft->units[s].base + label;
+	return likely(c < ft->hdr->nunits && ft->units[c].check == s)
+		? c : FT_FREE;
+}
+
+/*
+ * Find state whose subtree has all keys starting with @p prefix.
+ * @param pd (out) Depth of the state. It may be less than @p sz if the
+ *   state is leaf.
+ * @return 0 if success. -ENOENT if there is no key starting with @p prefix.
+ */
+static int
+ft_find_prefix(
+	const struct yftrie *ft,
+	const u8 *prefix,
+	u32 sz,
+	u32 *ps,
+	u32 *pd
+) {
+	u32 s = 0, d;
+	const struct fleaf *l;
+	if (unlikely(!ft->hdr->sz))
+		return -ENOENT;
+	for (d = 0; d < sz; d++) {
+		if (ft->units[s].base < 0) {
+			if (unlikely(!(l = ft_leaf(ft, ft->units[s].base))))
+				return -EINVAL;
+			if (l->tsz < sz - d
+				|| memcmp(ft->tail + l->toff, prefix + d, sz - d))
+			{ return -ENOENT; }
+			break;
+		}
+		if (FT_FREE == (s = ft_child(ft, s, (u32)prefix[d] + 1)))
+			return -ENOENT;
+	}
+	*ps = s;
+	*pd = d;
+	return 0;
+}
+
+int
+yftrie_get(
+	const struct yftrie *ft,
+	const void *key,
+	uint32_t keysz,
+	const void **value,
+	uint32_t *valuesz
+) {
+	int r;
+	u32 s, d;
+	const struct fleaf *l;
+	if (unlikely(r = ft_find_prefix(ft, key, keysz, &s, &d)))
+		return r;
+	/* Key ends here. */
+	if (ft->units[s].base >= 0
+		&& FT_FREE == (s = ft_child(ft, s, 0)))
+	{ return -ENOENT; }
+	if (unlikely(ft->units[s].base >= 0
+		|| !(l = ft_leaf(ft, ft->units[s].base))))
+	{ return -EINVAL; }
+	if (l->tsz != keysz - d
+		|| memcmp(ft->tail + l->toff, (const u8 *)key + d, l->tsz))
+	{ return -ENOENT; }
+	if (value)
+		*value = leaf_value(ft, l);
+	if (valuesz)
+		*valuesz = l->vsz;
+	return 0;
+}
+
+struct fframe {
+	u32 s;
+	u32 depth;
+	u32 next; /* 'label + 1' of next child to visit. 0 if done. */
+};
+
+struct fiter {
+	const struct yftrie *ft;
+	struct fframe st[YTRIE_MAX_KEY_LEN + 1];
+	u32 sp;
+	u8 kb[YTRIE_MAX_KEY_LEN];
+	u32 off; /* key passed to callback starts here */
+	void *tag;
+	int (*cb)(void *, const u8 *, u32, const void *, u32);
+};
+
+/*
+ * Visit leaf or push state to stack.
+ * @return 1 to keep going. 0 if callback stops. -EINVAL if file is broken.
+ */
+static int
+fiter_visit(struct fiter *it, u32 s, u32 depth) {
+	const struct fleaf *l;
+	s32 base = it->ft->units[s].base;
+	if (base < 0) {
+		if (unlikely(!(l = ft_leaf(it->ft, base))
+			|| depth + l->tsz > YTRIE_MAX_KEY_LEN))
+		{ return -EINVAL; }
+		memcpy(it->kb + depth, it->ft->tail + l->toff, l->tsz);
+		return (*it->cb)(it->tag,
+			it->kb + it->off,
+			depth + l->tsz - it->off,
+			leaf_value(it->ft, l),
+			l->vsz) ? 1 : 0;
+	}
+	if (unlikely(it->sp > YTRIE_MAX_KEY_LEN))
+		return -EINVAL;
+	it->st[it->sp].s = s;
+	it->st[it->sp].depth = depth;
+	it->st[it->sp].next = it->ft->ninfo[s].child;
+	it->sp++;
+	return 1;
+}
+
+int
+yftrie_iterate(
+	const struct yftrie *ft,
+	void *tag,
+	const void *prefix,
+	uint32_t prefixsz,
+	int (*cb)(void *, const u8 *, u32, const void *, u32)
+) {
+	int r;
+	u32 s, d, label;
+	struct fframe *f;
+	struct fiter *it;
+	if (unlikely(prefixsz > YTRIE_MAX_KEY_LEN))
+		return -ENOENT;
+	if (unlikely(r = ft_find_prefix(ft, prefix, prefixsz, &s, &d)))
+		return r;
+	if (unlikely(!(it = ymalloc(sizeof(*it)))))
+		return -ENOMEM;
+	it->ft = ft;
+	it->sp = 0;
+	it->off = prefixsz;
+	it->tag = tag;
+	it->cb = cb;
+	memcpy(it->kb, prefix, d);
+	if (0 >= (r = fiter_visit(it, s, d)))
+		goto done;
+	while (it->sp) {
+		f = &it->st[it->sp - 1];
+		if (!f->next) {
+			it->sp--;
+			continue;
+		}
+		label = f->next - 1;
+		if (unlikely(FT_FREE == (s = ft_child(ft, f->s, label)))) {
+			r = -EINVAL;
+			goto done;
+		}
+		/* Siblings are in increasing order. Broken file may loop. */
+		if (unlikely(ft->ninfo[s].sibling
+			&& ft->ninfo[s].sibling <= f->next)
+		) {
+			r = -EINVAL;
+			goto done;
+		}
+		f->next = ft->ninfo[s].sibling;
+		d = f->depth;
+		if (label) {
+			if (unlikely(d >= YTRIE_MAX_KEY_LEN)) {
+				r = -EINVAL;
+				goto done;
+			}
+			it->kb[d++] = (u8)(label - 1);
+		}
+		if (0 >= (r = fiter_visit(it, s, d)))
+			goto done;
+	}
+	r = 1;
+
+ done:
+	yfree(it);
+	return r;
+}
+
+int
+yftrie_auto_complete(
+	const struct yftrie *ft,
+	const void *keyprefix,
+	uint32_t keyprefixsz,
+	uint8_t *buf,
+	uint32_t bufsz
+) {
+	int r;
+	u32 s, c, d, bi, off;
+	u8 b;
+	const struct fleaf *l;
+
+#define append(p, n) do {						\
+		if (unlikely(bi + (n) >= bufsz))			\
+			return -EINVAL;					\
+		memcpy(buf + bi, p, n);					\
+		bi += (n);						\
+	} while (0)
+
+	if (unlikely(!bufsz))
+		return -EINVAL;
+	r = ft_find_prefix(ft, keyprefix, keyprefixsz, &s, &d);
+	if (-ENOENT == r)
+		return 2;
+	if (unlikely(r))
+		return r;
+	bi = 0;
+	off = keyprefixsz - d;
+	while (TRUE) {
+		if (ft->units[s].base < 0) {
+			if (unlikely(!(l = ft_leaf(ft, ft->units[s].base))))
+				return -EINVAL;
+			append(ft->tail + l->toff + off, l->tsz - off);
+			buf[bi] = 0;
+			return 1;
+		}
+		c = ft->ninfo[s].child;
+		if (unlikely(!c || FT_FREE == (s = ft_child(ft, s, c - 1))))
+			return -EINVAL;
+		/* Key ends here or branches. */
+		if (1 == c || ft->ninfo[s].sibling) {
+			buf[bi] = 0;
+			return 0;
+		}
+		b = (u8)(c - 2);
+		append(&b, 1);
+		off = 0;
+	}
+#undef append
+}
+
+/****************************************************************************
+ *
+ * File
+ *
+ ****************************************************************************/
+int
+yftrie_write_fd(const struct yftrie *ft, int fd) {
+	ssize_t n;
+	const u8 *p = (const u8 *)ft->hdr;
+	u64 sz = ft->hdr->totalsz;
+	while (sz > 0) {
+		n = write(fd, p, sz);
+		if (unlikely(n < 0)) {
+			if (EINTR == errno)
+				continue;
+			if (EAGAIN == errno) {
+				/* Non-blocking fd. Wait until it's writable */
+				struct pollfd pfd;
+				pfd.fd = fd;
+				pfd.events = POLLOUT;
+				if (unlikely(0 > poll(&pfd, 1, -1)
+					     && EINTR != errno))
+					return -errno;
+				continue;
+			}
+			return -errno;
+		}
+		p += n;
+		sz -= n;
+	}
+	return 0;
+}
+
+int
+yftrie_write_file(const struct yftrie *ft, const char *path) {
+	int fd, r;
+	if (unlikely(0 > (fd = open(path,
+		O_WRONLY | O_CLOEXEC | O_CREAT | O_TRUNC,
+		0644)))
+	) { return -errno; }
+	r = yftrie_write_fd(ft, fd);
+	if (unlikely(close(fd) && !r))
+		r = -errno;
+	return r;
+}
+
+/* Only header is verified. States are verified when they are used. */
+static bool
+ft_verify(const struct fhdr *hdr, u64 filesz) {
+	if (memcmp(hdr->magic, ft_magic, sizeof(hdr->magic))
+		|| FT_BOM != hdr->bom
+		|| FT_VERSION != hdr->version
+		|| !hdr->nunits
+		|| hdr->nunits > FT_MAX_UNITS
+		|| hdr->tailsz > UINT32_MAX
+		|| hdr->arenasz > filesz
+		|| hdr->totalsz != filesz)
+	{ return FALSE; }
+	return block_sz(hdr->nunits, hdr->sz, hdr->tailsz, hdr->arenasz)
+		== filesz;
+}
+
+int
+yftrie_map_fd(struct yftrie **out, int fd) {
+	struct stat st;
+	void *mem;
+	struct yftrie *ft;
+	if (unlikely(fstat(fd, &st)))
+		return -errno;
+	if (unlikely((u64)st.st_size < sizeof(struct fhdr)))
+		return -EINVAL;
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (unlikely(MAP_FAILED == mem))
+		return -errno;
+	if (unlikely(!ft_verify(mem, st.st_size))) {
+		munmap(mem, st.st_size);
+		return -EINVAL;
+	}
+	if (unlikely(!(ft = ymalloc(sizeof(*ft))))) {
+		munmap(mem, st.st_size);
+		return -ENOMEM;
+	}
+	ft_setup(ft, mem);
+	ft->mapped = TRUE;
+	*out = ft;
+	return 0;
+}
+
+int
+yftrie_map_file(struct yftrie **out, const char *path) {
+	int fd, r;
+	if (unlikely(0 > (fd = open(path, O_RDONLY | O_CLOEXEC))))
+		return -errno;
+	r = yftrie_map_fd(out, fd);
+	close(fd);
+	return r;
+}
@@ -37,10 +37,17 @@
 #include <memory.h>
 #include <string.h>
 #include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
 #include "yhash.h"
 #include "yhashl.h"
+#include "ystatprint.h"
+#include "yut.h"
 /* crc is used as hash function */
 #include "ycrc.h"
 
@@ -51,18 +58,182 @@
 /* hash node */
 struct hn {
 	struct yhashl_node hn;
+	struct ylistl_link olk; /* link in insertion order */
 	void *v; /* data value */
 };
 
+/*
+ * Key of binary-key hash.
+ * Key stored in the hash has key bytes right after this structure.
+ */
+struct bkey {
+	const u8 *data;
+	u32 len;
+	u32 hv32;
+};
+
+/* Internal option. Binary-key hash(yhashb). */
+#define OPT_BINKEY (1 << 16)
+/* Internal option. Hash is small table now. */
+#define OPT_SMALL (1 << 17)
+
 typedef int (*kcp_func_t)(const void **, const void *);
 typedef void (*free_func_t)(void *);
 
+/*
+ * Open addressing(OA) engine.
+ *
+ * Swiss-table like layout. Slots are grouped by OA_GROUP slots.
+ * Each slot has 1 byte control metadata.
+ *
+ *   ctrl: | c | c | c | ... | c | c | c | ... |
+ *         |<-- OA_GROUP --->|<-- OA_GROUP --->|
+ *   slot: | s | s | s | ... | s | s | s | ... |
+ *
+ * ctrl byte
+ *   0xxxxxxx: FULL. 7 bits(h2) from hash value.
+ *   10000000: EMPTY.
+ *   11111110: DELETED(tombstone).
+ *
+ * Probing is done in the unit of group. All ctrl bytes in a group are
+ *   compared with h2 at once(SSE2). Then, only slots matched are compared
+ *   by key. If group has EMPTY slot, probing stops there.
+ * Groups are probed quadratically(triangular numbers). Number of group is
+ *   power of 2. So, all groups are visited.
+ */
+#define OA_GROUP 16
+#define OA_MIN_CAP OA_GROUP
+#define OA_EMPTY ((u8)0x80)
+#define OA_DELETED ((u8)0xfe)
+#define OA_NONE ((u32)-1)
+
+/*
+ * FULL slots are linked in insertion order by index(prev, next).
+ * So, iteration is O(sz) regardless of capacity.
+ */
+struct oaslot {
+	void *key;
+	void *v;
+	u32 hv32;
+	u32 prev, next; /* OA_NONE at the end */
+};
+
+struct oa {
+	struct oaslot *slots;
+	u8 *ctrl;
+	u32 cap; /* number of slots. power of 2 and >= OA_MIN_CAP */
+	u32 sz; /* number of FULL slots */
+	u32 ndel; /* number of DELETED slots */
+	u32 head, tail; /* first and last slot in insertion order */
+	u32 nrehash; /* number of rehash. Slots are moved by rehash */
+	yhashl_hfunc_t h;
+	yhashl_keyeq_t keq;
+	u64 seed; /* for YHASHL_HFUNC_FAST_XXX */
+};
+
+/*
+ * Nodes of chaining engine are allocated from chunks owned by the hash.
+ * Size of chunk is doubled up to SLAB_MAX_CHUNK nodes.
+ * Freed nodes are kept at free list and reused. Chunks are freed when
+ *   hash is cleaned. So, destroying hash doesn't need to free node one by one.
+ * If most of nodes are freed, live nodes are moved to new chunk and old
+ *   chunks are freed(repack). See 'chain_need_repack'.
+ * Nodes of binary-key hash have variable size. So, they are not in slab.
+ */
+#define SLAB_MIN_CHUNK 8
+#define SLAB_MAX_CHUNK 1024
+
+struct slabchunk {
+	struct slabchunk *next;
+	struct hn n[];
+};
+
+struct slab {
+	struct slabchunk *chunks;
+	struct hn *free; /* list of freed nodes. linked by 'v' */
+	u32 nfresh; /* number of never-used nodes at the head chunk */
+	u32 chunksz; /* number of nodes of the head chunk */
+	u32 cap; /* number of nodes in all chunks */
+	u32 nused; /* number of nodes in use */
+};
+
+/*
+ * Small table.
+ * Up to SMALL_MAX items are kept in the array embedded in hash object, and
+ *   searched linearly. So, creating small hash needs only one allocation.
+ * Hash is promoted to engine(chaining or open addressing) when more items
+ *   are added. It's not demoted until it is reset.
+ * Slot is same with the one of open addressing engine.
+ */
+#define SMALL_MAX 8
+
+struct sslot {
+	void *key;
+	void *v;
+	u32 hv32;
+};
+
+/* Items are in insertion order */
+struct small {
+	yhashl_hfunc_t h;
+	yhashl_keyeq_t keq;
+	u64 seed;
+	u32 sz;
+	struct sslot e[SMALL_MAX];
+};
+
+#ifdef CONFIG_HASH_STAT
+/* Counters and rehash events. See yhash_stat */
+struct hstat {
+	u64 nget, nget_miss, nset, nremove;
+	u32 nrehash;
+	u64 rehash_ns, rehash_max_ns;
+};
+#endif /* CONFIG_HASH_STAT */
+
 /* order of struct member has meaning */
 struct yhash {
-	struct yhashl h;
+	union {
+		struct {
+			struct yhashl h; /* chaining engine */
+			struct slab slab;
+			struct ylistl_link order; /* nodes in insertion order */
+		};
+		struct oa oa; /* open addressing engine(YHASH_open_addressing) */
+		struct small s; /* small table(OPT_SMALL) */
+	};
 	void (*vfree)(void *); /* free for hash value */
 	void (*kfree)(void *); /* free for hash key */
 	kcp_func_t kcp; /* copy hash key */
+	int opt;
+	u32 reserved; /* hash is not shrunk below this. See yhash_reserve */
+	/* Items may be moved(index is changed) if this is changed.
+	 * (promotion, removing item at small table)
+	 */
+	u32 gen;
+	struct ylistl_link cursors; /* cursors opened at the hash */
+#ifdef CONFIG_HASH_STAT
+	struct hstat st;
+#endif /* CONFIG_HASH_STAT */
+};
+
+/*
+ * Position of an item. Node at chaining engine. Slot index at others.
+ */
+union hpos {
+	struct hn *n; /* NULL at the end */
+	u32 i; /* OA_NONE at the end */
+};
+
+struct yhash_cursor {
+	struct ylistl_link lk; /* link at yhash.cursors */
+	struct yhash *h;
+	union hpos pos; /* item to visit next. Meaningless if 'end' */
+	/* Item at 'pos' is found again with key if 'gen' is out of date. */
+	void *key;
+	u32 hv32;
+	u32 gen;
+	bool end;
 };
 
 
@@ -138,276 +309,1774 @@ hfunc_s(const void *k) {
 	return ycrc32(0, (const u8 *)k, (u32)strlen((const char *)k) + 1);
 }
 
+/*---------------------------------------------------------------------------
+ * Binary key
+ *--------------------------------------------------------------------------*/
+static INLINE size_t
+bkey_sz(const struct bkey *k) {
+	return sizeof(*k) + k->len;
+}
+
+/* Copy key to @p mem whose size is at least bkey_sz(k) */
+static INLINE struct bkey *
+bkey_copy(void *mem, const struct bkey *k) {
+	struct bkey *nk = mem;
+	nk->data = (const u8 *)(nk + 1);
+	nk->len = k->len;
+	nk->hv32 = k->hv32;
+	if (likely(k->len))
+		memcpy(nk + 1, k->data, k->len);
+	return nk;
+}
+
+static int
+kcp_b(const void **newk, const void *k) {
+	void *m = ymalloc(bkey_sz(k));
+	if (unlikely(!m))
+		return -ENOMEM;
+	*newk = bkey_copy(m, k);
+	return 0;
+}
+
+static int
+keq_b(const void *k0, const void *k1) {
+	const struct bkey *a = k0, *b = k1;
+	return !(a->len == b->len
+		&& (!a->len || !memcmp(a->data, b->data, a->len)));
+}
+
+/* Hash value is calculated before. See bkey_init() */
+static u32
+hfunc_b(const void *k) {
+	return ((const struct bkey *)k)->hv32;
+}
+
 /****************************************************************************
  *
  *
  *
  ****************************************************************************/
-static INLINE u32
-hmapsz(const struct yhash *h) {
-	return yhashl_hmapsz(&h->h);
+static INLINE bool
+is_binkey(const struct yhash *h) {
+	return !!(h->opt & OPT_BINKEY);
 }
 
-static INLINE u32
-hv__(u32 mapbits, u32 hv32) {
-	return hv32 >> (32 - mapbits);
+static INLINE bool
+is_oa(const struct yhash *h) {
+	return !!(h->opt & YHASH_open_addressing);
 }
 
-static INLINE u32
-hv_(const struct yhash *h, u32 hv32) {
-	return hv__(h->h.mapbits, hv32);
+static INLINE bool
+is_small(const struct yhash *h) {
+	return !!(h->opt & OPT_SMALL);
+}
+
+static INLINE yhashl_hfunc_t
+hfunc(const struct yhash *h) {
+	return is_small(h) ? h->s.h : is_oa(h) ? h->oa.h : h->h.h;
+}
+
+static INLINE yhashl_keyeq_t
+keqfunc(const struct yhash *h) {
+	return is_small(h) ? h->s.keq : is_oa(h) ? h->oa.keq : h->h.keq;
+}
+
+static INLINE u64
+hseed(const struct yhash *h) {
+	return is_small(h) ? h->s.seed : is_oa(h) ? h->oa.seed : h->h.seed;
 }
 
 static INLINE u32
-hv(const struct yhash *h, const struct hn *n) {
-	return hv_(h, n->hn.hv32);
+hhash(const struct yhash *h, const void *key) {
+	return yhashl_hv32(hfunc(h), hseed(h), key);
+}
+
+/*---------------------------------------------------------------------------
+ * Statistics(CONFIG_HASH_STAT)
+ * All of these are compiled out if CONFIG_HASH_STAT is not defined.
+ *--------------------------------------------------------------------------*/
+#ifdef CONFIG_HASH_STAT
+
+/* Hash may be given as const. But counters are not contents of hash. */
+#define hstat_inc(h, field) (((struct yhash *)(h))->st.field++)
+
+static INLINE u64
+hstat_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static INLINE void
+hstat_rehash(struct yhash *h, u64 t0) {
+	u64 d = hstat_now() - t0;
+	h->st.nrehash++;
+	h->st.rehash_ns += d;
+	if (d > h->st.rehash_max_ns)
+		h->st.rehash_max_ns = d;
+}
+
+#else /* CONFIG_HASH_STAT */
+
+#define hstat_inc(h, field) do { } while (0)
+
+static INLINE u64
+hstat_now(void) {
+	return 0;
 }
 
+static INLINE void
+hstat_rehash(unused struct yhash *h, unused u64 t0) { }
+
+#endif /* CONFIG_HASH_STAT */
+
 
 /****************************************************************************
  *
- *
+ * Slab for nodes of chaining engine
  *
  ****************************************************************************/
-static free_func_t
-hfree_func(free_func_t f) {
-	return f ? YHASH_MEM_FREE == f
-			? &free_default
-			: f
-		: &free_noop;
+static INLINE void
+slab_init(struct slab *sl) {
+	sl->chunks = NULL;
+	sl->free = NULL;
+	sl->nfresh = sl->chunksz = 0;
+	sl->cap = sl->nused = 0;
 }
 
 static void
-hdestroy_nodes(struct yhash *h) {
-	struct hn *n;
-	struct yhashl_node *cur, *tmp;
-	yhashl_foreach_safe(&h->h, cur, tmp) {
-		n = containerof(cur, struct hn, hn);
-		(*h->kfree)(yhashl_node_key(cur));
-		(*h->vfree)(n->v);
-		yhashl_node_remove(&h->h, cur);
-		yfree(n);
+slab_clean(struct slab *sl) {
+	struct slabchunk *c, *next;
+	for (c = sl->chunks; c; c = next) {
+		next = c->next;
+		yfree(c);
 	}
+	slab_init(sl);
 }
 
-static struct yhash *
-hash_create_internal(
-	void (*vfree)(void *),
-	void (*kfree)(void *),
-	int (*kcp)(const void **, const void *),
-	int (*keq)(const void *, const void *),
-	u32 (*hfunc)(const void *)
-) {
-	int r;
-	if (unlikely(!hfunc))
-		return NULL;
-
-	struct yhash *h = ymalloc(sizeof(*h));
-	if (unlikely(!h))
-		return NULL;
-	r = yhashl_init2(&h->h, hfunc, keq, MIN_HBITS);
-	if (unlikely(r)) {
-		yfree(h);
-		return NULL;
-	}
-	h->vfree = vfree;
-	h->kfree = kfree;
-	h->kcp = kcp;
-	return h;
+static INLINE void
+slab_free(struct slab *sl, struct hn *n) {
+	n->v = sl->free;
+	sl->free = n;
+	sl->nused--;
 }
 
-int
-hash_set(
-	struct yhash *h,
-	const void ** const phkey,
-	void *key,
-	void **oldv,
-	void *v
-) {
-	int r;
-	struct hn *hn;
-	void *key_copied;
-	struct yhashl_node *hln;
-
-	/* We need to expand hash map size if hash seems to be full */
-	if (yhashl_sz(&h->h) > yhashl_hmapsz(&h->h) * 2)
-		/* return value is ignored intentionally.
-		 * Actually, even if hmodify fails, hash can still
-		 *   continue to add new value.
-		 */
-		yhashl_hremap(&h->h, h->h.mapbits + 1);
-
-	hn = ymalloc(sizeof(*hn));
-	if (unlikely(!hn))
-		return -ENOMEM;
-	r = (*h->kcp)((const void **)&key_copied, key);
-	if (unlikely(r)) {
-		yfree(hn);
+/* Add new chunk having @p chunksz nodes. */
+static int
+slab_add_chunk(struct slab *sl, u32 chunksz) {
+	struct slabchunk *c = ymalloc(sizeof(*c) + sizeof(c->n[0]) * chunksz);
+	if (unlikely(!c))
 		return -ENOMEM;
+	/* Never-used nodes at current head chunk go to free list. */
+	sl->nused += sl->nfresh;
+	while (sl->nfresh)
+		slab_free(sl, &sl->chunks->n[sl->chunksz - sl->nfresh--]);
+	c->next = sl->chunks;
+	sl->chunks = c;
+	sl->chunksz = sl->nfresh = chunksz;
+	sl->cap += chunksz;
+	return 0;
+}
+
+static struct hn *
+slab_alloc(struct slab *sl) {
+	struct hn *n;
+	u32 chunksz;
+	if (sl->free) {
+		n = sl->free;
+		sl->free = n->v;
+		sl->nused++;
+		return n;
 	}
-	hn->v = v;
-	hln = yhashl_set(&h->h, key_copied, &hn->hn);
-	if (phkey)
-		*phkey = yhashl_node_key(&hn->hn);
-	if (hln) {
-		/* get replaced hash item */
-		hn = containerof(hln, struct hn, hn);
-		if (oldv) *oldv = hn->v;
-		else (*h->vfree)(hn->v);
-		(*h->kfree)(key_copied);
-		yfree(hn);
+	if (unlikely(!sl->nfresh)) {
+		chunksz = sl->chunksz ? sl->chunksz * 2 : SLAB_MIN_CHUNK;
+		if (chunksz > SLAB_MAX_CHUNK)
+			chunksz = SLAB_MAX_CHUNK;
+		if (unlikely(slab_add_chunk(sl, chunksz)))
+			return NULL;
 	}
-	return hln ? 0 : 1;
+	sl->nused++;
+	return &sl->chunks->n[sl->chunksz - sl->nfresh--];
+}
+
+/* Make @p n nodes can be allocated without allocating new chunk */
+static int
+slab_reserve(struct slab *sl, u32 n) {
+	u32 avail = sl->cap - sl->nused;
+	if (n <= avail)
+		return 0;
+	n -= avail;
+	return slab_add_chunk(sl, n < SLAB_MIN_CHUNK ? SLAB_MIN_CHUNK : n);
 }
 
+
 /****************************************************************************
  *
- *
+ * Open addressing engine
  *
  ****************************************************************************/
-struct yhash *
-yhashi_create(void (*vfree)(void *)) {
-	return hash_create_internal(
-		hfree_func(vfree),
-		&free_noop, /* kfree */
-		&kcp_i, /* kcp */
-		&keq_default, /* keq */
-		&hfunc_i);
+/* Maximum number of FULL + DELETED slots: 7/8 */
+static INLINE u32
+oa_maxload(u32 cap) {
+	return cap - cap / 8;
 }
 
-struct yhash *
-yhashs_create(void (*vfree)(void *), bool key_deepcopy) {
-	return hash_create_internal(
-		hfree_func(vfree),
-		&kfree_s, /* kfree */
-		key_deepcopy ? &kcp_s : &kcp_shallow, /* kcp */
-		&keq_s, /* keq */
-		&hfunc_s);
+/*
+ * Hash functions given by user may be poor(ex. 'hfunc_i' for pointer).
+ * So, hash value is mixed(Fibonacci hashing) before using it.
+ * h2: bits[32, 39). group: bits[39, 64).
+ */
+static INLINE u64
+oa_mix(u32 hv32) {
+	return hv32 * 0x9E3779B97F4A7C15ULL;
 }
 
-struct yhash *
-yhasho_create(
-	void (*vfree)(void *),
-	void (*keyfree)(void *),
-	kcp_func_t keycopy,
-	int (*keyeq)(const void *, const void *),
-	u32 (*hfunc)(const void *key)
-) {
-	/* Invalid request */
-	if (unlikely(!hfunc)) return NULL;
-	return hash_create_internal(
-		hfree_func(vfree),
-		hfree_func(keyfree),
-		keycopy ? keycopy : &kcp_shallow, /* kcp */
-		keyeq ? keyeq : &keq_default, /* keq */
-		hfunc);
+static INLINE u8
+oa_h2(u64 m) {
+	return (u8)((m >> 32) & 0x7f);
 }
 
-/*---------------------------------------------------------------------------
- *
- *--------------------------------------------------------------------------*/
-struct yhash *
-yhash_create(const struct yhash *h) {
-	return hash_create_internal(
-		h->vfree,
-		h->kfree,
-		h->kcp,
-		h->h.keq,
-		h->h.h);
+static INLINE u32
+oa_group(const struct oa *oa, u64 m) {
+	return (u32)(m >> 39) & (oa->cap / OA_GROUP - 1);
 }
 
-int
-yhash_reset(struct yhash *h) {
-	hdestroy_nodes(h);
-	yhashl_clean(&h->h);
-	return yhashl_init(&h->h, h->h.h, h->h.keq);
+/* @return bit mask of slots in group whose ctrl is @c */
+static INLINE u32
+oa_match(const u8 *g, u8 c) {
+#ifdef __SSE2__
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+	return (u32)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+#else /* __SSE2__ */
+	int i;
+	u32 bits = 0;
+	for (i = 0; i < OA_GROUP; i++)
+		if (g[i] == c)
+			bits |= 1 << i;
+	return bits;
+#endif /* __SSE2__ */
 }
 
-void
-yhash_destroy(struct yhash *h) {
-	hdestroy_nodes(h);
-	yhashl_clean(&h->h);
-	yfree(h);
+/* @return bit mask of slots in group that are EMPTY or DELETED. */
+static INLINE u32
+oa_match_free(const u8 *g) {
+#ifdef __SSE2__
+	return (u32)_mm_movemask_epi8(
+		_mm_loadu_si128((const __m128i *)g));
+#else /* __SSE2__ */
+	int i;
+	u32 bits = 0;
+	for (i = 0; i < OA_GROUP; i++)
+		if (g[i] & 0x80)
+			bits |= 1 << i;
+	return bits;
+#endif /* __SSE2__ */
 }
 
-u32
-yhash_sz(const struct yhash *h) {
-	return yhashl_sz(&h->h);
+static INLINE bool
+oa_is_full(const struct oa *oa, u32 i) {
+	return !(oa->ctrl[i] & 0x80);
 }
 
-bool
-yhash_is_sametype(const struct yhash *h0, const struct yhash *h1) {
-	return h0->h.keq == h1->h.keq
-		&& h0->h.h == h1->h.h
-		&& h0->kcp == h1->kcp
-		&& h0->kfree == h1->kfree
-		&& h0->vfree == h1->vfree;
+static INLINE u32
+oa_hv32(const struct oa *oa, const void *key) {
+	return yhashl_hv32(oa->h, oa->seed, key);
 }
 
-u32
-yhash_keys(const struct yhash *h, const void **keysbuf, u32 bufsz) {
-	struct yhashl_node *cur;
-	u32 i = 0;
-	yhashl_foreach(&h->h, cur) {
-		if (i >= bufsz) goto done;
-		keysbuf[i++] = yhashl_node_key(cur);
-	}
- done:
-	return i;
+static int
+oa_alloc(struct oa *oa, u32 cap) {
+	/* slots and ctrl bytes are allocated at once. */
+	u8 *mem = ymalloc((sizeof(*oa->slots) + 1) * (size_t)cap);
+	if (unlikely(!mem))
+		return -ENOMEM;
+	oa->slots = (struct oaslot *)mem;
+	oa->ctrl = mem + sizeof(*oa->slots) * (size_t)cap;
+	memset(oa->ctrl, OA_EMPTY, cap);
+	oa->cap = cap;
+	oa->sz = oa->ndel = 0;
+	oa->head = oa->tail = OA_NONE;
+	return 0;
 }
 
-int
-yhash_set(struct yhash *h, void *key, void *v) {
-	return hash_set(h, NULL, key, NULL, v);
+static int
+oa_init(struct oa *oa, yhashl_hfunc_t hfunc, yhashl_keyeq_t keq) {
+	oa->h = hfunc;
+	oa->keq = keq;
+	oa->seed = yhashl_new_seed();
+	oa->nrehash = 0;
+	return oa_alloc(oa, OA_MIN_CAP);
 }
 
-int
-yhash_set2(struct yhash *h, void *key, void **oldv, void *v) {
-	return hash_set(h, NULL, key, oldv, v);
+static void
+oa_clean(struct oa *oa) {
+	yfree(oa->slots);
 }
 
-int
-yhash_set3(
-	struct yhash *h,
-	const void ** const phkey,
-	void *key,
-	void *v
-) {
-	return hash_set(h, phkey, key, NULL, v);
+static u32
+oa_find(const struct oa *oa, const void *key, u32 hv32) {
+	u32 bits, i, g, step;
+	const u8 *ctrl;
+	u64 m = oa_mix(hv32);
+	u8 h2 = oa_h2(m);
+	u32 gmask = oa->cap / OA_GROUP - 1;
+	g = oa_group(oa, m);
+	for (step = 0; step <= gmask; step++) {
+		ctrl = oa->ctrl + g * OA_GROUP;
+		bits = oa_match(ctrl, h2);
+		while (bits) {
+			i = g * OA_GROUP + __builtin_ctz(bits);
+			if (likely(oa->slots[i].hv32 == hv32
+				&& !(*oa->keq)(key, oa->slots[i].key))
+			) { return i; }
+			bits &= bits - 1;
+		}
+		if (likely(oa_match(ctrl, OA_EMPTY)))
+			return OA_NONE;
+		g = (g + step + 1) & gmask;
+	}
+	return OA_NONE;
 }
 
-int
-yhash_remove2(struct yhash *h, const void *key, void **value) {
-	struct hn *hn;
-	struct yhashl_node *hln = yhashl_remove(&h->h, key);
-	if (!hln) return 0;
+/* @return first EMPTY or DELETED slot in the probing sequence */
+static u32
+oa_find_free(const struct oa *oa, u32 hv32) {
+	u32 bits, g, step;
+	u32 gmask = oa->cap / OA_GROUP - 1;
+	g = oa_group(oa, oa_mix(hv32));
+	for (step = 0; step <= gmask; step++) {
+		bits = oa_match_free(oa->ctrl + g * OA_GROUP);
+		if (likely(bits))
+			return g * OA_GROUP + __builtin_ctz(bits);
+		g = (g + step + 1) & gmask;
+	}
+	/* There is always free slot due to max-load. */
+	yassert(0);
+	return OA_NONE;
+}
 
-	hn = containerof(hln, struct hn, hn);
-	if (value)
-		*value = hn->v;
+/* Item is added at the end of insertion order */
+static INLINE void
+oa_fill(struct oa *oa, u32 i, void *key, void *v, u32 hv32) {
+	struct oaslot *slot = &oa->slots[i];
+	oa->ctrl[i] = oa_h2(oa_mix(hv32));
+	slot->key = key;
+	slot->v = v;
+	slot->hv32 = hv32;
+	slot->prev = oa->tail;
+	slot->next = OA_NONE;
+	if (OA_NONE == oa->tail)
+		oa->head = i;
 	else
-		(*h->vfree)(hn->v);
-	(*h->kfree)(yhashl_node_key(hln));
-	yfree(hn);
-	if (yhashl_sz(&h->h) < yhashl_hmapsz(&h->h) / 2)
-		/* return value is ignored intentionally.
-		 * Failure is not harmful.
-		 */
-		yhashl_hremap(&h->h, h->h.mapbits - 1);
-	return 1;
+		oa->slots[oa->tail].next = i;
+	oa->tail = i;
+	oa->sz++;
 }
 
-int
-yhash_remove(struct yhash *h, const void *key) {
-	return yhash_remove2(h, key, NULL);
+static INLINE u32
+oa_map_index(const u32 *map, u32 i) {
+	return OA_NONE == i ? OA_NONE : map[i];
 }
 
-int
-yhash_get(const struct yhash *h, const void *key, void **value) {
-	struct yhashl_node *hln = yhashl_get(&h->h, key);
+/*
+ * Tombstones are purged by rehash.
+ * Old slots are visited sequentially(not in insertion order) not to chase
+ *   links. Links are translated with index map(old -> new) instead.
+ */
+static int
+oa_rehash(struct oa *oa, u32 cap) {
+	u32 i, j;
+	u32 *map;
+	struct oaslot *s, *os;
+	struct oa old = *oa;
+	if (cap < OA_MIN_CAP)
+		cap = OA_MIN_CAP;
+	if (unlikely(!(map = ymalloc(sizeof(*map) * old.cap))))
+		return -ENOMEM;
+	if (unlikely(oa_alloc(oa, cap))) {
+		*oa = old;
+		yfree(map);
+		return -ENOMEM;
+	}
+	for (i = 0; i < old.cap; i++) {
+		if (!oa_is_full(&old, i))
+			continue;
+		j = map[i] = oa_find_free(oa, old.slots[i].hv32);
+		oa->ctrl[j] = old.ctrl[i];
+	}
+	for (i = 0; i < old.cap; i++) {
+		if (!oa_is_full(&old, i))
+			continue;
+		os = &old.slots[i];
+		s = &oa->slots[map[i]];
+		s->key = os->key;
+		s->v = os->v;
+		s->hv32 = os->hv32;
+		s->prev = oa_map_index(map, os->prev);
+		s->next = oa_map_index(map, os->next);
+	}
+	oa->sz = old.sz;
+	oa->head = oa_map_index(map, old.head);
+	oa->tail = oa_map_index(map, old.tail);
+	oa->nrehash++;
+	oa_clean(&old);
+	yfree(map);
+	return 0;
+}
+
+/*
+ * @key SHOULD NOT be in the hash.
+ * There SHOULD be room for new item. See 'oa_grow'.
+ */
+static void
+oa_insert(struct oa *oa, void *key, void *v, u32 hv32) {
+	u32 i = oa_find_free(oa, hv32);
+	if (OA_DELETED == oa->ctrl[i])
+		oa->ndel--;
+	oa_fill(oa, i, key, v, hv32);
+}
+
+static void
+oa_remove_at(struct oa *oa, u32 i) {
+	struct oaslot *slot = &oa->slots[i];
+	if (OA_NONE == slot->prev)
+		oa->head = slot->next;
+	else
+		oa->slots[slot->prev].next = slot->next;
+	if (OA_NONE == slot->next)
+		oa->tail = slot->prev;
+	else
+		oa->slots[slot->next].prev = slot->prev;
+	/* If group has EMPTY, probing always stops at this group.
+	 * So, slot can be EMPTY instead of DELETED.
+	 */
+	if (oa_match(oa->ctrl + (i & ~(OA_GROUP - 1)), OA_EMPTY))
+		oa->ctrl[i] = OA_EMPTY;
+	else {
+		oa->ctrl[i] = OA_DELETED;
+		oa->ndel++;
+	}
+	oa->sz--;
+}
+
+/* Smallest capacity that can hold @p n items without rehash */
+static u32
+oa_cap_for(u32 n) {
+	u32 cap = OA_MIN_CAP;
+	while (oa_maxload(cap) < n && cap < (1U << 31))
+		cap <<= 1;
+	return cap;
+}
+
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+static free_func_t
+hfree_func(free_func_t f) {
+	return f ? YHASH_MEM_FREE == f
+			? &free_default
+			: f
+		: &free_noop;
+}
+
+/*---------------------------------------------------------------------------
+ * Small table
+ *--------------------------------------------------------------------------*/
+static INLINE u32
+small_find(const struct small *s, const void *key, u32 hv32) {
+	u32 i;
+	for (i = 0; i < s->sz; i++) {
+		if (s->e[i].hv32 == hv32 && !(*s->keq)(key, s->e[i].key))
+			return i;
+	}
+	return OA_NONE;
+}
+
+/* Index of items after @p i is changed. So, yhash.gen SHOULD be updated. */
+static INLINE void
+small_remove_at(struct small *s, u32 i) {
+	s->sz--;
+	/* Order of items is kept */
+	memmove(&s->e[i], &s->e[i + 1], sizeof(s->e[0]) * (s->sz - i));
+}
+
+/*---------------------------------------------------------------------------
+ * Position of item in insertion order
+ *--------------------------------------------------------------------------*/
+static INLINE union hpos
+hpos_first(const struct yhash *h) {
+	union hpos p;
+	if (is_small(h))
+		p.i = h->s.sz ? 0 : OA_NONE;
+	else if (is_oa(h))
+		p.i = h->oa.head;
+	else
+		p.n = ylistl_is_empty(&h->order)
+			? NULL
+			: containerof(h->order.next, struct hn, olk);
+	return p;
+}
+
+static INLINE union hpos
+hpos_next(const struct yhash *h, union hpos p) {
+	if (is_small(h))
+		p.i = p.i + 1 < h->s.sz ? p.i + 1 : OA_NONE;
+	else if (is_oa(h))
+		p.i = h->oa.slots[p.i].next;
+	else
+		p.n = p.n->olk.next == &h->order
+			? NULL
+			: containerof(p.n->olk.next, struct hn, olk);
+	return p;
+}
+
+static INLINE bool
+hpos_is_end(const struct yhash *h, union hpos p) {
+	return is_small(h) || is_oa(h) ? OA_NONE == p.i : !p.n;
+}
+
+static INLINE void *
+hpos_key(const struct yhash *h, union hpos p) {
+	return is_small(h)
+		? h->s.e[p.i].key
+		: is_oa(h)
+			? h->oa.slots[p.i].key
+			: yhashl_node_key(&p.n->hn);
+}
+
+static INLINE void *
+hpos_value(const struct yhash *h, union hpos p) {
+	return is_small(h)
+		? h->s.e[p.i].v
+		: is_oa(h) ? h->oa.slots[p.i].v : p.n->v;
+}
+
+/* Slot index may be changed if it is changed. */
+static INLINE u32
+hgen(const struct yhash *h) {
+	return !is_small(h) && is_oa(h) ? h->gen + h->oa.nrehash : h->gen;
+}
+
+/*---------------------------------------------------------------------------
+ * Cursor
+ *--------------------------------------------------------------------------*/
+static void
+cursor_set(struct yhash_cursor *c, union hpos p) {
+	const struct yhash *h = c->h;
+	c->pos = p;
+	c->gen = hgen(h);
+	c->end = hpos_is_end(h, p);
+	if (c->end)
+		return;
+	c->hv32 = is_small(h)
+		? h->s.e[p.i].hv32
+		: is_oa(h) ? h->oa.slots[p.i].hv32 : p.n->hn.hv32;
+	c->key = hpos_key(h, p);
+}
+
+/* Find the item at cursor again if it may be moved. */
+static void
+cursor_sync(struct yhash_cursor *c) {
+	struct yhashl_node *hln;
+	const struct yhash *h = c->h;
+	if (likely(c->gen == hgen(h)) || c->end)
+		return;
+	/* Item at cursor is always in the hash. */
+	if (is_small(h) || is_oa(h)) {
+		c->pos.i = is_small(h)
+			? small_find(&h->s, c->key, c->hv32)
+			: oa_find(&h->oa, c->key, c->hv32);
+		yassert(OA_NONE != c->pos.i);
+	} else {
+		hln = yhashl_get2(&h->h, c->key, c->hv32);
+		yassert(hln);
+		c->pos.n = containerof(hln, struct hn, hn);
+	}
+	c->gen = hgen(h);
+}
+
+/* Item at @p p is about to be removed. Cursors at it move to next. */
+static INLINE void
+cursors_on_remove(struct yhash *h, union hpos p) {
+	struct yhash_cursor *c;
+	void *key;
+	if (likely(ylistl_is_empty(&h->cursors)))
+		return;
+	key = hpos_key(h, p);
+	ylistl_foreach_item(c, &h->cursors, struct yhash_cursor, lk) {
+		if (c->end || c->key != key)
+			continue;
+		cursor_sync(c);
+		cursor_set(c, hpos_next(h, c->pos));
+	}
+}
+
+/* All items are removed */
+static INLINE void
+cursors_on_clear(struct yhash *h) {
+	struct yhash_cursor *c;
+	ylistl_foreach_item(c, &h->cursors, struct yhash_cursor, lk)
+		c->end = TRUE;
+}
+
+static void
+hdestroy_nodes(struct yhash *h) {
+	struct hn *n, *tmp;
+	u32 i;
+	cursors_on_clear(h);
+	if (is_small(h)) {
+		for (i = 0; i < h->s.sz; i++) {
+			(*h->kfree)(h->s.e[i].key);
+			(*h->vfree)(h->s.e[i].v);
+		}
+		h->s.sz = 0;
+		return;
+	}
+	if (is_oa(h)) {
+		for (i = h->oa.head; OA_NONE != i; i = h->oa.slots[i].next) {
+			(*h->kfree)(h->oa.slots[i].key);
+			(*h->vfree)(h->oa.slots[i].v);
+		}
+		memset(h->oa.ctrl, OA_EMPTY, h->oa.cap);
+		h->oa.sz = h->oa.ndel = 0;
+		h->oa.head = h->oa.tail = OA_NONE;
+		return;
+	}
+	ylistl_foreach_item_safe(n, tmp, &h->order, struct hn, olk) {
+		(*h->kfree)(yhashl_node_key(&n->hn));
+		(*h->vfree)(n->v);
+		yhashl_node_remove(&h->h, &n->hn);
+		/* Nodes in slab are freed at once. */
+		if (is_binkey(h))
+			yfree(n);
+	}
+	ylistl_init_link(&h->order);
+	slab_clean(&h->slab);
+}
+
+static int
+engine_init(struct yhash *h, yhashl_hfunc_t hfunc, yhashl_keyeq_t keq) {
+	if (is_oa(h))
+		return oa_init(&h->oa, hfunc, keq);
+	slab_init(&h->slab);
+	ylistl_init_link(&h->order);
+	return yhashl_init2(&h->h, hfunc, keq, MIN_HBITS);
+}
+
+static int
+hinit(struct yhash *h, yhashl_hfunc_t hfunc, yhashl_keyeq_t keq) {
+	/* Node of binary-key hash has key in it. So, it always uses engine */
+	if (is_binkey(h)) {
+		h->opt &= ~OPT_SMALL;
+		return engine_init(h, hfunc, keq);
+	}
+	h->opt |= OPT_SMALL;
+	h->s.h = hfunc;
+	h->s.keq = keq;
+	h->s.seed = yhashl_new_seed();
+	h->s.sz = 0;
+	return 0;
+}
+
+static void
+hclean(struct yhash *h) {
+	if (is_small(h))
+		return;
+	if (is_oa(h))
+		oa_clean(&h->oa);
+	else {
+		yhashl_clean(&h->h);
+		slab_clean(&h->slab);
+	}
+}
+
+static struct yhash *
+hash_create_internal(
+	void (*vfree)(void *),
+	void (*kfree)(void *),
+	int (*kcp)(const void **, const void *),
+	int (*keq)(const void *, const void *),
+	u32 (*hfunc)(const void *),
+	int opt
+) {
+	int r;
+	if (unlikely(!hfunc))
+		return NULL;
+
+	struct yhash *h = ymalloc(sizeof(*h));
+	if (unlikely(!h))
+		return NULL;
+	h->opt = opt;
+	r = hinit(h, hfunc, keq);
+	if (unlikely(r)) {
+		yfree(h);
+		return NULL;
+	}
+	h->vfree = vfree;
+	h->kfree = kfree;
+	h->kcp = kcp;
+	h->gen = 0;
+	h->reserved = 0;
+	ylistl_init_link(&h->cursors);
+#ifdef CONFIG_HASH_STAT
+	memset(&h->st, 0, sizeof(h->st));
+#endif /* CONFIG_HASH_STAT */
+	return h;
+}
+
+/*---------------------------------------------------------------------------
+ * Capacity policy
+ *
+ * Hash grows when it is full, and shrinks when it is much less than the
+ *   size at which it shrinks. Gap between two thresholds(hysteresis)
+ *   prevents hash from being resized repeatedly by add/remove around one
+ *   boundary.
+ * - chaining: grow if sz > nbuckets * 2. shrink if sz < nbuckets / 2.
+ *   Slab is repacked if nodes in use < 1/4 of nodes in slab.
+ * - open addressing: grow if FULL + DELETED > cap * 7/8.
+ *   shrink if sz < cap / 8.
+ * Hash is never shrunk below the size reserved by yhash_reserve.
+ *--------------------------------------------------------------------------*/
+static INLINE bool
+chain_need_grow(const struct yhash *h) {
+	return yhashl_sz(&h->h) > yhashl_hmapsz(&h->h) * 2
+		&& !yhashl_is_remapping(&h->h);
+}
+
+static INLINE bool
+chain_need_shrink(const struct yhash *h) {
+	/* Map half of current one should hold reserved items. */
+	return yhashl_sz(&h->h) < yhashl_hmapsz(&h->h) / 2
+		&& h->reserved <= yhashl_hmapsz(&h->h)
+		&& !yhashl_is_remapping(&h->h);
+}
+
+static INLINE bool
+chain_need_repack(const struct yhash *h) {
+	u32 target = h->slab.nused > h->reserved
+		? h->slab.nused
+		: h->reserved;
+	return h->slab.cap > SLAB_MAX_CHUNK && target < h->slab.cap / 4;
+}
+
+static INLINE bool
+oa_need_grow(const struct yhash *h) {
+	return h->oa.sz + h->oa.ndel + 1 > oa_maxload(h->oa.cap);
+}
+
+static INLINE bool
+oa_need_shrink(const struct yhash *h) {
+	return h->oa.cap > OA_MIN_CAP
+		&& h->oa.sz < h->oa.cap / 8
+		&& oa_maxload(h->oa.cap / 2) >= h->reserved;
+}
+
+/* Rehash open addressing engine with new capacity @p cap. */
+static int
+oa_resize(struct yhash *h, u32 cap) {
+	int r;
+	u64 t0 = hstat_now();
+	r = oa_rehash(&h->oa, cap);
+	hstat_rehash(h, t0);
+	return r;
+}
+
+/* Remap chaining engine with new map of 2^@p bits buckets. */
+static int
+chain_resize(struct yhash *h, u32 bits, bool incremental) {
+	int r;
+	u64 t0 = hstat_now();
+	r = yhashl_hremap2(&h->h, bits, incremental);
+	hstat_rehash(h, t0);
+	return r;
+}
+
+/* Make room for one more item at open addressing engine. */
+static int
+oa_grow(struct yhash *h) {
+	/* Just purge tombstones if there are lots of them. */
+	u32 cap = (h->oa.sz + 1 > oa_maxload(h->oa.cap) / 2)
+		? h->oa.cap * 2
+		: h->oa.cap;
+	/* There may still be room even if rehash fails. */
+	if (unlikely(oa_resize(h, cap)
+		&& h->oa.sz + h->oa.ndel + 1 >= h->oa.cap)
+	) { return -ENOMEM; }
+	return 0;
+}
+
+/*
+ * Move nodes in use to new chunk, and free old chunks.
+ * Links of nodes(bucket and insertion order) are updated to new ones.
+ */
+static void
+chain_repack(struct yhash *h) {
+	struct slab sl;
+	struct hn *n, *tmp, *nn;
+	yassert(!is_binkey(h));
+	slab_init(&sl);
+	/* Failure is not harmful. Just keep old one. */
+	if (unlikely(slab_reserve(&sl, h->slab.nused > h->reserved
+		? h->slab.nused
+		: h->reserved))
+	) { return; }
+	ylistl_foreach_item_safe(n, tmp, &h->order, struct hn, olk) {
+		nn = slab_alloc(&sl);
+		*nn = *n;
+		ylistl_replace(&n->hn.lk, &nn->hn.lk);
+		ylistl_replace(&n->olk, &nn->olk);
+	}
+	slab_clean(&h->slab);
+	h->slab = sl;
+	/* Nodes at cursors are moved. */
+	h->gen++;
+}
+
+/* Add item to engine. @p key(already copied) SHOULD NOT be in the hash. */
+static int
+engine_add(struct yhash *h, void *key, void *v, u32 hv32) {
+	struct hn *hn;
+	if (is_oa(h)) {
+		if (unlikely(oa_need_grow(h) && oa_grow(h)))
+			return -ENOMEM;
+		oa_insert(&h->oa, key, v, hv32);
+		return 0;
+	}
+	hn = slab_alloc(&h->slab);
+	if (unlikely(!hn))
+		return -ENOMEM;
+	hn->v = v;
+	yhashl_set2(&h->h, key, &hn->hn, hv32);
+	ylistl_add_last(&h->order, &hn->olk);
+	return 0;
+}
+
+/* Move all items in small table to engine. */
+static int
+small_promote(struct yhash *h) {
+	u32 i;
+	struct small s = h->s;
+	u64 t0 = hstat_now();
+	h->opt &= ~OPT_SMALL;
+	if (unlikely(engine_init(h, s.h, s.keq)))
+		goto fail;
+	/* Hash values are kept as it is. */
+	if (is_oa(h))
+		h->oa.seed = s.seed;
+	else
+		h->h.seed = s.seed;
+	for (i = 0; i < s.sz; i++) {
+		if (unlikely(engine_add(h, s.e[i].key, s.e[i].v, s.e[i].hv32)))
+			goto fail_clean;
+	}
+	h->gen++;
+	hstat_rehash(h, t0);
+	return 0;
+
+ fail_clean:
+	hclean(h);
+ fail:
+	h->opt |= OPT_SMALL;
+	h->s = s;
+	return -ENOMEM;
+}
+
+/* @return Same with hash_set2. -EAGAIN if small table is full. */
+static int
+hash_set_small(
+	struct yhash *h,
+	const void ** const phkey,
+	void *key,
+	void **oldv,
+	void *v,
+	u32 hv32
+) {
+	void *key_copied;
+	struct sslot *e;
+	u32 i = small_find(&h->s, key, hv32);
+	if (OA_NONE != i) {
+		e = &h->s.e[i];
+		if (oldv) *oldv = e->v;
+		else (*h->vfree)(e->v);
+		e->v = v;
+		if (phkey)
+			*phkey = e->key;
+		return 0;
+	}
+	if (h->s.sz >= SMALL_MAX)
+		return -EAGAIN;
+	if (unlikely((*h->kcp)((const void **)&key_copied, key)))
+		return -ENOMEM;
+	e = &h->s.e[h->s.sz++];
+	e->key = key_copied;
+	e->v = v;
+	e->hv32 = hv32;
+	if (phkey)
+		*phkey = key_copied;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------
+ *
+ *--------------------------------------------------------------------------*/
+static int
+hash_set_oa(
+	struct yhash *h,
+	const void ** const phkey,
+	void *key,
+	void **oldv,
+	void *v,
+	u32 hv32
+) {
+	int r;
+	void *key_copied;
+	struct oaslot *slot;
+	u32 i = oa_find(&h->oa, key, hv32);
+	if (OA_NONE != i) {
+		/* key is NOT replaced. Only value is. */
+		slot = &h->oa.slots[i];
+		if (oldv) *oldv = slot->v;
+		else (*h->vfree)(slot->v);
+		slot->v = v;
+		if (phkey)
+			*phkey = slot->key;
+		return 0;
+	}
+	r = (*h->kcp)((const void **)&key_copied, key);
+	if (unlikely(r))
+		return -ENOMEM;
+	if (unlikely(engine_add(h, key_copied, v, hv32))) {
+		(*h->kfree)(key_copied);
+		return -ENOMEM;
+	}
+	if (phkey)
+		*phkey = key_copied;
+	return 1;
+}
+
+/* @p hv32 is hash value of @p key */
+static int
+hash_set2(
+	struct yhash *h,
+	const void ** const phkey,
+	void *key,
+	void **oldv,
+	void *v,
+	u32 hv32
+) {
+	int r;
+	struct hn *hn;
+	void *key_copied;
+	struct yhashl_node *hln;
+
+	hstat_inc(h, nset);
+	if (is_small(h)) {
+		r = hash_set_small(h, phkey, key, oldv, v, hv32);
+		if (likely(-EAGAIN != r))
+			return r;
+		if (unlikely(small_promote(h)))
+			return -ENOMEM;
+	}
+
+	if (is_oa(h))
+		return hash_set_oa(h, phkey, key, oldv, v, hv32);
+
+	/* Node is kept and only value is replaced. Key of binary-key hash is
+	 *   stored in the node, and node has position in insertion order.
+	 */
+	if ((hln = yhashl_get2(&h->h, key, hv32))) {
+		hn = containerof(hln, struct hn, hn);
+		if (oldv) *oldv = hn->v;
+		else (*h->vfree)(hn->v);
+		hn->v = v;
+		if (phkey)
+			*phkey = yhashl_node_key(hln);
+		return 0;
+	}
+
+	/* We need to expand hash map size if hash seems to be full.
+	 * Remapping is done incrementally not to stall this call.
+	 */
+	if (chain_need_grow(h)) {
+		/* return value is ignored intentionally.
+		 * Actually, even if hmodify fails, hash can still
+		 *   continue to add new value.
+		 */
+		chain_resize(h, h->h.mapbits + 1, TRUE);
+	}
+
+	if (is_binkey(h)) {
+		/* node and key are allocated at once */
+		hn = ymalloc(sizeof(*hn) + bkey_sz(key));
+		if (unlikely(!hn))
+			return -ENOMEM;
+		key_copied = bkey_copy(hn + 1, key);
+	} else {
+		hn = slab_alloc(&h->slab);
+		if (unlikely(!hn))
+			return -ENOMEM;
+		r = (*h->kcp)((const void **)&key_copied, key);
+		if (unlikely(r)) {
+			slab_free(&h->slab, hn);
+			return -ENOMEM;
+		}
+	}
+	hn->v = v;
+	hln = yhashl_set2(&h->h, key_copied, &hn->hn, hv32);
+	yassert(!hln);
+	ylistl_add_last(&h->order, &hn->olk);
+	if (phkey)
+		*phkey = yhashl_node_key(&hn->hn);
+	return 1;
+}
+
+static int
+hash_set(
+	struct yhash *h,
+	const void ** const phkey,
+	void *key,
+	void **oldv,
+	void *v
+) {
+	return hash_set2(h, phkey, key, oldv, v, hhash(h, key));
+}
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+struct yhash *
+yhashi_create2(void (*vfree)(void *), int opt) {
+	return hash_create_internal(
+		hfree_func(vfree),
+		&free_noop, /* kfree */
+		&kcp_i, /* kcp */
+		&keq_default, /* keq */
+		opt & YHASH_fast_hash ? YHASHL_HFUNC_FAST_PTR : &hfunc_i,
+		opt);
+}
+
+struct yhash *
+yhashi_create(void (*vfree)(void *)) {
+	return yhashi_create2(vfree, 0);
+}
+
+struct yhash *
+yhashs_create2(void (*vfree)(void *), bool key_deepcopy, int opt) {
+	return hash_create_internal(
+		hfree_func(vfree),
+		&kfree_s, /* kfree */
+		key_deepcopy ? &kcp_s : &kcp_shallow, /* kcp */
+		&keq_s, /* keq */
+		opt & YHASH_fast_hash ? YHASHL_HFUNC_FAST_STR : &hfunc_s,
+		opt);
+}
+
+struct yhash *
+yhashs_create(void (*vfree)(void *), bool key_deepcopy) {
+	return yhashs_create2(vfree, key_deepcopy, 0);
+}
+
+struct yhash *
+yhasho_create2(
+	void (*vfree)(void *),
+	void (*keyfree)(void *),
+	kcp_func_t keycopy,
+	int (*keyeq)(const void *, const void *),
+	u32 (*hfunc)(const void *key),
+	int opt
+) {
+	/* Invalid request */
+	if (unlikely(!hfunc)) return NULL;
+	return hash_create_internal(
+		hfree_func(vfree),
+		hfree_func(keyfree),
+		keycopy ? keycopy : &kcp_shallow, /* kcp */
+		keyeq ? keyeq : &keq_default, /* keq */
+		hfunc,
+		opt);
+}
+
+struct yhash *
+yhasho_create(
+	void (*vfree)(void *),
+	void (*keyfree)(void *),
+	kcp_func_t keycopy,
+	int (*keyeq)(const void *, const void *),
+	u32 (*hfunc)(const void *key)
+) {
+	return yhasho_create2(vfree, keyfree, keycopy, keyeq, hfunc, 0);
+}
+
+struct yhash *
+yhashb_create2(void (*vfree)(void *), int opt) {
+	opt &= ~YHASH_fast_hash;
+	return hash_create_internal(
+		hfree_func(vfree),
+		/* At chaining engine, key is freed with node. */
+		opt & YHASH_open_addressing ? &free_default : &free_noop,
+		&kcp_b, /* kcp */
+		&keq_b, /* keq */
+		&hfunc_b,
+		opt | OPT_BINKEY);
+}
+
+struct yhash *
+yhashb_create(void (*vfree)(void *)) {
+	return yhashb_create2(vfree, 0);
+}
+
+const void *
+yhashb_key(const void *hkey, uint32_t *len) {
+	const struct bkey *k = hkey;
+	*len = k->len;
+	return k->data;
+}
+
+/*
+ * Hash value is cached in key and key may be moved to other hash(ex. by
+ *   yset operations). So, seed is not per-hash, but per-process.
+ */
+static u64
+bkey_seed(void) {
+	static u64 seed;
+	u64 ns, s = __atomic_load_n(&seed, __ATOMIC_RELAXED);
+	if (unlikely(!s)) {
+		ns = yhashl_new_seed() | 1;
+		/* 's' is updated to the winner's if it fails. */
+		if (__atomic_compare_exchange_n(&seed, &s, ns, FALSE,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)
+		) { s = ns; }
+	}
+	return s;
+}
+
+static INLINE void
+bkey_init(struct bkey *k, const void *key, u32 keylen) {
+	k->data = key;
+	k->len = keylen;
+	k->hv32 = (u32)yhashl_fast(key, keylen, bkey_seed());
+}
+
+int
+yhashb_set2(
+	struct yhash *h,
+	const void *key,
+	uint32_t keylen,
+	void **oldv,
+	void *v
+) {
+	struct bkey k;
+	yassert(is_binkey(h));
+	bkey_init(&k, key, keylen);
+	return hash_set(h, NULL, &k, oldv, v);
+}
+
+int
+yhashb_remove2(
+	struct yhash *h,
+	const void *key,
+	uint32_t keylen,
+	void **value
+) {
+	struct bkey k;
+	yassert(is_binkey(h));
+	bkey_init(&k, key, keylen);
+	return yhash_remove2(h, &k, value);
+}
+
+int
+yhashb_get(
+	const struct yhash *h,
+	const void *key,
+	uint32_t keylen,
+	void **value
+) {
+	struct bkey k;
+	yassert(is_binkey(h));
+	bkey_init(&k, key, keylen);
+	return yhash_get(h, &k, value);
+}
+
+/*---------------------------------------------------------------------------
+ *
+ *--------------------------------------------------------------------------*/
+struct yhash *
+yhash_create(const struct yhash *h) {
+	return hash_create_internal(
+		h->vfree,
+		h->kfree,
+		h->kcp,
+		keqfunc(h),
+		hfunc(h),
+		h->opt & ~OPT_SMALL);
+}
+
+int
+yhash_reset(struct yhash *h) {
+	yhashl_hfunc_t hf = hfunc(h);
+	yhashl_keyeq_t keq = keqfunc(h);
+	hdestroy_nodes(h);
+	hclean(h);
+	h->reserved = 0;
+	return hinit(h, hf, keq);
+}
+
+int
+yhash_reserve(struct yhash *h, u32 n) {
+	u32 bits;
+	h->reserved = n;
+	if (is_small(h)) {
+		if (n <= SMALL_MAX)
+			return 0;
+		if (unlikely(small_promote(h)))
+			return -ENOMEM;
+	}
+	if (is_oa(h)) {
+		if (oa_cap_for(n) <= h->oa.cap)
+			return 0;
+		return oa_resize(h, oa_cap_for(n));
+	}
+	/* Map that doesn't need to grow until n items */
+	for (bits = MIN_HBITS; bits < MAX_HBITS; bits++)
+		if ((1ULL << bits) * 2 >= n)
+			break;
+	if (bits > h->h.mapbits
+		&& unlikely(chain_resize(h, bits, FALSE))
+	) { return -ENOMEM; }
+	if (is_binkey(h) || n <= yhashl_sz(&h->h))
+		return 0;
+	return slab_reserve(&h->slab, n - yhashl_sz(&h->h));
+}
+
+void
+yhash_destroy(struct yhash *h) {
+	/* Cursors SHOULD be destroyed before hash */
+	yassert(ylistl_is_empty(&h->cursors));
+	hdestroy_nodes(h);
+	hclean(h);
+	yfree(h);
+}
+
+u32
+yhash_sz(const struct yhash *h) {
+	return is_small(h)
+		? h->s.sz
+		: is_oa(h) ? h->oa.sz : yhashl_sz(&h->h);
+}
+
+bool
+yhash_is_sametype(const struct yhash *h0, const struct yhash *h1) {
+	/* Engine(options) doesn't matter. Only key and value handling do. */
+	return keqfunc(h0) == keqfunc(h1)
+		&& hfunc(h0) == hfunc(h1)
+		&& h0->kcp == h1->kcp
+		&& h0->kfree == h1->kfree
+		&& h0->vfree == h1->vfree;
+}
+
+u32
+yhash_keys(const struct yhash *h, const void **keysbuf, u32 bufsz) {
+	u32 i = 0;
+	union hpos p;
+	for (p = hpos_first(h);
+		i < bufsz && !hpos_is_end(h, p);
+		p = hpos_next(h, p)
+	) { keysbuf[i++] = hpos_key(h, p); }
+	return i;
+}
+
+int
+yhash_set(struct yhash *h, void *key, void *v) {
+	return hash_set(h, NULL, key, NULL, v);
+}
+
+int
+yhash_set2(struct yhash *h, void *key, void **oldv, void *v) {
+	return hash_set(h, NULL, key, oldv, v);
+}
+
+int
+yhash_set3(
+	struct yhash *h,
+	const void ** const phkey,
+	void *key,
+	void *v
+) {
+	return hash_set(h, phkey, key, NULL, v);
+}
+
+static int
+hash_remove_small(struct yhash *h, const void *key, void **value) {
+	struct sslot *e;
+	union hpos p;
+	u32 i = small_find(&h->s, key, hhash(h, key));
+	if (OA_NONE == i)
+		return 0;
+	hstat_inc(h, nremove);
+	p.i = i;
+	cursors_on_remove(h, p);
+	e = &h->s.e[i];
+	if (value)
+		*value = e->v;
+	else
+		(*h->vfree)(e->v);
+	(*h->kfree)(e->key);
+	small_remove_at(&h->s, i);
+	h->gen++;
+	return 1;
+}
+
+static int
+hash_remove_oa(struct yhash *h, const void *key, void **value) {
+	struct oaslot *slot;
+	union hpos p;
+	u32 i = oa_find(&h->oa, key, oa_hv32(&h->oa, key));
+	if (OA_NONE == i)
+		return 0;
+	hstat_inc(h, nremove);
+	p.i = i;
+	cursors_on_remove(h, p);
+	slot = &h->oa.slots[i];
+	if (value)
+		*value = slot->v;
+	else
+		(*h->vfree)(slot->v);
+	(*h->kfree)(slot->key);
+	oa_remove_at(&h->oa, i);
+	if (oa_need_shrink(h))
+		/* return value is ignored intentionally.
+		 * Failure is not harmful.
+		 */
+		oa_resize(h, h->oa.cap / 2);
+	return 1;
+}
+
+int
+yhash_remove2(struct yhash *h, const void *key, void **value) {
+	struct hn *hn;
+	union hpos p;
+	struct yhashl_node *hln;
+
+	if (is_small(h))
+		return hash_remove_small(h, key, value);
+	if (is_oa(h))
+		return hash_remove_oa(h, key, value);
+
+	if (!(hln = yhashl_remove(&h->h, key)))
+		return 0;
+	hstat_inc(h, nremove);
+
+	hn = containerof(hln, struct hn, hn);
+	p.n = hn;
+	cursors_on_remove(h, p);
+	ylistl_remove(&hn->olk);
+	if (value)
+		*value = hn->v;
+	else
+		(*h->vfree)(hn->v);
+	(*h->kfree)(yhashl_node_key(hln));
+	if (is_binkey(h))
+		yfree(hn);
+	else {
+		slab_free(&h->slab, hn);
+		if (unlikely(chain_need_repack(h)))
+			chain_repack(h);
+	}
+	if (chain_need_shrink(h))
+		/* return value is ignored intentionally.
+		 * Failure is not harmful.
+		 */
+		chain_resize(h, h->h.mapbits - 1, TRUE);
+	return 1;
+}
+
+int
+yhash_remove(struct yhash *h, const void *key) {
+	return yhash_remove2(h, key, NULL);
+}
+
+/* @p hv32 is hash value of @p key */
+static INLINE int
+hash_get2(const struct yhash *h, const void *key, void **value, u32 hv32) {
+	u32 i;
+	struct yhashl_node *hln;
+	hstat_inc(h, nget);
+	if (is_small(h)) {
+		i = small_find(&h->s, key, hv32);
+		if (OA_NONE == i)
+			goto miss;
+		if (likely(value))
+			*value = h->s.e[i].v;
+		return 0;
+	}
+	if (is_oa(h)) {
+		i = oa_find(&h->oa, key, hv32);
+		if (unlikely(OA_NONE == i))
+			goto miss;
+		if (likely(value))
+			*value = h->oa.slots[i].v;
+		return 0;
+	}
+	hln = yhashl_get2(&h->h, key, hv32);
 	if (likely(hln)) {
 		if (likely(value))
 			*value = containerof(hln, struct hn, hn)->v;
 		return 0;
-	} else return -ENOENT;
+	}
+ miss:
+	hstat_inc(h, nget_miss);
+	return -ENOENT;
+}
+
+int
+yhash_get(const struct yhash *h, const void *key, void **value) {
+	return hash_get2(h, key, value, hhash(h, key));
+}
+
+/*---------------------------------------------------------------------------
+ * Batched operations
+ *
+ * Memory latency of one lookup is hidden by others(group prefetching).
+ * Keys are processed in fixed-size batches and each stage is done for
+ *   all keys in the batch before moving to next stage.
+ *  1. Hash values are calculated and buckets(or control bytes) are
+ *     prefetched.
+ *  2. First node(or slot) is prefetched.
+ *  3. Keys are resolved.
+ *--------------------------------------------------------------------------*/
+#define BATCH_SZ 16
+
+/* Stage 1 */
+static INLINE void
+prefetch_bucket(const struct yhash *h, u32 hv32) {
+	if (is_small(h))
+		return;
+	if (is_oa(h))
+		prefetch(h->oa.ctrl
+			+ oa_group(&h->oa, oa_mix(hv32)) * OA_GROUP);
+	else
+		yhashl_prefetch(&h->h, hv32);
+}
+
+/* Stage 2. Bucket(or control bytes) prefetched at stage 1 is read. */
+static INLINE void
+prefetch_node(const struct yhash *h, u32 hv32) {
+	u32 g, bits;
+	u64 m;
+	if (is_small(h))
+		return;
+	if (!is_oa(h)) {
+		yhashl_prefetch_node(&h->h, hv32);
+		return;
+	}
+	m = oa_mix(hv32);
+	g = oa_group(&h->oa, m);
+	bits = oa_match(h->oa.ctrl + g * OA_GROUP, oa_h2(m));
+	if (bits)
+		prefetch(&h->oa.slots[g * OA_GROUP + __builtin_ctz(bits)]);
+}
+
+u32
+yhash_get_many(
+	const struct yhash *h,
+	const void *const *keys,
+	u32 n,
+	void **values
+) {
+	u32 i, j, m;
+	u32 hvs[BATCH_SZ];
+	u32 found = 0;
+	yassert(!is_binkey(h));
+	for (i = 0; i < n; i += m) {
+		m = n - i < BATCH_SZ ? n - i : BATCH_SZ;
+		for (j = 0; j < m; j++) {
+			hvs[j] = hhash(h, keys[i + j]);
+			prefetch_bucket(h, hvs[j]);
+		}
+		for (j = 0; j < m; j++)
+			prefetch_node(h, hvs[j]);
+		for (j = 0; j < m; j++) {
+			if (likely(!hash_get2(h, keys[i + j],
+				&values[i + j], hvs[j]))
+			) { found++; }
+			else values[i + j] = NULL;
+		}
+	}
+	return found;
+}
+
+int
+yhash_set_many(
+	struct yhash *h,
+	void *const *keys,
+	void *const *values,
+	u32 n
+) {
+	int r;
+	u32 i, j, m;
+	u32 hvs[BATCH_SZ];
+	int added = 0;
+	yassert(!is_binkey(h));
+	for (i = 0; i < n; i += m) {
+		m = n - i < BATCH_SZ ? n - i : BATCH_SZ;
+		for (j = 0; j < m; j++) {
+			hvs[j] = hhash(h, keys[i + j]);
+			prefetch_bucket(h, hvs[j]);
+		}
+		for (j = 0; j < m; j++)
+			prefetch_node(h, hvs[j]);
+		/* Hash may be resized while items are set. Then prefetched
+		 *   memory is just useless. But, it's still correct.
+		 */
+		for (j = 0; j < m; j++) {
+			r = hash_set2(h, NULL, keys[i + j], NULL,
+				values[i + j], hvs[j]);
+			if (unlikely(r < 0))
+				return r;
+			added += r;
+		}
+	}
+	return added;
 }
+
+/*---------------------------------------------------------------------------
+ * Cursor
+ *--------------------------------------------------------------------------*/
+struct yhash_cursor *
+yhash_cursor_create(struct yhash *h) {
+	struct yhash_cursor *c = ymalloc(sizeof(*c));
+	if (unlikely(!c))
+		return NULL;
+	c->h = h;
+	cursor_set(c, hpos_first(h));
+	ylistl_add_last(&h->cursors, &c->lk);
+	return c;
+}
+
+void
+yhash_cursor_destroy(struct yhash_cursor *c) {
+	ylistl_remove(&c->lk);
+	yfree(c);
+}
+
+int
+yhash_cursor_next(struct yhash_cursor *c, const void **key, void **value) {
+	const struct yhash *h = c->h;
+	cursor_sync(c);
+	if (c->end)
+		return -ENOENT;
+	if (key)
+		*key = hpos_key(h, c->pos);
+	if (value)
+		*value = hpos_value(h, c->pos);
+	cursor_set(c, hpos_next(h, c->pos));
+	return 0;
+}
+
+/*---------------------------------------------------------------------------
+ * Visiting items
+ *--------------------------------------------------------------------------*/
+int
+yhash_foreach(
+	const struct yhash *h,
+	int (*cb)(const void *key, void *value, void *user),
+	void *user
+) {
+	int r;
+	union hpos p;
+	for (p = hpos_first(h); !hpos_is_end(h, p); p = hpos_next(h, p)) {
+		if (unlikely(r = (*cb)(hpos_key(h, p), hpos_value(h, p), user)))
+			return r;
+	}
+	return 0;
+}
+
+/* Remove item at @p p without resizing. Item at next position is kept. */
+static void
+hash_filter_remove(struct yhash *h, union hpos p) {
+	struct hn *hn;
+	hstat_inc(h, nremove);
+	cursors_on_remove(h, p);
+	(*h->kfree)(hpos_key(h, p));
+	(*h->vfree)(hpos_value(h, p));
+	if (is_small(h)) {
+		small_remove_at(&h->s, p.i);
+		/* Items after it are moved. */
+		h->gen++;
+	} else if (is_oa(h))
+		oa_remove_at(&h->oa, p.i);
+	else {
+		hn = p.n;
+		yhashl_node_remove(&h->h, &hn->hn);
+		ylistl_remove(&hn->olk);
+		if (is_binkey(h))
+			yfree(hn);
+		else
+			slab_free(&h->slab, hn);
+	}
+}
+
+u32
+yhash_filter(
+	struct yhash *h,
+	bool (*keep)(const void *key, void *value, void *user),
+	void *user
+) {
+	u32 bits, cap, n = 0;
+	union hpos p, next;
+	for (p = hpos_first(h); !hpos_is_end(h, p); p = next) {
+		if ((*keep)(hpos_key(h, p), hpos_value(h, p), user)) {
+			next = hpos_next(h, p);
+			continue;
+		}
+		next = hpos_next(h, p);
+		/* Next item is moved to 'p' at small table. */
+		if (is_small(h) && OA_NONE != next.i)
+			next = p;
+		hash_filter_remove(h, p);
+		n++;
+	}
+	/* Hash is resized at once, as if it is shrunk repeatedly by the
+	 *   capacity policy. Failure is not harmful.
+	 */
+	if (!n || is_small(h))
+		return n;
+	if (is_oa(h)) {
+		if (!oa_need_shrink(h))
+			return n;
+		for (cap = h->oa.cap;
+			cap > OA_MIN_CAP
+			&& h->oa.sz < cap / 8
+			&& oa_maxload(cap / 2) >= h->reserved;
+			cap /= 2);
+		oa_resize(h, cap);
+		return n;
+	}
+	if (!is_binkey(h) && chain_need_repack(h))
+		chain_repack(h);
+	if (chain_need_shrink(h)) {
+		for (bits = h->h.mapbits;
+			bits > MIN_HBITS
+			&& yhashl_sz(&h->h) < (1U << bits) / 2
+			&& h->reserved <= (1U << bits);
+			bits--);
+		chain_resize(h, bits, TRUE);
+	}
+	return n;
+}
+
+/*---------------------------------------------------------------------------
+ * Statistics
+ *--------------------------------------------------------------------------*/
+#ifdef CONFIG_HASH_STAT
+
+/* Number of groups visited before the group of slot @p i. */
+static u32
+oa_probe_dist(const struct oa *oa, u32 i) {
+	u32 d;
+	u32 gmask = oa->cap / OA_GROUP - 1;
+	u32 g = oa_group(oa, oa_mix(oa->slots[i].hv32));
+	for (d = 0; g != i / OA_GROUP && d <= gmask; d++)
+		g = (g + d + 1) & gmask;
+	return d;
+}
+
+static INLINE void
+hist_add(u32 *hist, u32 v) {
+	hist[v < YHASH_STAT_HIST_SZ ? v : YHASH_STAT_HIST_SZ - 1]++;
+}
+
+int
+yhash_stat(const struct yhash *h, struct yhash_stat *st) {
+	u32 i;
+	memset(st, 0, sizeof(*st));
+	st->nget = h->st.nget;
+	st->nget_miss = h->st.nget_miss;
+	st->nset = h->st.nset;
+	st->nremove = h->st.nremove;
+	st->nrehash = h->st.nrehash;
+	st->rehash_ns = h->st.rehash_ns;
+	st->rehash_max_ns = h->st.rehash_max_ns;
+	st->sz = yhash_sz(h);
+	if (is_small(h)) {
+		st->cap = SMALL_MAX;
+		for (i = 0; i < h->s.sz; i++)
+			hist_add(st->probe, i);
+	} else if (is_oa(h)) {
+		st->cap = h->oa.cap;
+		for (i = 0; i < h->oa.cap; i++)
+			if (oa_is_full(&h->oa, i))
+				hist_add(st->probe, oa_probe_dist(&h->oa, i));
+	} else {
+		st->cap = yhashl_hmapsz(&h->h);
+		yhashl_hist(&h->h, st->chain, st->probe, YHASH_STAT_HIST_SZ);
+	}
+	st->load = (double)st->sz / (double)st->cap;
+	return 0;
+}
+
+static void
+stat_print_hist(int fd, const char *name, const u32 *hist) {
+	u32 i;
+	double vs[YHASH_STAT_HIST_SZ];
+	char last[16];
+	const char *cmts[] = {"0", last};
+	static const u32 idxs[] = {0, YHASH_STAT_HIST_SZ - 1};
+	bool flat = TRUE;
+	snprintf(last, sizeof(last), ">=%u", YHASH_STAT_HIST_SZ - 1);
+	dprintf(fd, "%s:", name);
+	for (i = 0; i < YHASH_STAT_HIST_SZ; i++) {
+		vs[i] = hist[i];
+		flat = flat && hist[i] == hist[0];
+		dprintf(fd, " %u", hist[i]);
+	}
+	dprintf(fd, "\n");
+	/* Bar graph needs different min and max values. */
+	if (!flat)
+		ystpr_bargraph(fd, vs, YHASH_STAT_HIST_SZ, 10,
+			idxs, cmts, yut_arrsz(idxs), 1, '*');
+}
+
+int
+yhash_stat_print(const struct yhash *h, int fd) {
+	struct yhash_stat st;
+	if (unlikely(fd < 0))
+		return -EINVAL;
+	yhash_stat(h, &st);
+	dprintf(fd, "engine: %s\n"
+		"size: %u, capacity: %u, load: %.3f\n"
+		"get: %llu(miss: %llu), set: %llu, remove: %llu\n"
+		"rehash: %u, total: %llu ns, max: %llu ns\n",
+		is_small(h) ? "small" : is_oa(h) ? "open addressing" : "chaining",
+		st.sz, st.cap, st.load,
+		(unsigned long long)st.nget,
+		(unsigned long long)st.nget_miss,
+		(unsigned long long)st.nset,
+		(unsigned long long)st.nremove,
+		st.nrehash,
+		(unsigned long long)st.rehash_ns,
+		(unsigned long long)st.rehash_max_ns);
+	stat_print_hist(fd, "probe length", st.probe);
+	if (!is_small(h) && !is_oa(h))
+		stat_print_hist(fd, "chain length", st.chain);
+	return 0;
+}
+
+#else /* CONFIG_HASH_STAT */
+
+int
+yhash_stat(unused const struct yhash *h, unused struct yhash_stat *st) {
+	return -ENOTSUP;
+}
+
+int
+yhash_stat_print(unused const struct yhash *h, unused int fd) {
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_HASH_STAT */
@@ -38,10 +38,12 @@
 #include <memory.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/random.h>
 
 #include "common.h"
 #include "yhashl.h"
 #include "ylistl.h"
+#include "yut.h"
 /* crc is used as hash function */
 #include "ycrc.h"
 
@@ -65,6 +67,130 @@ hf_default_str(const void *k) {
 	return ycrc32(0, (const u8 *)k, (u32)strlen((const char *)k));
 }
 
+/*---------------------------------------------------------------------------
+ * Fast hash. Based on wyhash(final version) by Wang Yi (public domain).
+ *--------------------------------------------------------------------------*/
+static const u64 _wyp[4] = {
+	0xa0761d6478bd642fULL,
+	0xe7037ed1a0b428dbULL,
+	0x8ebc6af09c88c6e3ULL,
+	0x589965cc75374cc3ULL
+};
+
+/* 128-bit multiplication. *a = low 64 bits, *b = high 64 bits */
+static INLINE void
+wymum(u64 *a, u64 *b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (u64)r;
+	*b = (u64)(r >> 64);
+#else /* __SIZEOF_INT128__ */
+	u64 ha = *a >> 32, hb = *b >> 32;
+	u64 la = (u32)*a, lb = (u32)*b;
+	u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	u64 t = rl + (rm0 << 32), c = t < rl;
+	u64 lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif /* __SIZEOF_INT128__ */
+}
+
+static INLINE u64
+wymix(u64 a, u64 b) {
+	wymum(&a, &b);
+	return a ^ b;
+}
+
+static INLINE u64
+wyr8(const u8 *p) {
+	u64 v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static INLINE u64
+wyr4(const u8 *p) {
+	u32 v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+/* 1 ~ 3 bytes */
+static INLINE u64
+wyr3(const u8 *p, size_t k) {
+	return ((u64)p[0] << 16) | ((u64)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t
+yhashl_fast(const void *data, size_t len, uint64_t seed) {
+	const u8 *p = (const u8 *)data;
+	size_t i = len;
+	u64 a, b, s1, s2;
+	seed ^= wymix(seed ^ _wyp[0], _wyp[1]);
+	if (likely(len <= 16)) {
+		if (likely(len >= 4)) {
+			a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+			b = (wyr4(p + len - 4) << 32)
+				| wyr4(p + len - 4 - ((len >> 3) << 2));
+		} else if (likely(len > 0)) {
+			a = wyr3(p, len);
+			b = 0;
+		} else
+			a = b = 0;
+	} else {
+		if (unlikely(i > 48)) {
+			s1 = s2 = seed;
+			do {
+				seed = wymix(wyr8(p) ^ _wyp[1],
+					wyr8(p + 8) ^ seed);
+				s1 = wymix(wyr8(p + 16) ^ _wyp[2],
+					wyr8(p + 24) ^ s1);
+				s2 = wymix(wyr8(p + 32) ^ _wyp[3],
+					wyr8(p + 40) ^ s2);
+				p += 48;
+				i -= 48;
+			} while (likely(i > 48));
+			seed ^= s1 ^ s2;
+		}
+		while (unlikely(i > 16)) {
+			seed = wymix(wyr8(p) ^ _wyp[1], wyr8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = wyr8(p + i - 16);
+		b = wyr8(p + i - 8);
+	}
+	a ^= _wyp[1];
+	b ^= seed;
+	wymum(&a, &b);
+	return wymix(a ^ _wyp[0] ^ len, b ^ _wyp[1]);
+}
+
+uint64_t
+yhashl_fast_u64(uint64_t v, uint64_t seed) {
+	return wymix(v ^ seed ^ _wyp[0], seed ^ _wyp[1]);
+}
+
+uint64_t
+yhashl_new_seed(void) {
+	static u64 base;
+	static u64 cnt;
+	u64 b = __atomic_load_n(&base, __ATOMIC_RELAXED);
+	if (unlikely(!b)) {
+		/* Racing here is harmless. Each caller just uses its own. */
+		if (sizeof(b) != getrandom(&b, sizeof(b), GRND_NONBLOCK))
+			b = yut_current_time_us() ^ (u64)(intptr_t)&b;
+		b |= 1;
+		__atomic_store_n(&base, b, __ATOMIC_RELAXED);
+	}
+	return wymix(b ^ __atomic_add_fetch(&cnt, _wyp[0], __ATOMIC_RELAXED),
+		_wyp[3]);
+}
+
+/*---------------------------------------------------------------------------
+ *
+ *--------------------------------------------------------------------------*/
 static int
 keq_default_ptr(const void *k0, const void *k1) {
 	return k0 == k1 ? 0 : 1;
@@ -82,7 +208,7 @@ keq_default_str(const void *k0, const void *k1) {
  ****************************************************************************/
 static INLINE u32
 hv__(u32 mapbits, u32 hv32) {
-	return hv32 >> (32 - mapbits);
+	return yhashl_bidx___(hv32, mapbits);
 }
 
 static INLINE u32
@@ -100,48 +226,88 @@ hv(const struct yhashl *h, const struct yhashl_node *n) {
  *
  *
  ****************************************************************************/
-int
-yhashl_hremap(struct yhashl *h, u32 bits) {
-	u32 i;
+/* Number of old buckets moved at each set/remove during remapping */
+#define REMAP_STEP 4
+
+/* Bucket where node having hash value @p hv32 is at now */
+static INLINE struct ylistl_link *
+bucket(const struct yhashl *h, u32 hv32) {
+	return yhashl_hbucket___(h, hv32);
+}
+
+/*
+ * Buckets of new map are initialized lazily when old buckets are moved.
+ * Hash value uses top bits. So, in case of growing, old bucket 'i' is
+ *   split into new buckets [i << d, (i + 1) << d). In case of shrinking,
+ *   old buckets [j << d, (j + 1) << d) are merged into new bucket 'j'.
+ */
+static void
+migrate_bucket(struct yhashl *h, u32 ob) {
+	u32 i, d;
 	struct yhashl_node *n, *tmp;
-	struct ylistl_link *oldmap;
+	if (h->mapbits > h->oldmapbits) {
+		d = h->mapbits - h->oldmapbits;
+		for (i = ob << d; i < (ob + 1) << d; i++)
+			ylistl_init_link(&h->map[i]);
+	} else {
+		d = h->oldmapbits - h->mapbits;
+		if (!(ob & ((1 << d) - 1)))
+			ylistl_init_link(&h->map[ob >> d]);
+	}
+	ylistl_foreach_item_safe(
+		n, tmp, &h->oldmap[ob], struct yhashl_node, lk
+	) {
+		ylistl_remove(&n->lk);
+		ylistl_add_last(&h->map[hv(h, n)], &n->lk);
+	}
+}
+
+uint32_t
+yhashl_hremap_step(struct yhashl *h, uint32_t nbuckets) {
 	u32 oldmapsz;
-	u32 oldbits;
+	if (likely(!h->oldmap))
+		return 0;
+	oldmapsz = 1 << h->oldmapbits;
+	while (nbuckets-- > 0 && h->migidx < oldmapsz)
+		migrate_bucket(h, h->migidx++);
+	if (h->migidx < oldmapsz)
+		return oldmapsz - h->migidx;
+	yfree(h->oldmap);
+	h->oldmap = NULL;
+	return 0;
+}
+
+int
+yhashl_hremap2(struct yhashl *h, u32 bits, bool incremental) {
+	struct ylistl_link *newmap;
 
 	if (bits < MIN_HBITS)
 		bits = MIN_HBITS;
 	if (bits > MAX_HBITS)
 		bits = MAX_HBITS;
 
+	/* Complete previous remapping first */
+	yhashl_hremap_step(h, (u32)-1);
 	if (h->mapbits == bits)
 		return 0;
 
-	oldmap = h->map;
-	oldmapsz = yhashl_hmapsz(h);
-	oldbits = h->mapbits;
-
-	h->mapbits = bits; /* map size is changed here */
-	if (unlikely(!(h->map = ymalloc(sizeof(*h->map) * yhashl_hmapsz(h))))) {
-		/* restore to original value */
-		h->map = oldmap;
-		h->mapbits = oldbits;
+	if (unlikely(!(newmap = ymalloc(sizeof(*newmap) * (1ULL << bits)))))
 		return -ENOMEM;
-	}
-	for (i = 0; i < yhashl_hmapsz(h); i++)
-		ylistl_init_link(&h->map[i]);
-	/* re assign hash nodes */
-	for (i = 0; i < oldmapsz; i++) {
-		ylistl_foreach_item_safe(
-			n, tmp, &oldmap[i], struct yhashl_node, lk
-		) {
-			ylistl_remove(&n->lk);
-			ylistl_add_last(&h->map[hv(h, n)], &n->lk);
-		}
-	}
-	yfree(oldmap);
+	h->oldmap = h->map;
+	h->oldmapbits = h->mapbits;
+	h->migidx = 0;
+	h->map = newmap;
+	h->mapbits = bits; /* map size is changed here */
+	if (!incremental)
+		yhashl_hremap_step(h, (u32)-1);
 	return 0;
 }
 
+int
+yhashl_hremap(struct yhashl *h, u32 bits) {
+	return yhashl_hremap2(h, bits, FALSE);
+}
+
 /****************************************************************************
  *
  *
@@ -160,6 +326,9 @@ yhashl_init2(
 
 	h->sz = 0;
 	h->mapbits = initbits;
+	h->oldmap = NULL;
+	h->oldmapbits = 0;
+	h->migidx = 0;
 	if (!hfunc || YHASHL_HFUNC_PTR == hfunc)
 		hfunc = &hf_default_ptr;
 	else if (YHASHL_HFUNC_STR == hfunc)
@@ -170,6 +339,7 @@ yhashl_init2(
 	else if (YHASHL_KEYEQ_STR == keqfunc)
 		keqfunc = &keq_default_str;
 	h->keq = keqfunc;
+	h->seed = yhashl_new_seed();
 
 	/* allocate and initialize slot list heads */
 	h->map = (struct ylistl_link *)ymalloc(
@@ -187,13 +357,20 @@ yhashl_init(struct yhashl *h, yhashl_hfunc_t hfunc, yhashl_keyeq_t keqfunc) {
 
 void
 yhashl_clean(struct yhashl *h) {
+	if (unlikely(h->oldmap))
+		yfree(h->oldmap);
 	yfree(h->map);
 }
 
 
 struct yhashl_node *
 yhashl_set(struct yhashl *h, void *key, struct yhashl_node *nnew) {
-	struct yhashl_node *n = yhashl_get(h, key);
+	return yhashl_set2(h, key, nnew, yhashl_hv32(h->h, h->seed, key));
+}
+
+struct yhashl_node *
+yhashl_set2(struct yhashl *h, void *key, struct yhashl_node *nnew, u32 hv32) {
+	struct yhashl_node *n = yhashl_get2(h, key, hv32);
 	if (n) {
 		nnew->hv32 = n->hv32;
 		nnew->key = n->key;
@@ -201,10 +378,11 @@ yhashl_set(struct yhashl *h, void *key, struct yhashl_node *nnew) {
 		yhashl_node_init(n);
 		return n;
 	}
-	nnew->hv32 = (*h->h)(key);
+	yhashl_hremap_step(h, REMAP_STEP);
+	nnew->hv32 = hv32;
 	nnew->key = key; /* Always shallow copy */
 	/* LRU concept. To find recently added node quickly */
-	ylistl_add_first(&h->map[hv(h, nnew)], &nnew->lk);
+	ylistl_add_first(bucket(h, nnew->hv32), &nnew->lk);
 	h->sz++;
 	return NULL;
 }
@@ -219,18 +397,57 @@ struct yhashl_node *
 yhashl_remove(struct yhashl *h, const void *key) {
 	struct yhashl_node *n = yhashl_get(h, key);
 	if (unlikely(!n)) return NULL;
+	/*
+	 * Remapping is not progressed here. Removing current node SHOULD be
+	 *   safe at yhashl_foreach_safe. But remapping moves next node.
+	 */
 	yhashl_node_remove(h, n);
 	return n;
 }
 
 struct yhashl_node *
 yhashl_get(const struct yhashl *h, const void *key) {
+	return yhashl_get2(h, key, yhashl_hv32(h->h, h->seed, key));
+}
+
+struct yhashl_node *
+yhashl_get2(const struct yhashl *h, const void *key, u32 hv32) {
 	struct yhashl_node *n;
-	u32 hv32 = (*h->h)(key);
-	struct ylistl_link *hd = &h->map[hv_(h, hv32)];
+	struct ylistl_link *hd = bucket(h, hv32);
 	ylistl_foreach_item(n, hd, struct yhashl_node, lk) {
 		if (n->hv32 == hv32 && !(*h->keq)(key, n->key))
 			break;
 	}
 	return (&n->lk == hd) ? NULL : n;
 }
+
+uint32_t
+yhashl_hist(const struct yhashl *h, u32 *chain, u32 *probe, u32 n) {
+	u32 i, len, nready, nb, cnt;
+	struct ylistl_link *hd, *lk;
+
+	yassert(n > 0);
+	if (chain)
+		memset(chain, 0, sizeof(*chain) * n);
+	if (probe)
+		memset(probe, 0, sizeof(*probe) * n);
+	nready = yhashl_nready___(h);
+	nb = yhashl_nbuckets___(h);
+	cnt = 0;
+	for (i = 0; i < nb; i++) {
+		/* Buckets of old map before 'migidx' are already moved. */
+		if (i >= nready && i - nready < h->migidx)
+			continue;
+		hd = yhashl_bucket___(h, i);
+		len = 0;
+		ylistl_foreach(lk, hd) {
+			if (probe)
+				probe[len < n ? len : n - 1]++;
+			len++;
+		}
+		if (chain)
+			chain[len < n ? len : n - 1]++;
+		cnt++;
+	}
+	return cnt;
+}
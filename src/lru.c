@@ -40,6 +40,7 @@
 #include "common.h"
 #include "ylru.h"
 #include "ylistl.h"
+#include "yhashl.h"
 #include "yhash.h"
 
 /*
@@ -51,24 +52,94 @@
  * +-------+  <hash value>
  * |       |-------+
  * +-------+       |
- * |  ...  |       v   Doubly Linked List
+ * |  ...  |       v   Doubly Linked List(s)
  *               +---+   +---+   +---+
  *     ^     ... -> <---->  <---->  <- ...
  *     |         +---+   +---+   +---+
  *     |                           |
  *     |  <access with key>        |
  *     +---------------------------+
+ *
+ * Every policy uses up to 3 lists(queues). The first of a list is the
+ *   newest and victim is taken from the last.
+ *
+ * LRU: q[0]. Hit moves node to the first.
+ * CLOCK: q[0] is clock and the last is position of hand. Hit just sets
+ *   reference bit. Referenced node at hand is moved to the first with
+ *   clearing the bit(second chance).
+ * S3-FIFO: q[Q_SMALL] and q[Q_MAIN]. New node goes to small queue(10% of
+ *   cache). Node leaving small queue moves to main queue if it is accessed,
+ *   otherwise it is evicted and its fingerprint goes to ghost queue.
+ *   New node whose fingerprint is in ghost goes to main queue directly.
+ *   Main queue is FIFO with reinsertion(freq is decreased).
+ * W-TinyLFU: q[Q_WINDOW](1% of cache), q[Q_PROBATION] and q[Q_PROTECTED]
+ *   (80% of main). Window and main(segmented LRU) are LRU. Node leaving
+ *   window is admitted to main only if it is accessed more frequently than
+ *   victim of main. Frequency is estimated by count-min sketch of
+ *   fingerprints. Counters are halved periodically(aging).
+ *
+ * Fingerprint is 32bit hash value of key. Collision just makes estimation
+ *   a bit inaccurate.
  */
 
+enum {
+	Q_SMALL = 0,
+	Q_MAIN = 1,
+};
+
+enum {
+	Q_WINDOW = 0,
+	Q_PROBATION = 1,
+	Q_PROTECTED = 2,
+};
+
+#define NQUEUES 3
+
+/* S3-FIFO */
+#define S3_FREQ_MAX 3
+
+/* W-TinyLFU */
+#define CMS_DEPTH 4
+#define CMS_COUNTER_MAX 15 /* 4bit counter */
+#define CMS_MIN_WIDTH 64
+#define CMS_MAX_WIDTH (1U << 22)
+/* Counters are halved after 'width * CMS_SAMPLE_FACTOR' increments */
+#define CMS_SAMPLE_FACTOR 10
+
+struct cmsketch {
+	u8 *t; /* CMS_DEPTH rows of 'width' counters */
+	u32 width; /* power of 2 */
+	u32 nsamples;
+};
+
+/* S3-FIFO ghost queue node */
+struct gnode {
+	struct ylistl_link lk;
+	u32 fp;
+};
+
 struct ylru {
 	/* members that may be different according to hash contents */
-	struct ylistl_link head; /* linked list */
+	struct ylistl_link q[NQUEUES];
+	u32 qsz[NQUEUES]; /* data size of each queue */
+	u32 qn[NQUEUES]; /* number of nodes in each queue */
 	struct yhash *h;
 	u32 sz;
+	/* S3-FIFO ghost */
+	struct ylistl_link ghead;
+	struct yhash *gh; /* fingerprint -> gnode */
+	u32 gn;
+	/* W-TinyLFU */
+	struct cmsketch cms;
 	/* contents-independent members (hash attributes)
 	 * 'maxsz' SHOULD be top of 'hash attributes'
 	 */
 	u32 maxsz;
+	int policy;
+	u32 qmax; /* S3-FIFO: small queue. W-TinyLFU: window */
+	u32 protmax; /* W-TinyLFU: protected queue */
+	yhashl_hfunc_t hf; /* for fingerprint */
+	u64 seed;
 	void (*dfree)(void *);
 	void *(*dcreate)(const void *key);
 	u32 (*dsize)(const void *);
@@ -81,6 +152,10 @@ struct lnode {
 	const void *key;
 	void *data; /* cached data */
 	struct ylru *lru; /* owner lru */
+	u32 dsz; /* data size */
+	u32 fp; /* fingerprint */
+	u8 q; /* queue having this node */
+	u8 freq; /* CLOCK: reference bit. S3-FIFO: access frequency */
 };
 
 static INLINE void
@@ -106,17 +181,341 @@ lnode_free(struct lnode *n) {
 	yfree(n);
 }
 
-struct ylru *
+static INLINE u32
+fingerprint(const struct ylru *l, const void *key) {
+	return yhashl_hv32(l->hf, l->seed, key);
+}
+
+/****************************************************************************
+ *
+ * Queues
+ *
+ ****************************************************************************/
+static INLINE struct lnode *
+q_last(struct ylru *l, int q) {
+	return ylistl_is_empty(&l->q[q])
+		? NULL
+		: containerof(l->q[q].prev, struct lnode, lk);
+}
+
+static INLINE void
+q_add(struct ylru *l, int q, struct lnode *n) {
+	n->q = q;
+	ylistl_add_first(&l->q[q], &n->lk);
+	l->qsz[q] += n->dsz;
+	l->qn[q]++;
+}
+
+static INLINE void
+q_remove(struct ylru *l, struct lnode *n) {
+	ylistl_remove(&n->lk);
+	l->qsz[n->q] -= n->dsz;
+	l->qn[n->q]--;
+}
+
+static INLINE void
+q_move(struct ylru *l, int q, struct lnode *n) {
+	q_remove(l, n);
+	q_add(l, q, n);
+}
+
+/*
+ * Node is removed from cache and freed.
+ */
+static void
+evict(struct ylru *l, struct lnode *n) {
+	q_remove(l, n);
+	l->sz -= n->dsz;
+	yhash_remove(l->h, n->key);
+}
+
+/****************************************************************************
+ *
+ * S3-FIFO ghost queue
+ *
+ ****************************************************************************/
+static void
+ghost_add(struct ylru *l, u32 fp) {
+	struct gnode *g;
+	u32 n = l->qn[Q_SMALL] + l->qn[Q_MAIN];
+	/* Ghost keeps as many as cached nodes. */
+	while (l->gn && l->gn >= (n ? n : 1)) {
+		g = containerof(l->ghead.prev, struct gnode, lk);
+		ylistl_remove(&g->lk);
+		l->gn--;
+		yhash_remove(l->gh, (void *)(uintptr_t)g->fp);
+	}
+	if (yhash_has(l->gh, (void *)(uintptr_t)fp)
+		|| unlikely(!(g = ymalloc(sizeof(*g))))
+	) { return; }
+	g->fp = fp;
+	if (unlikely(0 > yhash_set(l->gh, (void *)(uintptr_t)fp, g))) {
+		yfree(g);
+		return;
+	}
+	ylistl_add_first(&l->ghead, &g->lk);
+	l->gn++;
+}
+
+/*
+ * @return TRUE if @p fp was in ghost.
+ */
+static bool
+ghost_remove(struct ylru *l, u32 fp) {
+	struct gnode *g;
+	if (0 >= yhash_remove2(l->gh, (void *)(uintptr_t)fp, (void **)&g))
+		return FALSE;
+	ylistl_remove(&g->lk);
+	l->gn--;
+	yfree(g);
+	return TRUE;
+}
+
+static void
+ghost_reset(struct ylru *l) {
+	if (!l->gh)
+		return;
+	/* gnodes are freed by hash */
+	yhash_reset(l->gh);
+	ylistl_init_link(&l->ghead);
+	l->gn = 0;
+}
+
+/****************************************************************************
+ *
+ * Count-min sketch
+ *
+ ****************************************************************************/
+static int
+cms_init(struct cmsketch *s, u32 width) {
+	if (!(s->t = ycalloc(1, (size_t)width * CMS_DEPTH)))
+		return -ENOMEM;
+	s->width = width;
+	s->nsamples = 0;
+	return 0;
+}
+
+static INLINE u32
+cms_index(const struct ylru *l, u32 fp, int row) {
+	u64 x = yhashl_fast_u64(fp, l->seed);
+	u32 h1 = (u32)x;
+	u32 h2 = (u32)(x >> 32) | 1;
+	return row * l->cms.width + ((h1 + row * h2) & (l->cms.width - 1));
+}
+
+static u32
+cms_freq(const struct ylru *l, u32 fp) {
+	int i;
+	u32 c, f = CMS_COUNTER_MAX;
+	for (i = 0; i < CMS_DEPTH; i++) {
+		c = l->cms.t[cms_index(l, fp, i)];
+		if (c < f)
+			f = c;
+	}
+	return f;
+}
+
+static void
+cms_inc(struct ylru *l, u32 fp) {
+	int i;
+	u32 j;
+	u8 *c;
+	struct cmsketch *s = &l->cms;
+	u32 n = l->qn[Q_WINDOW] + l->qn[Q_PROBATION] + l->qn[Q_PROTECTED];
+	/* Sketch is too small for number of nodes. History is dropped. */
+	if (unlikely(n > s->width && s->width < CMS_MAX_WIDTH)) {
+		struct cmsketch ns;
+		if (likely(!cms_init(&ns, s->width * 2))) {
+			yfree(s->t);
+			*s = ns;
+		}
+	}
+	for (i = 0; i < CMS_DEPTH; i++) {
+		c = &s->t[cms_index(l, fp, i)];
+		if (*c < CMS_COUNTER_MAX)
+			(*c)++;
+	}
+	if (unlikely(++s->nsamples >= s->width * CMS_SAMPLE_FACTOR)) {
+		for (j = 0; j < s->width * CMS_DEPTH; j++)
+			s->t[j] >>= 1;
+		s->nsamples /= 2;
+	}
+}
+
+/****************************************************************************
+ *
+ * Policies
+ *
+ ****************************************************************************/
+/*
+ * Node in the cache is accessed.
+ */
+static void
+policy_hit(struct ylru *l, struct lnode *n) {
+	switch (l->policy) {
+	case YLRU_POLICY_CLOCK:
+		n->freq = 1;
+		break;
+	case YLRU_POLICY_S3FIFO:
+		if (n->freq < S3_FREQ_MAX)
+			n->freq++;
+		break;
+	case YLRU_POLICY_WTINYLFU:
+		if (Q_PROBATION == n->q) {
+			struct lnode *d;
+			q_move(l, Q_PROTECTED, n);
+			/* Demote the oldest protected one to probation. */
+			while (l->qsz[Q_PROTECTED] > l->protmax
+				&& (d = q_last(l, Q_PROTECTED)) != n
+			) { q_move(l, Q_PROBATION, d); }
+		} else
+			q_move(l, n->q, n);
+		break;
+	default: /* LRU */
+		q_move(l, 0, n);
+	}
+}
+
+/*
+ * Add new node to the cache.
+ */
+static void
+policy_insert(struct ylru *l, struct lnode *n) {
+	n->freq = 0;
+	switch (l->policy) {
+	case YLRU_POLICY_S3FIFO:
+		q_add(l, ghost_remove(l, n->fp) ? Q_MAIN : Q_SMALL, n);
+		break;
+	default: /* Q_WINDOW at W-TinyLFU */
+		q_add(l, 0, n);
+	}
+	l->sz += n->dsz;
+}
+
+static void
+clock_evict(struct ylru *l, struct lnode *keep) {
+	struct lnode *n;
+	while (l->sz > l->maxsz) {
+		n = q_last(l, 0);
+		if (n->freq || n == keep) {
+			/* second chance */
+			n->freq = 0;
+			q_move(l, 0, n);
+		} else
+			evict(l, n);
+	}
+}
+
+static void
+s3fifo_evict(struct ylru *l, struct lnode *keep) {
+	struct lnode *n;
+	while (l->sz > l->maxsz) {
+		/* The only node in small queue may be the newest one. */
+		if ((l->qsz[Q_SMALL] > l->qmax && l->qn[Q_SMALL] > 1)
+			|| !l->qn[Q_MAIN]
+			|| (1 == l->qn[Q_MAIN] && q_last(l, Q_MAIN) == keep)
+		) {
+			n = q_last(l, Q_SMALL);
+			if (n->freq) {
+				n->freq = 0;
+				q_move(l, Q_MAIN, n);
+			} else {
+				ghost_add(l, n->fp);
+				evict(l, n);
+			}
+		} else {
+			n = q_last(l, Q_MAIN);
+			if (n->freq) {
+				n->freq--;
+				q_move(l, Q_MAIN, n);
+			} else if (n == keep)
+				q_move(l, Q_MAIN, n);
+			else
+				evict(l, n);
+		}
+	}
+}
+
+static void
+wtinylfu_evict(struct ylru *l) {
+	struct lnode *cand, *victim;
+	for (;;) {
+		/* The only node in window may be the newest one. */
+		cand = l->qsz[Q_WINDOW] > l->qmax && l->qn[Q_WINDOW] > 1
+			? q_last(l, Q_WINDOW)
+			: NULL;
+		if (l->sz <= l->maxsz) {
+			/* Cache is not full. Admit without competition. */
+			if (!cand)
+				return;
+			q_move(l, Q_PROBATION, cand);
+			continue;
+		}
+		if (!(victim = q_last(l, Q_PROBATION)))
+			victim = q_last(l, Q_PROTECTED);
+		if (!victim) {
+			/* Main is empty. */
+			evict(l, q_last(l, Q_WINDOW));
+		} else if (!cand)
+			evict(l, victim);
+		else if (cms_freq(l, cand->fp) > cms_freq(l, victim->fp)) {
+			evict(l, victim);
+			q_move(l, Q_PROBATION, cand);
+		} else
+			evict(l, cand);
+	}
+}
+
+/*
+ * Evict nodes until cache size becomes smaller than maxsz.
+ * @p keep is newly added node. It is not evicted here, because it may be
+ *   returned to user(See ylru_peek).
+ * At LRU and W-TinyLFU, the newest node is never chosen as victim.
+ */
+static void
+policy_evict(struct ylru *l, struct lnode *keep) {
+	struct lnode *n;
+	switch (l->policy) {
+	case YLRU_POLICY_CLOCK:
+		clock_evict(l, keep);
+		break;
+	case YLRU_POLICY_S3FIFO:
+		s3fifo_evict(l, keep);
+		break;
+	case YLRU_POLICY_WTINYLFU:
+		wtinylfu_evict(l);
+		break;
+	default: /* LRU */
+		while (unlikely(l->sz > l->maxsz)
+			&& (n = q_last(l, 0))
+		) { evict(l, n); }
+	}
+}
+
+/****************************************************************************
+ *
+ *
+ *
+ ****************************************************************************/
+static struct ylru *
 lru_create(
 	struct yhash *h, /* hash used in lru cache */
+	yhashl_hfunc_t hf,
 	u32 maxsz,
+	int policy,
 	void (*datafree)(void *),
 	void *(*datacreate)(const void *key),
 	u32 (*datasize)(const void *)
 ) {
-	struct ylru *lru = ymalloc(sizeof(*lru));
-	if (unlikely(!lru))
+	int i;
+	u32 w;
+	struct ylru *lru;
+	if (unlikely(!h))
 		return NULL;
+	if (unlikely(policy < YLRU_POLICY_LRU
+		|| policy > YLRU_POLICY_WTINYLFU
+		|| !(lru = ymalloc(sizeof(*lru))))
+	) { goto fail_hash; }
 
 	if (!maxsz)
 		maxsz = 0xffffffff; /* maximum unsigned u32 */
@@ -125,22 +524,66 @@ lru_create(
 
 	lru->h = h;
 	lru->sz = 0;
-	ylistl_init_link(&lru->head);
+	for (i = 0; i < NQUEUES; i++) {
+		ylistl_init_link(&lru->q[i]);
+		lru->qsz[i] = lru->qn[i] = 0;
+	}
+	ylistl_init_link(&lru->ghead);
+	lru->gh = NULL;
+	lru->gn = 0;
+	lru->cms.t = NULL;
 
 	lru->maxsz = maxsz;
+	lru->policy = policy;
+	lru->qmax = lru->protmax = 0;
+	lru->hf = hf;
+	lru->seed = yhashl_new_seed();
 	lru->dfree = datafree;
 	lru->dcreate = datacreate;
 	lru->dsize = datasize;
 
+	switch (policy) {
+	case YLRU_POLICY_S3FIFO:
+		lru->qmax = maxsz / 10;
+		if (unlikely(!(lru->gh = yhashi_create2(
+			YHASH_MEM_FREE, YHASH_fast_hash)))
+		) { goto fail_lru; }
+		break;
+	case YLRU_POLICY_WTINYLFU:
+		lru->qmax = maxsz / 100;
+		lru->protmax = (u32)((u64)(maxsz - lru->qmax) * 80 / 100);
+		/* Number of nodes is unknown if data size is given. */
+		w = CMS_MIN_WIDTH;
+		if (!datasize)
+			while (w < maxsz && w < CMS_MAX_WIDTH)
+				w <<= 1;
+		if (unlikely(cms_init(&lru->cms, w)))
+			goto fail_lru;
+		break;
+	}
 	return lru;
 
+ fail_lru:
+	yfree(lru);
+ fail_hash:
+	yhash_destroy(h);
+	return NULL;
+}
+
+struct ylru *
+ylrui_create2(
+	u32 maxsz,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *),
+	int policy
+) {
+	return lru_create(
+		yhashi_create((void(*)(void *))&lnode_free),
+		YHASHL_HFUNC_FAST_PTR,
+		maxsz, policy, datafree, datacreate, datasize);
 }
 
-/****************************************************************************
- *
- *
- *
- ****************************************************************************/
 struct ylru *
 ylrui_create(
 	u32 maxsz,
@@ -148,14 +591,22 @@ ylrui_create(
 	void *(*datacreate)(const void *key),
 	u32 (*datasize)(const void *)
 ) {
-	struct ylru *l;
-	struct yhash *h = yhashi_create((void(*)(void *))&lnode_free);
-	if (unlikely(!h))
-		return NULL;
-	if (unlikely(!(l = lru_create(
-		h, maxsz, datafree, datacreate, datasize)))
-	) { yhash_destroy(h); }
-	return l;
+	return ylrui_create2(maxsz, datafree, datacreate, datasize,
+		YLRU_POLICY_LRU);
+}
+
+struct ylru *
+ylrus_create2(
+	u32 maxsz,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *),
+	int policy
+) {
+	return lru_create(
+		yhashs_create((void(*)(void *))&lnode_free, TRUE),
+		YHASHL_HFUNC_FAST_STR,
+		maxsz, policy, datafree, datacreate, datasize);
 }
 
 struct ylru *
@@ -165,18 +616,12 @@ ylrus_create(
 	void *(*datacreate)(const void *key),
 	u32 (*datasize)(const void *)
 ) {
-	struct ylru *l;
-	struct yhash *h = yhashs_create((void(*)(void *))&lnode_free, TRUE);
-	if (unlikely(!h))
-		return NULL;
-	if (unlikely(!(l = lru_create(
-		h, maxsz, datafree, datacreate, datasize)))
-	) { yhash_destroy(h); }
-	return l;
+	return ylrus_create2(maxsz, datafree, datacreate, datasize,
+		YLRU_POLICY_LRU);
 }
 
 struct ylru *
-ylruo_create(
+ylruo_create2(
 	u32 maxsz,
 	void (*datafree)(void *),
 	void *(*datacreate)(const void *key),
@@ -184,51 +629,66 @@ ylruo_create(
 	void(*keyfree)(void *),
 	int (*keycopy)(const void **newkey, const void *),
 	int (*keycmp)(const void *, const void *),
-	u32 (*hfunc)(const void *key)
+	u32 (*hfunc)(const void *key),
+	int policy
 ) {
-	struct ylru *l;
-	struct yhash *h;
-
 	if (YLRU_PREDEFINED_FREE == keyfree)
 		keyfree = YHASH_MEM_FREE;
 
-	h = yhasho_create(
-		(void(*)(void *))&lnode_free,
-		keyfree,
-		keycopy,
-		keycmp,
-		hfunc);
-	if (unlikely(!h))
-		return NULL;
-	if (unlikely(!(l = lru_create(
-		h, maxsz, datafree, datacreate, datasize)))
-	) { yhash_destroy(h); }
-	return l;
+	return lru_create(
+		yhasho_create(
+			(void(*)(void *))&lnode_free,
+			keyfree,
+			keycopy,
+			keycmp,
+			hfunc),
+		hfunc,
+		maxsz, policy, datafree, datacreate, datasize);
+}
+
+struct ylru *
+ylruo_create(
+	u32 maxsz,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	u32 (*datasize)(const void *),
+	void(*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keycmp)(const void *, const void *),
+	u32 (*hfunc)(const void *key)
+) {
+	return ylruo_create2(maxsz, datafree, datacreate, datasize,
+		keyfree, keycopy, keycmp, hfunc, YLRU_POLICY_LRU);
 }
 
 struct ylru *
 ylru_create(const struct ylru *lru) {
-	struct ylru *l;
-	struct yhash *h;
 	if (unlikely(!lru))
 		return NULL;
-	h = yhash_create(lru->h);
-	if (unlikely(!h))
-		return NULL;
-	if (unlikely(!(l = lru_create(
-		h, lru->maxsz, lru->dfree, lru->dcreate, lru->dsize)))
-	) { yhash_destroy(h); }
-	return l;
+	return lru_create(
+		yhash_create(lru->h),
+		lru->hf,
+		lru->maxsz, lru->policy,
+		lru->dfree, lru->dcreate, lru->dsize);
 }
 
 void
 ylru_reset(struct ylru *lru) {
+	int i;
 	if (unlikely(!lru))
 		return;
 	yhash_reset(lru->h);
 	/* list node is already destroied in yhash_clean */
-	ylistl_init_link(&lru->head);
+	for (i = 0; i < NQUEUES; i++) {
+		ylistl_init_link(&lru->q[i]);
+		lru->qsz[i] = lru->qn[i] = 0;
+	}
 	lru->sz = 0;
+	ghost_reset(lru);
+	if (lru->cms.t) {
+		memset(lru->cms.t, 0, (size_t)lru->cms.width * CMS_DEPTH);
+		lru->cms.nsamples = 0;
+	}
 }
 
 void
@@ -237,12 +697,17 @@ ylru_destroy(struct ylru *lru) {
 		return;
 	yhash_destroy(lru->h);
 	/* list node is already destroied in yhash_destroy */
+	if (lru->gh)
+		yhash_destroy(lru->gh);
+	if (lru->cms.t)
+		yfree(lru->cms.t);
 	yfree(lru);
 }
 
 int
 ylru_put(struct ylru *lru, const void *key, void *data) {
-	struct lnode *n, *tmp;
+	int r;
+	struct lnode *n;
 	u32 dsz;
 	if (unlikely(!lru))
 		return -EINVAL;
@@ -251,32 +716,37 @@ ylru_put(struct ylru *lru, const void *key, void *data) {
 		/* too large data to be in the cache */
 		return -EINVAL;
 
-	/*
-	 * shrink cache if cache becomes too large
-	 * the 'last' in the list is the 'oldest'.
-	 */
-	ylistl_foreach_item_safe_reverse(
-		n, tmp, &lru->head, struct lnode, lk
-	) {
-		if (unlikely(lru->sz + dsz > lru->maxsz)) {
-			ylistl_remove(&n->lk);
-			lru->sz -= data_size(lru, n->data);
-			yhash_remove(lru->h, n->key);
-		} else
-			break;
+	if (unlikely(!yhash_get(lru->h, key, (void **)&n))) {
+		/* Key is already in the cache. Data is replaced. */
+		if (n->data != data)
+			data_free(lru, n->data);
+		n->data = data;
+		lru->qsz[n->q] -= n->dsz;
+		lru->qsz[n->q] += dsz;
+		lru->sz -= n->dsz;
+		lru->sz += dsz;
+		n->dsz = dsz;
+		policy_hit(lru, n);
+		policy_evict(lru, NULL);
+		return 0;
 	}
+
 	if (unlikely(!(n = ymalloc(sizeof(*n)))))
 		return -ENOMEM;
 	n->data = data;
 	n->lru = lru;
-	if (unlikely(-1 == yhash_set3(lru->h, &n->key, (void *)key, n))) {
+	n->dsz = dsz;
+	n->fp = YLRU_POLICY_S3FIFO == lru->policy
+		|| YLRU_POLICY_WTINYLFU == lru->policy
+		? fingerprint(lru, key)
+		: 0;
+	if (unlikely(0 > (r = yhash_set3(lru->h, &n->key, (void *)key, n)))) {
 		yfree(n);
-		return -ENOMEM;
+		return r;
 	}
-
-	/* put at the first (newlest) */
-	ylistl_add_first(&lru->head, &n->lk);
-	lru->sz += dsz;
+	policy_insert(lru, n);
+	/* shrink cache if cache becomes too large. */
+	policy_evict(lru, n);
 	return 0;
 }
 
@@ -287,10 +757,15 @@ ylru_get(struct ylru *lru, void **data, const void *key) {
 	void *nd = NULL;
 	if (unlikely(!data))
 		return -EINVAL;
+	if (YLRU_POLICY_WTINYLFU == lru->policy)
+		cms_inc(lru, fingerprint(lru, key));
 	if (0 < yhash_remove2(lru->h, key, (void **)&n)) {
 		/* found */
-		ylistl_remove(&n->lk);
-		lru->sz -= data_size(lru, n->data);
+		q_remove(lru, n);
+		lru->sz -= n->dsz;
+		/* Taken out node is remembered as recently accessed one. */
+		if (YLRU_POLICY_S3FIFO == lru->policy)
+			ghost_add(lru, n->fp);
 		nd = n->data;
 		/* free only 'node' structure. */
 		yfree(n);
@@ -306,6 +781,31 @@ ylru_get(struct ylru *lru, void **data, const void *key) {
 	return r;
 }
 
+int
+ylru_peek(struct ylru *lru, void **data, const void *key) {
+	int r;
+	void *nd;
+	struct lnode *n;
+	if (unlikely(!data))
+		return -EINVAL;
+	if (YLRU_POLICY_WTINYLFU == lru->policy)
+		cms_inc(lru, fingerprint(lru, key));
+	if (!yhash_get(lru->h, key, (void **)&n)) {
+		policy_hit(lru, n);
+		*data = n->data;
+		return 0;
+	}
+	if (!lru->dcreate)
+		return 1;
+	nd = lru->dcreate(key);
+	if (unlikely(0 > (r = ylru_put(lru, key, nd)))) {
+		data_free(lru, nd);
+		return r;
+	}
+	*data = nd;
+	return 0;
+}
+
 u32
 ylru_sz(struct ylru *lru) {
 	return lru->sz;
@@ -0,0 +1,1363 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "yroaring.h"
+
+/*
+ * Containers are kept in the array sorted by key(upper 16 bits of value).
+ * Container is never empty. Empty container is removed from the set.
+ *
+ * Container type is chosen by cardinality.
+ * - array: card <= ARRAY_MAX. 2 bytes per value.
+ * - bitmap: card > ARRAY_MAX. Always 8KB.
+ * - run: only by yroaring_optimize(or it's already run container).
+ *   4 bytes per run.
+ * Bitmap container is converted to array container as soon as card becomes
+ *   ARRAY_MAX or less, and vice versa.
+ */
+#define ARRAY_MAX 4096
+#define ARRAY_MIN_CAP 4
+#define BM_WORDS (65536 / 64)
+#define BM_BYTES (BM_WORDS * sizeof(u64))
+/* Run container having more runs than this is converted. Bitmap is smaller */
+#define RUN_MAX (BM_BYTES / sizeof(struct run))
+
+enum {
+	CT_ARRAY = 0,
+	CT_BITMAP,
+	CT_RUN,
+};
+
+enum {
+	OP_AND = 0,
+	OP_OR,
+	OP_ANDNOT,
+};
+
+/* Values [start, start + len] */
+struct run {
+	u16 start;
+	u16 len;
+};
+
+struct cont {
+	u8 type;
+	u32 card; /* number of values. 1 ~ 65536 */
+	u32 n; /* array: number of values. run: number of runs */
+	u32 cap; /* array, run: number of elements allocated */
+	union {
+		u16 *a;
+		u64 *b;
+		struct run *r;
+		void *p;
+	};
+};
+
+struct yroaring {
+	u32 n; /* number of containers */
+	u32 cap;
+	u16 *keys; /* sorted */
+	struct cont *c;
+};
+
+
+/****************************************************************************
+ *
+ * Primitives
+ *
+ ****************************************************************************/
+static INLINE u32
+popcnt(u64 w) {
+	return (u32)__builtin_popcountll(w);
+}
+
+static INLINE u32
+run_end(const struct run *r) {
+	return (u32)r->start + r->len;
+}
+
+/* @return first index whose value >= @p v */
+static INLINE u32
+array_lower_bound(const u16 *a, u32 lo, u32 n, u16 v) {
+	u32 mid;
+	while (lo < n) {
+		mid = (lo + n) / 2;
+		if (a[mid] < v)
+			lo = mid + 1;
+		else
+			n = mid;
+	}
+	return lo;
+}
+
+/*
+ * Same with array_lower_bound. But search range is expanded exponentially
+ *   from @p lo. This is fast if target is near @p lo.
+ */
+static INLINE u32
+array_gallop(const u16 *a, u32 lo, u32 n, u16 v) {
+	u32 step = 1;
+	u32 hi = lo;
+	if (lo >= n || a[lo] >= v)
+		return lo;
+	while (hi + step < n && a[hi + step] < v) {
+		hi += step;
+		step <<= 1;
+	}
+	return array_lower_bound(a, hi + 1, hi + step < n ? hi + step : n, v);
+}
+
+/* @return index of run whose start <= @p v. @c -1 if there is no such run */
+static INLINE int
+run_floor(const struct run *r, u32 n, u16 v) {
+	u32 mid, lo = 0;
+	while (lo < n) {
+		mid = (lo + n) / 2;
+		if (r[mid].start <= v)
+			lo = mid + 1;
+		else
+			n = mid;
+	}
+	return (int)lo - 1;
+}
+
+static INLINE bool
+bm_has(const u64 *b, u16 v) {
+	return !!(b[v >> 6] & (1ULL << (v & 63)));
+}
+
+/* Mask of bits [lo, hi] of one word. 0 <= lo <= hi < 64 */
+static INLINE u64
+word_mask(u32 lo, u32 hi) {
+	return (~0ULL << lo) & (~0ULL >> (63 - hi));
+}
+
+/* Number of bits set in [lo, hi] */
+static u32
+bm_range_card(const u64 *b, u32 lo, u32 hi) {
+	u32 i, card;
+	u32 wl = lo >> 6, wh = hi >> 6;
+	if (wl == wh)
+		return popcnt(b[wl] & word_mask(lo & 63, hi & 63));
+	card = popcnt(b[wl] & word_mask(lo & 63, 63));
+	for (i = wl + 1; i < wh; i++)
+		card += popcnt(b[i]);
+	return card + popcnt(b[wh] & word_mask(0, hi & 63));
+}
+
+/* Set(@p set) or clear bits [lo, hi] */
+static void
+bm_fill_range(u64 *b, u32 lo, u32 hi, bool set) {
+	u32 i;
+	u32 wl = lo >> 6, wh = hi >> 6;
+	u64 m;
+	for (i = wl; i <= wh; i++) {
+		m = word_mask(i == wl ? lo & 63 : 0, i == wh ? hi & 63 : 63);
+		if (set)
+			b[i] |= m;
+		else
+			b[i] &= ~m;
+	}
+}
+
+/*
+ * @p d = @p a op @p b.
+ * @p d may be same with @p a. If @p d is NULL, only cardinality is counted.
+ * @return cardinality of result
+ */
+static INLINE u32
+bm_op(u64 *d, const u64 *a, const u64 *b, int op) {
+	u32 i, card = 0;
+#ifdef __SSE2__
+	u64 w[2];
+	__m128i x, y;
+	for (i = 0; i < BM_WORDS; i += 2) {
+		x = _mm_loadu_si128((const __m128i *)(a + i));
+		y = _mm_loadu_si128((const __m128i *)(b + i));
+		switch (op) {
+		case OP_AND: x = _mm_and_si128(x, y); break;
+		case OP_OR: x = _mm_or_si128(x, y); break;
+		default: x = _mm_andnot_si128(y, x); break;
+		}
+		if (d)
+			_mm_storeu_si128((__m128i *)(d + i), x);
+		_mm_storeu_si128((__m128i *)w, x);
+		card += popcnt(w[0]) + popcnt(w[1]);
+	}
+#else /* __SSE2__ */
+	u64 w;
+	for (i = 0; i < BM_WORDS; i++) {
+		switch (op) {
+		case OP_AND: w = a[i] & b[i]; break;
+		case OP_OR: w = a[i] | b[i]; break;
+		default: w = a[i] & ~b[i]; break;
+		}
+		if (d)
+			d[i] = w;
+		card += popcnt(w);
+	}
+#endif /* __SSE2__ */
+	return card;
+}
+
+/*
+ * Intersection of sorted arrays.
+ * @p out may be same with @p a. If it is NULL, only cardinality is counted.
+ * If sizes are very different, larger one is searched by galloping.
+ * @return number of values of result
+ */
+static u32
+array_and(u16 *out, const u16 *a, u32 na, const u16 *b, u32 nb) {
+	u32 i = 0, j = 0, k = 0;
+	if ((u64)na * 64 < nb) {
+		for (i = 0; i < na; i++) {
+			j = array_gallop(b, j, nb, a[i]);
+			if (j >= nb)
+				break;
+			if (b[j] == a[i]) {
+				if (out) out[k] = a[i];
+				k++;
+			}
+		}
+		return k;
+	}
+	if ((u64)nb * 64 < na) {
+		/* Output is not ahead of a[i]. So, out == a is safe. */
+		for (j = 0; j < nb; j++) {
+			i = array_gallop(a, i, na, b[j]);
+			if (i >= na)
+				break;
+			if (a[i] == b[j]) {
+				if (out) out[k] = b[j];
+				k++;
+			}
+		}
+		return k;
+	}
+	while (i < na && j < nb) {
+		if (a[i] < b[j])
+			i++;
+		else if (a[i] > b[j])
+			j++;
+		else {
+			if (out) out[k] = a[i];
+			k++;
+			i++;
+			j++;
+		}
+	}
+	return k;
+}
+
+/* @p a - @p b. See array_and. */
+static u32
+array_andnot(u16 *out, const u16 *a, u32 na, const u16 *b, u32 nb) {
+	u32 i = 0, j = 0, k = 0;
+	while (i < na) {
+		if (j >= nb || a[i] < b[j]) {
+			if (out) out[k] = a[i];
+			k++;
+			i++;
+		} else if (a[i] > b[j])
+			j++;
+		else {
+			i++;
+			j++;
+		}
+	}
+	return k;
+}
+
+/* @p out SHOULD be different from @p a and @p b. */
+static u32
+array_or(u16 *out, const u16 *a, u32 na, const u16 *b, u32 nb) {
+	u32 i = 0, j = 0, k = 0;
+	while (i < na && j < nb) {
+		if (a[i] < b[j])
+			out[k++] = a[i++];
+		else if (a[i] > b[j])
+			out[k++] = b[j++];
+		else {
+			out[k++] = a[i++];
+			j++;
+		}
+	}
+	while (i < na)
+		out[k++] = a[i++];
+	while (j < nb)
+		out[k++] = b[j++];
+	return k;
+}
+
+/*
+ * Values of @p a that are(@p in) or are not in bitmap @p b.
+ * @p out may be same with @p a or NULL. See array_and.
+ */
+static u32
+array_filter_bm(u16 *out, const u16 *a, u32 na, const u64 *b, bool in) {
+	u32 i, k = 0;
+	for (i = 0; i < na; i++) {
+		if (bm_has(b, a[i]) == in) {
+			if (out) out[k] = a[i];
+			k++;
+		}
+	}
+	return k;
+}
+
+/* Same with array_filter_bm. But with runs. */
+static u32
+array_filter_run(
+	u16 *out,
+	const u16 *a,
+	u32 na,
+	const struct run *r,
+	u32 nr,
+	bool in
+) {
+	u32 i = 0, j = 0, k = 0;
+	bool inside;
+	for (i = 0; i < na; i++) {
+		while (j < nr && run_end(&r[j]) < a[i])
+			j++;
+		inside = j < nr && r[j].start <= a[i];
+		if (inside == in) {
+			if (out) out[k] = a[i];
+			k++;
+		}
+	}
+	return k;
+}
+
+
+/****************************************************************************
+ *
+ * Container
+ *
+ ****************************************************************************/
+static INLINE void
+cont_free(struct cont *c) {
+	yfree(c->p);
+}
+
+static int
+cont_init_array(struct cont *c, u32 cap) {
+	if (cap < ARRAY_MIN_CAP)
+		cap = ARRAY_MIN_CAP;
+	if (unlikely(!(c->a = ymalloc(sizeof(*c->a) * cap))))
+		return -ENOMEM;
+	c->type = CT_ARRAY;
+	c->card = c->n = 0;
+	c->cap = cap;
+	return 0;
+}
+
+static int
+cont_init_bitmap(struct cont *c) {
+	if (unlikely(!(c->b = ymalloc(BM_BYTES))))
+		return -ENOMEM;
+	memset(c->b, 0, BM_BYTES);
+	c->type = CT_BITMAP;
+	c->card = c->n = c->cap = 0;
+	return 0;
+}
+
+static int
+cont_init_run(struct cont *c, u32 cap) {
+	if (cap < 1)
+		cap = 1;
+	if (unlikely(!(c->r = ymalloc(sizeof(*c->r) * cap))))
+		return -ENOMEM;
+	c->type = CT_RUN;
+	c->card = c->n = 0;
+	c->cap = cap;
+	return 0;
+}
+
+static int
+cont_clone(struct cont *d, const struct cont *s) {
+	size_t sz;
+	switch (s->type) {
+	case CT_ARRAY: sz = sizeof(*s->a) * s->n; break;
+	case CT_RUN: sz = sizeof(*s->r) * s->n; break;
+	default: sz = BM_BYTES;
+	}
+	*d = *s;
+	if (unlikely(!(d->p = ymalloc(sz ? sz : 1))))
+		return -ENOMEM;
+	memcpy(d->p, s->p, sz);
+	if (CT_BITMAP != s->type)
+		d->cap = s->n;
+	return 0;
+}
+
+/* Make room for one more element at array or run container. */
+static int
+cont_grow(struct cont *c, size_t esz) {
+	void *p;
+	u32 cap;
+	if (c->n < c->cap)
+		return 0;
+	cap = c->cap * 2;
+	if (CT_ARRAY == c->type && cap > ARRAY_MAX)
+		cap = ARRAY_MAX;
+	if (unlikely(!(p = yrealloc(c->p, esz * cap))))
+		return -ENOMEM;
+	c->p = p;
+	c->cap = cap;
+	return 0;
+}
+
+/* Number of runs if values in the container are represented by runs. */
+static u32
+cont_nruns(const struct cont *c) {
+	u32 i, n;
+	u64 w, prev;
+	switch (c->type) {
+	case CT_RUN:
+		return c->n;
+	case CT_ARRAY:
+		for (i = n = 0; i < c->n; i++)
+			if (!i || c->a[i - 1] + 1 != c->a[i])
+				n++;
+		return n;
+	}
+	/* Run starts at bit that is set and whose previous bit is clear. */
+	for (i = n = 0, prev = 0; i < BM_WORDS; i++) {
+		w = c->b[i];
+		n += popcnt(w & ~((w << 1) | prev));
+		prev = w >> 63;
+	}
+	return n;
+}
+
+/*
+ * Run @p body for each run [@p lo, @p hi] of values in the container.
+ * Runs of array and bitmap container are found on the fly.
+ */
+#define cont_foreach_run(c, lo, hi, body)				\
+	do {								\
+		u32 i___, v___;						\
+		if (CT_RUN == (c)->type) {				\
+			for (i___ = 0; i___ < (c)->n; i___++) {		\
+				lo = (c)->r[i___].start;		\
+				hi = run_end(&(c)->r[i___]);		\
+				body;					\
+			}						\
+		} else if (CT_ARRAY == (c)->type) {			\
+			for (i___ = 0; i___ < (c)->n; ) {		\
+				lo = hi = (c)->a[i___++];		\
+				while (i___ < (c)->n			\
+					&& (c)->a[i___] == hi + 1)	\
+				{ hi = (c)->a[i___++]; }		\
+				body;					\
+			}						\
+		} else {						\
+			for (v___ = 0; v___ < 65536; ) {		\
+				u64 w___ = (c)->b[v___ >> 6]		\
+					>> (v___ & 63);			\
+				if (!w___) {				\
+					v___ = (v___ | 63) + 1;		\
+					continue;			\
+				}					\
+				v___ += __builtin_ctzll(w___);		\
+				lo = v___;				\
+				while (v___ < 65536			\
+					&& bm_has((c)->b, v___))	\
+				{ v___++; }				\
+				hi = v___ - 1;				\
+				body;					\
+			}						\
+		}							\
+	} while (0)
+
+/* Convert container to type @p type. */
+static int
+cont_convert(struct cont *c, u8 type) {
+	u32 lo, hi, v;
+	struct cont t;
+	if (c->type == type)
+		return 0;
+	switch (type) {
+	case CT_ARRAY:
+		yassert(c->card <= ARRAY_MAX);
+		if (unlikely(cont_init_array(&t, c->card)))
+			return -ENOMEM;
+		cont_foreach_run(c, lo, hi, {
+			for (v = lo; v <= hi; v++)
+				t.a[t.n++] = (u16)v;
+		});
+		break;
+	case CT_BITMAP:
+		if (unlikely(cont_init_bitmap(&t)))
+			return -ENOMEM;
+		cont_foreach_run(c, lo, hi, bm_fill_range(t.b, lo, hi, TRUE));
+		break;
+	default:
+		if (unlikely(cont_init_run(&t, cont_nruns(c))))
+			return -ENOMEM;
+		cont_foreach_run(c, lo, hi, {
+			t.r[t.n].start = (u16)lo;
+			t.r[t.n].len = (u16)(hi - lo);
+			t.n++;
+		});
+	}
+	t.card = c->card;
+	cont_free(c);
+	*c = t;
+	return 0;
+}
+
+/*
+ * Use array container if it's small enough, and bitmap container otherwise.
+ * Failure is not harmful. Container is kept as it is.
+ */
+static void
+cont_normalize(struct cont *c) {
+	if (CT_BITMAP == c->type && c->card <= ARRAY_MAX)
+		cont_convert(c, CT_ARRAY);
+	else if (CT_ARRAY == c->type && c->card > ARRAY_MAX)
+		cont_convert(c, CT_BITMAP);
+	else if (CT_RUN == c->type && c->n > RUN_MAX)
+		cont_convert(c, c->card <= ARRAY_MAX ? CT_ARRAY : CT_BITMAP);
+}
+
+static bool
+cont_has(const struct cont *c, u16 v) {
+	u32 i;
+	int ri;
+	switch (c->type) {
+	case CT_ARRAY:
+		i = array_lower_bound(c->a, 0, c->n, v);
+		return i < c->n && c->a[i] == v;
+	case CT_BITMAP:
+		return bm_has(c->b, v);
+	}
+	ri = run_floor(c->r, c->n, v);
+	return ri >= 0 && v <= run_end(&c->r[ri]);
+}
+
+/* Insert run at @p i */
+static int
+run_insert(struct cont *c, u32 i, u16 start, u16 len) {
+	if (unlikely(cont_grow(c, sizeof(*c->r))))
+		return -ENOMEM;
+	memmove(&c->r[i + 1], &c->r[i], sizeof(*c->r) * (c->n - i));
+	c->r[i].start = start;
+	c->r[i].len = len;
+	c->n++;
+	return 0;
+}
+
+static INLINE void
+run_delete(struct cont *c, u32 i) {
+	memmove(&c->r[i], &c->r[i + 1], sizeof(*c->r) * (c->n - i - 1));
+	c->n--;
+}
+
+static int
+run_add(struct cont *c, u16 v) {
+	struct run *r;
+	int i = run_floor(c->r, c->n, v);
+	if (i >= 0) {
+		r = &c->r[i];
+		if (v <= run_end(r))
+			return 0;
+		if (v == run_end(r) + 1) {
+			r->len++;
+			/* Merge with next run */
+			if ((u32)i + 1 < c->n && r[1].start == v + 1) {
+				r->len += r[1].len + 1;
+				run_delete(c, i + 1);
+			}
+			return 1;
+		}
+	}
+	if ((u32)(i + 1) < c->n && c->r[i + 1].start == v + 1) {
+		c->r[i + 1].start--;
+		c->r[i + 1].len++;
+		return 1;
+	}
+	if (unlikely(run_insert(c, i + 1, v, 0)))
+		return -ENOMEM;
+	return 1;
+}
+
+static int
+run_remove(struct cont *c, u16 v) {
+	struct run *r;
+	u32 end;
+	int i = run_floor(c->r, c->n, v);
+	if (i < 0 || v > run_end(&c->r[i]))
+		return 0;
+	r = &c->r[i];
+	end = run_end(r);
+	if (r->start == v && !r->len)
+		run_delete(c, i);
+	else if (r->start == v) {
+		r->start++;
+		r->len--;
+	} else if (end == v)
+		r->len--;
+	else {
+		/* Split */
+		if (unlikely(run_insert(c, i + 1, v + 1, end - v - 1)))
+			return -ENOMEM;
+		c->r[i].len = v - c->r[i].start - 1;
+	}
+	return 1;
+}
+
+static int
+cont_add(struct cont *c, u16 v) {
+	u32 i;
+	int r;
+	switch (c->type) {
+	case CT_ARRAY:
+		i = array_lower_bound(c->a, 0, c->n, v);
+		if (i < c->n && c->a[i] == v)
+			return 0;
+		if (c->n >= ARRAY_MAX) {
+			if (unlikely(cont_convert(c, CT_BITMAP)))
+				return -ENOMEM;
+			return cont_add(c, v);
+		}
+		if (unlikely(cont_grow(c, sizeof(*c->a))))
+			return -ENOMEM;
+		memmove(&c->a[i + 1], &c->a[i], sizeof(*c->a) * (c->n - i));
+		c->a[i] = v;
+		c->n++;
+		break;
+	case CT_BITMAP:
+		if (bm_has(c->b, v))
+			return 0;
+		c->b[v >> 6] |= 1ULL << (v & 63);
+		break;
+	default:
+		if (unlikely(0 >= (r = run_add(c, v))))
+			return r;
+		c->card++;
+		cont_normalize(c);
+		return 1;
+	}
+	c->card++;
+	return 1;
+}
+
+static int
+cont_remove(struct cont *c, u16 v) {
+	u32 i;
+	int r;
+	switch (c->type) {
+	case CT_ARRAY:
+		i = array_lower_bound(c->a, 0, c->n, v);
+		if (i >= c->n || c->a[i] != v)
+			return 0;
+		memmove(&c->a[i], &c->a[i + 1], sizeof(*c->a) * (c->n - i - 1));
+		c->n--;
+		break;
+	case CT_BITMAP:
+		if (!bm_has(c->b, v))
+			return 0;
+		c->b[v >> 6] &= ~(1ULL << (v & 63));
+		c->card--;
+		cont_normalize(c);
+		return 1;
+	default:
+		if (unlikely(0 >= (r = run_remove(c, v))))
+			return r;
+		c->card--;
+		cont_normalize(c);
+		return 1;
+	}
+	c->card--;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------
+ * Operations between containers
+ *--------------------------------------------------------------------------*/
+/* Cardinality of intersection. Result is not created. */
+static u32
+cont_and_card(const struct cont *a, const struct cont *b) {
+	u32 i, j, card;
+	const struct cont *t;
+	/* Order by type: array < bitmap < run */
+	if (a->type > b->type) {
+		t = a;
+		a = b;
+		b = t;
+	}
+	switch (a->type * 3 + b->type) {
+	case CT_ARRAY * 3 + CT_ARRAY:
+		return array_and(NULL, a->a, a->n, b->a, b->n);
+	case CT_ARRAY * 3 + CT_BITMAP:
+		return array_filter_bm(NULL, a->a, a->n, b->b, TRUE);
+	case CT_ARRAY * 3 + CT_RUN:
+		return array_filter_run(NULL, a->a, a->n, b->r, b->n, TRUE);
+	case CT_BITMAP * 3 + CT_BITMAP:
+		return bm_op(NULL, a->b, b->b, OP_AND);
+	case CT_BITMAP * 3 + CT_RUN:
+		for (i = card = 0; i < b->n; i++)
+			card += bm_range_card(a->b, b->r[i].start,
+				run_end(&b->r[i]));
+		return card;
+	}
+	/* run and run: sum of overlaps */
+	i = j = card = 0;
+	while (i < a->n && j < b->n) {
+		u32 lo = a->r[i].start > b->r[j].start
+			? a->r[i].start : b->r[j].start;
+		u32 ea = run_end(&a->r[i]), eb = run_end(&b->r[j]);
+		u32 hi = ea < eb ? ea : eb;
+		if (lo <= hi)
+			card += hi - lo + 1;
+		if (ea < eb)
+			i++;
+		else
+			j++;
+	}
+	return card;
+}
+
+/* Set(@p set) or clear bits of values @p a at bitmap container @p c. */
+static void
+bm_apply_array(struct cont *c, const u16 *a, u32 n, bool set) {
+	u32 i;
+	u64 m, *w;
+	for (i = 0; i < n; i++) {
+		m = 1ULL << (a[i] & 63);
+		w = &c->b[a[i] >> 6];
+		if (set) {
+			c->card += !(*w & m);
+			*w |= m;
+		} else {
+			c->card -= !!(*w & m);
+			*w &= ~m;
+		}
+	}
+}
+
+/*
+ * @p out = @p a op @p b. Both SHOULD be array or bitmap container.
+ * Result may be empty.
+ */
+static int
+cont_op_ab(
+	int op,
+	const struct cont *a,
+	const struct cont *b,
+	struct cont *out
+) {
+	int r;
+	const struct cont *t;
+	if (CT_ARRAY == a->type && CT_ARRAY == b->type
+		&& !(OP_OR == op && a->n + b->n > ARRAY_MAX)
+	) {
+		if (unlikely(cont_init_array(out, OP_AND == op
+			? (a->n < b->n ? a->n : b->n)
+			: OP_OR == op ? a->n + b->n : a->n))
+		) { return -ENOMEM; }
+		out->n = out->card
+			= OP_AND == op ? array_and(out->a, a->a, a->n, b->a, b->n)
+			: OP_OR == op ? array_or(out->a, a->a, a->n, b->a, b->n)
+			: array_andnot(out->a, a->a, a->n, b->a, b->n);
+		return 0;
+	}
+	if (CT_BITMAP == a->type && CT_BITMAP == b->type) {
+		if (unlikely(cont_init_bitmap(out)))
+			return -ENOMEM;
+		out->card = bm_op(out->b, a->b, b->b, op);
+		cont_normalize(out);
+		return 0;
+	}
+	/* array & bitmap, array - bitmap: array is filtered. */
+	if (OP_AND == op || (OP_ANDNOT == op && CT_ARRAY == a->type)) {
+		if (CT_ARRAY != a->type) {
+			t = a;
+			a = b;
+			b = t;
+		}
+		if (unlikely(cont_init_array(out, a->n)))
+			return -ENOMEM;
+		out->n = out->card = array_filter_bm(
+			out->a, a->a, a->n, b->b, OP_AND == op);
+		return 0;
+	}
+	/* bitmap | array, bitmap - array, (large) array | array
+	 *   : bits of array are set to(or cleared from) bitmap.
+	 */
+	if (CT_ARRAY == a->type && CT_BITMAP == b->type) {
+		t = a;
+		a = b;
+		b = t;
+	}
+	if (unlikely(r = cont_clone(out, a))
+		|| unlikely(r = cont_convert(out, CT_BITMAP))
+	) { return r; }
+	bm_apply_array(out, b->a, b->n, OP_OR == op);
+	cont_normalize(out);
+	return 0;
+}
+
+/*
+ * Clone run container @p s to array or bitmap container @p d.
+ */
+static int
+cont_expand(struct cont *d, const struct cont *s) {
+	int r;
+	if (unlikely(r = cont_clone(d, s)))
+		return r;
+	if (unlikely(r = cont_convert(d, d->card <= ARRAY_MAX
+		? CT_ARRAY : CT_BITMAP))
+	) {
+		cont_free(d);
+		return r;
+	}
+	return 0;
+}
+
+/* @p out = @p a op @p b. Result may be empty. */
+static int
+cont_op(int op, const struct cont *a, const struct cont *b, struct cont *out) {
+	int r;
+	struct cont ta, tb;
+	/* Array is filtered by runs directly. */
+	if (CT_RUN == b->type && CT_ARRAY == a->type && OP_OR != op) {
+		if (unlikely(cont_init_array(out, a->n)))
+			return -ENOMEM;
+		out->n = out->card = array_filter_run(
+			out->a, a->a, a->n, b->r, b->n, OP_AND == op);
+		return 0;
+	}
+	if (CT_RUN == a->type && CT_ARRAY == b->type && OP_AND == op)
+		return cont_op(op, b, a, out);
+	/* Otherwise, run container is expanded. */
+	if (CT_RUN == a->type) {
+		if (unlikely(r = cont_expand(&ta, a)))
+			return r;
+		r = cont_op(op, &ta, b, out);
+		cont_free(&ta);
+		return r;
+	}
+	if (CT_RUN == b->type) {
+		if (unlikely(r = cont_expand(&tb, b)))
+			return r;
+		r = cont_op(op, a, &tb, out);
+		cont_free(&tb);
+		return r;
+	}
+	return cont_op_ab(op, a, b, out);
+}
+
+/*
+ * @p a = @p a op @p b.
+ * Result is written to memory of @p a if possible(filtering array, or
+ *   updating bitmap). Result may be empty.
+ * If it fails, @p a is not changed.
+ */
+static int
+cont_op_inplace(int op, struct cont *a, const struct cont *b) {
+	int r;
+	u32 lo, hi, next;
+	struct cont t;
+	if (CT_ARRAY == a->type && OP_OR != op) {
+		/* Result is subset of 'a'. */
+		switch (b->type) {
+		case CT_ARRAY:
+			a->n = OP_AND == op
+				? array_and(a->a, a->a, a->n, b->a, b->n)
+				: array_andnot(a->a, a->a, a->n, b->a, b->n);
+			break;
+		case CT_BITMAP:
+			a->n = array_filter_bm(
+				a->a, a->a, a->n, b->b, OP_AND == op);
+			break;
+		default:
+			a->n = array_filter_run(
+				a->a, a->a, a->n, b->r, b->n, OP_AND == op);
+		}
+		a->card = a->n;
+		return 0;
+	}
+	if (CT_BITMAP == a->type) {
+		switch (b->type) {
+		case CT_BITMAP:
+			a->card = bm_op(a->b, a->b, b->b, op);
+			cont_normalize(a);
+			return 0;
+		case CT_ARRAY:
+			if (OP_AND == op)
+				break; /* Result is array */
+			bm_apply_array(a, b->a, b->n, OP_OR == op);
+			cont_normalize(a);
+			return 0;
+		default:
+			if (OP_AND != op)
+				cont_foreach_run(b, lo, hi, bm_fill_range(
+					a->b, lo, hi, OP_OR == op));
+			else {
+				/* Clear gaps between runs */
+				next = 0;
+				cont_foreach_run(b, lo, hi, {
+					if (lo > next)
+						bm_fill_range(a->b, next, lo - 1,
+							FALSE);
+					next = hi + 1;
+				});
+				if (next < 65536)
+					bm_fill_range(a->b, next, 65535, FALSE);
+			}
+			a->card = bm_op(NULL, a->b, a->b, OP_OR);
+			cont_normalize(a);
+			return 0;
+		}
+	}
+	if (unlikely(r = cont_op(op, a, b, &t)))
+		return r;
+	cont_free(a);
+	*a = t;
+	return 0;
+}
+
+
+/****************************************************************************
+ *
+ * Roaring bitmap
+ *
+ ****************************************************************************/
+/* @return index of container of key @p k. If there is no such container,
+ *   -(index to insert) - 1.
+ */
+static int
+key_find(const struct yroaring *r, u16 k) {
+	u32 i = array_lower_bound(r->keys, 0, r->n, k);
+	return i < r->n && r->keys[i] == k ? (int)i : -(int)i - 1;
+}
+
+/* Make room for @p n containers. */
+static int
+reserve(struct yroaring *r, u32 n) {
+	u16 *keys;
+	struct cont *c;
+	u32 cap = r->cap * 2;
+	if (n <= r->cap)
+		return 0;
+	if (cap < n)
+		cap = n;
+	if (cap < 4)
+		cap = 4;
+	keys = r->keys
+		? yrealloc(r->keys, sizeof(*keys) * cap)
+		: ymalloc(sizeof(*keys) * cap);
+	if (unlikely(!keys))
+		return -ENOMEM;
+	r->keys = keys;
+	c = r->c
+		? yrealloc(r->c, sizeof(*c) * cap)
+		: ymalloc(sizeof(*c) * cap);
+	if (unlikely(!c))
+		return -ENOMEM;
+	r->c = c;
+	r->cap = cap;
+	return 0;
+}
+
+/* Container @p c is moved into the set. There SHOULD be room for it. */
+static INLINE void
+insert_at(struct yroaring *r, u32 i, u16 k, const struct cont *c) {
+	memmove(&r->keys[i + 1], &r->keys[i], sizeof(*r->keys) * (r->n - i));
+	memmove(&r->c[i + 1], &r->c[i], sizeof(*r->c) * (r->n - i));
+	r->keys[i] = k;
+	r->c[i] = *c;
+	r->n++;
+}
+
+static INLINE void
+remove_at(struct yroaring *r, u32 i) {
+	cont_free(&r->c[i]);
+	memmove(&r->keys[i], &r->keys[i + 1],
+		sizeof(*r->keys) * (r->n - i - 1));
+	memmove(&r->c[i], &r->c[i + 1], sizeof(*r->c) * (r->n - i - 1));
+	r->n--;
+}
+
+/* Append container @p c or free it if it is empty. */
+static INLINE void
+append(struct yroaring *r, u16 k, struct cont *c) {
+	if (!c->card) {
+		cont_free(c);
+		return;
+	}
+	yassert(r->n < r->cap);
+	r->keys[r->n] = k;
+	r->c[r->n++] = *c;
+}
+
+struct yroaring *
+yroaring_create(void) {
+	struct yroaring *r = ymalloc(sizeof(*r));
+	if (unlikely(!r))
+		return NULL;
+	r->n = r->cap = 0;
+	r->keys = NULL;
+	r->c = NULL;
+	return r;
+}
+
+void
+yroaring_clear(struct yroaring *r) {
+	u32 i;
+	for (i = 0; i < r->n; i++)
+		cont_free(&r->c[i]);
+	r->n = 0;
+}
+
+void
+yroaring_destroy(struct yroaring *r) {
+	yroaring_clear(r);
+	if (r->keys)
+		yfree(r->keys);
+	if (r->c)
+		yfree(r->c);
+	yfree(r);
+}
+
+struct yroaring *
+yroaring_clone(const struct yroaring *r) {
+	u32 i;
+	struct cont c;
+	struct yroaring *d = yroaring_create();
+	if (unlikely(!d))
+		return NULL;
+	if (unlikely(reserve(d, r->n)))
+		goto fail;
+	for (i = 0; i < r->n; i++) {
+		if (unlikely(cont_clone(&c, &r->c[i])))
+			goto fail;
+		append(d, r->keys[i], &c);
+	}
+	return d;
+
+ fail:
+	yroaring_destroy(d);
+	return NULL;
+}
+
+int
+yroaring_add(struct yroaring *r, u32 v) {
+	int ret;
+	struct cont c;
+	int i = key_find(r, (u16)(v >> 16));
+	if (i >= 0)
+		return cont_add(&r->c[i], (u16)v);
+	i = -i - 1;
+	if (unlikely(reserve(r, r->n + 1)
+		|| cont_init_array(&c, ARRAY_MIN_CAP))
+	) { return -ENOMEM; }
+	ret = cont_add(&c, (u16)v);
+	yassert(1 == ret);
+	insert_at(r, i, (u16)(v >> 16), &c);
+	return ret;
+}
+
+int
+yroaring_remove(struct yroaring *r, u32 v) {
+	int ret;
+	int i = key_find(r, (u16)(v >> 16));
+	if (i < 0)
+		return 0;
+	ret = cont_remove(&r->c[i], (u16)v);
+	if (!r->c[i].card)
+		remove_at(r, i);
+	return ret;
+}
+
+bool
+yroaring_has(const struct yroaring *r, u32 v) {
+	int i = key_find(r, (u16)(v >> 16));
+	return i >= 0 && cont_has(&r->c[i], (u16)v);
+}
+
+u64
+yroaring_card(const struct yroaring *r) {
+	u32 i;
+	u64 card = 0;
+	for (i = 0; i < r->n; i++)
+		card += r->c[i].card;
+	return card;
+}
+
+u32
+yroaring_values(const struct yroaring *r, u32 *buf, u32 bufsz) {
+	u32 i, lo, hi, v, k = 0;
+	u32 hb;
+	for (i = 0; i < r->n && k < bufsz; i++) {
+		hb = (u32)r->keys[i] << 16;
+		cont_foreach_run(&r->c[i], lo, hi, {
+			for (v = lo; v <= hi && k < bufsz; v++)
+				buf[k++] = hb | v;
+		});
+	}
+	return k;
+}
+
+int
+yroaring_optimize(struct yroaring *r) {
+	u32 i, runsz, sz;
+	struct cont *c;
+	for (i = 0; i < r->n; i++) {
+		c = &r->c[i];
+		runsz = sizeof(struct run) * cont_nruns(c);
+		sz = c->card <= ARRAY_MAX ? sizeof(u16) * c->card : BM_BYTES;
+		if (runsz < sz) {
+			if (unlikely(cont_convert(c, CT_RUN)))
+				return -ENOMEM;
+		} else if (CT_RUN == c->type) {
+			if (unlikely(cont_convert(c, c->card <= ARRAY_MAX
+				? CT_ARRAY : CT_BITMAP))
+			) { return -ENOMEM; }
+		}
+	}
+	return 0;
+}
+
+bool
+yroaring_equal(const struct yroaring *a, const struct yroaring *b) {
+	u32 i;
+	if (a->n != b->n)
+		return FALSE;
+	for (i = 0; i < a->n; i++) {
+		if (a->keys[i] != b->keys[i]
+			|| a->c[i].card != b->c[i].card
+			|| a->c[i].card != cont_and_card(&a->c[i], &b->c[i])
+		) { return FALSE; }
+	}
+	return TRUE;
+}
+
+/*---------------------------------------------------------------------------
+ * Set operations
+ *--------------------------------------------------------------------------*/
+static struct yroaring *
+roaring_op(int op, const struct yroaring *a, const struct yroaring *b) {
+	u32 i = 0, j = 0;
+	struct cont c;
+	struct yroaring *r = yroaring_create();
+	if (unlikely(!r))
+		return NULL;
+	if (unlikely(reserve(r, OP_OR == op ? a->n + b->n : a->n)))
+		goto fail;
+	while (i < a->n && (j < b->n || OP_AND != op)) {
+		if (j >= b->n || a->keys[i] < b->keys[j]) {
+			if (OP_AND != op) {
+				if (unlikely(cont_clone(&c, &a->c[i])))
+					goto fail;
+				append(r, a->keys[i], &c);
+			}
+			i++;
+		} else if (a->keys[i] > b->keys[j]) {
+			if (OP_OR == op) {
+				if (unlikely(cont_clone(&c, &b->c[j])))
+					goto fail;
+				append(r, b->keys[j], &c);
+			}
+			j++;
+		} else {
+			if (unlikely(cont_op(op, &a->c[i], &b->c[j], &c)))
+				goto fail;
+			append(r, a->keys[i], &c);
+			i++;
+			j++;
+		}
+	}
+	for (; OP_OR == op && j < b->n; j++) {
+		if (unlikely(cont_clone(&c, &b->c[j])))
+			goto fail;
+		append(r, b->keys[j], &c);
+	}
+	return r;
+
+ fail:
+	yroaring_destroy(r);
+	return NULL;
+}
+
+struct yroaring *
+yroaring_and(const struct yroaring *a, const struct yroaring *b) {
+	return roaring_op(OP_AND, a, b);
+}
+
+struct yroaring *
+yroaring_or(const struct yroaring *a, const struct yroaring *b) {
+	return roaring_op(OP_OR, a, b);
+}
+
+struct yroaring *
+yroaring_andnot(const struct yroaring *a, const struct yroaring *b) {
+	return roaring_op(OP_ANDNOT, a, b);
+}
+
+/* and, andnot. Result is subset of @p a. So, containers are compacted. */
+static int
+roaring_op_inplace(int op, struct yroaring *a, const struct yroaring *b) {
+	int r = 0;
+	u32 i, j = 0, k = 0;
+	for (i = 0; i < a->n; i++) {
+		while (j < b->n && b->keys[j] < a->keys[i])
+			j++;
+		if (j < b->n && b->keys[j] == a->keys[i]) {
+			/* Container is kept as it is if it fails. */
+			if (!r)
+				r = cont_op_inplace(op, &a->c[i], &b->c[j]);
+		} else if (OP_AND == op)
+			a->c[i].card = 0;
+		if (!a->c[i].card) {
+			cont_free(&a->c[i]);
+			continue;
+		}
+		a->keys[k] = a->keys[i];
+		a->c[k++] = a->c[i];
+	}
+	a->n = k;
+	return r;
+}
+
+int
+yroaring_and_inplace(struct yroaring *a, const struct yroaring *b) {
+	return roaring_op_inplace(OP_AND, a, b);
+}
+
+int
+yroaring_andnot_inplace(struct yroaring *a, const struct yroaring *b) {
+	return roaring_op_inplace(OP_ANDNOT, a, b);
+}
+
+int
+yroaring_or_inplace(struct yroaring *a, const struct yroaring *b) {
+	int r = 0;
+	int i, j, d;
+	u32 nnew = 0, k = 0;
+	struct cont *nc = NULL;
+	/* Containers only in 'b' are cloned first. Then, merging below
+	 *   doesn't fail in the middle.
+	 */
+	for (i = j = 0; j < b->n; j++) {
+		while ((u32)i < a->n && a->keys[i] < b->keys[j])
+			i++;
+		if ((u32)i >= a->n || a->keys[i] != b->keys[j])
+			nnew++;
+	}
+	if (!nnew)
+		goto merge;
+	if (unlikely(reserve(a, a->n + nnew)
+		|| !(nc = ymalloc(sizeof(*nc) * nnew)))
+	) { return -ENOMEM; }
+	for (i = j = 0; j < b->n; j++) {
+		while ((u32)i < a->n && a->keys[i] < b->keys[j])
+			i++;
+		if ((u32)i < a->n && a->keys[i] == b->keys[j])
+			continue;
+		if (unlikely(cont_clone(&nc[k], &b->c[j]))) {
+			while (k--)
+				cont_free(&nc[k]);
+			yfree(nc);
+			return -ENOMEM;
+		}
+		k++;
+	}
+
+ merge:
+	/* Merge from the end. */
+	i = a->n - 1;
+	j = b->n - 1;
+	d = a->n + nnew - 1;
+	while (j >= 0) {
+		if (i >= 0 && a->keys[i] > b->keys[j]) {
+			a->keys[d] = a->keys[i];
+			a->c[d--] = a->c[i--];
+		} else if (i >= 0 && a->keys[i] == b->keys[j]) {
+			if (!r)
+				r = cont_op_inplace(OP_OR, &a->c[i], &b->c[j]);
+			a->keys[d] = a->keys[i];
+			a->c[d--] = a->c[i--];
+			j--;
+		} else {
+			a->keys[d] = b->keys[j];
+			a->c[d--] = nc[--k];
+			j--;
+		}
+	}
+	a->n += nnew;
+	if (nnew)
+		yfree(nc);
+	return r;
+}
+
+/*---------------------------------------------------------------------------
+ * Cardinality
+ *--------------------------------------------------------------------------*/
+u64
+yroaring_and_card(const struct yroaring *a, const struct yroaring *b) {
+	u32 i = 0, j = 0;
+	u64 card = 0;
+	while (i < a->n && j < b->n) {
+		if (a->keys[i] < b->keys[j])
+			i++;
+		else if (a->keys[i] > b->keys[j])
+			j++;
+		else
+			card += cont_and_card(&a->c[i++], &b->c[j++]);
+	}
+	return card;
+}
+
+u64
+yroaring_or_card(const struct yroaring *a, const struct yroaring *b) {
+	return yroaring_card(a) + yroaring_card(b) - yroaring_and_card(a, b);
+}
+
+u64
+yroaring_andnot_card(const struct yroaring *a, const struct yroaring *b) {
+	return yroaring_card(a) - yroaring_and_card(a, b);
+}
@@ -34,74 +34,171 @@
  * official policies, either expressed or implied, of the FreeBSD Project.
  *****************************************************************************/
 #include <stdlib.h>
+#include <errno.h>
 
 #include "common.h"
 #include "yset.h"
 
+/*
+ * Set operations are done by visiting items of one set with
+ *   yhash_foreach/yhash_filter. So, nothing is allocated except for
+ *   result set.
+ */
+struct setop {
+	yset_t s; /* set to be updated */
+	yset_t other; /* set to test element against */
+	u32 n; /* number of matched elements */
+};
+
+static bool
+keep_if_in(const void *elem, unused void *v, void *other) {
+	return yset_has((yset_t)other, elem);
+}
+
+static bool
+keep_if_not_in(const void *elem, unused void *v, void *other) {
+	return !yset_has((yset_t)other, elem);
+}
+
+static int
+count_if_in(const void *elem, unused void *v, void *arg) {
+	struct setop *op = arg;
+	if (yset_has(op->other, elem))
+		op->n++;
+	return 0;
+}
+
+static int
+add_to(const void *elem, unused void *v, void *s) {
+	int r = yset_add((yset_t)s, (void *)elem);
+	return r < 0 ? r : 0;
+}
+
+static int
+remove_from(const void *elem, unused void *v, void *s) {
+	yset_remove((yset_t)s, elem);
+	return 0;
+}
+
+static int
+add_if_in(const void *elem, unused void *v, void *arg) {
+	struct setop *op = arg;
+	if (!yset_has(op->other, elem))
+		return 0;
+	return add_to(elem, v, op->s);
+}
+
+static int
+add_if_not_in(const void *elem, unused void *v, void *arg) {
+	struct setop *op = arg;
+	if (yset_has(op->other, elem))
+		return 0;
+	return add_to(elem, v, op->s);
+}
+
+static INLINE bool
+is_valid_pair(const yset_t s0, const yset_t s1) {
+	return s0 && s1 && yhash_is_sametype(s0, s1);
+}
+
+/****************************************************************************
+ *
+ * In-place and cardinality-only operations
+ *
+ ****************************************************************************/
+u32
+yset_intersect_count(const yset_t s0, const yset_t s1) {
+	struct setop op;
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return 0;
+	/* Smaller one is visited. */
+	op.s = NULL;
+	op.other = yset_sz(s0) < yset_sz(s1) ? s1 : s0;
+	op.n = 0;
+	yhash_foreach(op.other == s0 ? s1 : s0, &count_if_in, &op);
+	return op.n;
+}
+
+int
+yset_intersect_inplace(yset_t s0, const yset_t s1) {
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return -EINVAL;
+	if (s0 != s1)
+		yhash_filter(s0, &keep_if_in, s1);
+	return 0;
+}
+
+int
+yset_union_inplace(yset_t s0, const yset_t s1) {
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return -EINVAL;
+	if (s0 == s1)
+		return 0;
+	return yhash_foreach(s1, &add_to, s0);
+}
+
+int
+yset_diff_inplace(yset_t s0, const yset_t s1) {
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return -EINVAL;
+	/* Smaller one is visited. */
+	if (yset_sz(s1) < yset_sz(s0))
+		yhash_foreach(s1, &remove_from, s0);
+	else
+		yhash_filter(s0, &keep_if_not_in, s1);
+	return 0;
+}
+
+/****************************************************************************
+ *
+ * Operations creating new set
+ *
+ ****************************************************************************/
 yset_t
 yset_intersect(const yset_t s0, const yset_t s1) {
-	/* NOT TESTED YET */
-	yset_t ss; /* source set - smaller set */
-	yset_t ts; /* target set - larger set */
-	u32 sz0, sz1, sssz, i;
-	const void **ebuf = NULL;
-	yset_t s = NULL;
-	if (unlikely(!s0
-		|| !s1
-		|| !yhash_is_sametype(s0, s1))
-	) { return NULL; }
-	if (unlikely(!(s = yset_create(s0))))
+	struct setop op;
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return NULL;
+	if (unlikely(!(op.s = yset_create(s0))))
 		return NULL; /* ENOMEM */
-	sz0 = yset_sz(s0);
-	sz1 = yset_sz(s1);
-	/* Trivial case : There is empty set. */
-	if (unlikely(!sz0 || !sz1))
-		return s; /* return empty set */
-
-	if (sz0 < sz1) {
-		ss = s0;
-		ts = s1;
-		sssz = sz0;
-	} else {
-		ss = s1;
-		ts = s0;
-		sssz = sz1;
-	}
-	if (unlikely(!(ebuf = (const void **)ymalloc(sizeof(*ebuf) * sssz))))
-		goto fail; /* ENOMEM */
-	if (unlikely(sssz != yset_elements(ss, ebuf, sssz)))
-		/* this is totally unexpected! */
-		goto fail;
-
-	i = sssz;
-	while (i--) {
-		if (yset_has(ts, ebuf[i])) {
-			if (unlikely(0 > yset_add(s, (void *)ebuf[i])))
-				goto fail; /* ENOMEM */
-		}
+	/* Smaller one is visited. */
+	op.other = yset_sz(s0) < yset_sz(s1) ? s1 : s0;
+	if (unlikely(yhash_foreach(op.other == s0 ? s1 : s0,
+		&add_if_in, &op))
+	) {
+		yset_destroy(op.s);
+		return NULL;
 	}
-
-	goto done;
-
- fail:
-	if (likely(s))
-		yset_destroy(s);
-	s = NULL;
- done:
-	if (likely(ebuf))
-		free(ebuf);
-	return s;
-
+	return op.s;
 }
 
 yset_t
 yset_union(const yset_t s0, const yset_t s1) {
-	/* NOT IMPLEMENTED YET */
-	return NULL;
+	yset_t s;
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return NULL;
+	if (unlikely(!(s = yset_create(s0))))
+		return NULL; /* ENOMEM */
+	if (unlikely(yset_union_inplace(s, s0)
+		|| yset_union_inplace(s, s1))
+	) {
+		yset_destroy(s);
+		return NULL;
+	}
+	return s;
 }
 
 yset_t
 yset_diff(const yset_t s0, const yset_t s1) {
-	/* NOT IMPLEMENTED YET */
-	return NULL;
+	struct setop op;
+	if (unlikely(!is_valid_pair(s0, s1)))
+		return NULL;
+	if (unlikely(!(op.s = yset_create(s0))))
+		return NULL; /* ENOMEM */
+	op.other = s1;
+	if (unlikely(yhash_foreach(s0, &add_if_not_in, &op))) {
+		yset_destroy(op.s);
+		return NULL;
+	}
+	return op.s;
 }
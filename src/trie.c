@@ -71,8 +71,13 @@
 #include <memory.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
+#include "ebr.h"
 #include "ytrie.h"
 
 
@@ -88,280 +93,2012 @@ struct node {
 	void *v;
 };
 
+/* Max depth of 4-bit node. Two nodes(front and back) per key byte. */
+#define NODE_MAX_DEPTH (YTRIE_MAX_KEY_LEN * 2)
+
+/* Type of memory to be freed after grace period at concurrent mode */
+enum {
+	R_MEM, /* node or leaf of ART */
+	R_VALUE, /* value */
+	R_TREE, /* whole ART subtree including values */
+};
+
+struct retired {
+	void *p;
+	int type;
+};
+
+/*
+ * Nodes of 4-bit engine are carved from chunks owned by trie.
+ * Removed node is kept at free list of trie and reused. So, chunks are
+ *   freed only at reset(or destroy) at once, instead of each node.
+ */
+#define NCHUNK_NODES 480 /* about 64KB */
+
+struct nchunk {
+	struct nchunk *next;
+	u32 used; /* number of nodes carved from this chunk */
+	struct node n[NCHUNK_NODES];
+};
+
 struct ytrie {
 	struct node rt; /* root. sentinel */
+	struct nchunk *chunks; /* chunks of nodes. the latest one is first */
+	struct node *nfree; /* free nodes. linked by 'n[0]' */
+	void *art; /* root of ART engine. leaf or inner node */
 	void (*vfree)(void *); /* callback for free value */
+	u32 (*vscore)(const void *); /* NULL if trie isn't scored */
+	u32 sz; /* number of values */
+	int opt; /* YTRIE_xxx options */
+	/* Followings are used only at concurrent mode */
+	pthread_mutex_t w_lock; /* serializes writers */
+	struct retired *rl; /* memories waiting grace period */
+	u32 rlsz;
+	u32 rlcap;
 };
 
-static INLINE struct node *
-alloc_node(void) {
-	struct node *n = ycalloc(1, sizeof(*n));
+declare_lock(mutex, struct ytrie, w, NULL)
+
+/* Return values of auto complete */
+#define YTRIEBranch 0
+#define YTRIELeaf 1
+#define YTRIEFail 2
+
+static INLINE bool
+is_art(const struct ytrie *t) {
+	return !!(t->opt & YTRIE_art);
+}
+
+static INLINE bool
+is_conc(const struct ytrie *t) {
+	return !!(t->opt & YTRIE_concurrent);
+}
+
+static INLINE void
+read_begin(const struct ytrie *t) {
+	if (is_conc(t))
+		ebr_read_begin();
+}
+
+static INLINE void
+read_end(const struct ytrie *t) {
+	if (is_conc(t))
+		ebr_read_end();
+}
+
+static struct node *
+alloc_node(struct ytrie *t) {
+	struct node *n;
+	struct nchunk *c = t->chunks;
+	if ((n = t->nfree))
+		t->nfree = n->n[0];
+	else {
+		if (unlikely(!c || c->used >= NCHUNK_NODES)) {
+			if (unlikely(!(c = ymalloc(sizeof(*c)))))
+				return NULL;
+			c->next = t->chunks;
+			c->used = 0;
+			t->chunks = c;
+		}
+		n = &c->n[c->used++];
+	}
+	memset(n, 0, sizeof(*n));
+	return n;
+}
+
+static INLINE void
+free_node(struct ytrie *t, struct node *n) {
+	/* Node at free list SHOULD NOT have value. See free_nodes(). */
+	yassert(!n->v);
+	n->n[0] = t->nfree;
+	t->nfree = n;
+}
+
+/*
+ * Free all nodes.
+ * Values are found by scanning chunks linearly, instead of walking tree.
+ */
+static void
+free_nodes(struct ytrie *t) {
+	u32 i;
+	struct nchunk *c, *next;
+	for (c = t->chunks; c; c = next) {
+		next = c->next;
+		if (t->vfree)
+			for (i = 0; i < c->used; i++)
+				if (c->n[i].v)
+					(*t->vfree)(c->n[i].v);
+		yfree(c);
+	}
+	t->chunks = NULL;
+	t->nfree = NULL;
+	memset(&t->rt, 0, sizeof(t->rt));
+}
+
+static INLINE bool
+is_empty_leaf(const struct node *n) {
+	register int i;
+	if (n->v)
+		return FALSE;
+	for (i = 0; i < 16; i++)
+		if (n->n[i])
+			return FALSE;
+	return TRUE;
+}
+
+/*
+ * Remove value and empty leaf nodes on the path of key.
+ * @return 1 if removed. 0 if key is not in the trie.
+ */
+static int
+remove_key(struct ytrie *t, const u8 *key, u32 sz) {
+	/* path[0] is root. */
+	struct node *path[NODE_MAX_DEPTH + 1];
+	struct node *n = &t->rt;
+	u32 i, d;
+	if (unlikely(sz >= YTRIE_MAX_KEY_LEN))
+		return 0;
+	d = 0;
+	path[d++] = n;
+	for (i = 0; i < sz; i++) {
+		if (!(n = n->n[key[i] >> 4]))
+			return 0;
+		path[d++] = n;
+		if (!(n = n->n[key[i] & 0x0f]))
+			return 0;
+		path[d++] = n;
+	}
+	if (!n->v)
+		return 0;
+	if (t->vfree)
+		(*t->vfree)(n->v);
+	n->v = NULL;
+	/* Root is never removed. */
+	for (d--; d > 0 && is_empty_leaf(path[d]); d--) {
+		/* odd depth: front node. even depth: back node */
+		u8 c = key[(d - 1) / 2];
+		path[d - 1]->n[d & 1 ? c >> 4 : c & 0x0f] = NULL;
+		free_node(t, path[d]);
+	}
+	return 1;
+}
+
+/*
+ * @param c (char) character
+ * @param n (struct node *) node to move down
+ * @param fi (int) variable to store front index
+ * @param bi (int) variable to store back index
+ * @param felse (statement) code in 'else' brace of front node
+ * @param belse (statement) code in 'else' brace of back node
+ */
+#define move_down_node(c, n, fi, bi, felse, belse)	\
+	do {						\
+		(fi) = (c) >> 4; (bi) = (c) & 0x0f;	\
+		if ((n)->n[fi])				\
+			(n) = (n)->n[fi];		\
+		else {					\
+			felse;				\
+		}					\
+		if ((n)->n[bi])				\
+			(n) = (n)->n[bi];		\
+		else {					\
+			belse;				\
+		}					\
+	} while (0)
+/*
+ * If node exists, it returns node. If not, it creates new one and returns it.
+ * @return back node of last character of symbol.
+ *	If fails to get, NULL is returned.
+ */
+static struct node *
+get_node(struct ytrie *t, const u8 *key, u32 sz, int bcreate) {
+	register struct node *n = &t->rt;
+	register const u8 *p = key;
+	register const u8 *pend = p+sz;
+	register int fi, bi; /* front index */
+
+	if (bcreate) {
+		while (p < pend) {
+			move_down_node(*p, n, fi, bi,
+				       n = n->n[fi] = alloc_node(t); \
+				       if (unlikely(!n)) { return NULL; },
+				       n = n->n[bi] = alloc_node(t); \
+				       if (unlikely(!n)) { return NULL; });
+			p++;
+		}
+	} else {
+		while (p < pend) {
+			move_down_node(*p, n, fi, bi,
+				       return NULL, return NULL);
+			p++;
+		}
+	}
+	return n;
+}
+
+/*
+ * Make room to push one more frame to explicit stack of walking tree.
+ * Stack is allocated from heap and grows on demand, because frames for
+ *   the maximum depth are too large to be on the stack of thread.
+ * @return Stack having room for frame @p sp. NULL if fails. In this case,
+ *   @p st is still valid.
+ */
+static void *
+wstack_reserve(void *st, u32 *cap, u32 sp, size_t esz) {
+	u32 ncap;
+	void *p;
+	if (likely(sp < *cap))
+		return st;
+	ncap = *cap ? *cap * 2 : 64;
+	p = st ? yrealloc(st, esz * ncap) : ymalloc(esz * ncap);
+	if (unlikely(!p))
+		return NULL;
+	*cap = ncap;
+	return p;
+}
+
+struct cframe {
+	const struct node *s;
+	struct node *d;
+	u32 i; /* next child to visit */
+};
+
+/*
+ * Clone children of @p src to @p dst whose nodes are allocated from @p t.
+ * Tree is walked with explicit stack.
+ * @return Number of cloned values. -ENOMEM if fails. Nodes cloned before
+ *   failure are left at @p dst.
+ */
+static s64
+clone_nodes(
+	struct ytrie *t,
+	const struct node *src,
+	struct node *dst,
+	void *tag,
+	void *(*clonev)(void *, const void *)
+) {
+	struct cframe *st = NULL;
+	u32 sp = 0, cap = 0, i;
+	s64 nv = 0;
+	const struct node *s;
+	struct node *n;
+	void *p;
+
+	if (unlikely(!(st = wstack_reserve(st, &cap, sp, sizeof(*st)))))
+		return -ENOMEM;
+	st[0].s = src;
+	st[0].d = dst;
+	st[0].i = 0;
+	sp = 1;
+	while (sp) {
+		struct cframe *f = &st[sp - 1];
+		while (f->i < 16 && !f->s->n[f->i])
+			f->i++;
+		if (f->i >= 16) {
+			sp--;
+			continue;
+		}
+		i = f->i++;
+		s = f->s->n[i];
+		if (unlikely(!(n = alloc_node(t))))
+			goto nomem;
+		f->d->n[i] = n;
+		if (s->v) {
+			if (unlikely(!(n->v = (*clonev)(tag, s->v))))
+				goto nomem;
+			nv++;
+		}
+		/* Depth is limited by YTRIE_MAX_KEY_LEN. */
+		yassert(sp <= NODE_MAX_DEPTH);
+		if (unlikely(!(p = wstack_reserve(st, &cap, sp, sizeof(*st)))))
+			goto nomem;
+		st = p;
+		st[sp].s = s;
+		st[sp].d = n;
+		st[sp].i = 0;
+		sp++;
+	}
+	yfree(st);
+	return nv;
+ nomem:
+	yfree(st);
+	return -ENOMEM;
+}
+
+struct iframe {
+	struct node *n;
+	u32 i; /* next child to visit */
+};
+
+/*
+ * Visit values in the subtree of @p n in order of key.
+ * Tree is walked with explicit stack.
+ *
+ * @param bsz Size of @p buf excluding space for trailing 0.
+ */
+static int
+iterate_internal(
+	void *tag,
+	struct node *n,
+	int(cb)(void *, const u8 *, u32, void *),
+	u8 *buf,
+	u32 bsz
+) {
+	struct iframe *st = NULL;
+	u32 sp = 0, cap = 0, d, i;
+	int r = 1;
+	struct node *c;
+	void *p;
+
+	buf[0] = 0; /* empty key of 'n' */
+	if (n->v && !(*cb)(tag, buf, 0, n->v))
+		return 0;
+	if (unlikely(!(st = wstack_reserve(st, &cap, sp, sizeof(*st)))))
+		return -ENOMEM;
+	st[0].n = n;
+	st[0].i = 0;
+	sp = 1;
+	while (sp) {
+		struct iframe *f = &st[sp - 1];
+		while (f->i < 16 && !f->n->n[f->i])
+			f->i++;
+		if (f->i >= 16) {
+			sp--;
+			continue;
+		}
+		i = f->i++;
+		/* depth of 'f' in nibbles. even: front node. odd: back node */
+		d = sp - 1;
+		if (!(d & 1)) {
+			/* check that buffer is remained enough */
+			if (d / 2 >= bsz) {
+				r = -EINVAL;
+				break;
+			}
+			buf[d / 2] = i << 4;
+		} else {
+			buf[d / 2] &= 0xf0;
+			buf[d / 2] |= i;
+		}
+		c = f->n->n[i];
+		/* value should exists at byte-based-node */
+		yassert(!c->v || (d & 1));
+		if (c->v && !(*cb)(tag, buf, d / 2 + 1, c->v)) {
+			r = 0;
+			break;
+		}
+		if (unlikely(sp > NODE_MAX_DEPTH)) {
+			r = -EINVAL;
+			break;
+		}
+		if (unlikely(!(p = wstack_reserve(st, &cap, sp, sizeof(*st))))) {
+			r = -ENOMEM;
+			break;
+		}
+		st = p;
+		st[sp].n = c;
+		st[sp].i = 0;
+		sp++;
+	}
+	yfree(st);
+	return r;
+}
+
+/******************************************************************************
+ *
+ * Adaptive radix tree(ART) engine
+ *
+ *****************************************************************************/
+/*
+ * Inner node has one of 4 kinds of child array(4, 16, 48 and 256 children)
+ *   and grows/shrinks adaptively as number of children changes.
+ * Key bytes shared by all keys in the subtree are kept at the node
+ *   (path compression). And key is stored at leaf completely
+ *   (lazy expansion). So, a single path is always one node or one leaf.
+ * Value of key that is prefix of other keys is stored at inner node.
+ * Child pointer whose lowest bit is set, is leaf.
+ *
+ * Invariant: inner node has at least two entries(children and value).
+ *
+ *        +------+-------+
+ *        | "ab" | v(ab) |       <- node4. compressed path "ab"
+ *        +--+---+---+---+
+ *           |c      |x
+ *    +------v-+   +-v------+
+ *    | "abcd" |   | "abxyz"|    <- leaves having full key.
+ *    +--------+   +--------+
+ */
+enum {
+	AN4 = 0,
+	AN16,
+	AN48,
+	AN256,
+};
+
+struct anode {
+	u8 type; /* AN4, AN16, AN48 or AN256 */
+	u16 n; /* number of children */
+	u16 plen; /* length of compressed path */
+	u32 score; /* max score of values in subtree. Used at scored trie */
+	void *v; /* value of key ending at this node */
+	/* bytes of compressed path are located right after child array */
+};
+
+/* keys are sorted */
+struct anode4 {
+	struct anode h;
+	u8 key[4];
+	void *c[4];
+};
+
+/* keys are sorted */
+struct anode16 {
+	struct anode h;
+	u8 key[16];
+	void *c[16];
+};
+
+struct anode48 {
+	struct anode h;
+	u8 idx[256]; /* 0 means empty. Otherwise, (index of 'c') + 1 */
+	void *c[48];
+};
+
+struct anode256 {
+	struct anode h;
+	void *c[256];
+};
+
+struct aleaf {
+	void *v;
+	u32 ksz;
+	u8 key[0];
+};
+
+/*
+ * Depth of inner node is less than length of key. So, depth of tree is
+ *   always less than YTRIE_MAX_KEY_LEN.
+ */
+#define ART_MAX_DEPTH YTRIE_MAX_KEY_LEN
+
+/* Frame used for non-recursive traversal */
+struct aframe {
+	struct anode *n;
+	u32 pos; /* position of next child to visit */
+	u32 depth; /* key depth right after compressed path of 'n' */
+};
+
+static const u32 _ansz[] = {
+	sizeof(struct anode4),
+	sizeof(struct anode16),
+	sizeof(struct anode48),
+	sizeof(struct anode256),
+};
+
+/* Capacity of each node type */
+static const u16 _ancap[] = { 4, 16, 48, 256 };
+
+/*
+ * Node shrinks to smaller one if number of children is less than or
+ *   equal to this value. There is gap from capacity of smaller node
+ *   to avoid repeated grow/shrink at the border.
+ */
+static const u16 _anshrink[] = { 0, 3, 12, 37 };
+
+/* Retired memories are reclaimed when this many memories are collected */
+#define RECLAIM_BATCH 64
+
+static void
+free_retired(struct ytrie *t, const struct retired *r);
+
+static INLINE bool
+is_aleaf(const void *p) {
+	return !!((uintptr_t)p & 1);
+}
+
+static INLINE struct aleaf *
+to_aleaf(const void *p) {
+	return (struct aleaf *)((uintptr_t)p & ~(uintptr_t)1);
+}
+
+static INLINE void *
+mk_aleaf(const struct aleaf *l) {
+	return (void *)((uintptr_t)l | 1);
+}
+
+static INLINE u8 *
+anode_pfx(const struct anode *n) {
+	return (u8 *)n + _ansz[n->type];
+}
+
+static struct aleaf *
+aleaf_new(const u8 *key, u32 sz, void *v) {
+	struct aleaf *l = ymalloc(sizeof(*l) + sz);
+	if (unlikely(!l))
+		return NULL;
+	yassert(!((uintptr_t)l & 1));
+	l->v = v;
+	l->ksz = sz;
+	memcpy(l->key, key, sz);
+	return l;
+}
+
+static INLINE void
+aleaf_free(struct aleaf *l, void (*vfree)(void *)) {
+	if (vfree)
+		(*vfree)(l->v);
+	yfree(l);
+}
+
+static struct anode *
+anode_new(int type, const u8 *pfx, u32 plen) {
+	struct anode *n = ycalloc(1, _ansz[type] + plen);
 	if (unlikely(!n))
-		/*
-		 * if allocing such a small size of memory fails,
-		 *  we can't do anything!
-		 * Just ASSERT IT!
-		 */
 		return NULL;
+	n->type = type;
+	n->plen = plen;
+	memcpy(anode_pfx(n), pfx, plen);
 	return n;
 }
 
 static INLINE void
-free_node(struct node *n, void(*vfree)(void *), int recursive) {
-	if (recursive) {
-		register int i;
-		for (i = 0; i < 16; i++)
-			if (n->n[i])
-				free_node(n->n[i], vfree, TRUE);
-	}
+anode_free(struct anode *n, void (*vfree)(void *)) {
 	if (n->v && vfree)
 		(*vfree)(n->v);
 	yfree(n);
 }
 
-static INLINE int
-remove_empty_leaf(struct node *n) {
-	register int i;
+/* @return bit mask of keys that are same with @b */
+static INLINE u32
+an16_match(const u8 *key, u8 b) {
+#ifdef __SSE2__
+	return (u32)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)key),
+			       _mm_set1_epi8((char)b)));
+#else /* __SSE2__ */
+	int i;
+	u32 bits = 0;
+	for (i = 0; i < 16; i++)
+		if (key[i] == b)
+			bits |= 1 << i;
+	return bits;
+#endif /* __SSE2__ */
+}
+
+/* @return NULL if there is no child for @b */
+static INLINE void **
+anode_child_ref(struct anode *n, u8 b) {
+	switch (n->type) {
+	case AN4: {
+		struct anode4 *n4 = (struct anode4 *)n;
+		u32 i;
+		for (i = 0; i < n->n; i++)
+			if (n4->key[i] == b)
+				return &n4->c[i];
+		return NULL;
+	}
+	case AN16: {
+		struct anode16 *n16 = (struct anode16 *)n;
+		u32 bits = an16_match(n16->key, b) & ((1U << n->n) - 1);
+		return bits ? &n16->c[__builtin_ctz(bits)] : NULL;
+	}
+	case AN48: {
+		struct anode48 *n48 = (struct anode48 *)n;
+		return n48->idx[b] ? &n48->c[n48->idx[b] - 1] : NULL;
+	}
+	default: {
+		struct anode256 *n256 = (struct anode256 *)n;
+		return n256->c[b] ? &n256->c[b] : NULL;
+	}
+	}
+}
+
+/*
+ * Get child at position @pos or after it, in order of key byte.
+ * @pos is updated to position of next child.
+ *
+ * @param[out] b Key byte of the child.
+ * @return NULL if there is no more child.
+ */
+static INLINE void **
+anode_next_ref(struct anode *n, u32 *pos, u8 *b) {
+	u32 i = *pos;
+	switch (n->type) {
+	case AN4:
+	case AN16: {
+		u8 *key = AN4 == n->type
+			? ((struct anode4 *)n)->key
+			: ((struct anode16 *)n)->key;
+		void **c = AN4 == n->type
+			? ((struct anode4 *)n)->c
+			: ((struct anode16 *)n)->c;
+		if (i >= n->n)
+			return NULL;
+		*pos = i + 1;
+		*b = key[i];
+		return &c[i];
+	}
+	case AN48: {
+		struct anode48 *n48 = (struct anode48 *)n;
+		for (; i < 256; i++) {
+			if (n48->idx[i]) {
+				*pos = i + 1;
+				*b = (u8)i;
+				return &n48->c[n48->idx[i] - 1];
+			}
+		}
+		return NULL;
+	}
+	default: {
+		struct anode256 *n256 = (struct anode256 *)n;
+		for (; i < 256; i++) {
+			if (n256->c[i]) {
+				*pos = i + 1;
+				*b = (u8)i;
+				return &n256->c[i];
+			}
+		}
+		return NULL;
+	}
+	}
+}
+
+/*
+ * Append child to node having enough room. Child should be appended in
+ *   order of key byte.
+ */
+static INLINE void
+anode_append(struct anode *n, u8 b, void *c) {
+	yassert(n->n < _ancap[n->type]);
+	switch (n->type) {
+	case AN4:
+		((struct anode4 *)n)->key[n->n] = b;
+		((struct anode4 *)n)->c[n->n] = c;
+		break;
+	case AN16:
+		((struct anode16 *)n)->key[n->n] = b;
+		((struct anode16 *)n)->c[n->n] = c;
+		break;
+	case AN48:
+		((struct anode48 *)n)->idx[b] = n->n + 1;
+		((struct anode48 *)n)->c[n->n] = c;
+		break;
+	default:
+		((struct anode256 *)n)->c[b] = c;
+	}
+	n->n++;
+}
+
+/*
+ * Move contents of node to new node of type @type. @n is freed.
+ * @return NULL if fails. In this case, @n is not changed.
+ */
+static struct anode *
+anode_resize(struct anode *n, int type) {
+	void **pc;
+	u32 pos = 0;
+	u8 b;
+	struct anode *nn = anode_new(type, anode_pfx(n), n->plen);
+	if (unlikely(!nn))
+		return NULL;
+	yassert(n->n <= _ancap[type]);
+	nn->v = n->v;
+	nn->score = n->score;
+	while ((pc = anode_next_ref(n, &pos, &b)))
+		anode_append(nn, b, *pc);
+	yfree(n);
+	return nn;
+}
+
+/*
+ * Node at @ref may be replaced with larger one.
+ * @return 0 if success. Otherwise -ENOMEM.
+ */
+static int
+anode_add_child(void **ref, u8 b, void *c) {
+	struct anode *n = *ref;
+	yassert(!anode_child_ref(n, b));
+	if (n->n >= _ancap[n->type]) {
+		if (unlikely(!(n = anode_resize(n, n->type + 1))))
+			return -ENOMEM;
+		*ref = n;
+	}
+	if (AN4 == n->type || AN16 == n->type) {
+		u32 i;
+		u8 *key = AN4 == n->type
+			? ((struct anode4 *)n)->key
+			: ((struct anode16 *)n)->key;
+		void **ch = AN4 == n->type
+			? ((struct anode4 *)n)->c
+			: ((struct anode16 *)n)->c;
+		for (i = 0; i < n->n && key[i] < b; i++);
+		memmove(key + i + 1, key + i, n->n - i);
+		memmove(ch + i + 1, ch + i, (n->n - i) * sizeof(*ch));
+		key[i] = b;
+		ch[i] = c;
+		n->n++;
+	} else
+		anode_append(n, b, c);
+	return 0;
+}
+
+static void
+anode_remove_child(struct anode *n, u8 b) {
+	switch (n->type) {
+	case AN4:
+	case AN16: {
+		u32 i;
+		u8 *key = AN4 == n->type
+			? ((struct anode4 *)n)->key
+			: ((struct anode16 *)n)->key;
+		void **ch = AN4 == n->type
+			? ((struct anode4 *)n)->c
+			: ((struct anode16 *)n)->c;
+		for (i = 0; key[i] != b; i++)
+			yassert(i < n->n);
+		n->n--;
+		memmove(key + i, key + i + 1, n->n - i);
+		memmove(ch + i, ch + i + 1, (n->n - i) * sizeof(*ch));
+		break;
+	}
+	case AN48: {
+		struct anode48 *n48 = (struct anode48 *)n;
+		u32 i;
+		u32 slot = n48->idx[b] - 1;
+		n48->idx[b] = 0;
+		n->n--;
+		if (slot != n->n) {
+			/* move last slot to the hole to keep slots dense */
+			n48->c[slot] = n48->c[n->n];
+			for (i = 0; n48->idx[i] != n->n + 1; i++);
+			n48->idx[i] = slot + 1;
+		}
+		break;
+	}
+	default:
+		((struct anode256 *)n)->c[b] = NULL;
+		n->n--;
+	}
+}
+
+/*
+ * Free memory after grace period. Retired list is protected by writer lock.
+ * If list cannot grow, wait grace period here. But, memory is leaked if
+ *   this is in read-side section(very rare case).
+ */
+static void
+retire(struct ytrie *t, void *p, int type) {
+	if (unlikely(t->rlsz >= t->rlcap)) {
+		u32 cap = t->rlcap ? t->rlcap * 2 : RECLAIM_BATCH;
+		struct retired *rl = t->rl
+			? yrealloc(t->rl, sizeof(*rl) * cap)
+			: ymalloc(sizeof(*rl) * cap);
+		if (unlikely(!rl)) {
+			struct retired r = { .p = p, .type = type };
+			if (!ebr_in_read()) {
+				ebr_synchronize();
+				free_retired(t, &r);
+			}
+			return;
+		}
+		t->rl = rl;
+		t->rlcap = cap;
+	}
+	t->rl[t->rlsz].p = p;
+	t->rl[t->rlsz].type = type;
+	t->rlsz++;
+}
+
+/* Free value replaced or removed from ART */
+static INLINE void
+art_vfree(struct ytrie *t, void *v) {
+	if (!t->vfree)
+		return;
+	if (is_conc(t))
+		retire(t, v, R_VALUE);
+	else
+		(*t->vfree)(v);
+}
+
+/*
+ * Restore invariant of node at @ref after removing one of its entries.
+ * Node may be replaced with leaf, its child or smaller node.
+ * If memory allocation fails, node is kept as it is. It is still valid
+ *   tree, even if it's not compact.
+ * At concurrent mode, only the child of the node may be shared with
+ *   readers. So, it is copied instead of being modified.
+ *
+ * @param key Key bytes of path to the node.
+ * @param depth Key depth right after compressed path of node.
+ */
+static void
+anode_normalize(struct ytrie *t, void **ref, const u8 *key, u32 depth) {
+	struct anode *n = *ref;
+	if (!n->n) {
+		/* only value is left. Node becomes leaf */
+		struct aleaf *l;
+		yassert(n->v);
+		if (likely(l = aleaf_new(key, depth, n->v))) {
+			*ref = mk_aleaf(l);
+			yfree(n);
+		}
+	} else if (1 == n->n && !n->v) {
+		/* merge with the only child */
+		u32 pos = 0;
+		u8 b;
+		void *c = *anode_next_ref(n, &pos, &b);
+		struct anode *cn;
+		u32 plen;
+		if (is_aleaf(c)) {
+			*ref = c;
+			yfree(n);
+			return;
+		}
+		cn = c;
+		plen = n->plen + 1 + cn->plen;
+		if (is_conc(t)) {
+			struct anode *nn = ymalloc(_ansz[cn->type] + plen);
+			if (unlikely(!nn))
+				return;
+			memcpy(nn, cn, _ansz[cn->type]);
+			memcpy(anode_pfx(nn) + n->plen + 1,
+			       anode_pfx(cn),
+			       cn->plen);
+			retire(t, cn, R_MEM);
+			cn = nn;
+		} else {
+			if (unlikely(!(cn = yrealloc(cn,
+						     _ansz[cn->type] + plen))))
+				return;
+			memmove(anode_pfx(cn) + n->plen + 1,
+				anode_pfx(cn),
+				cn->plen);
+		}
+		memcpy(anode_pfx(cn), anode_pfx(n), n->plen);
+		anode_pfx(cn)[n->plen] = b;
+		cn->plen = plen;
+		*ref = cn;
+		yfree(n);
+	} else if (n->n <= _anshrink[n->type]) {
+		struct anode *nn = anode_resize(n, n->type - 1);
+		if (likely(nn))
+			*ref = nn;
+	}
+}
+
+/* Max score of subtree @p p */
+static INLINE u32
+art_score(const struct ytrie *t, const void *p) {
+	return is_aleaf(p)
+		? (*t->vscore)(to_aleaf(p)->v)
+		: ((const struct anode *)p)->score;
+}
+
+static u32
+anode_score(const struct ytrie *t, struct anode *n) {
+	void **pc;
+	u32 pos = 0, s, cs;
+	u8 b;
+	s = n->v ? (*t->vscore)(n->v) : 0;
+	while ((pc = anode_next_ref(n, &pos, &b)))
+		if ((cs = art_score(t, *pc)) > s)
+			s = cs;
+	return s;
+}
+
+/*
+ * Update max scores of nodes on the path of @p key, after @p key is
+ *   inserted to or removed from tree @p root.
+ * Only nodes on the path may be changed by insert and remove. At
+ *   concurrent mode, they are not published yet.
+ */
+static void
+art_rescore(struct ytrie *t, void *root, const u8 *key, u32 sz) {
+	struct anode *path[ART_MAX_DEPTH + 1];
+	void *p = root, **pc;
+	u32 np = 0, depth = 0, s;
+	while (p && !is_aleaf(p)) {
+		struct anode *n = p;
+		/* Subtree not having key isn't changed. */
+		if (sz - depth < n->plen
+		    || memcmp(anode_pfx(n), key + depth, n->plen))
+			break;
+		yassert(np <= ART_MAX_DEPTH);
+		path[np++] = n;
+		depth += n->plen;
+		if (depth == sz || !(pc = anode_child_ref(n, key[depth])))
+			break;
+		p = *pc;
+		depth++;
+	}
+	/* Nodes above unchanged node are not changed. */
+	while (np--) {
+		s = anode_score(t, path[np]);
+		if (s == path[np]->score)
+			break;
+		path[np]->score = s;
+	}
+}
+
+/*
+ * Root is loaded with acquire. At concurrent mode, nodes reachable from
+ *   it are never changed. So, there is no more barrier in traversal.
+ */
+static INLINE void *
+art_root(const struct ytrie *t) {
+	return __atomic_load_n(&t->art, __ATOMIC_ACQUIRE);
+}
+
+static void **
+art_getref(struct ytrie *t, const u8 *key, u32 sz) {
+	void *p = art_root(t);
+	void **pp;
+	u32 depth = 0;
+	while (p) {
+		struct anode *n;
+		if (is_aleaf(p)) {
+			struct aleaf *l = to_aleaf(p);
+			return (l->ksz == sz
+				&& !memcmp(l->key + depth,
+					   key + depth,
+					   sz - depth))
+				? &l->v : NULL;
+		}
+		n = p;
+		if (n->plen) {
+			if (sz - depth < n->plen
+			    || memcmp(anode_pfx(n), key + depth, n->plen))
+				return NULL;
+			depth += n->plen;
+		}
+		if (depth == sz)
+			return n->v ? &n->v : NULL;
+		if (!(pp = anode_child_ref(n, key[depth])))
+			return NULL;
+		p = *pp;
+		depth++;
+	}
+	return NULL;
+}
+
+/*
+ * @param root Root of tree to insert to.
+ * @return 1: value is overwritten. 0: newly added. <0: @c -errno.
+ */
+static int
+art_insert(struct ytrie *t, void **root, const u8 *key, u32 sz, void *v) {
+	void **ref = root;
+	u32 depth = 0;
+	while (TRUE) {
+		struct anode *n, *nn;
+		struct aleaf *nl = NULL;
+		u32 i, lim;
+		if (!*ref) {
+			if (unlikely(!(nl = aleaf_new(key, sz, v))))
+				return -ENOMEM;
+			*ref = mk_aleaf(nl);
+			return 0;
+		}
+		if (is_aleaf(*ref)) {
+			struct aleaf *l = to_aleaf(*ref);
+			if (l->ksz == sz
+			    && !memcmp(l->key + depth,
+				       key + depth,
+				       sz - depth)) {
+				art_vfree(t, l->v);
+				l->v = v;
+				return 1;
+			}
+			/* split leaf. New node has common prefix */
+			lim = l->ksz < sz ? l->ksz : sz;
+			for (i = depth; i < lim && l->key[i] == key[i]; i++);
+			if (unlikely(!(nn = anode_new(AN4,
+						      key + depth,
+						      i - depth))))
+				return -ENOMEM;
+			if (i < sz
+			    && unlikely(!(nl = aleaf_new(key, sz, v)))) {
+				yfree(nn);
+				return -ENOMEM;
+			}
+			/* node4 has enough room for two entries. */
+			if (i == l->ksz) {
+				nn->v = l->v;
+				yfree(l);
+			} else
+				anode_append(nn, l->key[i], *ref);
+			if (i == sz)
+				nn->v = v;
+			else
+				anode_add_child((void **)&nn,
+						key[i],
+						mk_aleaf(nl));
+			*ref = nn;
+			return 0;
+		}
+		n = *ref;
+		if (n->plen) {
+			u8 *pfx = anode_pfx(n);
+			lim = sz - depth < n->plen ? sz - depth : n->plen;
+			for (i = 0; i < lim && pfx[i] == key[depth + i]; i++);
+			if (i < n->plen) {
+				/* split compressed path at 'i' */
+				if (unlikely(!(nn = anode_new(AN4, pfx, i))))
+					return -ENOMEM;
+				if (depth + i < sz
+				    && unlikely(!(nl = aleaf_new(key, sz, v)))) {
+					yfree(nn);
+					return -ENOMEM;
+				}
+				anode_append(nn, pfx[i], n);
+				memmove(pfx, pfx + i + 1, n->plen - i - 1);
+				n->plen -= i + 1;
+				depth += i;
+				if (depth == sz)
+					nn->v = v;
+				else
+					anode_add_child((void **)&nn,
+							key[depth],
+							mk_aleaf(nl));
+				*ref = nn;
+				return 0;
+			}
+			depth += n->plen;
+		}
+		if (depth == sz) {
+			if (n->v) {
+				art_vfree(t, n->v);
+				n->v = v;
+				return 1;
+			}
+			n->v = v;
+			return 0;
+		}
+		{ /* Just scope */
+			void **pc = anode_child_ref(n, key[depth]);
+			if (!pc) {
+				if (unlikely(!(nl = aleaf_new(key, sz, v))))
+					return -ENOMEM;
+				if (unlikely(anode_add_child(
+					ref, key[depth], mk_aleaf(nl)))) {
+					yfree(nl);
+					return -ENOMEM;
+				}
+				return 0;
+			}
+			ref = pc;
+			depth++;
+		}
+	}
+}
+
+/*
+ * @param root Root of tree to remove from.
+ * @return 1 if value is removed. 0 if @p key is not in the trie.
+ */
+static int
+art_remove(struct ytrie *t, void **root, const u8 *key, u32 sz) {
+	void **ref = root;
+	void **pref = NULL; /* parent of 'ref' */
+	u32 pdepth = 0; /* depth of parent after its compressed path */
+	u32 depth = 0;
 	/*
-	 * Check followings
-	 *    This node doens't have 'value'
-	 *    This node is leaf.
+	 * Thanks to invariant, removing an entry changes only the node that
+	 *   has the entry. So, parent of leaf is enough to be kept.
 	 */
-	for (i = 0; i < 16; i++)
-		if (n->n[i])
+	while (*ref) {
+		struct anode *n;
+		if (is_aleaf(*ref)) {
+			struct aleaf *l = to_aleaf(*ref);
+			if (l->ksz != sz
+			    || memcmp(l->key + depth, key + depth, sz - depth))
+				return 0;
+			art_vfree(t, l->v);
+			yfree(l);
+			if (!pref) {
+				*ref = NULL;
+				return 1;
+			}
+			anode_remove_child(*pref, key[pdepth]);
+			anode_normalize(t, pref, key, pdepth);
+			return 1;
+		}
+		n = *ref;
+		if (n->plen) {
+			if (sz - depth < n->plen
+			    || memcmp(anode_pfx(n), key + depth, n->plen))
+				return 0;
+			depth += n->plen;
+		}
+		if (depth == sz) {
+			if (!n->v)
+				return 0;
+			art_vfree(t, n->v);
+			n->v = NULL;
+			anode_normalize(t, ref, key, depth);
+			return 1;
+		}
+		pref = ref;
+		pdepth = depth;
+		if (!(ref = anode_child_ref(n, key[depth])))
+			return 0;
+		depth++;
+	}
+	return 0;
+}
+
+/*
+ * Find subtree in which all keys start with @key.
+ *
+ * @param[out] pdepth Key depth at the returned subtree(before compressed
+ *   path if subtree is inner node).
+ * @return NULL if there is no key starting with @key.
+ */
+static void *
+art_find_prefix(const struct ytrie *t, const u8 *key, u32 sz, u32 *pdepth) {
+	void *p = art_root(t);
+	void **pc;
+	u32 depth = 0;
+	while (p) {
+		struct anode *n;
+		u32 m;
+		if (is_aleaf(p)) {
+			struct aleaf *l = to_aleaf(p);
+			if (l->ksz < sz
+			    || memcmp(l->key + depth, key + depth, sz - depth))
+				return NULL;
 			break;
-	if (i >= 16 /* Is this leaf? */
-	    && !n->v) { /* Doesn't this have 'value'? */
-		/* there is no 'value'. So, free callback is not required */
-		free_node(n, NULL, FALSE);
-		return 1; /* true */
-	} else
-		return 0;/* false */
+		}
+		n = p;
+		m = sz - depth < n->plen ? sz - depth : n->plen;
+		if (memcmp(anode_pfx(n), key + depth, m))
+			return NULL;
+		if (depth + n->plen >= sz)
+			break;
+		depth += n->plen;
+		if (!(pc = anode_child_ref(n, key[depth])))
+			return NULL;
+		p = *pc;
+		depth++;
+	}
+	*pdepth = depth;
+	return p;
+}
+
+static INLINE int
+aframe_push(struct aframe *st, u32 *sp, struct anode *n, u8 *kb, u32 depth) {
+	yassert(*sp <= ART_MAX_DEPTH);
+	memcpy(kb + depth, anode_pfx(n), n->plen);
+	st[*sp].n = n;
+	st[*sp].pos = 0;
+	st[*sp].depth = depth + n->plen;
+	(*sp)++;
+	return depth + n->plen;
+}
+
+/*
+ * Visit values in subtree @p in order of key, without recursion.
+ * @cb is called with full key.
+ *
+ * @param depth Key depth at @p
+ * @param kb Buffer having @depth bytes of key of path to @p.
+ *   Size of buffer should be YTRIE_MAX_KEY_LEN.
+ * @return 0 if @cb stops iteration. Otherwise 1.
+ */
+static int
+art_walk(void *p,
+	 u32 depth,
+	 u8 *kb,
+	 void *tag,
+	 int (*cb)(void *, const u8 *, u32, void *)
+) {
+	struct aframe st[ART_MAX_DEPTH + 1];
+	u32 sp = 0;
+	if (!p)
+		return 1;
+	if (is_aleaf(p)) {
+		struct aleaf *l = to_aleaf(p);
+		return (*cb)(tag, l->key, l->ksz, l->v) ? 1 : 0;
+	}
+	depth = aframe_push(st, &sp, p, kb, depth);
+	if (((struct anode *)p)->v
+	    && !(*cb)(tag, kb, depth, ((struct anode *)p)->v))
+		return 0;
+	while (sp) {
+		struct aframe *f = &st[sp - 1];
+		struct anode *n;
+		u8 b;
+		void **pc = anode_next_ref(f->n, &f->pos, &b);
+		if (!pc) {
+			sp--;
+			continue;
+		}
+		if (is_aleaf(*pc)) {
+			struct aleaf *l = to_aleaf(*pc);
+			if (!(*cb)(tag, l->key, l->ksz, l->v))
+				return 0;
+			continue;
+		}
+		n = *pc;
+		kb[f->depth] = b;
+		depth = aframe_push(st, &sp, n, kb, f->depth + 1);
+		if (n->v && !(*cb)(tag, kb, depth, n->v))
+			return 0;
+	}
+	return 1;
+}
+
+/* Free all nodes and leaves in subtree @p, without recursion. */
+static void
+art_free(void *p, void (*vfree)(void *)) {
+	struct aframe st[ART_MAX_DEPTH + 1];
+	u32 sp = 0;
+	if (!p)
+		return;
+	if (is_aleaf(p)) {
+		aleaf_free(to_aleaf(p), vfree);
+		return;
+	}
+	st[sp].n = p;
+	st[sp++].pos = 0;
+	while (sp) {
+		struct aframe *f = &st[sp - 1];
+		u8 b;
+		void **pc = anode_next_ref(f->n, &f->pos, &b);
+		if (!pc) {
+			anode_free(f->n, vfree);
+			sp--;
+		} else if (is_aleaf(*pc))
+			aleaf_free(to_aleaf(*pc), vfree);
+		else {
+			yassert(sp <= ART_MAX_DEPTH);
+			st[sp].n = *pc;
+			st[sp++].pos = 0;
+		}
+	}
+}
+
+struct art_iterate_arg {
+	void *tag;
+	int (*cb)(void *, const u8 *, u32, void *);
+	u32 off; /* length of prefix key */
+};
+
+static int
+art_iterate_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct art_iterate_arg *arg = tag;
+	return (*arg->cb)(arg->tag, key + arg->off, sz - arg->off, v);
+}
+
+static int
+art_iterate(
+	struct ytrie *t,
+	void *tag,
+	const u8 *key,
+	u32 keysz,
+	int(cb)(void *, const u8 *, u32, void *)
+) {
+	u8 kb[YTRIE_MAX_KEY_LEN];
+	u32 depth;
+	struct art_iterate_arg arg;
+	void *p;
+	if (!keysz && !art_root(t))
+		return 1; /* empty trie */
+	if (!(p = art_find_prefix(t, key, keysz, &depth)))
+		return -EINVAL;
+	memcpy(kb, key, depth);
+	arg.tag = tag;
+	arg.cb = cb;
+	arg.off = keysz;
+	return art_walk(p, depth, kb, &arg, &art_iterate_cb);
+}
+
+static int
+art_auto_complete(
+	struct ytrie *t,
+	const u8 *keyprefix,
+	u32 keyprefixsz,
+	u8 *buf,
+	u32 bufsz
+) {
+	struct anode *n;
+	u32 depth, bi, len;
+	const u8 *s;
+	void *p = art_find_prefix(t, keyprefix, keyprefixsz, &depth);
+
+#define append(bytes, sz)					\
+	do {							\
+		if (unlikely(bi + (sz) >= bufsz))		\
+			return -EINVAL;				\
+		memcpy(buf + bi, (bytes), (sz));		\
+		bi += (sz);					\
+	} while (0)
+
+	if (unlikely(!p))
+		return YTRIEFail;
+	if (unlikely(!bufsz))
+		return -EINVAL;
+	bi = 0;
+	/* bytes of compressed path after prefix */
+	depth = keyprefixsz - depth;
+	while (!is_aleaf(p)) {
+		n = p;
+		len = n->plen - depth;
+		append(anode_pfx(n) + depth, len);
+		if (n->n > 1 || (n->n && n->v)) {
+			buf[bi] = 0;
+			return YTRIEBranch;
+		} else if (!n->n) {
+			buf[bi] = 0;
+			return YTRIELeaf;
+		} else {
+			/* Single path. Only if memory allocation failed */
+			u32 pos = 0;
+			u8 b;
+			p = *anode_next_ref(n, &pos, &b);
+			append(&b, 1);
+			depth = 0;
+		}
+	}
+	s = to_aleaf(p)->key + keyprefixsz + bi;
+	len = to_aleaf(p)->ksz - keyprefixsz - bi;
+	append(s, len);
+	buf[bi] = 0;
+	return YTRIELeaf;
+
+#undef append
+}
+
+/******************************************************************************
+ *
+ * Range scan
+ *
+ *****************************************************************************/
+/*
+ * Keys in range are visited with explicit stack, in order of key.
+ * While path of visiting node is same with prefix of bound, the node is
+ *   'tight' to the bound. Only children of tight node are compared with
+ *   bound. And subtree out of range is never entered. Because keys are
+ *   visited in order, walking stops at the first key beyond upper bound.
+ */
+/* Flags of cursor */
+#define CUR_LOINCL 0x1 /* lower bound is inclusive */
+#define CUR_HI 0x2 /* upper bound is used */
+#define CUR_DONE 0x4 /* no more key */
+
+/* Tight flags */
+#define RT_LO 0x1
+#define RT_HI 0x2
+
+/* Result of checking bound */
+enum {
+	RB_IN,
+	RB_SKIP, /* subtree is out of range. Skip it. */
+	RB_STOP, /* this and all following keys are out of range */
+};
+
+struct range {
+	struct ytrie_cursor *cur;
+	u32 limit; /* 0 means no limit */
+	u32 cnt; /* number of visited keys */
+	bool stopped; /* by callback or limit */
+	int err; /* -errno if walking fails */
+	void *tag;
+	int (*cb)(void *, const u8 *, u32, void *);
+};
+
+/* Frame used for non-recursive range scan of both engines. */
+struct rframe {
+	void *n; /* struct node or struct anode */
+	u32 pos; /* position of next child to visit */
+	u32 depth; /* key depth of children of 'n' */
+	u32 tight;
+};
+
+static INLINE int
+key_cmp(const u8 *k0, u32 sz0, const u8 *k1, u32 sz1) {
+	int r = memcmp(k0, k1, sz0 < sz1 ? sz0 : sz1);
+	return r ? r : (int)sz0 - (int)sz1;
+}
+
+/*
+ * Check path bytes @p p from key depth @p depth.
+ * @param tight (in/out) Tight flags of path to @p depth, and it is
+ *   updated to flags of path after @p p.
+ */
+static int
+range_path(const struct ytrie_cursor *c,
+	   u32 depth,
+	   const u8 *p,
+	   u32 plen,
+	   u32 *tight
+) {
+	int r;
+	u32 m;
+	if (*tight & RT_LO) {
+		m = c->losz - depth < plen ? c->losz - depth : plen;
+		r = memcmp(p, c->lo + depth, m);
+		if (r < 0)
+			return RB_SKIP;
+		/* Lower bound is prefix of path: path is larger. */
+		if (r > 0 || m < plen)
+			*tight &= ~RT_LO;
+	}
+	if (*tight & RT_HI) {
+		m = c->hisz - depth < plen ? c->hisz - depth : plen;
+		r = memcmp(p, c->hi + depth, m);
+		if (r > 0 || (!r && m < plen))
+			return RB_STOP;
+		if (r < 0)
+			*tight &= ~RT_HI;
+	}
+	return RB_IN;
+}
+
+/* Check key of @p sz bytes, that is path having @p tight flags. */
+static INLINE int
+range_value(const struct ytrie_cursor *c, u32 sz, u32 tight) {
+	/* Key is same with or prefix of bound. */
+	if ((tight & RT_LO)
+	    && (sz < c->losz || !(c->flags & CUR_LOINCL)))
+		return RB_SKIP;
+	if ((tight & RT_HI) && sz == c->hisz)
+		return RB_STOP;
+	return RB_IN;
+}
+
+/* Check full key at leaf of ART. */
+static INLINE int
+range_key(const struct ytrie_cursor *c, const u8 *key, u32 sz, u32 tight) {
+	int r;
+	if (tight & RT_LO) {
+		r = key_cmp(key, sz, c->lo, c->losz);
+		if (r < 0 || (!r && !(c->flags & CUR_LOINCL)))
+			return RB_SKIP;
+	}
+	if ((tight & RT_HI) && 0 <= key_cmp(key, sz, c->hi, c->hisz))
+		return RB_STOP;
+	return RB_IN;
+}
+
+/* @return RB_STOP if visiting should be stopped. */
+static int
+range_emit(struct range *r, const u8 *key, u32 sz, void *v) {
+	r->cnt++;
+	if (!(*r->cb)(r->tag, key, sz, v) || r->cnt == r->limit) {
+		/* Resumed after this key. */
+		r->stopped = TRUE;
+		memcpy(r->cur->lo, key, sz);
+		r->cur->losz = sz;
+		r->cur->flags &= ~CUR_LOINCL;
+		return RB_STOP;
+	}
+	return RB_IN;
 }
 
-static INLINE int
-remove_empty_byte_leaf(struct node *n, u8 c) {
-	register int fi = c >> 4;
-	register int bi = c & 0x0f;
-	if (remove_empty_leaf(n->n[fi]->n[bi])) {
-		/*
-		 * node itself is removed!
-		 * So, front node should also be checked!
-		 */
-		n->n[fi]->n[bi] = NULL;
-		if (remove_empty_leaf(n->n[fi])) {
-			n->n[fi] = NULL;
-			/* this node itself should be checked! */
-			return 1;
-		} else
-			return 0; /* all done */
-	} else
-		return 0; /* all done */
+/* First position to visit of tight node. */
+static INLINE u32
+range_first_byte(const struct ytrie_cursor *c, u32 depth, u32 tight) {
+	return (tight & RT_LO) && depth < c->losz ? c->lo[depth] : 0;
+}
+
+/*
+ * Get child(back node) by key byte at or after @p pos, in order of key
+ *   byte. @p pos is updated to position of next child.
+ */
+static INLINE struct node *
+node_next(struct node *n, u32 *pos, u8 *b) {
+	u32 i = *pos;
+	while (i < 256) {
+		struct node *f = n->n[i >> 4];
+		if (!f) {
+			i = (i | 0x0f) + 1;
+			continue;
+		}
+		if (f->n[i & 0x0f]) {
+			*pos = i + 1;
+			*b = (u8)i;
+			return f->n[i & 0x0f];
+		}
+		i++;
+	}
+	return NULL;
 }
 
 /*
- * @return:
- *     1 : needed to be checked that the node @t is empty leaf or not!
- *     0 : all done successfully
- *     -1: cannot find node(symbol is not in trie)
+ * @return RB_STOP if visiting is stopped before the end of range. At
+ *   failure, 'err' of @p r is set and RB_STOP is returned.
  */
 static int
-remove_key(struct node *n, const u8 *p,
-	   u32 sz, void(*vfree)(void *)) {
-	register int fi = *p >> 4;
-	register int bi = *p & 0x0f;
-	if (sz > 0) {
-		/* check that there is front & back node */
-		if (n->n[fi] && n->n[fi]->n[bi]) {
-			switch(remove_key(n->n[fi]->n[bi],
-					  p + 1,
-					  sz - 1,
-					  vfree)) {
-			case 1:
-				return remove_empty_byte_leaf(n, *p);
-			case 0:
-				return 0;
-			}
+node_range(struct ytrie *t, struct range *r) {
+	struct rframe *st = NULL;
+	u8 kb[YTRIE_MAX_KEY_LEN];
+	const struct ytrie_cursor *c = r->cur;
+	u32 sp = 0, cap = 0, tight;
+	int rb = RB_IN;
+	u8 b;
+	struct node *n;
+	void *p;
+
+	if (unlikely(!(st = wstack_reserve(st, &cap, sp, sizeof(*st))))) {
+		r->err = -ENOMEM;
+		return RB_STOP;
+	}
+	st[0].n = &t->rt;
+	st[0].depth = 0;
+	st[0].tight = RT_LO | (c->flags & CUR_HI ? RT_HI : 0);
+	st[0].pos = range_first_byte(c, 0, st[0].tight);
+	sp = 1;
+	while (sp) {
+		struct rframe *f = &st[sp - 1];
+		u32 depth = f->depth;
+		if (!(n = node_next(f->n, &f->pos, &b))) {
+			sp--;
+			continue;
 		}
-		/* Cannot find symbol! */
-		return -1;
-	} else {
-		/*
-		 * End of stream.
-		 * We need to check this node has valid data.
-		 * If yes, remove value!
-		 * If not, key is not valid one!
-		 */
+		tight = f->tight;
+		if (RB_IN != (rb = range_path(c, depth, &b, 1, &tight))) {
+			if (RB_STOP == rb)
+				goto out;
+			continue;
+		}
+		kb[depth] = b;
 		if (n->v) {
-			if (vfree)
-				(*vfree)(n->v);
-			n->v = NULL;
-			return 1;
-		} else
-			return -1;
+			rb = range_value(c, depth + 1, tight);
+			if (RB_STOP == rb
+			    || (RB_IN == rb
+				&& RB_STOP == (rb = range_emit(r, kb, depth + 1,
+							       n->v))))
+				goto out;
+		}
+		/* Key is shorter than YTRIE_MAX_KEY_LEN. */
+		yassert(sp <= YTRIE_MAX_KEY_LEN);
+		if (unlikely(!(p = wstack_reserve(st, &cap, sp, sizeof(*st))))) {
+			r->err = -ENOMEM;
+			rb = RB_STOP;
+			goto out;
+		}
+		st = p;
+		st[sp].n = n;
+		st[sp].depth = depth + 1;
+		st[sp].tight = tight;
+		st[sp].pos = range_first_byte(c, depth + 1, tight);
+		sp++;
 	}
+	rb = RB_IN;
+ out:
+	yfree(st);
+	return rb;
 }
 
 /*
- * @param c (char) character
- * @param n (struct node *) node to move down
- * @param fi (int) variable to store front index
- * @param bi (int) variable to store back index
- * @param felse (statement) code in 'else' brace of front node
- * @param belse (statement) code in 'else' brace of back node
+ * Check and push inner node of ART.
+ * @return RB_STOP if visiting should be stopped.
  */
-#define move_down_node(c, n, fi, bi, felse, belse)	\
-	do {						\
-		(fi) = (c) >> 4; (bi) = (c) & 0x0f;	\
-		if ((n)->n[fi])				\
-			(n) = (n)->n[fi];		\
-		else {					\
-			felse;				\
-		}					\
-		if ((n)->n[bi])				\
-			(n) = (n)->n[bi];		\
-		else {					\
-			belse;				\
-		}					\
-	} while (0)
+static int
+art_range_push(struct range *r,
+	       struct rframe **st,
+	       u32 *cap,
+	       u32 *sp,
+	       struct anode *n,
+	       u8 *kb,
+	       u32 depth,
+	       u32 tight
+) {
+	int rb;
+	struct rframe *f;
+	const struct ytrie_cursor *c = r->cur;
+	if (RB_IN != (rb = range_path(c, depth, anode_pfx(n), n->plen, &tight)))
+		return rb;
+	memcpy(kb + depth, anode_pfx(n), n->plen);
+	depth += n->plen;
+	if (n->v) {
+		rb = range_value(c, depth, tight);
+		if (RB_STOP == rb
+		    || (RB_IN == rb
+			&& RB_STOP == range_emit(r, kb, depth, n->v)))
+			return RB_STOP;
+	}
+	yassert(*sp <= ART_MAX_DEPTH);
+	if (unlikely(!(f = wstack_reserve(*st, cap, *sp, sizeof(**st))))) {
+		r->err = -ENOMEM;
+		return RB_STOP;
+	}
+	*st = f;
+	f += *sp;
+	f->n = n;
+	f->depth = depth;
+	f->tight = tight;
+	/* Position of node48 and node256 is key byte. */
+	f->pos = AN48 <= n->type ? range_first_byte(c, depth, tight) : 0;
+	(*sp)++;
+	return RB_IN;
+}
+
 /*
- * If node exists, it returns node. If not, it creates new one and returns it.
- * @return back node of last character of symbol.
- *	If fails to get, NULL is returned.
+ * @return RB_STOP if visiting is stopped before the end of range. At
+ *   failure, 'err' of @p r is set and RB_STOP is returned.
  */
-static struct node *
-get_node(struct ytrie *t, const u8 *key, u32 sz, int bcreate) {
-	register struct node *n = &t->rt;
-	register const u8 *p = key;
-	register const u8 *pend = p+sz;
-	register int fi, bi; /* front index */
+static int
+art_range(struct ytrie *t, struct range *r) {
+	struct rframe *st = NULL;
+	u8 kb[YTRIE_MAX_KEY_LEN];
+	const struct ytrie_cursor *c = r->cur;
+	u32 sp = 0, cap = 0, tight;
+	int rb;
+	u8 b;
+	void *p = art_root(t), **pc;
 
-	if (bcreate) {
-		while (p < pend) {
-			move_down_node(*p, n, fi, bi,
-				       n = n->n[fi] = alloc_node(); \
-				       if (unlikely(!n)) { return NULL; },
-				       n = n->n[bi] = alloc_node(); \
-				       if (unlikely(!n)) { return NULL; });
-			p++;
+	tight = RT_LO | (c->flags & CUR_HI ? RT_HI : 0);
+	if (!p)
+		return RB_IN;
+	if (is_aleaf(p)) {
+		struct aleaf *l = to_aleaf(p);
+		return RB_IN == range_key(c, l->key, l->ksz, tight)
+			? range_emit(r, l->key, l->ksz, l->v)
+			: RB_IN;
+	}
+	if (RB_STOP == (rb = art_range_push(r, &st, &cap, &sp, p, kb, 0,
+					    tight)))
+		goto out;
+	while (sp) {
+		struct rframe *f = &st[sp - 1];
+		u32 depth = f->depth;
+		if (!(pc = anode_next_ref(f->n, &f->pos, &b))) {
+			sp--;
+			continue;
 		}
-	} else {
-		while (p < pend) {
-			move_down_node(*p, n, fi, bi,
-				       return NULL, return NULL);
-			p++;
+		tight = f->tight;
+		if (RB_IN != (rb = range_path(c, depth, &b, 1, &tight))) {
+			if (RB_STOP == rb)
+				goto out;
+			continue;
+		}
+		if (is_aleaf(*pc)) {
+			struct aleaf *l = to_aleaf(*pc);
+			rb = range_key(c, l->key, l->ksz, tight);
+			if (RB_STOP == rb
+			    || (RB_IN == rb
+				&& RB_STOP == (rb = range_emit(r, l->key,
+							       l->ksz, l->v))))
+				goto out;
+			continue;
 		}
+		kb[depth] = b;
+		if (RB_STOP == (rb = art_range_push(r, &st, &cap, &sp, *pc, kb,
+						    depth + 1, tight)))
+			goto out;
 	}
-	return n;
+	rb = RB_IN;
+ out:
+	/* Stack is not allocated if root is not pushed. */
+	if (st)
+		yfree(st);
+	return rb;
 }
 
-static bool
-equal_internal(
-	const struct node *n0,
-	const struct node *n1,
-	int(*cmp)(const void *, const void *)
-) {
-	register int i;
-	if (n0->v && n1->v) {
-		if (0 == cmp(n0->v, n1->v))
-			return FALSE; /* NOT same */
-	} else if (n0->v || n1->v)
-		return FALSE; /* NOT same */
+/******************************************************************************
+ *
+ * Top-k scored completion
+ *
+ *****************************************************************************/
+/*
+ * Best-first search with max-heap. Entry of heap is subtree having max
+ *   score of it, or a value having its score. Subtree is expanded only if
+ *   it has the highest score among entries. So, subtree whose max score
+ *   is lower than k-th score is never entered.
+ */
+enum {
+	TK_TREE, /* whole subtree of node or leaf */
+	TK_VALUE, /* value of inner node */
+};
+
+struct tkent {
+	void *p; /* inner node or leaf */
+	u32 score;
+	u32 depth; /* key depth at 'p'(before compressed path) */
+	int type;
+};
+
+struct tkheap {
+	struct tkent *e;
+	u32 sz, cap;
+};
 
-	/* compare child nodes! */
-	for (i = 0; i < 16; i++) {
-		if (n0->n[i] && n1->n[i]) {
-			if (0 == equal_internal(n0->n[i], n1->n[i], cmp))
-				return FALSE; /* NOT same */
-		} else if (n0->n[i] || n1->n[i])
-			return FALSE; /* NOT same */
+static int
+tkheap_push(struct tkheap *h, void *p, u32 score, u32 depth, int type) {
+	u32 i, pi;
+	if (unlikely(h->sz >= h->cap)) {
+		u32 cap = h->cap ? h->cap * 2 : 64;
+		struct tkent *e = h->e
+			? yrealloc(h->e, sizeof(*e) * cap)
+			: ymalloc(sizeof(*e) * cap);
+		if (unlikely(!e))
+			return -ENOMEM;
+		h->e = e;
+		h->cap = cap;
+	}
+	for (i = h->sz++; i > 0; i = pi) {
+		pi = (i - 1) / 2;
+		if (h->e[pi].score >= score)
+			break;
+		h->e[i] = h->e[pi];
 	}
-	return TRUE; /* n0 and n1 is same */
+	h->e[i].p = p;
+	h->e[i].score = score;
+	h->e[i].depth = depth;
+	h->e[i].type = type;
+	return 0;
 }
 
-static struct node *
-node_clone(
-	const struct node *n,
+static void
+tkheap_pop(struct tkheap *h, struct tkent *out) {
+	u32 i, c;
+	struct tkent last;
+	yassert(h->sz);
+	*out = h->e[0];
+	last = h->e[--h->sz];
+	for (i = 0; (c = i * 2 + 1) < h->sz; i = c) {
+		if (c + 1 < h->sz && h->e[c + 1].score > h->e[c].score)
+			c++;
+		if (last.score >= h->e[c].score)
+			break;
+		h->e[i] = h->e[c];
+	}
+	h->e[i] = last;
+}
+
+/* Any leaf in subtree. Its key starts with path to @p p. */
+static struct aleaf *
+art_any_leaf(void *p) {
+	u32 pos;
+	u8 b;
+	while (!is_aleaf(p)) {
+		pos = 0;
+		/* Inner node has at least one child by invariant. */
+		p = *anode_next_ref(p, &pos, &b);
+	}
+	return to_aleaf(p);
+}
+
+static int
+art_top_k(
+	struct ytrie *t,
+	const u8 *keyprefix,
+	u32 keyprefixsz,
+	u32 k,
 	void *tag,
-	void *(*clonev)(void *, const void *)
+	int (*cb)(void *, const u8 *, u32, void *, u32)
 ) {
-	register int i;
-	struct node *r = alloc_node();
-	if (unlikely(!r))
-		return NULL;
-	if (n->v)
-		r->v = clonev(tag, n->v);
-	for (i = 0; i < 16; i++)
-		if (n->n[i])
-			r->n[i] = node_clone(n->n[i], tag, clonev);
+	int r = 0;
+	u32 cnt = 0, depth, pos;
+	u8 b;
+	void *p, **pc;
+	struct anode *n;
+	struct aleaf *l;
+	struct tkent e;
+	struct tkheap h = { NULL, 0, 0 };
+
+	if (!(p = art_find_prefix(t, keyprefix, keyprefixsz, &depth)))
+		return 0;
+	if (unlikely(r = tkheap_push(&h, p, art_score(t, p), depth, TK_TREE)))
+		goto done;
+	while (cnt < k && h.sz) {
+		tkheap_pop(&h, &e);
+		if (TK_VALUE == e.type) {
+			/* Key of value is path to the node. */
+			n = e.p;
+			l = art_any_leaf(n);
+			cnt++;
+			if (!(*cb)(tag, l->key, e.depth, n->v, e.score))
+				break;
+			continue;
+		}
+		if (is_aleaf(e.p)) {
+			l = to_aleaf(e.p);
+			cnt++;
+			if (!(*cb)(tag, l->key, l->ksz, l->v, e.score))
+				break;
+			continue;
+		}
+		n = e.p;
+		depth = e.depth + n->plen;
+		if (n->v && unlikely(r = tkheap_push(&h, n, (*t->vscore)(n->v),
+						     depth, TK_VALUE)))
+			goto done;
+		pos = 0;
+		while ((pc = anode_next_ref(n, &pos, &b)))
+			if (unlikely(r = tkheap_push(&h,
+						     *pc,
+						     art_score(t, *pc),
+						     depth + 1,
+						     TK_TREE)))
+				goto done;
+	}
+	r = (int)cnt;
+
+ done:
+	if (h.e)
+		yfree(h.e);
 	return r;
 }
 
+/******************************************************************************
+ *
+ * Concurrent mode
+ *
+ *****************************************************************************/
+/*
+ * Nodes reachable from published root are never modified. Writer copies
+ *   nodes on the path of key(copy-on-write), modifies the copies with
+ *   functions of ART engine, and publishes new root with release-store.
+ * ART engine modifies only nodes on the path of key, except for the child
+ *   merged at anode_normalize(). Replaced nodes and values are retired,
+ *   and freed after grace period(see ebr.h).
+ * So, readers see either old or new trie without any lock.
+ */
+struct cow {
+	u32 n;
+	void *old[ART_MAX_DEPTH + 1]; /* nodes or leaves(not tagged) */
+	void *new[ART_MAX_DEPTH + 1];
+};
+
+static void
+free_retired(struct ytrie *t, const struct retired *r) {
+	switch (r->type) {
+	case R_MEM:
+		yfree(r->p);
+		break;
+	case R_VALUE:
+		(*t->vfree)(r->p);
+		break;
+	case R_TREE:
+		art_free(r->p, t->vfree);
+		break;
+	default:
+		yassert(0);
+	}
+}
+
+/* Called with writer lock. */
+static void
+reclaim(struct ytrie *t, bool force) {
+	u32 i;
+	/* Waiting grace period in read-side section is deadlock. */
+	if ((!force && likely(t->rlsz < RECLAIM_BATCH))
+	    || !t->rlsz
+	    || ebr_in_read())
+		return;
+	ebr_synchronize();
+	for (i = 0; i < t->rlsz; i++)
+		free_retired(t, &t->rl[i]);
+	t->rlsz = 0;
+}
+
+/* Free copied nodes. They are not visible to anyone. */
+static void
+cow_discard(struct cow *c) {
+	u32 i;
+	for (i = 0; i < c->n; i++)
+		yfree(c->new[i]);
+}
+
+static void
+cow_commit(struct ytrie *t, struct cow *c) {
+	u32 i;
+	for (i = 0; i < c->n; i++)
+		retire(t, c->old[i], R_MEM);
+}
+
 /*
+ * Copy nodes on the path of @key. @root is replaced with root of copied
+ *   path.
  *
+ * @return 0 if success. Otherwise -ENOMEM.
  */
 static int
-iterate_internal(
-	void *tag,
-	struct node *n,
-	int(cb)(void *, const u8 *, u32, void *),
-	/* bsz: excluding space for trailing 0 */
-	u8 *buf,
-	u32 bsz,
-	u32 bitoffset
-) {
-	register u32 i;
+cow_path(void **root, const u8 *key, u32 sz, struct cow *c) {
+	void **ref = root;
+	u32 depth = 0;
+	c->n = 0;
+	while (*ref) {
+		struct anode *n, *nn;
+		u32 nsz;
+		if (is_aleaf(*ref)) {
+			struct aleaf *l = to_aleaf(*ref);
+			struct aleaf *nl = aleaf_new(l->key, l->ksz, l->v);
+			if (unlikely(!nl))
+				goto fail;
+			c->old[c->n] = l;
+			c->new[c->n++] = nl;
+			*ref = mk_aleaf(nl);
+			break;
+		}
+		n = *ref;
+		nsz = _ansz[n->type] + n->plen;
+		if (unlikely(!(nn = ymalloc(nsz))))
+			goto fail;
+		memcpy(nn, n, nsz);
+		c->old[c->n] = n;
+		c->new[c->n++] = nn;
+		*ref = nn;
+		/* End of key or compressed path is split at this node */
+		if (depth + n->plen >= sz
+		    || memcmp(anode_pfx(n), key + depth, n->plen))
+			break;
+		depth += n->plen;
+		if (!(ref = anode_child_ref(nn, key[depth])))
+			break;
+		depth++;
+	}
+	return 0;
 
-	if (n->v) {
-		/* value should exists at byte-based-node */
-		yassert(0 == bitoffset % 8);
-		/* if (buf) { buf[bitoffset>>3] = 0 ; } */
-		/* keep going? */
-		if (!(*cb)(tag, buf, bitoffset / 8, n->v))
-			return 0;
+ fail:
+	cow_discard(c);
+	return -ENOMEM;
+}
+
+static int
+conc_insert(struct ytrie *t, const u8 *key, u32 sz, void *v) {
+	int r;
+	void *root;
+	struct cow c;
+	lock_w(t);
+	root = t->art;
+	if (unlikely(r = cow_path(&root, key, sz, &c)))
+		goto out;
+	if (unlikely(0 > (r = art_insert(t, &root, key, sz, v)))) {
+		/* Copied nodes are not changed if it fails. */
+		cow_discard(&c);
+		goto out;
 	}
+	if (t->vscore)
+		art_rescore(t, root, key, sz);
+	__atomic_store_n(&t->art, root, __ATOMIC_RELEASE);
+	cow_commit(t, &c);
+	if (!r)
+		__atomic_store_n(&t->sz, t->sz + 1, __ATOMIC_RELAXED);
+	reclaim(t, FALSE);
+ out:
+	unlock_w(t);
+	return r;
+}
 
-	for (i = 0; i < 16; i++) {
-		if (n->n[i]) {
-			int   r;
-			if (buf) {
-				u8 *p =  buf + (bitoffset >> 3);
-				/* check that buffer is remained enough */
-				if (bitoffset >> 3 == bsz)
-					/* Not enough buffer.
-					 * TODO
-					 * Useful error value should be used.
-					 */
-					return -EINVAL;
-
-				if (!(bitoffset % 8))
-					/*
-					 * multiple of 8
-					 * - getting index for front node
-					 */
-					*p = (i << 4);
-				else {
-					/*
-					 * multiple of 4
-					 * - getting index for back node
-					 */
-					*p &= 0xf0;
-					*p |= i;
-				}
-			}
-			/* go to next depth */
-			r = iterate_internal(
-				tag,
-				n->n[i],
-				cb,
-				buf,
-				bsz,
-				bitoffset + 4);
-			if (r <= 0)
-				return r;
-		}
+static int
+conc_remove(struct ytrie *t, const u8 *key, u32 sz) {
+	int r;
+	void *root;
+	struct cow c;
+	lock_w(t);
+	root = t->art;
+	if (unlikely(r = cow_path(&root, key, sz, &c)))
+		goto out;
+	if (!(r = art_remove(t, &root, key, sz))) {
+		cow_discard(&c);
+		goto out;
 	}
-	return 1;
+	if (t->vscore)
+		art_rescore(t, root, key, sz);
+	__atomic_store_n(&t->art, root, __ATOMIC_RELEASE);
+	cow_commit(t, &c);
+	__atomic_store_n(&t->sz, t->sz - 1, __ATOMIC_RELAXED);
+	reclaim(t, FALSE);
+ out:
+	unlock_w(t);
+	return r;
+}
+
+static void
+conc_reset(struct ytrie *t) {
+	void *root;
+	lock_w(t);
+	if ((root = t->art)) {
+		__atomic_store_n(&t->art, NULL, __ATOMIC_RELEASE);
+		__atomic_store_n(&t->sz, 0, __ATOMIC_RELAXED);
+		retire(t, root, R_TREE);
+	}
+	reclaim(t, TRUE);
+	unlock_w(t);
 }
 
 void **
@@ -370,14 +2107,20 @@ ytrie_getref(struct ytrie *t, const u8 *key, u32 sz) {
 	yassert(key);
 	if (!sz)
 		return NULL; /* 0 length string */
+	if (is_art(t))
+		return art_getref(t, key, sz);
 	n = get_node(t, key, sz, FALSE);
 	return n ? &n->v : NULL;
 }
 
 void *
 ytrie_get(struct ytrie *t, const u8 *key, u32 sz) {
-	void ** pv = ytrie_getref(t, key, sz);
-	return pv ? *pv : NULL;
+	void **pv, *v;
+	read_begin(t);
+	pv = ytrie_getref(t, key, sz);
+	v = pv ? *pv : NULL;
+	read_end(t);
+	return v;
 }
 
 int
@@ -390,17 +2133,24 @@ ytrie_iterate(
 	int(cb)(void *, const u8 *, u32, void *)
 ) {
 	char buf[YTRIE_MAX_KEY_LEN + 1];
-	struct node *n = get_node(t, key, keysz, FALSE);
+	struct node *n;
 
 	yassert(t && key);
+	if (is_art(t)) {
+		int r;
+		read_begin(t);
+		r = art_iterate(t, tag, key, keysz, cb);
+		read_end(t);
+		return r;
+	}
+	n = get_node(t, key, keysz, FALSE);
 	if (n)
 		return iterate_internal(
 			tag,
 			n,
 			cb,
 			(u8 *)buf,
-			YTRIE_MAX_KEY_LEN,
-			0);
+			YTRIE_MAX_KEY_LEN);
 	else
 		return -EINVAL;
 }
@@ -408,6 +2158,7 @@ ytrie_iterate(
 int
 ytrie_insert(struct ytrie *t, const u8 *key, u32 sz, void *v) {
 	struct node *n;
+	int r;
 
 	yassert(t && key);
 	if (unlikely(!sz))
@@ -415,6 +2166,15 @@ ytrie_insert(struct ytrie *t, const u8 *key, u32 sz, void *v) {
 	if (unlikely(!v || (sz >= YTRIE_MAX_KEY_LEN)))
 		return -1; /* error case */
 
+	if (is_conc(t))
+		return conc_insert(t, key, sz, v);
+	if (is_art(t)) {
+		if (!(r = art_insert(t, &t->art, key, sz, v)))
+			t->sz++;
+		if (r >= 0 && t->vscore)
+			art_rescore(t, t->art, key, sz);
+		return r;
+	}
 	if (unlikely(!(n = get_node(t, key, sz, TRUE))))
 		return -ENOMEM;
 	if (n->v) {
@@ -424,33 +2184,68 @@ ytrie_insert(struct ytrie *t, const u8 *key, u32 sz, void *v) {
 		return 1; /* overwritten */
 	} else {
 		n->v = v;
+		t->sz++;
 		return 0; /* newly created */
 	}
 }
 
 struct ytrie *
 ytrie_create(void (*vfree)(void *)) {
+	return ytrie_create2(vfree, 0);
+}
+
+struct ytrie *
+ytrie_create2(void (*vfree)(void *), int opt) {
+	return ytrie_create_scored(vfree, opt, NULL);
+}
+
+struct ytrie *
+ytrie_create_scored(
+	void (*vfree)(void *),
+	int opt,
+	u32 (*vscore)(const void *)
+) {
 	struct ytrie *t = ycalloc(1, sizeof(*t));
 	if (!t)
 		return NULL;
 	t->vfree = vfree;
+	t->vscore = vscore;
+	if (vscore)
+		opt |= YTRIE_art;
+	if (opt & YTRIE_concurrent) {
+		opt |= YTRIE_art;
+		init_w_lock(t);
+	}
+	t->opt = opt;
 	return t;
 }
 
 void
 ytrie_reset(struct ytrie *t) {
-	register int i;
-	for (i = 0; i < 16; i++) {
-		if (t->rt.n[i]) {
-			free_node(t->rt.n[i], t->vfree, FALSE);
-			t->rt.n[i] = NULL;
-		}
-	}
+	if (is_conc(t)) {
+		conc_reset(t);
+		return;
+	} else if (is_art(t)) {
+		art_free(t->art, t->vfree);
+		t->art = NULL;
+	} else
+		free_nodes(t);
+	t->sz = 0;
 }
 
 void
 ytrie_destroy(struct ytrie *t) {
-	ytrie_reset(t);
+	if (is_conc(t)) {
+		u32 i;
+		/* No one uses trie. Grace period is not required. */
+		art_free(t->art, t->vfree);
+		for (i = 0; i < t->rlsz; i++)
+			free_retired(t, &t->rl[i]);
+		if (t->rl)
+			yfree(t->rl);
+		destroy_w_lock(t);
+	} else
+		ytrie_reset(t);
 	yfree(t);
 }
 
@@ -458,11 +2253,35 @@ ytrie_destroy(struct ytrie *t) {
 int
 ytrie_remove(struct ytrie *t, const u8 *key, u32 sz) {
 	yassert(t && key);
-	switch(remove_key(&t->rt, key, sz, t->vfree)) {
-	case 1:
-	case 0: return 1;
-	default: return 0;
+	if (is_conc(t))
+		return sz ? conc_remove(t, key, sz) : 0;
+	if (is_art(t)) {
+		if (!sz || !art_remove(t, &t->art, key, sz))
+			return 0;
+		if (t->vscore)
+			art_rescore(t, t->art, key, sz);
+		t->sz--;
+		return 1;
 	}
+	if (!remove_key(t, key, sz))
+		return 0;
+	t->sz--;
+	return 1;
+}
+
+uint32_t
+ytrie_sz(const struct ytrie *t) {
+	return __atomic_load_n(&t->sz, __ATOMIC_RELAXED);
+}
+
+void
+ytrie_read_begin(void) {
+	ebr_read_begin();
+}
+
+void
+ytrie_read_end(void) {
+	ebr_read_end();
 }
 
 void (*
@@ -470,13 +2289,63 @@ ytrie_vfree(const struct ytrie *t))(void *) {
 	return t->vfree;
 }
 
+struct equal_arg {
+	struct ytrie *t;
+	int (*cmp)(const void *, const void *);
+};
+
+static int
+equal_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct equal_arg *arg = tag;
+	void *v1 = ytrie_get(arg->t, key, sz);
+	return v1 && 0 == (*arg->cmp)(v, v1);
+}
+
 bool
 ytrie_equal(
 	const struct ytrie *t0,
 	const struct ytrie *t1,
 	int (*cmp)(const void *, const void *)
 ) {
-	return equal_internal(&t0->rt, &t1->rt, cmp);
+	struct equal_arg arg;
+	if (ytrie_sz(t0) != ytrie_sz(t1))
+		return FALSE;
+	if (!ytrie_sz(t0))
+		return TRUE;
+	/*
+	 * Same number of values, and every value of t0 has same one at t1.
+	 * This works regardless of engine of each trie.
+	 */
+	arg.t = (struct ytrie *)t1;
+	arg.cmp = cmp;
+	return 1 == ytrie_iterate((struct ytrie *)t0,
+				  &arg,
+				  (const u8 *)"",
+				  0,
+				  &equal_cb);
+}
+
+struct copy_arg {
+	struct ytrie *dst;
+	void *tag;
+	void *(*clonev)(void *, const void *);
+	int r;
+};
+
+static int
+copy_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct copy_arg *arg = tag;
+	void *nv = (*arg->clonev)(arg->tag, v);
+	if (unlikely(!nv)) {
+		arg->r = -ENOMEM;
+		return 0;
+	}
+	if (unlikely(0 > (arg->r = ytrie_insert(arg->dst, key, sz, nv)))) {
+		if (arg->dst->vfree)
+			(*arg->dst->vfree)(nv);
+		return 0;
+	}
+	return 1;
 }
 
 int
@@ -486,14 +2355,39 @@ ytrie_copy(
 	void *tag,
 	void *(*clonev)(void *,const void *)
 ) {
-	register int i;
+	s64 nv;
 	ytrie_reset(dst);
 	dst->vfree = src->vfree;
-	for (i=0; i<16; i++) {
-		if (src->rt.n[i])
-			dst->rt.n[i] = node_clone(src->rt.n[i], tag, clonev);
+	dst->vscore = src->vscore;
+	/* Concurrent trie keeps its mode(and ART engine) */
+	if (!is_conc(dst))
+		dst->opt = src->opt & ~YTRIE_concurrent;
+	if (is_art(src) || is_art(dst)) {
+		/* Keys are visited in order. So, path is built incrementally */
+		struct copy_arg arg;
+		int r;
+		arg.dst = dst;
+		arg.tag = tag;
+		arg.clonev = clonev;
+		arg.r = 0;
+		r = ytrie_iterate((struct ytrie *)src,
+				  &arg,
+				  (const u8 *)"",
+				  0,
+				  &copy_cb);
+		if (!arg.r && 0 > r)
+			arg.r = r;
+		if (unlikely(arg.r))
+			ytrie_reset(dst);
+		return arg.r;
 	}
-	/* return value of this function is reserved for future use */
+	if (unlikely(0 > (nv = clone_nodes(dst, &src->rt, &dst->rt,
+					     tag, clonev))))
+	{
+		ytrie_reset(dst);
+		return (int)nv;
+	}
+	dst->sz = (u32)nv;
 	return 0;
 }
 
@@ -503,8 +2397,13 @@ ytrie_clone(
 	void *tag,
 	void *(*clonev)(void *, const void *)
 ) {
-	struct ytrie *r = ytrie_create(t->vfree);
-	ytrie_copy(r, t, tag, clonev);
+	struct ytrie *r = ytrie_create_scored(t->vfree, t->opt, t->vscore);
+	if (unlikely(!r))
+		return NULL;
+	if (unlikely(ytrie_copy(r, t, tag, clonev))) {
+		ytrie_destroy(r);
+		return NULL;
+	}
 	return r;
 }
 
@@ -516,10 +2415,6 @@ ytrie_auto_complete(
 	u8 *buf,
 	u32 bufsz
 ) {
-#define YTRIEBranch 0
-#define YTRIELeaf 1
-#define YTRIEFail 2
-
 	int ret = -EINVAL;
 	register struct node *n;
 	register u32 i;
@@ -528,6 +2423,13 @@ ytrie_auto_complete(
 
 	yassert(t && keyprefix && buf);
 
+	if (is_art(t)) {
+		read_begin(t);
+		ret = art_auto_complete(t, keyprefix, keyprefixsz, buf, bufsz);
+		read_end(t);
+		return ret;
+	}
+
 	/* move to prefix */
 	if (unlikely(!(n = get_node(t, keyprefix, keyprefixsz, FALSE))))
 		goto fail;
@@ -586,8 +2488,141 @@ ytrie_auto_complete(
 
  fail:
 	return YTRIEFail;
+}
+
+void *
+ytrie_longest_prefix(struct ytrie *t, const u8 *key, u32 sz, u32 *matchlen) {
+	void *v = NULL;
+	u32 depth, len = 0;
+
+	yassert(t && key);
+	if (!is_art(t)) {
+		struct node *n = &t->rt;
+		for (depth = 0; depth < sz; depth++) {
+			if (!(n = n->n[key[depth] >> 4])
+			    || !(n = n->n[key[depth] & 0x0f]))
+				break;
+			if (n->v) {
+				v = n->v;
+				len = depth + 1;
+			}
+		}
+		goto out;
+	}
+
+	read_begin(t);
+	{
+		void *p = art_root(t), **pc;
+		depth = 0;
+		while (p) {
+			struct anode *n;
+			if (is_aleaf(p)) {
+				struct aleaf *l = to_aleaf(p);
+				if (l->ksz <= sz
+				    && !memcmp(l->key + depth,
+					       key + depth,
+					       l->ksz - depth)) {
+					v = l->v;
+					len = l->ksz;
+				}
+				break;
+			}
+			n = p;
+			if (sz - depth < n->plen
+			    || memcmp(anode_pfx(n), key + depth, n->plen))
+				break;
+			depth += n->plen;
+			if (n->v) {
+				v = n->v;
+				len = depth;
+			}
+			if (depth == sz
+			    || !(pc = anode_child_ref(n, key[depth])))
+				break;
+			p = *pc;
+			depth++;
+		}
+	}
+	read_end(t);
+
+ out:
+	if (v && matchlen)
+		*matchlen = len;
+	return v;
+}
+
+int
+ytrie_cursor_init(
+	struct ytrie_cursor *c,
+	const u8 *start,
+	u32 startsz,
+	const u8 *end,
+	u32 endsz
+) {
+	if (unlikely((start && startsz > YTRIE_MAX_KEY_LEN)
+		     || (end && endsz > YTRIE_MAX_KEY_LEN)))
+		return -EINVAL;
+	c->flags = CUR_LOINCL;
+	c->losz = start ? startsz : 0;
+	if (c->losz)
+		memcpy(c->lo, start, c->losz);
+	c->hisz = 0;
+	if (end) {
+		c->flags |= CUR_HI;
+		c->hisz = endsz;
+		memcpy(c->hi, end, endsz);
+	}
+	return 0;
+}
 
-#undef YTRIEBranch
-#undef YTRIELeaf
-#undef YTRIEFail
+int
+ytrie_cursor_next(
+	struct ytrie *t,
+	struct ytrie_cursor *c,
+	void *tag,
+	u32 limit,
+	int (*cb)(void *, const u8 *, u32, void *)
+) {
+	struct range r;
+
+	yassert(t && c && cb);
+	if (c->flags & CUR_DONE)
+		return 0;
+	r.cur = c;
+	r.limit = limit;
+	r.cnt = 0;
+	r.stopped = FALSE;
+	r.err = 0;
+	r.tag = tag;
+	r.cb = cb;
+	if (is_art(t)) {
+		read_begin(t);
+		art_range(t, &r);
+		read_end(t);
+	} else
+		node_range(t, &r);
+	if (unlikely(r.err))
+		return r.err;
+	if (!r.stopped)
+		c->flags |= CUR_DONE;
+	return (int)r.cnt;
+}
+
+int
+ytrie_auto_complete_top(
+	struct ytrie *t,
+	const u8 *keyprefix,
+	u32 keyprefixsz,
+	u32 k,
+	void *tag,
+	int (*cb)(void *, const u8 *, u32, void *, u32)
+) {
+	int r;
+	yassert(t && keyprefix && cb);
+	if (unlikely(!t->vscore))
+		return -EINVAL;
+	read_begin(t);
+	r = art_top_k(t, keyprefix, keyprefixsz, k, tag, cb);
+	read_end(t);
+	return r;
 }
@@ -0,0 +1,147 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/**
+ * @file ychash.h
+ * @brief Header file to use concurrent hash.
+ *
+ * This is MT(Multithread)-safe.
+ * Writers(set, remove) are serialized by lock per stripe(group of buckets).
+ * Readers(get) don't take any lock. Memory removed from the hash is freed
+ *   after all readers that may see it are done(epoch based reclamation).
+ * Resizing hash is done while readers are running.
+ */
+
+#pragma once
+
+#include "ydef.h"
+
+/** Predefined function ID. 'free()' function for malloc() */
+#define YCHASH_MEM_FREE ((void (*)(void *))1)
+
+/** ychash object. */
+struct ychash;
+
+/**
+ * Create concurrent hash.
+ *
+ * @param vfree
+ * function to free hash value.
+ * set as NULL not to free.
+ * set as @ref YCHASH_MEM_FREE to use standard 'free' function.
+ * @param keyfree Same with @c vfree
+ * @param keycopy
+ * Callback function to copy key. Set NULL to use shallow copy.
+ * This should return 0 if success. Otherwise non-zero.
+ * @param keyeq
+ * Callback function to compare key objects.
+ * Set as NULL to compare mem-addresses of key-objects.
+ * @c YHASHL_KEYEQ_XXX at yhashl.h can be used.
+ * This should return 0 if same. Otherewise non-zero.
+ * @param hfunc Hash function creating 32bit hash value from @c key.
+ * Set as NULL to use mem-address of key.
+ * @c YHASHL_HFUNC_XXX at yhashl.h can be used.
+ * @return NULL if fails(ex. ENOMEM). Otherwise new hash object.
+ */
+YYEXPORT struct ychash *
+ychash_create(
+	void (*vfree)(void *),
+	void (*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keyeq)(const void *, const void *),
+	uint32_t (*hfunc)(const void *key));
+
+/**
+ * Destroy hash object. Hash becomes invalid.
+ * Hash SHOULD NOT be used by other threads.
+ */
+YYEXPORT void
+ychash_destroy(struct ychash *);
+
+/**
+ * Get hash size(number of keys in the hash).
+ * Under concurrent updates, this is just a snapshot.
+ */
+YYEXPORT uint32_t
+ychash_sz(const struct ychash *);
+
+/**
+ * Add new value to hash.
+ * If key already exists, key is kept and only value is replaced.
+ * Replaced value is freed later when no reader can see it.
+ *
+ * @return # of newly added item (0 means overwritten). @c -errno if fails.
+ */
+YYEXPORT int
+ychash_set(struct ychash *, void *key, void *v);
+
+/**
+ * Delete key from hash.
+ * Key and value are freed later when no reader can see them.
+ *
+ * @return Number of deleted values. (0 means nothing deleted).
+ */
+YYEXPORT int
+ychash_remove(struct ychash *, const void *key);
+
+/**
+ * Find key and get value. This doesn't take any lock.
+ * If hash has @c vfree, value may be freed by other thread right after
+ *   this returns. To use the value safely, call this between
+ *   @ref ychash_read_begin and @ref ychash_read_end.
+ *
+ * @param value Value in the hash. If it is NULL, it is ignored.
+ * @return 0 if success. @c -errno if fails.
+ */
+YYEXPORT int
+ychash_get(const struct ychash *, const void *key, void **value);
+
+/**
+ * Begin read-side critical section. It can be nested.
+ * Keys and values got in the section are not freed until
+ *   @ref ychash_read_end.
+ * @ref ychash_set and @ref ychash_remove can be used in the section. But,
+ *   memory is not reclaimed by them.
+ * This is not per-hash. Section covers all @c ychash objects.
+ */
+YYEXPORT void
+ychash_read_begin(void);
+
+/**
+ * End read-side critical section.
+ */
+YYEXPORT void
+ychash_read_end(void);
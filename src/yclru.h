@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/**
+ * @file yclru.h
+ * @brief Concurrent LRU cache.
+ *
+ * This is MT(Multithread)-safe.
+ * Keys are distributed to shards by hash value. Each shard is independent
+ *   LRU cache(hash + list) protected by its own lock. So, capacity is also
+ *   divided evenly among shards and eviction order is LRU per shard.
+ * Data got from cache is kept in the cache(unlike @ref ylru_get).
+ *   Evicted or replaced data is freed after all readers that may see it
+ *   are done(epoch based reclamation).
+ */
+
+#pragma once
+
+#include "ydef.h"
+
+/** Predefined function ID. 'free()' function for 'malloc()' */
+#define YCLRU_PREDEFINED_FREE ((void (*)(void *))1)
+
+/** Options used at @c yclruX_create */
+enum {
+	/**
+	 * Cache hit doesn't take exclusive lock of shard.
+	 * Hit is recorded to per-shard buffer, and recorded entries are
+	 *   moved to the newest position in batch, when buffer becomes full
+	 *   or before shard is modified. Records are dropped if buffer is full
+	 *   and shard is busy. So, LRU order becomes approximate.
+	 */
+	YCLRU_buffered_read = 0x1,
+};
+
+/** Concurrent lru object */
+struct yclru;
+
+/**
+ * Create concurrent lru cache that uses integer value as key.
+ *
+ * @param maxsz Maximum size that cache can keep (NOT bytes).
+ * '0' means infinite (as many as possible).
+ * Each shard can keep up to 'maxsz / nshards'(rounded up).
+ * @param nshards Number of shards. It is rounded up to power of 2.
+ * '0' means default value.
+ * @param opt Bitwise-OR of @c YCLRU_xxx options.
+ * @param datafree Function to free user data evicted from cache
+ * 'NULL' means 'DO NOT free'.
+ * @param datacreate Function to create data if cache misses.
+ * 'NULL' means 'DO NOT create'.
+ * @param datasize Function to calculate data size.
+ * This is to compare with 'maxsz' of cache.
+ * 'NULL' means fixed value (1).
+ * @return NULL for fails
+ */
+YYEXPORT struct yclru *
+yclrui_create(
+	uint32_t maxsz,
+	uint32_t nshards,
+	int opt,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	uint32_t (*datasize)(const void *));
+
+/**
+ * Create concurrent lru cache that uses string value as key.
+ * @see yclrui_create
+ */
+YYEXPORT struct yclru *
+yclrus_create(
+	uint32_t maxsz,
+	uint32_t nshards,
+	int opt,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	uint32_t (*datasize)(const void *));
+
+/**
+ * Create concurrent lru cache that uses object as key.
+ * See @ref yclrui_create and @ref yhasho_create in {@link yhash.h}
+ */
+YYEXPORT struct yclru *
+yclruo_create(
+	uint32_t maxsz,
+	uint32_t nshards,
+	int opt,
+	/* functions to handle cache data */
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	uint32_t (*datasize)(const void *),
+	/* functions to handle key object */
+	void (*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keycmp)(const void *, const void *),
+	uint32_t (*hfunc)(const void *key));
+
+/**
+ * Make cache empty.
+ * Cache SHOULD NOT be used by other threads.
+ */
+YYEXPORT void
+yclru_reset(struct yclru *);
+
+/**
+ * Destroy lru object. Object pointer becomes invalid.
+ * Cache SHOULD NOT be used by other threads.
+ */
+YYEXPORT void
+yclru_destroy(struct yclru *);
+
+/**
+ * Put data to lru cache. It becomes the newest one in its shard.
+ * If key already exists, data is replaced. Replaced data is freed later
+ *   when no reader can see it.
+ *
+ * @return 0 for success. Otherwise @c -errno.
+ * (-EINVAL if data is larger than size of shard)
+ */
+YYEXPORT int
+yclru_put(struct yclru *, const void *key, void *data);
+
+/**
+ * Get data from lru cache. Data is kept in the cache.
+ * If cache has @c datafree, data may be freed by other thread right after
+ *   this returns. To use the data safely, call this between
+ *   @ref yclru_read_begin and @ref yclru_read_end.
+ * Data created by @c datacreate is put to the cache.
+ *
+ * @param data 'NULL' is NOT allowed.
+ * @param key Key value of data to get.
+ * @return 0 for getting data(existing one, or newly created one).
+ * 1 cache missed and not newly created.
+ * <0 error (@c -errno)
+ */
+YYEXPORT int
+yclru_get(struct yclru *, void **data, const void *key);
+
+/**
+ * Remove data from lru cache.
+ * Data is freed later when no reader can see it.
+ *
+ * @return Number of removed data (0 means nothing removed).
+ */
+YYEXPORT int
+yclru_remove(struct yclru *, const void *key);
+
+/**
+ * Get size of cached data. See @c datasize at @ref yclrui_create.
+ * Under concurrent updates, this is just a snapshot.
+ */
+YYEXPORT uint32_t
+yclru_sz(const struct yclru *);
+
+/**
+ * Begin read-side critical section. It can be nested.
+ * Data got in the section is not freed until @ref yclru_read_end.
+ * @ref yclru_put and @ref yclru_remove can be used in the section. But,
+ *   memory is not reclaimed by them.
+ * This is not per-cache. Section covers all @c yclru objects.
+ */
+YYEXPORT void
+yclru_read_begin(void);
+
+/**
+ * End read-side critical section.
+ */
+YYEXPORT void
+yclru_read_end(void);
@@ -38,7 +38,9 @@
  * @file ycrc.h
  * @brief File continas simple interfaces for crc.
  *
- * Only crc16 and crc32 are supported.
+ * crc16, crc32 and crc64 are supported.
+ * Slicing-by-8/16 table-lookup(See @c CONFIG_CRC_SLICE in crc.c) or
+ * hardware instructions are used after @ref ylib_init.
  */
 
 #pragma once
@@ -59,6 +61,106 @@ ycrc16(uint16_t crc, const uint8_t *data, uint32_t len);
 
 /**
  * See @ref ycrc16 for details.
+ * Polynomial is same with @ref ycrc32c(CRC-32C). But there is no
+ * pre/post-conditioning. That is, @p crc is used as crc register as it is.
  */
 YYEXPORT uint32_t
 ycrc32(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/**
+ * Calculate CRC-32C(Castagnoli, polynomial 0x1EDC6F41).
+ * Standard pre/post-conditioning(XOR 0xffffffff) is applied.
+ * So, `0xE3069283 == ycrc32c(0, "123456789", 9)`.
+ * To continue calculation, pass previous return value as @p crc.
+ * On x86-64, SSE4.2 'crc32' and PCLMULQDQ instructions are used if CPU
+ * supports them(It is decided at @ref ylib_init).
+ *
+ * @param crc Previous crc value. 0 for the first.
+ * @param data Data pointer
+ * @param len Number of bytes in the buffer. 0 is allowed.
+ * @return Calculated value
+ */
+YYEXPORT uint32_t
+ycrc32c(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/**
+ * Get crc of concatenated data A+B from crc of A and crc of B.
+ * This works for both @ref ycrc32 and @ref ycrc32c.
+ * - @ref ycrc32: @p crcb should be calculated with 0 as initial crc.
+ *   Then, `ycrc32(c, A+B) == ycrc32_combine(ycrc32(c, A), ycrc32(0, B), |B|)`
+ * - @ref ycrc32c: Both are calculated as usual(0 as initial crc).
+ *
+ * This is available after @ref ylib_init.
+ *
+ * @param crca crc of A
+ * @param crcb crc of B
+ * @param lenb Number of bytes of B.
+ * @return crc of A+B
+ */
+YYEXPORT uint32_t
+ycrc32_combine(uint32_t crca, uint32_t crcb, uint64_t lenb);
+
+/**
+ * Same with @ref ycrc32. But buffer is split into chunks and crc of each
+ * chunk is calculated at separated threads. And then, they are joined by
+ * @ref ycrc32_combine.
+ * Small buffer is calculated at caller's thread.
+ *
+ * This is available after @ref ylib_init.
+ *
+ * @param crc Previous crc value
+ * @param data Data pointer
+ * @param len Number of bytes in the buffer.
+ * @param nthreads Maximum number of threads including caller's thread.
+ * If <= 0, number of online CPUs is used.
+ * @return Calculated value
+ */
+YYEXPORT uint32_t
+ycrc32_parallel(uint32_t crc, const uint8_t *data, uint64_t len,
+		int nthreads);
+
+/**
+ * Initial crc value for @ref ycrc64 and @ref ycrc64_iso.
+ */
+static YYINLINE uint64_t
+ycrc64_init(void) {
+	return ~(uint64_t)0;
+}
+
+/**
+ * Calculate 64bit crc with ECMA-182 polynomial(CRC-64/XZ).
+ * Like @ref ycrc32, @p crc is used as crc register as it is. So, data can
+ * be given piece by piece:
+ * <PRE>
+ *     uint64_t crc = ycrc64_init();
+ *     crc = ycrc64(crc, data0, len0);
+ *     crc = ycrc64(crc, data1, len1);
+ *     ...
+ *     crc = ycrc64_final(crc);
+ * </PRE>
+ * `0x995DC9BBDF1939FA == ycrc64_final(ycrc64(ycrc64_init(), "123456789", 9))`
+ * Slicing-by-8 table-lookup is used after @ref ylib_init.
+ *
+ * @param crc Previous crc value. @ref ycrc64_init for the first.
+ * @param data Data pointer
+ * @param len Number of bytes in the buffer. 0 is allowed.
+ * @return Calculated value
+ */
+YYEXPORT uint64_t
+ycrc64(uint64_t crc, const uint8_t *data, uint32_t len);
+
+/**
+ * Same with @ref ycrc64 except for using ISO polynomial(CRC-64/GO-ISO).
+ * `0xB90956C775A41001 == ycrc64_final(ycrc64_iso(ycrc64_init(), "123456789", 9))`
+ * Note that ISO polynomial is weak for long data. ECMA is recommended.
+ */
+YYEXPORT uint64_t
+ycrc64_iso(uint64_t crc, const uint8_t *data, uint32_t len);
+
+/**
+ * Get final crc value from crc value of @ref ycrc64 and @ref ycrc64_iso.
+ */
+static YYINLINE uint64_t
+ycrc64_final(uint64_t crc) {
+	return ~crc;
+}
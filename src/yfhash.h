@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/**
+ * @file yfhash.h
+ * @brief Header file to use frozen hash.
+ *
+ * Frozen hash is read-only snapshot of @ref yhash. Keys and values are
+ *   stored as byte arrays in one contiguous memory block(packed open
+ *   addressing table followed by key/value arena).
+ * The block can be written to file as it is, and mapped(mmap) back without
+ *   any parsing. So, large lookup table can be loaded at start-up by just
+ *   paging it in.
+ *
+ * File format depends on byte order of the host. It is checked when file
+ *   is loaded.
+ */
+
+#pragma once
+
+#include "ydef.h"
+
+struct yhash;
+
+/** Frozen hash object */
+struct yfhash;
+
+/**
+ * Function giving byte array representing object(key or value) of
+ *   @ref yhash.
+ * Returned memory SHOULD be valid until @ref yfhash_freeze returns.
+ *
+ * @param obj Key or value object in the hash.
+ * @param len (out) Length of byte array.
+ * @return Byte array
+ */
+typedef const void *(*yfhash_bytes_t)(const void *obj, uint32_t *len);
+
+/**
+ * @ref yfhash_bytes_t for string object. Trailing 0 is not included.
+ */
+YYEXPORT const void *
+yfhash_bytes_str(const void *obj, uint32_t *len);
+
+/**
+ * Create frozen hash from @p h.
+ *
+ * @param kbytes Function giving byte array of key. Keys of binary-key hash
+ *   can be used by passing @ref yhashb_key.
+ * @param vbytes Function giving byte array of value.
+ * @return NULL if fails(ENOMEM, or two keys give same byte array).
+ */
+YYEXPORT struct yfhash *
+yfhash_freeze(
+	const struct yhash *h,
+	yfhash_bytes_t kbytes,
+	yfhash_bytes_t vbytes);
+
+/**
+ * Destroy frozen hash.
+ * If it is loaded from file, memory is unmapped.
+ */
+YYEXPORT void
+yfhash_destroy(struct yfhash *);
+
+/**
+ * Get number of items in the hash.
+ */
+YYEXPORT uint32_t
+yfhash_sz(const struct yfhash *);
+
+/**
+ * Find key and get value.
+ *
+ * @param key Byte array of key
+ * @param keylen Length of @p key
+ * @param value (out) NULLable. Byte array of value. Memory is valid until
+ *   hash is destroyed. It is aligned by 8 bytes.
+ * @param valuelen (out) NULLable. Length of value.
+ * @return 0 if success. @c -errno if fails.
+ */
+YYEXPORT int
+yfhash_get(
+	const struct yfhash *,
+	const void *key,
+	uint32_t keylen,
+	const void **value,
+	uint32_t *valuelen);
+
+/**
+ * Write frozen hash to file.
+ *
+ * @return 0 if success. @c -errno if fails.
+ */
+YYEXPORT int
+yfhash_write_fd(const struct yfhash *, int fd);
+
+/**
+ * Same with @ref yfhash_write_fd except for it writes to file at @p path.
+ * File is truncated.
+ */
+YYEXPORT int
+yfhash_write_file(const struct yfhash *, const char *path);
+
+/**
+ * Map frozen hash written by @ref yfhash_write_fd.
+ * File is mapped read-only. @p fd can be closed after this returns.
+ *
+ * @param out (out) Frozen hash
+ * @return 0 if success. @c -errno if fails. @c -EINVAL if file is not
+ *   valid frozen hash.
+ */
+YYEXPORT int
+yfhash_map_fd(struct yfhash **out, int fd);
+
+/**
+ * Same with @ref yfhash_map_fd except for it maps file at @p path.
+ */
+YYEXPORT int
+yfhash_map_file(struct yfhash **out, const char *path);
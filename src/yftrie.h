@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/**
+ * @file yftrie.h
+ * @brief Header file to use frozen trie.
+ *
+ * Frozen trie is read-only snapshot of @ref ytrie, compiled into
+ *   double-array trie. Transition from state 's' by key byte 'c' is just
+ *   'base[s] + c + 1' whose 'check' is 's'. Suffix that is unique to one
+ *   key is not expanded to states, but is stored at tail array.
+ * Everything is stored in one contiguous memory block. The block can be
+ *   written to file as it is, and mapped(mmap) back without any parsing.
+ *   So, loading takes constant time and pages are shared among processes
+ *   mapping the same file.
+ *
+ * File format depends on byte order of the host. It is checked when file
+ *   is loaded.
+ */
+
+#pragma once
+
+#include "ydef.h"
+
+struct ytrie;
+
+/** Frozen trie object */
+struct yftrie;
+
+/**
+ * Function giving byte array representing value of @ref ytrie.
+ * Returned memory SHOULD be valid until @ref yftrie_freeze returns.
+ *
+ * @param obj Value in the trie.
+ * @param len (out) Length of byte array.
+ * @return Byte array
+ */
+typedef const void *(*yftrie_bytes_t)(const void *obj, uint32_t *len);
+
+/**
+ * @ref yftrie_bytes_t for string object. Trailing 0 is not included.
+ */
+YYEXPORT const void *
+yftrie_bytes_str(const void *obj, uint32_t *len);
+
+/**
+ * Create frozen trie from @p t.
+ *
+ * @param vbytes Function giving byte array of value.
+ * @return NULL if fails(ex. ENOMEM).
+ */
+YYEXPORT struct yftrie *
+yftrie_freeze(const struct ytrie *t, yftrie_bytes_t vbytes);
+
+/**
+ * Destroy frozen trie.
+ * If it is loaded from file, memory is unmapped.
+ */
+YYEXPORT void
+yftrie_destroy(struct yftrie *);
+
+/**
+ * Get number of keys in the trie.
+ */
+YYEXPORT uint32_t
+yftrie_sz(const struct yftrie *);
+
+/**
+ * Find key and get value.
+ *
+ * @param key Byte array of key
+ * @param keysz Length of @p key
+ * @param value (out) NULLable. Byte array of value. Memory is valid until
+ *   trie is destroyed. It is aligned by 8 bytes.
+ * @param valuesz (out) NULLable. Length of value.
+ * @return 0 if success. @c -errno if fails.
+ */
+YYEXPORT int
+yftrie_get(
+	const struct yftrie *,
+	const void *key,
+	uint32_t keysz,
+	const void **value,
+	uint32_t *valuesz);
+
+/**
+ * Iterate keys starting with @p prefix in order of key.
+ *
+ * @param tag Tag passed to @p cb.
+ * @param cb Callback called for each key. Key passed to callback is the
+ *   part after @p prefix(same with @ref ytrie_iterate).
+ * If callback returns 1, iteration keeps going.
+ * But if callback returns 0, iteration stops and this function finishes.
+ * @return
+ * 0: Iteration stops in the middle of iteration due to callback returns 0.
+ * 1: Interation is completely done.
+ * <0: Error. @c -errno. @c -ENOENT if there is no key starting with
+ *   @p prefix.
+ */
+YYEXPORT int
+yftrie_iterate(
+	const struct yftrie *,
+	void *tag,
+	const void *prefix,
+	uint32_t prefixsz,
+	int (*cb)(void *tag,
+		  const uint8_t *key,
+		  uint32_t keysz,
+		  const void *value,
+		  uint32_t valuesz));
+
+/**
+ * Same with @ref ytrie_auto_complete.
+ *
+ * @return
+ * 0: There are more than one candidates that starts with @p keyprefix.
+ * 1: There is only one candidate.
+ * 2: There is no matching candidate key.
+ * <0: @c -errno. Ex. size of @p buf is not large enough.
+ */
+YYEXPORT int
+yftrie_auto_complete(
+	const struct yftrie *,
+	const void *keyprefix,
+	uint32_t keyprefixsz,
+	uint8_t *buf,
+	uint32_t bufsz);
+
+/**
+ * Write frozen trie to file.
+ *
+ * @return 0 if success. @c -errno if fails.
+ */
+YYEXPORT int
+yftrie_write_fd(const struct yftrie *, int fd);
+
+/**
+ * Same with @ref yftrie_write_fd except for it writes to file at @p path.
+ * File is truncated.
+ */
+YYEXPORT int
+yftrie_write_file(const struct yftrie *, const char *path);
+
+/**
+ * Map frozen trie written by @ref yftrie_write_fd.
+ * File is mapped read-only. @p fd can be closed after this returns.
+ *
+ * @param out (out) Frozen trie
+ * @return 0 if success. @c -errno if fails. @c -EINVAL if file is not
+ *   valid frozen trie.
+ */
+YYEXPORT int
+yftrie_map_fd(struct yftrie **out, int fd);
+
+/**
+ * Same with @ref yftrie_map_fd except for it maps file at @p path.
+ */
+YYEXPORT int
+yftrie_map_file(struct yftrie **out, const char *path);
@@ -47,10 +47,36 @@
 
 /** Predefined function ID. 'free()' function for malloc() */
 #define YHASH_MEM_FREE ((void (*)(void *))1)
+/**
+ * Predefined hash function ID. Fast seeded hash for pointer and number.
+ * Same with YHASHL_HFUNC_FAST_PTR at yhashl.h
+ */
+#define YHASH_HFUNC_FAST_PTR ((uint32_t (*)(const void *))(void *)3)
+/**
+ * Predefined hash function ID. Fast seeded hash for string.
+ * Same with YHASHL_HFUNC_FAST_STR at yhashl.h
+ */
+#define YHASH_HFUNC_FAST_STR ((uint32_t (*)(const void *))(void *)4)
 
 /** yhash object. */
 struct yhash;
 
+/** Options used at @c yhashX_create2 */
+enum {
+	/**
+	 * Use open addressing(SIMD-probed control bytes) instead of chaining.
+	 * Hash node is not allocated for each item. So, this is faster and
+	 * more cache-friendly. But, address of value slot is not stable.
+	 */
+	YHASH_open_addressing = 0x1,
+	/**
+	 * Use fast hash function(@ref YHASH_HFUNC_FAST_PTR or
+	 * @ref YHASH_HFUNC_FAST_STR) with random seed for each hash,
+	 * instead of default one. This is ignored at @ref yhasho_create2.
+	 */
+	YHASH_fast_hash = 0x2,
+};
+
 /******************************************************************************
  *
  * Interfaces for integer-key hash
@@ -71,6 +97,14 @@ struct yhash;
 YYEXPORT struct yhash *
 yhashi_create(void (*vfree)(void *));
 
+/**
+ * @ref yhashi_create with options.
+ *
+ * @param opt Bitwise-OR of @c YHASH_xxx options.
+ */
+YYEXPORT struct yhash *
+yhashi_create2(void (*vfree)(void *), int opt);
+
 /******************************************************************************
  *
  * Interfaces for string-key hash
@@ -89,6 +123,14 @@ yhashi_create(void (*vfree)(void *));
 YYEXPORT struct yhash *
 yhashs_create(void (*vfree)(void *), bool key_deepcopy);
 
+/**
+ * @ref yhashs_create with options.
+ *
+ * @param opt See @c opt at @ref yhashi_create2
+ */
+YYEXPORT struct yhash *
+yhashs_create2(void (*vfree)(void *), bool key_deepcopy, int opt);
+
 /******************************************************************************
  *
  * Interfaces for general-object-key hash
@@ -108,6 +150,7 @@ yhashs_create(void (*vfree)(void *), bool key_deepcopy);
  * Set as NULL to compare mem-addresses of key-objects.
  * This should return 0 if same. Otherewise non-zero.
  * @param hfunc Hash function creating 32bit hash value from @c key.
+ * Predefined @c YHASH_HFUNC_XXX can be used.
  * @return NULL if fails(ex. ENOMEM). Otherwise new hash object.
  */
 YYEXPORT struct yhash *
@@ -118,6 +161,118 @@ yhasho_create(
 	int (*keyeq)(const void *, const void *),
 	uint32_t (*hfunc)(const void *key));
 
+/**
+ * @ref yhasho_create with options.
+ *
+ * @param opt See @c opt at @ref yhashi_create2
+ */
+YYEXPORT struct yhash *
+yhasho_create2(
+	void (*vfree)(void *),
+	void (*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keyeq)(const void *, const void *),
+	uint32_t (*hfunc)(const void *key),
+	int opt);
+
+/******************************************************************************
+ *
+ * Interfaces for binary-key hash
+ * prefix : 'yhashb_'
+ *
+ *****************************************************************************/
+/**
+ * Create hash that uses byte array(pointer and length) as key.
+ * Key bytes are always copied into hash, and stored with hash node in one
+ *   memory block. Length and hash value of key are cached with it.
+ * Keys are hashed by fast hash function with random seed for each process.
+ * So, keys(See @ref yhash_keys) can be put to other binary-key hash.
+ *
+ * At this hash, @c yhashb_xxx should be used instead of
+ *   @ref yhash_set, @ref yhash_get and @ref yhash_remove family.
+ * Other common interfaces(@c yhash_xxx) can be used as it is.
+ * Keys given by @ref yhash_keys can be read by @ref yhashb_key.
+ *
+ * @param vfree See {@code vfree} at @ref yhashi_create
+ * @return NULL if fails(ex. ENOMEM). Otherwise new hash object.
+ */
+YYEXPORT struct yhash *
+yhashb_create(void (*vfree)(void *));
+
+/**
+ * @ref yhashb_create with options.
+ * @c YHASH_fast_hash is meaningless here.
+ *
+ * @param opt See @c opt at @ref yhashi_create2
+ */
+YYEXPORT struct yhash *
+yhashb_create2(void (*vfree)(void *), int opt);
+
+/**
+ * Get key bytes from the key stored in the hash(ex. key given by
+ *   @ref yhash_keys).
+ *
+ * @param hkey Key stored in the binary-key hash.
+ * @param len Length of key bytes is stored here.
+ * @return Key bytes.
+ */
+YYEXPORT const void *
+yhashb_key(const void *hkey, uint32_t *len);
+
+/**
+ * Same with @ref yhash_set2 except for key.
+ *
+ * @param key Key bytes. It's NULLable if @p keylen is 0.
+ * @param keylen Length of key bytes.
+ */
+YYEXPORT int
+yhashb_set2(
+	struct yhash *,
+	const void *key,
+	uint32_t keylen,
+	void **oldv,
+	void *v);
+
+/**
+ * Same with @ref yhash_set except for key.
+ * See @ref yhashb_set2 for @p key and @p keylen.
+ */
+static YYINLINE int
+yhashb_set(struct yhash *h, const void *key, uint32_t keylen, void *v) {
+	return yhashb_set2(h, key, keylen, NULL, v);
+}
+
+/**
+ * Same with @ref yhash_remove2 except for key.
+ * See @ref yhashb_set2 for @p key and @p keylen.
+ */
+YYEXPORT int
+yhashb_remove2(
+	struct yhash *,
+	const void *key,
+	uint32_t keylen,
+	void **value);
+
+/**
+ * Same with @ref yhash_remove except for key.
+ * See @ref yhashb_set2 for @p key and @p keylen.
+ */
+static YYINLINE int
+yhashb_remove(struct yhash *h, const void *key, uint32_t keylen) {
+	return yhashb_remove2(h, key, keylen, NULL);
+}
+
+/**
+ * Same with @ref yhash_get except for key.
+ * See @ref yhashb_set2 for @p key and @p keylen.
+ */
+YYEXPORT int
+yhashb_get(
+	const struct yhash *,
+	const void *key,
+	uint32_t keylen,
+	void **value);
+
 /******************************************************************************
  *
  * Common Interfaces
@@ -154,6 +309,21 @@ yhash_reset(struct yhash *);
 YYEXPORT uint32_t
 yhash_sz(const struct yhash *);
 
+/**
+ * Make hash be able to hold @p n items without resizing.
+ * This is useful to add lots of items at once. Hash is not shrunk below
+ *   this size even if items are removed. Reservation is cleared by
+ *   @ref yhash_reset or by calling this with 0.
+ *
+ * Hash grows when it is full, and shrinks automatically when it becomes
+ *   much smaller(less than about 1/4) than the size at which it grows.
+ *
+ * @param n Number of items
+ * @return 0 if success. @c -errno if fails.
+ */
+YYEXPORT int
+yhash_reserve(struct yhash *, uint32_t n);
+
 /**
  * 'sametype' means all hash attributes (ex. key type, free function etc) are
  * same.
@@ -165,6 +335,7 @@ yhash_is_sametype(const struct yhash *, const struct yhash *);
 
 /**
  * Get keys in the hash.
+ * Keys are in insertion order. Replacing value doesn't change the order.
  * If size of @p keysbuf is not large enough, this fills @p keysbuf fully and
  * returns @p bufsz.
  * So, caller may need to compare returned value and hash size.
@@ -255,3 +426,174 @@ static YYINLINE bool
 yhash_has(const struct yhash *h, const void *key) {
 	return !yhash_get(h, key, NULL);
 }
+
+/**
+ * Get values of several keys at once.
+ * Memory accesses of keys are overlapped by prefetching. So, this is faster
+ *   than calling @ref yhash_get for each key at large hash.
+ * This SHOULD NOT be used at binary-key hash.
+ *
+ * @param keys Array of @p n keys
+ * @param n Number of keys
+ * @param values Array of @p n. Value of @c keys[i] is stored at
+ *   @c values[i]. NULL is stored if key is not in the hash.
+ * @return Number of keys found.
+ */
+YYEXPORT uint32_t
+yhash_get_many(
+	const struct yhash *,
+	const void *const *keys,
+	uint32_t n,
+	void **values);
+
+/**
+ * Set several key-value pairs at once. See @ref yhash_get_many.
+ * Each pair is set in order as if @ref yhash_set is called for it.
+ * If it fails in the middle, pairs before it are still in the hash.
+ * This SHOULD NOT be used at binary-key hash.
+ *
+ * @param keys Array of @p n keys
+ * @param values Array of @p n values
+ * @param n Number of pairs
+ * @return Number of newly added keys. @c -errno if fails.
+ */
+YYEXPORT int
+yhash_set_many(
+	struct yhash *,
+	void *const *keys,
+	void *const *values,
+	uint32_t n);
+
+/**
+ * Visit all items in insertion order. Nothing is allocated.
+ * Hash SHOULD NOT be modified by @p cb.
+ *
+ * @param cb Callback called for each item. Visiting stops if it returns
+ *   non-zero.
+ * @param user User data passed to @p cb.
+ * @return 0 if all items are visited. Otherwise, value returned by @p cb.
+ */
+YYEXPORT int
+yhash_foreach(
+	const struct yhash *,
+	int (*cb)(const void *key, void *value, void *user),
+	void *user);
+
+/**
+ * Remove items that @p keep returns FALSE for. Items are visited in
+ *   insertion order. Key and value of removed item are freed.
+ * Hash is shrunk at most once after all items are visited.
+ * Hash SHOULD NOT be modified by @p keep.
+ *
+ * @param user User data passed to @p keep.
+ * @return Number of removed items.
+ */
+YYEXPORT uint32_t
+yhash_filter(
+	struct yhash *,
+	bool (*keep)(const void *key, void *value, void *user),
+	void *user);
+
+/******************************************************************************
+ *
+ * Cursor
+ *
+ *****************************************************************************/
+/**
+ * Cursor to visit items of hash one by one in insertion order.
+ * Hash can be modified while cursor is opened. So, large hash can be scanned
+ *   incrementally(ex. some items at each message of message looper).
+ * - Items that are in the hash during whole scan are visited exactly once.
+ * - Removed items are not visited after removal.
+ * - Items added during scan may or may not be visited.
+ * - @ref yhash_reset moves cursor to the end.
+ */
+struct yhash_cursor;
+
+/**
+ * Open cursor at the first item of hash.
+ * Cursor SHOULD be destroyed before hash is destroyed.
+ *
+ * @return NULL if fails(ENOMEM).
+ */
+YYEXPORT struct yhash_cursor *
+yhash_cursor_create(struct yhash *);
+
+/**
+ * Close cursor.
+ */
+YYEXPORT void
+yhash_cursor_destroy(struct yhash_cursor *);
+
+/**
+ * Get item at cursor and move cursor to next item.
+ *
+ * @param key NULLable. Key in the hash.
+ * @param value NULLable. Value in the hash.
+ * @return 0 if success. -ENOENT if there is no more item.
+ */
+YYEXPORT int
+yhash_cursor_next(struct yhash_cursor *, const void **key, void **value);
+
+/******************************************************************************
+ *
+ * Statistics
+ *
+ *****************************************************************************/
+/** Number of bins of histograms in @ref yhash_stat */
+#define YHASH_STAT_HIST_SZ 16
+
+/**
+ * Statistics of hash.
+ * Counters and rehash events are collected only if library is built with
+ *   @c CONFIG_HASH_STAT(configure --with-hash-stat). Otherwise, nothing is
+ *   collected and there is no cost at hash operations.
+ * Last bin of histogram counts all values larger than or equal to
+ *   @c YHASH_STAT_HIST_SZ - 1.
+ */
+struct yhash_stat {
+	uint64_t nget; /**< number of get. */
+	uint64_t nget_miss; /**< number of get whose key is not found. */
+	uint64_t nset; /**< number of set(add or replace). */
+	uint64_t nremove; /**< number of remove whose key is found. */
+	/** Number of rehash(remapping) events. Promotion from small table
+	 * to engine is also counted. */
+	uint32_t nrehash;
+	/** Total and maximum duration(ns) of rehash events.
+	 * Incremental remapping of chaining hash is done at following
+	 *   operations. So, only the part done at the event is measured. */
+	uint64_t rehash_ns, rehash_max_ns;
+	uint32_t sz; /**< number of items */
+	/** Number of buckets(chaining) or slots(others) */
+	uint32_t cap;
+	double load; /**< load factor. sz / cap */
+	/** Number of buckets having i items. Only for chaining hash. */
+	uint32_t chain[YHASH_STAT_HIST_SZ];
+	/**
+	 * Number of items found at i-th probing.
+	 * - chaining: position in the bucket.
+	 * - open addressing: number of groups visited before the group of item.
+	 * - small table: position in the table.
+	 */
+	uint32_t probe[YHASH_STAT_HIST_SZ];
+};
+
+/**
+ * Get statistics of hash.
+ *
+ * @return 0 if success. @c -ENOTSUP if library is built without
+ *   @c CONFIG_HASH_STAT.
+ */
+YYEXPORT int
+yhash_stat(const struct yhash *, struct yhash_stat *);
+
+/**
+ * Print statistics of hash with bar graph of probe length histogram(and
+ *   chain length histogram at chaining hash). See @ref ystpr_bargraph.
+ *
+ * @param fd File to write.
+ * @return 0 if success. @c -errno if fails. @c -ENOTSUP if library is built
+ *   without @c CONFIG_HASH_STAT.
+ */
+YYEXPORT int
+yhash_stat_print(const struct yhash *, int fd);
@@ -44,6 +44,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <string.h>
 #include "ylistl.h"
 
 /** Hash function type */
@@ -60,6 +61,16 @@ typedef int (*yhashl_keyeq_t)(const void *, const void *);
 #define YHASHL_HFUNC_PTR ((yhashl_hfunc_t)(void *)1)
 /** Default hash function for string. */
 #define YHASHL_HFUNC_STR ((yhashl_hfunc_t)(void *)2)
+/**
+ * Fast(wyhash-like) hash function for pointer and number.
+ * Seed is chosen randomly for each hash.
+ */
+#define YHASHL_HFUNC_FAST_PTR ((yhashl_hfunc_t)(void *)3)
+/**
+ * Fast(wyhash-like) hash function for string.
+ * Seed is chosen randomly for each hash, to resist collision attacks.
+ */
+#define YHASHL_HFUNC_FAST_STR ((yhashl_hfunc_t)(void *)4)
 /** Default key equal-function for pointer and number */
 #define YHASHL_KEYEQ_PTR ((yhashl_keyeq_t)(void *)1)
 /** Default key equal-function for string */
@@ -88,6 +99,13 @@ struct yhashl {
 	uint32_t sz;
 	yhashl_hfunc_t h;
 	yhashl_keyeq_t keq;
+	uint64_t seed; /* Used by YHASHL_HFUNC_FAST_XXX */
+	/* Used only while incremental remapping is in progress.
+	 * Buckets of @c oldmap in [0, migidx) are already moved to @c map.
+	 */
+	struct ylistl_link *oldmap;
+	uint8_t oldmapbits;
+	uint32_t migidx;
 	/* @endcond */
 };
 
@@ -100,6 +118,107 @@ yhashl_hmapsz(const struct yhashl *h) {
 	return 1 << h->mapbits;
 }
 
+/**
+ * Fast non-cryptographic 64-bit hash(wyhash-like) of @p len bytes.
+ * Result is NOT same on machines having different endianness.
+ */
+YYEXPORT uint64_t
+yhashl_fast(const void *data, size_t len, uint64_t seed);
+
+/**
+ * Same with @ref yhashl_fast for 8-bytes integer value. But faster.
+ */
+YYEXPORT uint64_t
+yhashl_fast_u64(uint64_t v, uint64_t seed);
+
+/**
+ * Get new random seed for @ref yhashl_fast.
+ * Every call returns different value.
+ */
+YYEXPORT uint64_t
+yhashl_new_seed(void);
+
+/**
+ * Get 32bit hash value of @p key with hash function that may be one of
+ *   predefined @c YHASHL_HFUNC_FAST_XXX.
+ *
+ * @param seed Used only for @c YHASHL_HFUNC_FAST_XXX.
+ */
+static YYINLINE uint32_t
+yhashl_hv32(yhashl_hfunc_t hfunc, uint64_t seed, const void *key) {
+	if (YHASHL_HFUNC_FAST_STR == hfunc)
+		return (uint32_t)yhashl_fast(
+			key, strlen((const char *)key), seed);
+	if (YHASHL_HFUNC_FAST_PTR == hfunc)
+		return (uint32_t)yhashl_fast_u64((uintptr_t)key, seed);
+	return (*hfunc)(key);
+}
+
+/**
+ * Is incremental remapping(See @ref yhashl_hremap2) in progress?
+ */
+static YYINLINE bool
+yhashl_is_remapping(const struct yhashl *h) {
+	return !!h->oldmap;
+}
+
+/**
+ * Get 32bit hash value of @p key used in the hash.
+ */
+static YYINLINE uint32_t
+yhashl_hash(const struct yhashl *h, const void *key) {
+	return yhashl_hv32(h->h, h->seed, key);
+}
+
+/* @cond */
+/*
+ * Bucket index of hash value @p hv32 at map of 2^@p bits buckets.
+ * Hash functions given by user may be poor(ex. identity for integer key).
+ *   So, hash value is mixed(Fibonacci hashing) and upper bits are used.
+ * Index at smaller map is always prefix of the one at larger map.
+ */
+static YYINLINE uint32_t
+yhashl_bidx___(uint32_t hv32, uint32_t bits) {
+	return (uint32_t)(hv32 * 0x9E3779B9U) >> (32 - bits);
+}
+
+/* Bucket where node having hash value @p hv32 is at now */
+static YYINLINE struct ylistl_link *
+yhashl_hbucket___(const struct yhashl *h, uint32_t hv32) {
+	uint32_t ob;
+	if (YYunlikely(h->oldmap)) {
+		ob = yhashl_bidx___(hv32, h->oldmapbits);
+		if (ob >= h->migidx)
+			return &h->oldmap[ob];
+	}
+	return &h->map[yhashl_bidx___(hv32, h->mapbits)];
+}
+
+/* Number of buckets of new map that are ready to use. */
+static YYINLINE uint32_t
+yhashl_nready___(const struct yhashl *h) {
+	if (!h->oldmap)
+		return yhashl_hmapsz(h);
+	return h->mapbits > h->oldmapbits
+		? h->migidx << (h->mapbits - h->oldmapbits)
+		: (h->migidx + (1 << (h->oldmapbits - h->mapbits)) - 1)
+			>> (h->oldmapbits - h->mapbits);
+}
+
+/* Number of buckets to visit for iteration. */
+static YYINLINE uint32_t
+yhashl_nbuckets___(const struct yhashl *h) {
+	return yhashl_nready___(h)
+		+ (h->oldmap ? (uint32_t)1 << h->oldmapbits : 0);
+}
+
+static YYINLINE struct ylistl_link *
+yhashl_bucket___(const struct yhashl *h, uint32_t i) {
+	uint32_t nready = yhashl_nready___(h);
+	return i < nready ? &h->map[i] : &h->oldmap[i - nready];
+}
+/* @endcond */
+
 /** Number of items(nodes) in hash */
 static YYINLINE uint32_t
 yhashl_sz(const struct yhashl *h) {
@@ -131,7 +250,8 @@ YYEXPORT int
 yhashl_init(struct yhashl *, yhashl_hfunc_t hfunc, yhashl_keyeq_t keyeq);
 
 /**
- * @param hfunc NULLable. Default is @ref YHASHL_HFUNC_PTR
+ * @param hfunc NULLable. Default is @ref YHASHL_HFUNC_PTR.
+ *   Predefined @c YHASHL_HFUNC_XXX can be used.
  * @param keqfunc NULLable. Default is @ref YHASHL_KEYEQ_PTR
  * @param initbits <= 32. 2 ^ initbits is used as initial map size.
  */
@@ -152,12 +272,39 @@ yhashl_clean(struct yhashl *);
 
 /**
  * Change hash map size.
+ * All nodes are moved to new map before return.
+ * If incremental remapping is in progress, it is completed first.
  *
  * @return 0 for success othersize -errno
  */
 YYEXPORT int
 yhashl_hremap(struct yhashl *, u32 mapbits);
 
+/**
+ * Same with @ref yhashl_hremap if @p incremental is FALSE.
+ * Otherwise, only new map is allocated and old map is kept. Then,
+ *   nodes are moved to new map little by little at every
+ *   @ref yhashl_set(adding new node). Removing doesn't move nodes. So,
+ *   hash that is only shrinking should use @ref yhashl_hremap_step.
+ * So, cost of remapping is amortized, and latency of one operation is
+ *   bounded regardless of hash size.
+ * @ref yhashl_hremap_step can be used to move nodes explicitly.
+ *
+ * @return 0 for success othersize -errno
+ */
+YYEXPORT int
+yhashl_hremap2(struct yhashl *, u32 mapbits, bool incremental);
+
+/**
+ * Move nodes in at most @p nbuckets buckets of old map to new map.
+ * Nothing happens if incremental remapping is not in progress.
+ *
+ * @return Number of buckets of old map that are not moved yet.
+ * 0 means remapping is done.
+ */
+YYEXPORT uint32_t
+yhashl_hremap_step(struct yhashl *, uint32_t nbuckets);
+
 /**
  * Key is ALWAYS stored by SHALLOW-COPY.
  * If node having same key is found, then key is NOT replaced.
@@ -170,6 +317,18 @@ yhashl_hremap(struct yhashl *, u32 mapbits);
 YYEXPORT struct yhashl_node *
 yhashl_set(struct yhashl *h, void *key, struct yhashl_node *);
 
+/**
+ * Same with @ref yhashl_set. But hash value of @p key is given.
+ *
+ * @param hv32 Hash value of @p key. See @ref yhashl_hash
+ */
+YYEXPORT struct yhashl_node *
+yhashl_set2(
+	struct yhashl *h,
+	void *key,
+	struct yhashl_node *,
+	uint32_t hv32);
+
 /**
  * @p n should be node in hash @p h. If it's not, behavior is not defined.
  */
@@ -191,14 +350,65 @@ YYEXPORT struct yhashl_node *
 yhashl_get(const struct yhashl *h, const void *key);
 
 /**
- * Visit all hash nodes
+ * Same with @ref yhashl_get. But hash value of @p key is given.
+ *
+ * @param hv32 Hash value of @p key. See @ref yhashl_hash
+ * @return NULL if not found
+ */
+YYEXPORT struct yhashl_node *
+yhashl_get2(const struct yhashl *h, const void *key, uint32_t hv32);
+
+/**
+ * Get histograms of chain length and probe length.
+ * @p chain[i] is number of buckets having @p i nodes.
+ * @p probe[i] is number of nodes at @p i-th position(0-based) in its bucket.
+ *   That is, node is found after @p i + 1 key comparisons.
+ * Last bin(@p n - 1) counts all values larger than or equal to @p n - 1.
+ * Buckets of old map that are already migrated are not counted.
+ *
+ * @param chain Array having @p n elements. NULL to skip.
+ * @param probe Array having @p n elements. NULL to skip.
+ * @param n Number of bins. It should be larger than 0.
+ * @return Number of buckets counted.
+ */
+YYEXPORT uint32_t
+yhashl_hist(
+	const struct yhashl *h,
+	uint32_t *chain,
+	uint32_t *probe,
+	uint32_t n);
+
+/**
+ * Bring bucket of hash value @p hv32 to cache.
+ * This can be used to overlap memory latency of several lookups.
+ */
+static YYINLINE void
+yhashl_prefetch(const struct yhashl *h, uint32_t hv32) {
+	__builtin_prefetch(yhashl_hbucket___(h, hv32));
+}
+
+/**
+ * Bring first node in the bucket of hash value @p hv32 to cache.
+ * Bucket is read here. So, @ref yhashl_prefetch should be called before.
+ */
+static YYINLINE void
+yhashl_prefetch_node(const struct yhashl *h, uint32_t hv32) {
+	struct ylistl_link *hd = yhashl_hbucket___(h, hv32);
+	if (hd->next != hd)
+		__builtin_prefetch(hd->next);
+}
+
+/**
+ * Visit all hash nodes.
+ * Hash should not be modified during iteration, except for removing
+ *   current node at @ref yhashl_foreach_safe.
  *
  * @param h (struct yhashl *)
  * @param cur (struct yhashl_node *) Cursor
  */
 #define yhashl_foreach(h, cur)						\
-	for (unsigned int i___ = 0; i___ < yhashl_hmapsz(h); i___++)	\
-		ylistl_foreach_item(cur, &(h)->map[i___], 		\
+	for (unsigned int i___ = 0; i___ < yhashl_nbuckets___(h); i___++)\
+		ylistl_foreach_item(cur, yhashl_bucket___(h, i___),	\
 			struct yhashl_node, lk)
 
 /**
@@ -209,6 +419,6 @@ yhashl_get(const struct yhashl *h, const void *key);
  * @param tmp (struct yhashl_node *) Temporary storage.
  */
 #define yhashl_foreach_safe(h, cur, tmp)				\
-	for (unsigned int i___ = 0; i___ < yhashl_hmapsz(h); i___++)	\
-		ylistl_foreach_item_safe(cur, tmp, &(h)->map[i___],	\
+	for (unsigned int i___ = 0; i___ < yhashl_nbuckets___(h); i___++)\
+		ylistl_foreach_item_safe(cur, tmp, yhashl_bucket___(h, i___),\
 			struct yhashl_node, lk)
@@ -46,6 +46,30 @@
 /** Predefined function ID. 'free()' function for 'malloc()' */
 #define YLRU_PREDEFINED_FREE ((void (*)(void *))1)
 
+/** Eviction policies used at @c ylruX_create2 */
+enum {
+	/** Least recently used. This is default. */
+	YLRU_POLICY_LRU = 0,
+	/**
+	 * CLOCK(second chance). Hit by @ref ylru_peek just sets reference
+	 *   bit of data. There is no list manipulation.
+	 */
+	YLRU_POLICY_CLOCK,
+	/**
+	 * S3-FIFO. New data goes to small FIFO(10% of cache) and is moved to
+	 *   main FIFO only if it is accessed again. So, data accessed once
+	 *   (ex. by scan) doesn't flush frequently used data.
+	 */
+	YLRU_POLICY_S3FIFO,
+	/**
+	 * W-TinyLFU. Small LRU window(1% of cache) in front of segmented LRU.
+	 *   Data leaving window is admitted only if it is accessed more
+	 *   frequently than victim. Frequency is estimated by count-min
+	 *   sketch, and includes history of data not in the cache.
+	 */
+	YLRU_POLICY_WTINYLFU,
+};
+
 /** lru object */
 struct ylru;
 
@@ -70,6 +94,19 @@ ylrui_create(
 	void *(*datacreate)(const void *key),
 	uint32_t (*datasize)(const void *));
 
+/**
+ * @ref ylrui_create with eviction policy.
+ *
+ * @param policy One of @c YLRU_POLICY_xxx.
+ */
+YYEXPORT struct ylru *
+ylrui_create2(
+	uint32_t maxsz,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	uint32_t (*datasize)(const void *),
+	int policy);
+
 
 /**
  * Create lru cache that uses string value as key.
@@ -82,6 +119,18 @@ ylrus_create(
 	void *(*datacreate)(const void *key),
 	uint32_t (*datasize)(const void *));
 
+/**
+ * @ref ylrus_create with eviction policy.
+ * @see ylrui_create2
+ */
+YYEXPORT struct ylru *
+ylrus_create2(
+	uint32_t maxsz,
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	uint32_t (*datasize)(const void *),
+	int policy);
+
 /**
  * Create lru cache that uses string value as key.
  * See @ref ylrui_create and @ref yhasho_create in {@link yhash.h}
@@ -99,6 +148,24 @@ ylruo_create(
 	int (*keycmp)(const void *, const void *),
 	uint32_t (*hfunc)(const void *key));
 
+/**
+ * @ref ylruo_create with eviction policy.
+ * @see ylrui_create2
+ */
+YYEXPORT struct ylru *
+ylruo_create2(
+	uint32_t maxsz,
+	/* functions to handle cache data */
+	void (*datafree)(void *),
+	void *(*datacreate)(const void *key),
+	uint32_t  (*datasize)(const void *),
+	/* functions to handle key object */
+	void (*keyfree)(void *),
+	int (*keycopy)(const void **newkey, const void *),
+	int (*keycmp)(const void *, const void *),
+	uint32_t (*hfunc)(const void *key),
+	int policy);
+
 /**
  * Create empty lru cache that has same attributes with given one.
  * @see yhash_create
@@ -124,6 +191,9 @@ ylru_destroy(struct ylru *);
 
 /**
  * Put data to lru cache.
+ * If key already exists, data is replaced(and old one is freed).
+ * At @ref YLRU_POLICY_WTINYLFU, data may be evicted later without being
+ *   admitted to main area of cache.
  *
  * @param key Key
  * @param data Data
@@ -136,6 +206,9 @@ ylru_put(struct ylru *, const void *key, void *data);
  * Get data from LRU cache.
  * It is important to note that value is remove from cache.
  * So, after using it, user SHOULD put it again to caching it again.
+ * Access history of taken out data is kept at @ref YLRU_POLICY_S3FIFO and
+ *   @ref YLRU_POLICY_WTINYLFU. So, putting it again is treated as
+ *   re-access.
  *
  * @param data 'NULL' is NOT allowed.
  * @param key Key value of data to get.
@@ -146,6 +219,17 @@ ylru_put(struct ylru *, const void *key, void *data);
 YYEXPORT int
 ylru_get(struct ylru *, void **data, const void *key);
 
+/**
+ * Get data from LRU cache. Unlike @ref ylru_get, data is kept in the cache
+ *   and is valid until cache is modified.
+ * This is counted as access to the data by eviction policy.
+ * Data newly created by @c datacreate is put to the cache.
+ *
+ * @see ylru_get
+ */
+YYEXPORT int
+ylru_peek(struct ylru *, void **data, const void *key);
+
 /**
  * Get size of cached data.
  * This is based on @c datasize function passed when cache object is created.
@@ -0,0 +1,196 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+/**
+ * @file yroaring.h
+ * @brief Header file to use compressed bitmap(roaring bitmap) integer set.
+ *
+ * Set of 32bit unsigned integers. This is alternative of integer set
+ *   (@ref yseti_create) for dense integer ids(ex. vertex ids of graph).
+ * Value is split into upper 16 bits(container key) and lower 16 bits.
+ *   Lower 16 bits of values having same key are kept in one container.
+ *   Type of container is decided by density of values.
+ * - array: sorted array of up to 4096 values.
+ * - bitmap: 2^16 bits(8KB).
+ * - run: sorted array of runs(consecutive values). See @ref yroaring_optimize.
+ *
+ * Set operations work container by container. Operations between bitmap
+ *   containers use SIMD(SSE2) if it is available.
+ */
+
+#pragma once
+
+#include "ydef.h"
+
+/** Roaring bitmap object */
+struct yroaring;
+
+/**
+ * Create empty set.
+ *
+ * @return NULL if fails(ENOMEM).
+ */
+YYEXPORT struct yroaring *
+yroaring_create(void);
+
+/**
+ * Create deep copy of @p r.
+ *
+ * @return NULL if fails(ENOMEM).
+ */
+YYEXPORT struct yroaring *
+yroaring_clone(const struct yroaring *r);
+
+YYEXPORT void
+yroaring_destroy(struct yroaring *r);
+
+/**
+ * Remove all values.
+ */
+YYEXPORT void
+yroaring_clear(struct yroaring *r);
+
+/**
+ * @return 1 if @p v is added. 0 if @p v is already in the set.
+ *   @c -ENOMEM if fails.
+ */
+YYEXPORT int
+yroaring_add(struct yroaring *r, uint32_t v);
+
+/**
+ * @return 1 if @p v is removed. 0 if @p v is not in the set.
+ *   @c -ENOMEM if fails(Run may be split into two).
+ */
+YYEXPORT int
+yroaring_remove(struct yroaring *r, uint32_t v);
+
+YYEXPORT bool
+yroaring_has(const struct yroaring *r, uint32_t v);
+
+/**
+ * Number of values in the set(cardinality).
+ */
+YYEXPORT uint64_t
+yroaring_card(const struct yroaring *r);
+
+/**
+ * Get values in ascending order.
+ *
+ * @param buf Buffer to store values.
+ * @param bufsz Number of elements of @p buf.
+ * @return Number of values stored at @p buf.
+ */
+YYEXPORT uint32_t
+yroaring_values(const struct yroaring *r, uint32_t *buf, uint32_t bufsz);
+
+/**
+ * Convert containers to run containers if it is smaller, and vice versa.
+ * Call this after set is built, if it has long runs of consecutive values.
+ *
+ * @return 0 if success. @c -ENOMEM if fails. Set is still valid even if
+ *   it fails.
+ */
+YYEXPORT int
+yroaring_optimize(struct yroaring *r);
+
+/**
+ * Do two sets have same values? Type of containers doesn't matter.
+ */
+YYEXPORT bool
+yroaring_equal(const struct yroaring *a, const struct yroaring *b);
+
+/**
+ * Create new set that is intersection of two sets.
+ *
+ * @return NULL if fails(ENOMEM).
+ */
+YYEXPORT struct yroaring *
+yroaring_and(const struct yroaring *a, const struct yroaring *b);
+
+/**
+ * Create new set that is union of two sets.
+ *
+ * @return NULL if fails(ENOMEM).
+ */
+YYEXPORT struct yroaring *
+yroaring_or(const struct yroaring *a, const struct yroaring *b);
+
+/**
+ * Create new set that is difference of two sets(@p a - @p b).
+ *
+ * @return NULL if fails(ENOMEM).
+ */
+YYEXPORT struct yroaring *
+yroaring_andnot(const struct yroaring *a, const struct yroaring *b);
+
+/**
+ * @p a = @p a & @p b.
+ *
+ * @return 0 if success. @c -ENOMEM if fails. Then @p a is still valid but
+ *   may be partially updated.
+ */
+YYEXPORT int
+yroaring_and_inplace(struct yroaring *a, const struct yroaring *b);
+
+/**
+ * @p a = @p a | @p b. See @ref yroaring_and_inplace.
+ */
+YYEXPORT int
+yroaring_or_inplace(struct yroaring *a, const struct yroaring *b);
+
+/**
+ * @p a = @p a - @p b. See @ref yroaring_and_inplace.
+ */
+YYEXPORT int
+yroaring_andnot_inplace(struct yroaring *a, const struct yroaring *b);
+
+/**
+ * Cardinality of intersection of two sets. Result set is not created.
+ */
+YYEXPORT uint64_t
+yroaring_and_card(const struct yroaring *a, const struct yroaring *b);
+
+/**
+ * Cardinality of union of two sets. Result set is not created.
+ */
+YYEXPORT uint64_t
+yroaring_or_card(const struct yroaring *a, const struct yroaring *b);
+
+/**
+ * Cardinality of difference of two sets. Result set is not created.
+ */
+YYEXPORT uint64_t
+yroaring_andnot_card(const struct yroaring *a, const struct yroaring *b);
@@ -195,7 +195,7 @@ yset_clone(const yset_t s) {
 
 /**
  * Create new set which is insection of two sets.
- * Elements are copied from source set.
+ * Elements are copied from source set. Smaller set is visited.
  *
  * @return newly created @c yset for success, otherwise NULL.
  */
@@ -204,7 +204,6 @@ yset_intersect(const yset_t, const yset_t);
 
 /**
  * Create new set which is union of two sets.
- * (NOT IMPLEMENTED YET)
  * @see yset_intersect
  */
 YYEXPORT yset_t
@@ -212,8 +211,46 @@ yset_union(const yset_t, const yset_t);
 
 /**
  * Create new set which is diff of two sets.
- * (NOT IMPLEMENTED YET)
  * @see yset_intersect
  */
 YYEXPORT yset_t
 yset_diff(const yset_t, const yset_t);
+
+/**
+ * Number of elements in both sets. Result set is not created, and nothing
+ *   is allocated. Smaller set is visited.
+ *
+ * @return 0 if sets are not same type.
+ */
+YYEXPORT uint32_t
+yset_intersect_count(const yset_t, const yset_t);
+
+/**
+ * @p s0 = @p s0 & @p s1.
+ * Every element of @p s0 is visited, because elements that are not in
+ *   @p s1 are removed from @p s0. Nothing is allocated.
+ *
+ * @return 0 if success. @c -EINVAL if sets are not same type.
+ */
+YYEXPORT int
+yset_intersect_inplace(yset_t s0, const yset_t s1);
+
+/**
+ * @p s0 = @p s0 | @p s1.
+ * Elements of @p s1 are visited and added to @p s0.
+ *
+ * @return 0 if success. @c -EINVAL if sets are not same type.
+ *   @c -ENOMEM if fails to add. Then some elements may be added.
+ */
+YYEXPORT int
+yset_union_inplace(yset_t s0, const yset_t s1);
+
+/**
+ * @p s0 = @p s0 - @p s1. Smaller set is visited.
+ * @p s0 may be shrunk(rehashed) after elements are removed. It allocates
+ *   new table. But, if it fails, @p s0 just keeps its table.
+ *
+ * @return 0 if success. @c -EINVAL if sets are not same type.
+ */
+YYEXPORT int
+yset_diff_inplace(yset_t s0, const yset_t s1);
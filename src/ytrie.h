@@ -49,6 +49,32 @@
 /** Trie object */
 struct ytrie;
 
+/** Options used at @ref ytrie_create2 */
+enum {
+	/**
+	 * Use adaptive radix tree(ART) engine instead of 4-bit trie.
+	 * Node has 4, 16, 48 or 256 children adaptively, and single path is
+	 *   compressed into one node. So, it uses far less memory and
+	 *   lookup is faster, especially for long keys sharing prefix.
+	 * But, address of value returned by @ref ytrie_getref is valid only
+	 *   until trie is modified.
+	 */
+	YTRIE_art = 0x1,
+	/**
+	 * Concurrent mode for read-mostly trie. This implies @ref YTRIE_art.
+	 * Readers(get, iterate, auto complete and so on) don't take any lock
+	 *   and don't do atomic read-modify-write. Writers(insert, remove
+	 *   and reset) are serialized by lock. They copy nodes on the path
+	 *   of the key and publish them at once. So, readers always see
+	 *   consistent trie.
+	 * Replaced nodes and values are freed after all readers that may
+	 *   see them are done(epoch based reclamation).
+	 * Value SHOULD NOT be changed via @ref ytrie_getref. And trie SHOULD
+	 *   NOT be used by other threads at @ref ytrie_destroy.
+	 */
+	YTRIE_concurrent = 0x2,
+};
+
 /**
  * Get pointer of value. So, user can edit trie value directly.
  * This is dangerous function. So DO NOT use it if possible.
@@ -64,6 +90,9 @@ ytrie_getref(struct ytrie *, const uint8_t *key, uint32_t keysz);
 
 /**
  * Get value.
+ * At concurrent mode, value may be freed by other thread right after this
+ *   returns, if trie has @c vfree. To use the value safely, call this
+ *   between @ref ytrie_read_begin and @ref ytrie_read_end.
  *
  * @param key Key of trie
  * @param keysz Key size
@@ -119,8 +148,34 @@ ytrie_insert(
 YYEXPORT struct ytrie *
 ytrie_create(void (*vfree)(void *));
 
+/**
+ * @ref ytrie_create with options.
+ *
+ * @param opt Bitwise-OR of @c YTRIE_xxx options.
+ */
+YYEXPORT struct ytrie *
+ytrie_create2(void (*vfree)(void *), int opt);
+
+/**
+ * @ref ytrie_create2 for scored trie. This implies @ref YTRIE_art.
+ * Each node keeps max score of values in its subtree. So,
+ *   @ref ytrie_auto_complete_top can skip subtrees having low scores.
+ * Score of value SHOULD NOT be changed while value is in the trie. To
+ *   change it, insert new value with same key.
+ *
+ * @param vscore Function giving score of value.
+ */
+YYEXPORT struct ytrie *
+ytrie_create_scored(
+	void (*vfree)(void *),
+	int opt,
+	uint32_t (*vscore)(const void *v));
+
 /**
  * Reset contents of trie. Trie becomes empty.
+ * Nodes of 4-bit trie are allocated in chunks, and memory of removed
+ *   nodes is reused by the trie. The memory is returned here(and at
+ *   @ref ytrie_destroy) chunk by chunk.
  */
 YYEXPORT void
 ytrie_reset(struct ytrie *);
@@ -142,6 +197,28 @@ ytrie_destroy(struct ytrie *);
 YYEXPORT int
 ytrie_remove(struct ytrie *, const uint8_t *key, uint32_t keysz);
 
+/**
+ * Get number of values in the trie.
+ */
+YYEXPORT uint32_t
+ytrie_sz(const struct ytrie *);
+
+/**
+ * Begin read-side critical section for concurrent mode. It can be nested.
+ * Values got in the section are not freed until @ref ytrie_read_end.
+ * Writers can be used in the section. But, memory is not reclaimed by
+ *   them.
+ * This is not per-trie. Section covers all concurrent tries.
+ */
+YYEXPORT void
+ytrie_read_begin(void);
+
+/**
+ * End read-side critical section.
+ */
+YYEXPORT void
+ytrie_read_end(void);
+
 /**
  * Get function used to free trie value.
  *
@@ -163,6 +240,7 @@ ytrie_equal(const struct ytrie *, const struct ytrie *,
 
 /**
  * Copy trie. Key is deep-copied. And value is copied by using @p clonev.
+ * Options of @p src(ex. engine) are also copied to @p dst.
  *
  * @param dst Destination trie object where value is copied to.
  * All existing values will be removed and filled with new values.
@@ -170,7 +248,8 @@ ytrie_equal(const struct ytrie *, const struct ytrie *,
  * @param tag Tag object passed to @p clonev.
  * @param clonev Function used to copy trie value.
  * It should returns NULL if fails.
- * @return 0 if success. Otherwise @c -errno.
+ * @return 0 if success. Otherwise @c -errno. At failure, @p dst is
+ *   emptied.
  */
 YYEXPORT int
 ytrie_copy(
@@ -185,6 +264,7 @@ ytrie_copy(
  * @param tag Tag object passed to @p clonev.
  * @param clonev Callback function cloning element.
  * It should returns NULL if fails.
+ * @return NULL if fails.
  */
 YYEXPORT struct ytrie *
 ytrie_clone(
@@ -212,3 +292,101 @@ ytrie_auto_complete(
 	uint32_t keyprefixsz,
 	uint8_t *buf,
 	uint32_t bufsz);
+
+/**
+ * Find the longest key that is prefix of @p key. @p key itself is also
+ *   candidate.
+ * At concurrent mode, see @ref ytrie_get for lifetime of returned value.
+ *
+ * @param key Key to match
+ * @param keysz Size of @p key
+ * @param[out] matchlen NULLable. Length of found key.
+ * @return Value of found key. NULL if there is no matching key.
+ */
+YYEXPORT void *
+ytrie_longest_prefix(
+	struct ytrie *,
+	const uint8_t *key,
+	uint32_t keysz,
+	uint32_t *matchlen);
+
+/**
+ * Cursor visiting keys in range [start, end) in order of key.
+ * Cursor keeps key where visiting is resumed, not node of trie. So, trie
+ *   can be modified between @ref ytrie_cursor_next calls.
+ * Members are private. Use @ref ytrie_cursor_init to initialize.
+ */
+struct ytrie_cursor {
+	uint8_t lo[YTRIE_MAX_KEY_LEN];
+	uint32_t losz;
+	uint8_t hi[YTRIE_MAX_KEY_LEN];
+	uint32_t hisz;
+	int flags;
+};
+
+/**
+ * Initialize cursor.
+ *
+ * @param start NULLable. Keys larger than or equal to @p start are
+ *   visited. NULL means from the first key.
+ * @param startsz Size of @p start
+ * @param end NULLable. Keys smaller than @p end are visited. NULL means
+ *   to the last key.
+ * @param endsz Size of @p end
+ * @return 0 if success. @c -EINVAL if key is longer than
+ *   @ref YTRIE_MAX_KEY_LEN.
+ */
+YYEXPORT int
+ytrie_cursor_init(
+	struct ytrie_cursor *,
+	const uint8_t *start,
+	uint32_t startsz,
+	const uint8_t *end,
+	uint32_t endsz);
+
+/**
+ * Visit next keys of cursor in order of key.
+ * Only nodes in the range are visited. Next call resumes right after the
+ *   last visited key.
+ *
+ * @param tag Tag passed to @p cb.
+ * @param limit Maximum number of keys visited by this call. 0 means no
+ *   limit.
+ * @param cb Callback called with full key. If it returns 0, visiting
+ *   stops after the key.
+ * @return Number of visited keys. 0 if there is no more key in range.
+ *   @c -errno if fails.
+ */
+YYEXPORT int
+ytrie_cursor_next(
+	struct ytrie *,
+	struct ytrie_cursor *,
+	void *tag,
+	uint32_t limit,
+	int (*cb)(void *tag, const uint8_t *key, uint32_t keysz, void *v));
+
+/**
+ * Visit @p k keys having the highest scores among keys starting with
+ *   @p keyprefix, in descending order of score. Order of keys having same
+ *   score is not defined.
+ * Trie SHOULD be created by @ref ytrie_create_scored.
+ *
+ * @param k Maximum number of keys to visit.
+ * @param tag Tag passed to @p cb.
+ * @param cb Callback called with full key. If it returns 0, visiting
+ *   stops.
+ * @return Number of visited keys. @c -errno if fails. @c -EINVAL if trie
+ *   isn't scored.
+ */
+YYEXPORT int
+ytrie_auto_complete_top(
+	struct ytrie *,
+	const uint8_t *keyprefix,
+	uint32_t keyprefixsz,
+	uint32_t k,
+	void *tag,
+	int (*cb)(void *tag,
+		  const uint8_t *key,
+		  uint32_t keysz,
+		  void *v,
+		  uint32_t score));
@@ -0,0 +1,317 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include "test.h"
+#ifdef CONFIG_TEST
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "ychash.h"
+#include "yhashl.h"
+#include "yhash.h"
+#include "yut.h"
+
+#define iptr(i) ((void *)(intptr_t)(i))
+
+static int
+strkey_copy(const void **newkey, const void *key) {
+	if (!(*newkey = ystrdup(key)))
+		return -ENOMEM;
+	return 0;
+}
+
+static void
+test_chash_basic(void) {
+	int i;
+	char buf[64];
+	void *v;
+	struct ychash *h = ychash_create(
+		YCHASH_MEM_FREE,
+		YCHASH_MEM_FREE,
+		&strkey_copy,
+		YHASHL_KEYEQ_STR,
+		YHASHL_HFUNC_STR);
+
+	/* Large enough to resize several times */
+	for (i = 0; i < 20000; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(1 == ychash_set(h, buf, ystrdup(buf)));
+	}
+	yassert(20000 == ychash_sz(h));
+	for (i = 0; i < 20000; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(!ychash_get(h, buf, &v) && !strcmp(buf, v));
+	}
+	yassert(-ENOENT == ychash_get(h, "key--1", &v));
+	/* overwrite */
+	for (i = 0; i < 20000; i += 2) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(0 == ychash_set(h, buf, ystrdup("new")));
+	}
+	yassert(20000 == ychash_sz(h));
+	for (i = 0; i < 20000; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(!ychash_get(h, buf, &v));
+		yassert(!strcmp(i & 1 ? buf : "new", v));
+	}
+	for (i = 0; i < 20000; i += 3) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(1 == ychash_remove(h, buf));
+		yassert(0 == ychash_remove(h, buf));
+	}
+	for (i = 0; i < 20000; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(!(i % 3) == !!ychash_get(h, buf, NULL));
+	}
+	ychash_destroy(h);
+}
+
+#define MT_NKEYS 4096
+#define MT_ITER 20000
+
+struct mtarg {
+	struct ychash *h;
+	int id;
+	int nthreads;
+};
+
+static void
+ivfree(void *v) {
+	/* Make use-after-free visible */
+	*(int *)v = -1;
+	yfree(v);
+}
+
+static void *
+ivalue(int i) {
+	int *v = ymalloc(sizeof(*v));
+	*v = i;
+	return v;
+}
+
+/*
+ * Keys in [0, MT_NKEYS / 2) are always in the hash. Their values are
+ *   replaced by writers. Others are set and removed by writers.
+ * Value of key 'k' is always 'k'.
+ */
+static void *
+mt_writer(void *arg) {
+	int i, k;
+	struct mtarg *a = arg;
+	for (i = 0; i < MT_ITER; i++) {
+		k = (i * a->nthreads + a->id) % MT_NKEYS;
+		if (k < MT_NKEYS / 2)
+			yassert(0 == ychash_set(a->h, iptr(k), ivalue(k)));
+		else if (ychash_remove(a->h, iptr(k)) <= 0)
+			ychash_set(a->h, iptr(k), ivalue(k));
+	}
+	return NULL;
+}
+
+static void *
+mt_reader(void *arg) {
+	int i, k;
+	void *v;
+	struct mtarg *a = arg;
+	for (i = 0; i < MT_ITER; i++) {
+		k = (i * 7 + a->id) % MT_NKEYS;
+		ychash_read_begin();
+		if (!ychash_get(a->h, iptr(k), &v))
+			yassert(k == *(int *)v);
+		else
+			yassert(k >= MT_NKEYS / 2);
+		ychash_read_end();
+	}
+	return NULL;
+}
+
+static void
+test_chash_mt(void) {
+	int i;
+	const int nwriters = 4;
+	const int nreaders = 4;
+	pthread_t thds[nwriters + nreaders];
+	struct mtarg args[nwriters + nreaders];
+	struct ychash *h = ychash_create(&ivfree, NULL, NULL, NULL, NULL);
+
+	for (i = 0; i < MT_NKEYS / 2; i++)
+		yassert(1 == ychash_set(h, iptr(i), ivalue(i)));
+	for (i = 0; i < nwriters + nreaders; i++) {
+		args[i].h = h;
+		args[i].id = i < nwriters ? i : i - nwriters;
+		args[i].nthreads = nwriters;
+		yassert(!pthread_create(&thds[i], NULL,
+			i < nwriters ? &mt_writer : &mt_reader, &args[i]));
+	}
+	for (i = 0; i < nwriters + nreaders; i++)
+		pthread_join(thds[i], NULL);
+	for (i = 0; i < MT_NKEYS / 2; i++)
+		yassert(!ychash_get(h, iptr(i), NULL));
+	ychash_destroy(h);
+}
+
+static void
+test_chash(void) {
+	test_chash_basic();
+	test_chash_mt();
+}
+
+TESTFN(chash)
+
+
+/*
+ * Scalability benchmark.
+ * ychash is compared with yhash protected by one global mutex.
+ */
+#define PERF_NKEYS (1024 * 1024)
+#define PERF_TOTAL_OPS (4 * 1024 * 1024)
+
+struct perfarg {
+	struct ychash *ch;
+	struct yhash *h;
+	pthread_mutex_t *m;
+	int rdpct; /* percentage of get */
+	int nops;
+	u32 seed;
+};
+
+static INLINE u32
+xorshift(u32 *s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+static void *
+perf_worker(void *arg) {
+	int i, op;
+	u32 k;
+	void *v;
+	struct perfarg *a = arg;
+	for (i = 0; i < a->nops; i++) {
+		k = xorshift(&a->seed) % PERF_NKEYS;
+		op = xorshift(&a->seed) % 100;
+		if (a->ch) {
+			if (op < a->rdpct)
+				ychash_get(a->ch, iptr(k), &v);
+			else if (op & 1)
+				ychash_set(a->ch, iptr(k), iptr(k));
+			else
+				ychash_remove(a->ch, iptr(k));
+		} else {
+			pthread_mutex_lock(a->m);
+			if (op < a->rdpct)
+				yhash_get(a->h, iptr(k), &v);
+			else if (op & 1)
+				yhash_set(a->h, iptr(k), iptr(k));
+			else
+				yhash_remove(a->h, iptr(k));
+			pthread_mutex_unlock(a->m);
+		}
+	}
+	return NULL;
+}
+
+static void
+perf_chash(void) {
+	int i, j, n, m;
+	u64 t;
+	pthread_t thds[64];
+	struct perfarg args[64];
+	pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	const int rdpcts[] = { 95, 50 };
+	const int nthds[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+	printf("chash: M ops/sec (%d keys, %d ops)\n",
+		PERF_NKEYS, PERF_TOTAL_OPS);
+	printf("%8s %8s %12s %12s\n",
+		"threads", "get(%)", "ychash", "yhash+mutex");
+	for (i = 0; i < yut_arrsz(rdpcts); i++) {
+		for (j = 0; j < yut_arrsz(nthds); j++) {
+			printf("%8d %8d", nthds[j], rdpcts[i]);
+			for (m = 0; m < 2; m++) {
+				struct ychash *ch = NULL;
+				struct yhash *h = NULL;
+				if (m)
+					h = yhashi_create2(NULL,
+						YHASH_fast_hash);
+				else
+					ch = ychash_create(
+						NULL, NULL, NULL, NULL, NULL);
+				/* Half of keys are in the hash */
+				for (n = 0; n < PERF_NKEYS; n += 2) {
+					if (m)
+						yhash_set(h, iptr(n), iptr(n));
+					else
+						ychash_set(ch, iptr(n),
+							iptr(n));
+				}
+				t = yut_current_time_us();
+				for (n = 0; n < nthds[j]; n++) {
+					args[n].ch = ch;
+					args[n].h = h;
+					args[n].m = &mtx;
+					args[n].rdpct = rdpcts[i];
+					args[n].nops =
+						PERF_TOTAL_OPS / nthds[j];
+					args[n].seed = n * 7919 + 1;
+					yassert(!pthread_create(&thds[n],
+						NULL, &perf_worker,
+						&args[n]));
+				}
+				for (n = 0; n < nthds[j]; n++)
+					pthread_join(thds[n], NULL);
+				t = yut_current_time_us() - t;
+				printf(" %12.2f",
+					(double)PERF_TOTAL_OPS / (t ? t : 1));
+				if (m)
+					yhash_destroy(h);
+				else
+					ychash_destroy(ch);
+			}
+			printf("\n");
+		}
+	}
+}
+
+PERFFN(chash)
+
+#endif /* CONFIG_TEST */
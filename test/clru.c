@@ -0,0 +1,368 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include "test.h"
+#ifdef CONFIG_TEST
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "yclru.h"
+#include "ylru.h"
+#include "yut.h"
+
+#define iptr(i) ((void *)(intptr_t)(i))
+
+static void *
+data_create(unused const void *key) {
+	int *i;
+	i = ymalloc(sizeof(*i));
+	*i = 10;
+	return i;
+}
+
+static u32
+data_size(unused const void *d) {
+	return sizeof(int);
+}
+
+static int *
+ivalue(int i) {
+	int *v = ymalloc(sizeof(*v));
+	*v = i;
+	return v;
+}
+
+static void
+test_clru_basic(int opt) {
+	int *pi;
+	struct yclru *c = yclrus_create(
+		sizeof(int) * 3,
+		1,
+		opt,
+		YCLRU_PREDEFINED_FREE,
+		NULL,
+		&data_size);
+
+	yassert(1 == yclru_get(c, (void **)&pi, "k000"));
+	yassert(!yclru_put(c, "k100", ivalue(100)));
+	yassert(sizeof(int) == yclru_sz(c));
+	/* Data is kept in the cache */
+	yassert(0 == yclru_get(c, (void **)&pi, "k100"));
+	yassert(100 == *pi);
+	yassert(sizeof(int) == yclru_sz(c));
+
+	yassert(!yclru_put(c, "k200", ivalue(200)));
+	yassert(!yclru_put(c, "k300", ivalue(300)));
+	yassert(sizeof(int) * 3 == yclru_sz(c));
+
+	/* [ 100 - 200 - 300 (newest) ] -> [ 200 - 300 - 100 ] */
+	yassert(0 == yclru_get(c, (void **)&pi, "k100"));
+	yassert(100 == *pi);
+	yassert(!yclru_put(c, "k400", ivalue(400)));
+	yassert(sizeof(int) * 3 == yclru_sz(c));
+	/* [ 300 - 100 - 400 ] */
+	yassert(1 == yclru_get(c, (void **)&pi, "k200"));
+	yassert(0 == yclru_get(c, (void **)&pi, "k300"));
+	yassert(300 == *pi);
+
+	/* Replace: [ 100 - 400 - 300 ] -> [ 400 - 300 - 100 ] */
+	yassert(!yclru_put(c, "k100", ivalue(101)));
+	yassert(sizeof(int) * 3 == yclru_sz(c));
+	yassert(0 == yclru_get(c, (void **)&pi, "k100"));
+	yassert(101 == *pi);
+	/* Put same data again */
+	yassert(!yclru_put(c, "k100", pi));
+	yassert(0 == yclru_get(c, (void **)&pi, "k100"));
+	yassert(101 == *pi);
+	yassert(!yclru_put(c, "k500", ivalue(500)));
+	yassert(1 == yclru_get(c, (void **)&pi, "k400"));
+
+	yassert(1 == yclru_remove(c, "k300"));
+	yassert(0 == yclru_remove(c, "k300"));
+	yassert(sizeof(int) * 2 == yclru_sz(c));
+	yassert(1 == yclru_get(c, (void **)&pi, "k300"));
+
+	yclru_reset(c);
+	yassert(0 == yclru_sz(c));
+	yassert(1 == yclru_get(c, (void **)&pi, "k100"));
+	yclru_destroy(c);
+
+	c = yclrus_create(
+		sizeof(int) * 3,
+		1,
+		opt,
+		YCLRU_PREDEFINED_FREE,
+		&data_create,
+		&data_size);
+	yassert(0 == yclru_get(c, (void **)&pi, "k000"));
+	yassert(10 == *pi);
+	yassert(sizeof(int) == yclru_sz(c));
+	yclru_destroy(c);
+}
+
+static void
+test_clru_sharded(int opt) {
+	int i, nhits;
+	void *v;
+	/* Cache size is larger than number of keys at each shard. */
+	struct yclru *c = yclrui_create(0, 8, opt, NULL, NULL, NULL);
+	for (i = 0; i < 1000; i++)
+		yassert(!yclru_put(c, iptr(i), iptr(i + 1)));
+	yassert(1000 == yclru_sz(c));
+	for (i = 0; i < 1000; i++) {
+		yassert(!yclru_get(c, &v, iptr(i)));
+		yassert(i + 1 == (intptr_t)v);
+	}
+	for (i = 0; i < 1000; i += 2)
+		yassert(1 == yclru_remove(c, iptr(i)));
+	yassert(500 == yclru_sz(c));
+	yclru_destroy(c);
+
+	/* Each shard keeps at most 4 */
+	c = yclrui_create(32, 8, opt, NULL, NULL, NULL);
+	for (i = 0; i < 1000; i++)
+		yassert(!yclru_put(c, iptr(i), iptr(i + 1)));
+	yassert(32 >= yclru_sz(c));
+	nhits = 0;
+	for (i = 0; i < 1000; i++) {
+		if (!yclru_get(c, &v, iptr(i))) {
+			yassert(i + 1 == (intptr_t)v);
+			nhits++;
+		}
+	}
+	yassert(nhits == (int)yclru_sz(c));
+	yclru_destroy(c);
+
+	/* Data is larger than size of a shard */
+	c = yclrui_create(8, 8, opt, NULL, NULL, &data_size);
+	yassert(-EINVAL == yclru_put(c, iptr(0), iptr(1)));
+	yclru_destroy(c);
+}
+
+#define MT_NKEYS 4096
+#define MT_ITER 20000
+
+struct mtarg {
+	struct yclru *c;
+	int id;
+};
+
+static void
+ivfree(void *v) {
+	/* Make use-after-free visible */
+	*(int *)v = -1;
+	yfree(v);
+}
+
+/*
+ * Value of key 'k' is always 'k'. Cache is smaller than key space.
+ * So, values are evicted and replaced while readers are using them.
+ */
+static void *
+mt_worker(void *arg) {
+	int i, k;
+	void *v;
+	struct mtarg *a = arg;
+	u32 seed = a->id * 7919 + 1;
+	for (i = 0; i < MT_ITER; i++) {
+		seed = seed * 1103515245 + 12345;
+		k = (seed >> 8) % MT_NKEYS;
+		switch ((seed >> 4) % 8) {
+		case 0:
+			yassert(!yclru_put(a->c, iptr(k), ivalue(k)));
+			break;
+		case 1:
+			yclru_remove(a->c, iptr(k));
+			break;
+		default:
+			yclru_read_begin();
+			if (!yclru_get(a->c, &v, iptr(k)))
+				yassert(k == *(int *)v);
+			else if (!(i % 4))
+				yassert(!yclru_put(a->c, iptr(k), ivalue(k)));
+			yclru_read_end();
+		}
+	}
+	return NULL;
+}
+
+static void
+test_clru_mt(int opt) {
+	int i;
+	const int nthreads = 8;
+	pthread_t thds[nthreads];
+	struct mtarg args[nthreads];
+	struct yclru *c = yclrui_create(
+		MT_NKEYS / 4, 4, opt, &ivfree, NULL, NULL);
+	for (i = 0; i < nthreads; i++) {
+		args[i].c = c;
+		args[i].id = i;
+		yassert(!pthread_create(&thds[i], NULL, &mt_worker, &args[i]));
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(thds[i], NULL);
+	yassert(MT_NKEYS / 4 >= yclru_sz(c));
+	yclru_destroy(c);
+}
+
+static void
+test_clru(void) {
+	int i;
+	const int opts[] = { 0, YCLRU_buffered_read };
+	for (i = 0; i < yut_arrsz(opts); i++) {
+		test_clru_basic(opts[i]);
+		test_clru_sharded(opts[i]);
+		test_clru_mt(opts[i]);
+	}
+}
+
+TESTFN(clru)
+
+
+/*
+ * Scalability benchmark.
+ * yclru is compared with ylru protected by one global mutex.
+ * Accesses are skewed. 90% of them are for 1/8 of keys.
+ * Missed key is put to the cache.
+ */
+#define PERF_NKEYS (64 * 1024)
+#define PERF_CACHESZ (PERF_NKEYS / 4)
+#define PERF_TOTAL_OPS (2 * 1024 * 1024)
+
+struct perfarg {
+	struct yclru *c;
+	struct ylru *l;
+	pthread_mutex_t *m;
+	int nops;
+	int nhits;
+	u32 seed;
+};
+
+static INLINE u32
+xorshift(u32 *s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+static void *
+perf_worker(void *arg) {
+	int i;
+	u32 k;
+	void *v;
+	struct perfarg *a = arg;
+	for (i = 0; i < a->nops; i++) {
+		k = xorshift(&a->seed);
+		k = k % 10
+			? xorshift(&a->seed) % (PERF_NKEYS / 8)
+			: xorshift(&a->seed) % PERF_NKEYS;
+		if (a->c) {
+			if (!yclru_get(a->c, &v, iptr(k)))
+				a->nhits++;
+			else
+				yclru_put(a->c, iptr(k), iptr(k));
+		} else {
+			pthread_mutex_lock(a->m);
+			/* ylru_get takes data out of cache. */
+			if (!ylru_get(a->l, &v, iptr(k)))
+				a->nhits++;
+			ylru_put(a->l, iptr(k), iptr(k));
+			pthread_mutex_unlock(a->m);
+		}
+	}
+	return NULL;
+}
+
+static void
+perf_clru(void) {
+	int j, n, m, nhits;
+	u64 t;
+	pthread_t thds[64];
+	struct perfarg args[64];
+	pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	const int nthds[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+	printf("clru: M ops/sec, hit(%%) (%d keys, cache %d, %d ops)\n",
+		PERF_NKEYS, PERF_CACHESZ, PERF_TOTAL_OPS);
+	printf("%8s %18s %18s %18s\n",
+		"threads", "ylru+mutex", "yclru", "yclru+buffered");
+	for (j = 0; j < yut_arrsz(nthds); j++) {
+		printf("%8d", nthds[j]);
+		for (m = 0; m < 3; m++) {
+			struct yclru *c = NULL;
+			struct ylru *l = NULL;
+			if (!m)
+				l = ylrui_create(PERF_CACHESZ, NULL, NULL, NULL);
+			else
+				c = yclrui_create(PERF_CACHESZ, 0,
+					2 == m ? YCLRU_buffered_read : 0,
+					NULL, NULL, NULL);
+			t = yut_current_time_us();
+			for (n = 0; n < nthds[j]; n++) {
+				args[n].c = c;
+				args[n].l = l;
+				args[n].m = &mtx;
+				args[n].nops = PERF_TOTAL_OPS / nthds[j];
+				args[n].nhits = 0;
+				args[n].seed = n * 7919 + 1;
+				yassert(!pthread_create(&thds[n],
+					NULL, &perf_worker, &args[n]));
+			}
+			nhits = 0;
+			for (n = 0; n < nthds[j]; n++) {
+				pthread_join(thds[n], NULL);
+				nhits += args[n].nhits;
+			}
+			t = yut_current_time_us() - t;
+			printf(" %10.2f %6.2f",
+				(double)PERF_TOTAL_OPS / (t ? t : 1),
+				(double)nhits * 100 / PERF_TOTAL_OPS);
+			if (l)
+				ylru_destroy(l);
+			else
+				yclru_destroy(c);
+		}
+		printf("\n");
+	}
+}
+
+PERFFN(clru)
+
+#endif /* CONFIG_TEST */
@@ -37,15 +37,285 @@
 #include "test.h"
 #ifdef CONFIG_TEST
 
+#include <stdio.h>
+#include <string.h>
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
 #include "ycrc.h"
+#include "yut.h"
+
+extern u32 crc32_slice(int slice, u32 crc, const u8 *data, u32 len);
+extern u16 crc16_slice(int slice, u16 crc, const u8 *data, u32 len);
+
+static const int _slices[] = { 1, 8, 16 };
+static const u32 _perfszs[] = { 8, 64, 512, 4096, 64 * 1024, 1024 * 1024 };
+
+static void
+fill_random(u8 *buf, u32 sz) {
+	u32 i;
+	u32 seed = 0x12345678;
+	for (i = 0; i < sz; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (u8)(seed >> 16);
+	}
+}
 
 static void
-test_crc(void)  {
-	/* NOT IMPLEMENTED YET */
+test_crc16_32(void)  {
+	int i;
+	u32 off, len;
+	u32 crc32;
+	u16 crc16;
+	const u8 check[] = "123456789";
+	u8 buf[1024 + 16];
+
+	/* Known check values: CRC-32C and CRC-16/ARC */
+	yassert(0xE3069283 == (ycrc32(0xffffffff, check, 9) ^ 0xffffffff));
+	yassert(0xBB3D == ycrc16(0, check, 9));
+
+	/* All kernels should give bit-identical results.
+	 * Various alignments and lengths are used to cover tail handling.
+	 */
+	fill_random(buf, sizeof(buf));
+	for (off = 0; off < 16; off++) {
+		for (len = 1; len <= 1024; len += (len < 64) ? 1 : 61) {
+			crc32 = crc32_slice(1, 0xffffffff, buf + off, len);
+			crc16 = crc16_slice(1, 0, buf + off, len);
+			for (i = 0; i < yut_arrsz(_slices); i++) {
+				yassert(crc32 == crc32_slice(
+					_slices[i], 0xffffffff, buf + off, len));
+				yassert(crc16 == crc16_slice(
+					_slices[i], 0, buf + off, len));
+			}
+			yassert(crc32 == ycrc32(0xffffffff, buf + off, len));
+			yassert(crc16 == ycrc16(0, buf + off, len));
+		}
+	}
+
+	/* Streaming: crc of whole == crc of pieces */
+	crc32 = ycrc32(0, buf, 100);
+	crc32 = ycrc32(crc32, buf + 100, 900);
+	yassert(crc32 == ycrc32(0, buf, 1000));
+}
+
+static void
+test_crc32c(void) {
+	u32 off, len, crc;
+	const u32 bigsz = 100 * 1024;
+	u8 *big = ymalloc(bigsz);
+
+	yassert(0xE3069283 == ycrc32c(0, (const u8 *)"123456789", 9));
+	yassert(0 == ycrc32c(0, (const u8 *)"", 0));
+
+	/* Large buffers go through multi-lane hardware path(if supported). */
+	fill_random(big, bigsz);
+	for (off = 0; off < 8; off += 3) {
+		for (len = 1; len + off <= bigsz; len = len * 3 + 7) {
+			crc = crc32_slice(1, 0xffffffff, big + off, len);
+			yassert(crc == ycrc32(0xffffffff, big + off, len));
+			yassert(~crc == ycrc32c(0, big + off, len));
+		}
+	}
+	len = bigsz - 8;
+	crc = ycrc32c(0, big, 777);
+	crc = ycrc32c(crc, big + 777, len - 777);
+	yassert(crc == ycrc32c(0, big, len));
+	yfree(big);
+}
+
+static void
+test_crc32_combine(void) {
+	int i;
+	u32 lena, crca, crcb, crc;
+	const u32 bigsz = 3 * 1024 * 1024 + 13;
+	const int nthreads[] = { 0, 1, 2, 3, 7 };
+	u8 *big = ymalloc(bigsz);
+
+	fill_random(big, bigsz);
+	for (lena = 1; lena < 4096; lena = lena * 2 + 1) {
+		/* ycrc32 */
+		crca = ycrc32(0xffffffff, big, lena);
+		crcb = ycrc32(0, big + lena, 4096);
+		crc = ycrc32(0xffffffff, big, lena + 4096);
+		yassert(crc == ycrc32_combine(crca, crcb, 4096));
+		/* ycrc32c */
+		crca = ycrc32c(0, big, lena);
+		crcb = ycrc32c(0, big + lena, 4096);
+		crc = ycrc32c(0, big, lena + 4096);
+		yassert(crc == ycrc32_combine(crca, crcb, 4096));
+	}
+	yassert(crca == ycrc32_combine(crca, 0, 0));
+
+	crc = ycrc32(0x1234, big, bigsz);
+	for (i = 0; i < yut_arrsz(nthreads); i++) {
+		yassert(crc == ycrc32_parallel(0x1234, big, bigsz, nthreads[i]));
+		/* Too small to be split */
+		yassert(ycrc32(0, big, 1000)
+			== ycrc32_parallel(0, big, 1000, nthreads[i]));
+	}
+	yfree(big);
 }
 
+static u64
+crc64_ref(u64 poly, u64 crc, const u8 *data, u32 len) {
+	int k;
+	while (len--) {
+		crc ^= *data++;
+		for (k = 0; k < 8; k++)
+			crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+	}
+	return crc;
+}
+
+static void
+test_crc64(void) {
+	u32 off, len;
+	u64 crc;
+	const u8 check[] = "123456789";
+	u8 buf[1024 + 8];
+
+	yassert(0x995DC9BBDF1939FAULL
+		== ycrc64_final(ycrc64(ycrc64_init(), check, 9)));
+	yassert(0xB90956C775A41001ULL
+		== ycrc64_final(ycrc64_iso(ycrc64_init(), check, 9)));
+
+	fill_random(buf, sizeof(buf));
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len <= 1024; len += (len < 32) ? 1 : 37) {
+			yassert(crc64_ref(0xC96C5795D7870F42ULL,
+					ycrc64_init(), buf + off, len)
+				== ycrc64(ycrc64_init(), buf + off, len));
+			yassert(crc64_ref(0xD800000000000000ULL,
+					ycrc64_init(), buf + off, len)
+				== ycrc64_iso(ycrc64_init(), buf + off, len));
+		}
+	}
+	/* Streaming */
+	crc = ycrc64_init();
+	crc = ycrc64(crc, buf, 13);
+	crc = ycrc64(crc, buf + 13, 1000 - 13);
+	yassert(crc == ycrc64(ycrc64_init(), buf, 1000));
+}
 
+static void
+test_crc(void) {
+	test_crc16_32();
+	test_crc32c();
+	test_crc32_combine();
+	test_crc64();
+}
 
 TESTFN(crc)
 
+
+/* Cycle counter. TSC is used if possible. Otherwise nanoseconds. */
+static u64
+cycles(void) {
+#ifdef __x86_64__
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void
+perf_crc(void) {
+	int i, j, s;
+	u32 sz, n, k;
+	u64 t;
+	u32 crc32 = 0;
+	u16 crc16 = 0;
+	u64 crc64 = 0;
+	char label[16];
+	/* Total bytes processed for each measurement. */
+	const u32 total = 64 * 1024 * 1024;
+	const u32 maxsz = _perfszs[yut_arrsz(_perfszs) - 1];
+	u8 *buf = ymalloc(maxsz);
+
+	fill_random(buf, maxsz);
+	printf("crc kernels: bytes/cycle\n");
+	printf("%10s %8s", "size", "");
+	for (i = 0; i < yut_arrsz(_slices); i++) {
+		snprintf(label, sizeof(label), "slice%d", _slices[i]);
+		printf(" %10s", label);
+	}
+	printf(" %10s\n", "ycrcXX");
+	for (j = 0; j < 2; j++) {
+		for (s = 0; s < yut_arrsz(_perfszs); s++) {
+			sz = _perfszs[s];
+			n = total / sz;
+			printf("%10u %8s", sz, j ? "crc16" : "crc32");
+			for (i = 0; i < yut_arrsz(_slices); i++) {
+				t = cycles();
+				for (k = 0; k < n; k++) {
+					if (j)
+						crc16 = crc16_slice(
+							_slices[i], crc16,
+							buf, sz);
+					else
+						crc32 = crc32_slice(
+							_slices[i], crc32,
+							buf, sz);
+				}
+				t = cycles() - t;
+				printf(" %10.3f", (double)n * sz / (t ? t : 1));
+			}
+			/* Kernel chosen at ylib_init */
+			t = cycles();
+			for (k = 0; k < n; k++) {
+				if (j)
+					crc16 = ycrc16(crc16, buf, sz);
+				else
+					crc32 = ycrc32(crc32, buf, sz);
+			}
+			t = cycles() - t;
+			printf(" %10.3f\n", (double)n * sz / (t ? t : 1));
+		}
+	}
+
+
+	printf("%10s %8s", "size", "");
+	printf(" %10s %10s\n", "ycrc64", "ycrc64_iso");
+	for (s = 0; s < yut_arrsz(_perfszs); s++) {
+		sz = _perfszs[s];
+		n = total / sz;
+		printf("%10u %8s", sz, "crc64");
+		for (j = 0; j < 2; j++) {
+			t = cycles();
+			for (k = 0; k < n; k++) {
+				if (j)
+					crc64 = ycrc64_iso(crc64, buf, sz);
+				else
+					crc64 = ycrc64(crc64, buf, sz);
+			}
+			t = cycles() - t;
+			printf(" %10.3f", (double)n * sz / (t ? t : 1));
+		}
+		printf("\n");
+	}
+	yfree(buf);
+
+	/* 64 MB */
+	sz = maxsz * 64;
+	buf = ymalloc(sz);
+	fill_random(buf, sz);
+	printf("ycrc32_parallel: %u MB\n", sz / (1024 * 1024));
+	for (i = 1; i <= 8; i *= 2) {
+		t = yut_current_time_us();
+		crc32 ^= ycrc32_parallel(crc32, buf, sz, i);
+		t = yut_current_time_us() - t;
+		printf("%4d threads: %8.3f GB/s\n",
+			i, (double)sz / (t ? t : 1) / 1000);
+	}
+	/* To avoid that compiler optimizes out above loops. */
+	printf("(%x %x %llx)\n", crc32, crc16, (unsigned long long)crc64);
+	yfree(buf);
+}
+
+PERFFN(crc)
+
 #endif /* CONFIG_TEST */
@@ -0,0 +1,264 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include "test.h"
+#ifdef CONFIG_TEST
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "yfhash.h"
+#include "yhash.h"
+#include "yut.h"
+#include "fhash.h"
+
+static const char *tmpfpath = "/tmp/___ylib_test_fhash___";
+
+/* Value is pointer to int */
+static const void *
+bytes_int(const void *obj, uint32_t *len) {
+	*len = sizeof(int);
+	return obj;
+}
+
+static const void *
+bytes_same(unused const void *obj, uint32_t *len) {
+	*len = 4;
+	return "same";
+}
+
+static void
+verify_strs(const struct yfhash *fh, int n) {
+	int i;
+	char buf[64];
+	const void *v;
+	uint32_t vlen;
+	yassert(n == yfhash_sz(fh));
+	for (i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		yassert(!yfhash_get(fh, buf, strlen(buf), &v, &vlen));
+		/* Value is aligned by 8 bytes. */
+		yassert(!((uintptr_t)v & 7));
+		yassert(vlen == strlen(buf) - 4
+			&& !memcmp(v, buf + 4, vlen));
+	}
+	yassert(-ENOENT == yfhash_get(fh, "key-", 4, &v, &vlen));
+	yassert(-ENOENT == yfhash_get(fh, "", 0, NULL, NULL));
+	snprintf(buf, sizeof(buf), "key-%d", n);
+	yassert(-ENOENT == yfhash_get(fh, buf, strlen(buf), NULL, NULL));
+}
+
+/*
+ * Header fields are crafted so that sum of header, slot and arena size
+ *   overflows and matches file size.
+ */
+static void
+broken_header(void) {
+	FILE *f;
+	struct fhdr hdr;
+	u8 pad[112 - sizeof(hdr)];
+	struct yfhash *fh;
+
+	yassert((f = fopen(tmpfpath, "r")));
+	yassert(1 == fread(&hdr, sizeof(hdr), 1, f));
+	fclose(f);
+	hdr.sz = 0;
+	hdr.cap = 1U << 24;
+	hdr.totalsz = sizeof(hdr) + sizeof(pad);
+	/* 'sizeof(hdr) + slots + arenasz' wraps around to 'totalsz' */
+	hdr.arenasz = 0 - (sizeof(hdr) + sizeof(struct fslot) * (u64)hdr.cap
+			   - hdr.totalsz);
+	memset(pad, 0, sizeof(pad));
+	yassert((f = fopen(tmpfpath, "w")));
+	yassert(1 == fwrite(&hdr, sizeof(hdr), 1, f));
+	yassert(1 == fwrite(pad, sizeof(pad), 1, f));
+	fclose(f);
+	yassert(-EINVAL == yfhash_map_file(&fh, tmpfpath));
+
+	/* Truncated header */
+	yassert(!truncate(tmpfpath, sizeof(hdr) / 2));
+	yassert(-EINVAL == yfhash_map_file(&fh, tmpfpath));
+}
+
+static void
+test_fhash_str(void) {
+	int i;
+	char buf[64];
+	const int n = 10000;
+	struct yfhash *fh;
+	struct yhash *h = yhashs_create(YHASH_MEM_FREE, TRUE);
+
+	for (i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		/* value: "<i>" */
+		yhash_set(h, buf, ystrdup(buf + 4));
+	}
+	fh = yfhash_freeze(h, &yfhash_bytes_str, &yfhash_bytes_str);
+	yassert(fh);
+	verify_strs(fh, n);
+	yassert(!yfhash_write_file(fh, tmpfpath));
+	yfhash_destroy(fh);
+
+	yassert(!yfhash_map_file(&fh, tmpfpath));
+	verify_strs(fh, n);
+	yfhash_destroy(fh);
+
+	/* Broken file */
+	broken_header();
+	yassert(!truncate(tmpfpath, 1000));
+	yassert(-EINVAL == yfhash_map_file(&fh, tmpfpath));
+	yassert(!truncate(tmpfpath, 0));
+	yassert(-EINVAL == yfhash_map_file(&fh, tmpfpath));
+	unlink(tmpfpath);
+	yassert(-ENOENT == yfhash_map_file(&fh, tmpfpath));
+
+	/* Different keys having same bytes */
+	yassert(!yfhash_freeze(h, &bytes_same, &yfhash_bytes_str));
+	yhash_destroy(h);
+}
+
+static void
+test_fhash_bin(void) {
+	int i;
+	const void *v;
+	uint32_t vlen;
+	int vs[1000];
+	struct yfhash *fh;
+	struct yhash *h = yhashb_create(NULL);
+
+	/* Empty hash */
+	fh = yfhash_freeze(h, &yhashb_key, &bytes_int);
+	yassert(fh && 0 == yfhash_sz(fh));
+	yassert(-ENOENT == yfhash_get(fh, &i, sizeof(i), &v, &vlen));
+	yassert(!yfhash_write_file(fh, tmpfpath));
+	yfhash_destroy(fh);
+	yassert(!yfhash_map_file(&fh, tmpfpath));
+	yassert(-ENOENT == yfhash_get(fh, &i, sizeof(i), &v, &vlen));
+	yfhash_destroy(fh);
+	unlink(tmpfpath);
+
+	for (i = 0; i < 1000; i++) {
+		vs[i] = i * 3;
+		yhashb_set(h, &i, sizeof(i), &vs[i]);
+	}
+	fh = yfhash_freeze(h, &yhashb_key, &bytes_int);
+	yassert(fh);
+	for (i = 0; i < 1000; i++) {
+		yassert(!yfhash_get(fh, &i, sizeof(i), &v, &vlen));
+		yassert(sizeof(int) == vlen && *(const int *)v == i * 3);
+	}
+	yfhash_destroy(fh);
+	yhash_destroy(h);
+}
+
+static void
+test_fhash(void) {
+	test_fhash_str();
+	test_fhash_bin();
+}
+
+TESTFN(fhash)
+
+
+#define PERF_NKEYS (1024 * 1024)
+
+static void
+perf_fhash(void) {
+	int i;
+	u64 t;
+	void *v;
+	const void *fv;
+	char buf[64];
+	double tbuild, tfreeze, tmap, tget, tfget, twarm;
+	struct yfhash *fh;
+	char **keys = ymalloc(sizeof(*keys) * PERF_NKEYS);
+	struct yhash *h = yhashs_create(NULL, TRUE);
+
+	for (i = 0; i < PERF_NKEYS; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		keys[i] = ystrdup(buf);
+	}
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yhash_set(h, keys[i], keys[i]);
+	tbuild = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	fh = yfhash_freeze(h, &yfhash_bytes_str, &yfhash_bytes_str);
+	tfreeze = (double)(yut_current_time_us() - t);
+	yassert(!yfhash_write_file(fh, tmpfpath));
+	yfhash_destroy(fh);
+
+	t = yut_current_time_us();
+	yassert(!yfhash_map_file(&fh, tmpfpath));
+	tmap = (double)(yut_current_time_us() - t);
+
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yassert(!yhash_get(h, keys[i], &v));
+	tget = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yassert(!yfhash_get(fh, keys[i], strlen(keys[i]), &fv, NULL));
+	tfget = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yassert(!yfhash_get(fh, keys[i], strlen(keys[i]), &fv, NULL));
+	twarm = (double)(yut_current_time_us() - t);
+
+	printf("fhash: %d string keys\n", PERF_NKEYS);
+	printf("  build yhash(ms) : %10.2f\n", tbuild / 1000);
+	printf("  freeze(ms)      : %10.2f\n", tfreeze / 1000);
+	printf("  map file(ms)    : %10.2f\n", tmap / 1000);
+	printf("  yhash get(M/s)  : %10.2f\n", PERF_NKEYS / (tget ? tget : 1));
+	printf("  yfhash get(M/s) : %10.2f (first touch of pages included)\n",
+		PERF_NKEYS / (tfget ? tfget : 1));
+	printf("  yfhash get(M/s) : %10.2f (warm)\n",
+		PERF_NKEYS / (twarm ? twarm : 1));
+
+	yfhash_destroy(fh);
+	unlink(tmpfpath);
+	yhash_destroy(h);
+	for (i = 0; i < PERF_NKEYS; i++)
+		yfree(keys[i]);
+	yfree(keys);
+}
+
+PERFFN(fhash)
+
+#endif /* CONFIG_TEST */
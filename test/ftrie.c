@@ -0,0 +1,423 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include "test.h"
+#ifdef CONFIG_TEST
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "yftrie.h"
+#include "ytrie.h"
+#include "yut.h"
+
+static const char *tmpfpath = "/tmp/___ylib_test_ftrie___";
+static const char *tmpfpath2 = "/tmp/___ylib_test_ftrie2___";
+
+#define NKEYS 3000
+#define MAXKSZ 16
+
+static u32 rseed = 0x7654321;
+
+static u32
+rnd(void) {
+	/* xorshift32 */
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 17;
+	rseed ^= rseed << 5;
+	return rseed;
+}
+
+static void
+vfree(void *v) {
+	yfree(v);
+}
+
+/* Value is pointer to int */
+static const void *
+bytes_int(const void *obj, uint32_t *len) {
+	*len = sizeof(int);
+	return obj;
+}
+
+/* Keys and values visited by iteration */
+struct visited {
+	u8 k[NKEYS][MAXKSZ];
+	u32 ksz[NKEYS];
+	int v[NKEYS];
+	u32 n;
+};
+
+static int
+trie_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct visited *vs = tag;
+	yassert(vs->n < NKEYS && sz <= MAXKSZ);
+	memcpy(vs->k[vs->n], key, sz);
+	vs->ksz[vs->n] = sz;
+	vs->v[vs->n++] = *(int *)v;
+	return 1;
+}
+
+static int
+ftrie_cb(void *tag, const u8 *key, u32 sz, const void *v, u32 vsz) {
+	struct visited *vs = tag;
+	yassert(vs->n < NKEYS && sz <= MAXKSZ && sizeof(int) == vsz);
+	yassert(!((uintptr_t)v & 7));
+	memcpy(vs->k[vs->n], key, sz);
+	vs->ksz[vs->n] = sz;
+	vs->v[vs->n++] = *(const int *)v;
+	return 1;
+}
+
+static int
+ftrie_stop_cb(void *tag, unused const u8 *key, unused u32 sz,
+	unused const void *v, unused u32 vsz
+) {
+	return --*(int *)tag > 0;
+}
+
+/* Frozen trie SHOULD give same results with trie. */
+static void
+verify(struct ytrie *t, const struct yftrie *ft, u8 (*keys)[MAXKSZ],
+	u32 *kszs
+) {
+	int i, j, r0, r1;
+	u32 psz, vsz;
+	const void *v;
+	u8 pfx[MAXKSZ];
+	u8 b0[MAXKSZ + 1], b1[MAXKSZ + 1];
+	static struct visited vs0, vs1;
+
+	yassert(ytrie_sz(t) == yftrie_sz(ft));
+	for (i = 0; i < NKEYS; i++) {
+		int *tv = ytrie_get(t, keys[i], kszs[i]);
+		r0 = yftrie_get(ft, keys[i], kszs[i], &v, &vsz);
+		if (tv)
+			yassert(!r0 && sizeof(int) == vsz
+				&& *tv == *(const int *)v);
+		else
+			yassert(-ENOENT == r0);
+		/* prefix of key */
+		if (kszs[i] > 1) {
+			tv = ytrie_get(t, keys[i], kszs[i] - 1);
+			r0 = yftrie_get(ft, keys[i], kszs[i] - 1, NULL, NULL);
+			yassert(tv ? !r0 : -ENOENT == r0);
+		}
+	}
+	yassert(-ENOENT == yftrie_get(ft, "", 0, NULL, NULL));
+
+	for (i = 0; i < 200; i++) {
+		/* Empty prefix, prefix of existing key, or random prefix */
+		j = rnd() % NKEYS;
+		psz = i ? 1 + rnd() % kszs[j] : 0;
+		memcpy(pfx, keys[j], psz);
+		if (i & 1)
+			pfx[psz - 1] = 'a' + rnd() % 5;
+		vs0.n = vs1.n = 0;
+		r0 = ytrie_sz(t)
+			? ytrie_iterate(t, &vs0, pfx, psz, &trie_cb)
+			: -EINVAL;
+		r1 = yftrie_iterate(ft, &vs1, pfx, psz, &ftrie_cb);
+		if (vs0.n) {
+			yassert(1 == r0 && 1 == r1);
+		} else
+			yassert(-ENOENT == r1);
+		yassert(vs0.n == vs1.n);
+		for (j = 0; j < (int)vs0.n; j++)
+			yassert(vs0.ksz[j] == vs1.ksz[j]
+				&& !memcmp(vs0.k[j], vs1.k[j], vs0.ksz[j])
+				&& vs0.v[j] == vs1.v[j]);
+
+		if (!psz)
+			continue;
+		r0 = ytrie_auto_complete(t, pfx, psz, b0, sizeof(b0));
+		r1 = yftrie_auto_complete(ft, pfx, psz, b1, sizeof(b1));
+		yassert(r0 == r1);
+		if (0 == r0 || 1 == r0)
+			yassert(!strcmp((char *)b0, (char *)b1));
+	}
+
+	/* Iteration stops */
+	if (yftrie_sz(ft) > 3) {
+		i = 3;
+		yassert(0 == yftrie_iterate(ft, &i, "", 0, &ftrie_stop_cb));
+		yassert(0 == i);
+	}
+}
+
+struct warg {
+	const struct yftrie *ft;
+	int fd;
+	int r;
+};
+
+static void *
+write_main(void *arg) {
+	struct warg *a = arg;
+	a->r = yftrie_write_fd(a->ft, a->fd);
+	close(a->fd);
+	return NULL;
+}
+
+/* Write to non-blocking pipe, whose reader copies data to @p path */
+static void
+write_nonblock(const struct yftrie *ft, const char *path) {
+	int pfd[2], fd;
+	ssize_t n;
+	char buf[4096];
+	pthread_t thd;
+	struct warg a;
+
+	yassert(!pipe(pfd));
+	yassert(!fcntl(pfd[1], F_SETFL, O_NONBLOCK));
+	a.ft = ft;
+	a.fd = pfd[1];
+	yassert(!pthread_create(&thd, NULL, &write_main, &a));
+	yassert(0 <= (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)));
+	while (0 < (n = read(pfd[0], buf, sizeof(buf))))
+		yassert(n == write(fd, buf, n));
+	yassert(!n);
+	close(fd);
+	close(pfd[0]);
+	yassert(!pthread_join(thd, NULL));
+	yassert(!a.r);
+}
+
+static void
+test_ftrie_random(int opt) {
+	int i, j, n;
+	int *v;
+	u8 (*keys)[MAXKSZ] = ymalloc(sizeof(*keys) * NKEYS);
+	u32 *kszs = ymalloc(sizeof(*kszs) * NKEYS);
+	struct yftrie *ft;
+	struct ytrie *t = ytrie_create2(&vfree, opt);
+
+	/* Empty trie */
+	yassert((ft = yftrie_freeze(t, &bytes_int)));
+	yassert(0 == yftrie_sz(ft));
+	yassert(-ENOENT == yftrie_get(ft, "a", 1, NULL, NULL));
+	yassert(-ENOENT == yftrie_iterate(ft, NULL, "", 0, &ftrie_cb));
+	yassert(2 == yftrie_auto_complete(ft, "a", 1, (u8 *)&i, sizeof(i)));
+	yftrie_destroy(ft);
+
+	/*
+	 * Keys with small alphabet make lots of shared prefixes.
+	 * Some keys use large alphabet to make states having many children.
+	 */
+	for (i = 0; i < NKEYS; i++) {
+		kszs[i] = 1 + rnd() % MAXKSZ;
+		for (j = 0; j < (int)kszs[i]; j++)
+			keys[i][j] = i % 3 ? 'a' + rnd() % 4 : (u8)rnd();
+	}
+	for (n = 0, i = 0; i < NKEYS; i++) {
+		/* Some keys are left out to test absent keys. */
+		if (!(i % 7))
+			continue;
+		v = ymalloc(sizeof(*v));
+		*v = i;
+		/* Value of duplicated key is replaced. */
+		if (0 == ytrie_insert(t, keys[i], kszs[i], v))
+			n++;
+		/* Trie having just one key */
+		if (1 == n) {
+			yassert((ft = yftrie_freeze(t, &bytes_int)));
+			verify(t, ft, keys, kszs);
+			yftrie_destroy(ft);
+		}
+	}
+	yassert(n == (int)ytrie_sz(t));
+	yassert((ft = yftrie_freeze(t, &bytes_int)));
+	verify(t, ft, keys, kszs);
+	yassert(!yftrie_write_file(ft, tmpfpath));
+	yftrie_destroy(ft);
+
+	yassert(!yftrie_map_file(&ft, tmpfpath));
+	verify(t, ft, keys, kszs);
+	/* Pipe is full before whole trie is written */
+	write_nonblock(ft, tmpfpath2);
+	yftrie_destroy(ft);
+	yassert(!yftrie_map_file(&ft, tmpfpath2));
+	verify(t, ft, keys, kszs);
+	yftrie_destroy(ft);
+	unlink(tmpfpath2);
+
+	/* Broken file */
+	yassert(!truncate(tmpfpath, 1000));
+	yassert(-EINVAL == yftrie_map_file(&ft, tmpfpath));
+	yassert(!truncate(tmpfpath, 0));
+	yassert(-EINVAL == yftrie_map_file(&ft, tmpfpath));
+	unlink(tmpfpath);
+	yassert(-ENOENT == yftrie_map_file(&ft, tmpfpath));
+
+	ytrie_destroy(t);
+	yfree(kszs);
+	yfree(keys);
+}
+
+static void
+test_ftrie_str(void) {
+	u8 buf[YTRIE_MAX_KEY_LEN];
+	u8 lk[YTRIE_MAX_KEY_LEN];
+	const void *v;
+	u32 vsz;
+	struct yftrie *ft;
+	struct ytrie *t = ytrie_create(&vfree);
+
+#define ins(s, vs) ytrie_insert(t, (const u8 *)(s), strlen(s), ystrdup(vs))
+#define ac(s, bsz) yftrie_auto_complete(ft, (const u8 *)(s), strlen(s),	\
+					buf, bsz)
+	yassert(0 == ins("abcdef", "v0"));
+	yassert(0 == ins("abcxyz", "v1"));
+	yassert(0 == ins("abcxyw", "v2"));
+	yassert(0 == ins("abcxy", ""));
+	memset(lk, 'k', sizeof(lk));
+	yassert(0 == ytrie_insert(t, lk, sizeof(lk) - 1, ystrdup("long")));
+	lk[500] = 'x';
+	yassert(0 == ytrie_insert(t, lk, sizeof(lk) - 1, ystrdup("long2")));
+	ft = yftrie_freeze(t, &yftrie_bytes_str);
+	yassert(ft && 6 == yftrie_sz(ft));
+	yassert(!yftrie_get(ft, "abcxyw", 6, &v, &vsz)
+		&& 2 == vsz && !memcmp(v, "v2", 2));
+	yassert(!yftrie_get(ft, "abcxy", 5, &v, &vsz) && 0 == vsz);
+	yassert(-ENOENT == yftrie_get(ft, "abcx", 4, &v, &vsz));
+	yassert(-ENOENT == yftrie_get(ft, "abcdefg", 7, &v, &vsz));
+	yassert(!yftrie_get(ft, lk, sizeof(lk) - 1, &v, &vsz)
+		&& 5 == vsz && !memcmp(v, "long2", 5));
+	yassert(0 == ac("ab", sizeof(buf)) && !strcmp((char *)buf, "c"));
+	yassert(1 == ac("abcd", sizeof(buf)) && !strcmp((char *)buf, "ef"));
+	yassert(1 == ac("abcdef", sizeof(buf)) && !buf[0]);
+	yassert(0 == ac("abcx", sizeof(buf)) && !strcmp((char *)buf, "y"));
+	yassert(0 == ac("abcxy", sizeof(buf)) && !buf[0]);
+	yassert(2 == ac("abd", sizeof(buf)));
+	yassert(2 == ac("abcdefg", sizeof(buf)));
+	yassert(-EINVAL == ac("abcd", 2));
+	yassert(1 == ac("abcd", 3));
+	yassert(0 == yftrie_auto_complete(ft, lk, 1, buf, sizeof(buf))
+		&& 499 == strlen((char *)buf));
+	yassert(1 == yftrie_auto_complete(ft, lk, 501, buf, sizeof(buf))
+		&& sizeof(lk) - 1 - 501 == strlen((char *)buf));
+#undef ins
+#undef ac
+	yftrie_destroy(ft);
+	ytrie_destroy(t);
+}
+
+static void
+test_ftrie(void) {
+	test_ftrie_str();
+	test_ftrie_random(0);
+	test_ftrie_random(YTRIE_art);
+}
+
+TESTFN(ftrie)
+
+
+#define PERF_NKEYS (1024 * 1024)
+
+static void
+perf_ftrie(void) {
+	int i;
+	u64 t;
+	const void *fv;
+	char buf[64];
+	double tbuild, tfreeze, tmap, tget, tfget, twarm;
+	struct stat st;
+	struct yftrie *ft;
+	char **keys = ymalloc(sizeof(*keys) * PERF_NKEYS);
+	struct ytrie *tr = ytrie_create2(NULL, YTRIE_art);
+
+	for (i = 0; i < PERF_NKEYS; i++) {
+		snprintf(buf, sizeof(buf), "key-%d", i);
+		keys[i] = ystrdup(buf);
+	}
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		ytrie_insert(tr, (const u8 *)keys[i], strlen(keys[i]),
+			keys[i]);
+	tbuild = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	ft = yftrie_freeze(tr, &yftrie_bytes_str);
+	tfreeze = (double)(yut_current_time_us() - t);
+	yassert(!yftrie_write_file(ft, tmpfpath));
+	yftrie_destroy(ft);
+	yassert(!stat(tmpfpath, &st));
+
+	t = yut_current_time_us();
+	yassert(!yftrie_map_file(&ft, tmpfpath));
+	tmap = (double)(yut_current_time_us() - t);
+
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yassert(ytrie_get(tr, (const u8 *)keys[i], strlen(keys[i])));
+	tget = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yassert(!yftrie_get(ft, keys[i], strlen(keys[i]), &fv, NULL));
+	tfget = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		yassert(!yftrie_get(ft, keys[i], strlen(keys[i]), &fv, NULL));
+	twarm = (double)(yut_current_time_us() - t);
+
+	printf("ftrie: %d string keys\n", PERF_NKEYS);
+	printf("  build ytrie(ms) : %10.2f\n", tbuild / 1000);
+	printf("  freeze(ms)      : %10.2f\n", tfreeze / 1000);
+	printf("  file size(MB)   : %10.2f\n",
+		(double)st.st_size / (1024 * 1024));
+	printf("  map file(ms)    : %10.2f\n", tmap / 1000);
+	printf("  ytrie get(M/s)  : %10.2f\n", PERF_NKEYS / (tget ? tget : 1));
+	printf("  yftrie get(M/s) : %10.2f (first touch of pages included)\n",
+		PERF_NKEYS / (tfget ? tfget : 1));
+	printf("  yftrie get(M/s) : %10.2f (warm)\n",
+		PERF_NKEYS / (twarm ? twarm : 1));
+
+	yftrie_destroy(ft);
+	unlink(tmpfpath);
+	ytrie_destroy(tr);
+	for (i = 0; i < PERF_NKEYS; i++)
+		yfree(keys[i]);
+	yfree(keys);
+}
+
+PERFFN(ftrie)
+
+#endif /* CONFIG_TEST */
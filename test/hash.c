@@ -40,9 +40,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "yhash.h"
 #include "ycrc.h"
+#include "yut.h"
 
 
 static void
@@ -71,7 +74,7 @@ strkey_hash(const void *key) {
 }
 
 static void
-test_hasho(void) {
+test_hasho(int opt) {
 	int i;
 	char buf[4096];
 	void *v;
@@ -81,12 +84,13 @@ test_hasho(void) {
 	/*
 	 * Test normal hash.
 	 */
-	struct yhash *h = yhasho_create(
+	struct yhash *h = yhasho_create2(
 		YHASH_MEM_FREE,
 		YHASH_MEM_FREE,
 		&strkey_copy,
 		&strkey_cmp,
-		&strkey_hash);
+		opt & YHASH_fast_hash ? YHASH_HFUNC_FAST_STR : &strkey_hash,
+		opt);
 
 	for (i = 0; i < 1024; i++) {
 		snprintf(buf, sizeof(buf), "this is key %d", i);
@@ -129,7 +133,7 @@ test_hasho(void) {
 }
 
 static void
-test_hashs(void) {
+test_hashs(int opt) {
 	int i;
 	char buf[4096];
 	void *v;
@@ -138,7 +142,7 @@ test_hashs(void) {
 	/*
 	 * Test normal hash.
 	 */
-	struct yhash *h = yhashs_create(YHASH_MEM_FREE, TRUE);
+	struct yhash *h = yhashs_create2(YHASH_MEM_FREE, TRUE, opt);
 
 	for (i = 0; i < 1024; i++) {
 		snprintf(buf, sizeof(buf), "this is key %d", i);
@@ -181,7 +185,7 @@ test_hashs(void) {
 }
 
 unused static void
-test_hashi(void) {
+test_hashi(int opt) {
 	int i, unused r;
 	char buf[4096];
 	char *ptsv[1024];
@@ -189,7 +193,7 @@ test_hashi(void) {
 	/*
 	 * Test address hash.
 	 */
-	struct yhash *h = yhashi_create(&vfree);
+	struct yhash *h = yhashi_create2(&vfree, opt);
 
 	for (i = 0; i < 1024; i++) {
 		snprintf(buf, sizeof(buf), "this is key %d", i);
@@ -215,14 +219,752 @@ test_hashi(void) {
 	yhash_destroy(h);
 }
 
+static void
+test_hashb(int opt) {
+	int i;
+	u32 len;
+	void *v, *oldv;
+	const void *k;
+	const void *keys[64];
+	u8 buf[64];
+	/* keys that are prefix of others, and having '\0' in it */
+	static const char *bkeys[] = { "ab", "ab\0", "ab\0c", "a", "", "\0" };
+	static const u32 bkeylens[] = { 2, 3, 4, 1, 0, 1 };
+	struct yhash *h2, *h = yhashb_create2(YHASH_MEM_FREE, opt);
+
+	for (i = 0; i < yut_arrsz(bkeys); i++) {
+		v = ymalloc(sizeof(int));
+		*(int *)v = i;
+		yassert(1 == yhashb_set(h, bkeys[i], bkeylens[i], v));
+	}
+	yassert(yut_arrsz(bkeys) == yhash_sz(h));
+	for (i = 0; i < yut_arrsz(bkeys); i++) {
+		/* Lookup with key at different memory */
+		memcpy(buf, bkeys[i], bkeylens[i]);
+		yassert(!yhashb_get(h, buf, bkeylens[i], &v)
+			&& i == *(int *)v);
+	}
+	yassert(-ENOENT == yhashb_get(h, "abc", 3, &v));
+	yassert(-ENOENT == yhashb_get(h, "\0\0", 2, &v));
+	/* NULL is allowed for empty key */
+	yassert(!yhashb_get(h, NULL, 0, &v) && 4 == *(int *)v);
+
+	/* overwrite */
+	v = ymalloc(sizeof(int));
+	*(int *)v = 100;
+	yassert(0 == yhashb_set2(h, "ab", 2, &oldv, v));
+	yassert(0 == *(int *)oldv);
+	yfree(oldv);
+	yassert(!yhashb_get(h, "ab", 2, &v) && 100 == *(int *)v);
+	yassert(yut_arrsz(bkeys) == yhash_sz(h));
+
+	yassert(yut_arrsz(bkeys) == yhash_keys(h, keys, yut_arrsz(keys)));
+	for (i = 0; i < yut_arrsz(bkeys); i++) {
+		k = yhashb_key(keys[i], &len);
+		yassert(!yhashb_get(h, k, len, NULL));
+	}
+
+	/* Keys moved to other hash */
+	h2 = yhashb_create2(NULL, opt);
+	for (i = 0; i < yut_arrsz(bkeys); i++)
+		yassert(1 == yhash_set(h2, (void *)keys[i], NULL));
+	for (i = 0; i < yut_arrsz(bkeys); i++)
+		yassert(!yhashb_get(h2, bkeys[i], bkeylens[i], NULL));
+	yhash_destroy(h2);
+
+	yassert(1 == yhashb_remove(h, "ab\0", 3));
+	yassert(0 == yhashb_remove(h, "ab\0", 3));
+	yassert(-ENOENT == yhashb_get(h, "ab\0", 3, &v));
+	yassert(!yhashb_get(h, "ab\0c", 4, &v) && 2 == *(int *)v);
+
+	/* Many keys. Items are left to be freed at destroy. */
+	for (i = 0; i < 4096; i++)
+		yassert(1 == yhashb_set(h, &i, sizeof(i), NULL));
+	for (i = 0; i < 4096; i += 2)
+		yassert(1 == yhashb_remove(h, &i, sizeof(i)));
+	for (i = 0; i < 4096; i++)
+		yassert(!!(i & 1) == !yhashb_get(h, &i, sizeof(i), NULL));
+	yhash_destroy(h);
+}
+
+/*
+ * Random set/remove sequence on both engines should give same result.
+ * Lots of removes make tombstones at open addressing engine.
+ */
+static void
+test_hash_sametype(void) {
+	struct yhash *h0 = yhashs_create(NULL, TRUE);
+	struct yhash *h1 = yhashs_create(NULL, FALSE);
+	struct yhash *h2 = yhashs_create2(NULL, TRUE, YHASH_open_addressing);
+	/* Key of one is owned by hash, but the other's is not. */
+	yassert(!yhash_is_sametype(h0, h1));
+	yassert(yhash_is_sametype(h0, h2));
+	yhash_destroy(h0);
+	yhash_destroy(h1);
+	yhash_destroy(h2);
+}
+
+static void
+test_hash_engines(void) {
+	int i, j, r0, r1;
+	void *v0, *v1;
+	u32 seed = 0x12345678;
+	const int nkeys = 4096;
+	struct yhash *h0 = yhashi_create(NULL);
+	struct yhash *h1 = yhashi_create2(NULL, YHASH_open_addressing);
+
+	/* Engines are different. But keys are handled in the same way. */
+	yassert(yhash_is_sametype(h0, h1));
+	for (i = 0; i < 200000; i++) {
+		/* xorshift32 */
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		/* key '0' is valid too. */
+		j = seed % nkeys;
+		if (seed & 0x30000000) {
+			r0 = yhash_set(h0, (void *)(intptr_t)j,
+				(void *)(intptr_t)i);
+			r1 = yhash_set(h1, (void *)(intptr_t)j,
+				(void *)(intptr_t)i);
+		} else {
+			r0 = yhash_remove(h0, (void *)(intptr_t)j);
+			r1 = yhash_remove(h1, (void *)(intptr_t)j);
+		}
+		yassert(r0 == r1);
+		yassert(yhash_sz(h0) == yhash_sz(h1));
+	}
+	for (j = 0; j < nkeys; j++) {
+		r0 = yhash_get(h0, (void *)(intptr_t)j, &v0);
+		r1 = yhash_get(h1, (void *)(intptr_t)j, &v1);
+		yassert(r0 == r1 && (r0 || v0 == v1));
+	}
+	/* Remove all. Table should shrink and be still usable. */
+	for (j = 0; j < nkeys; j++)
+		yassert(yhash_remove(h0, (void *)(intptr_t)j)
+			== yhash_remove(h1, (void *)(intptr_t)j));
+	yassert(0 == yhash_sz(h1));
+	yassert(1 == yhash_set(h1, (void *)1, (void *)2));
+	yassert(!yhash_get(h1, (void *)1, &v1) && (void *)2 == v1);
+	yassert(0 == yhash_set2(h1, (void *)1, &v1, (void *)3)
+		&& (void *)2 == v1);
+
+	yhash_destroy(h0);
+	yhash_destroy(h1);
+}
+
+/* Hash starts as small table and is promoted as it grows */
+static void
+test_hash_grow(int opt) {
+	int i, n;
+	void *v;
+	const void *hkey;
+	char buf[32];
+	struct yhash *h, *h2;
+
+	for (n = 0; n < 40; n += 3) {
+		h = yhashs_create2(YHASH_MEM_FREE, TRUE, opt);
+		for (i = 0; i < n; i++) {
+			sprintf(buf, "%d", i);
+			yassert(1 == yhash_set3(h, &hkey, buf, ystrdup(buf)));
+			yassert(hkey != buf && !strcmp(hkey, buf));
+		}
+		yassert(n == yhash_sz(h));
+		/* Remove odd keys. */
+		for (i = 1; i < n; i += 2) {
+			sprintf(buf, "%d", i);
+			yassert(1 == yhash_remove(h, buf));
+			yassert(0 == yhash_remove(h, buf));
+		}
+		for (i = 0; i < n; i++) {
+			sprintf(buf, "%d", i);
+			if (i & 1)
+				yassert(!yhash_has(h, buf));
+			else
+				yassert(!yhash_get(h, buf, &v)
+					&& !strcmp(v, buf));
+		}
+		h2 = yhash_create(h);
+		yassert(yhash_is_sametype(h, h2));
+		yassert(0 == yhash_sz(h2));
+		yhash_destroy(h2);
+		yassert(!yhash_reset(h));
+		yassert(0 == yhash_sz(h));
+		for (i = 0; i < n; i++) {
+			sprintf(buf, "%d", i);
+			yassert(1 == yhash_set(h, buf, ystrdup(buf)));
+		}
+		yassert(n == yhash_sz(h));
+		yhash_destroy(h);
+	}
+}
+
+/* Keys are iterated in insertion order */
+static void
+test_hash_order(int opt) {
+	int i, j;
+	const int n = 3000;
+	const void **keys = ymalloc(sizeof(*keys) * n);
+	struct yhash *h = yhashi_create2(NULL, opt);
+
+	for (i = 0; i < n; i++)
+		yassert(1 == yhash_set(h, (void *)(intptr_t)i, NULL));
+	/* Replacing value doesn't change order. */
+	yassert(0 == yhash_set(h, (void *)(intptr_t)7, (void *)1));
+	/* Remove most of them. Table shrinks. */
+	for (i = 0; i < n; i++)
+		if (i % 50)
+			yassert(1 == yhash_remove(h, (void *)(intptr_t)i));
+	for (i = n - 1; i >= 0; i -= 50)
+		yassert(1 == yhash_set(h, (void *)(intptr_t)(n + i), NULL));
+	yassert(n / 50 * 2 == yhash_keys(h, keys, n));
+	for (i = 0, j = 0; j < n; j += 50)
+		yassert((intptr_t)keys[i++] == j);
+	for (j = n - 1; j >= 0; j -= 50)
+		yassert((intptr_t)keys[i++] == n + j);
+	yhash_destroy(h);
+	yfree(keys);
+}
+
+/*
+ * Hash is modified heavily(promotion, rehash and removing item at cursor)
+ *   while it is scanned by cursor.
+ */
+static void
+test_hash_cursor(int opt) {
+	int i, k, r;
+	void *v;
+	const void *key;
+	const int n = 2000;
+	/* 0: not in hash, 1: in hash for whole scan, 2: added/removed */
+	u8 *st = ycalloc(n * 2, 1);
+	u8 *visited = ycalloc(n * 2, 1);
+	struct yhash *h = yhashi_create2(NULL, opt);
+	struct yhash_cursor *c, *c2;
+
+	c = yhash_cursor_create(h);
+	yassert(-ENOENT == yhash_cursor_next(c, &key, &v));
+	yhash_cursor_destroy(c);
+
+	/* Start from small table. */
+	for (i = 0; i < 4; i++) {
+		yhash_set(h, (void *)(intptr_t)i, (void *)(intptr_t)(i + 1));
+		st[i] = 1;
+	}
+	c = yhash_cursor_create(h);
+	c2 = yhash_cursor_create(h);
+	k = 0;
+	while (!(r = yhash_cursor_next(c, &key, &v))) {
+		i = (int)(intptr_t)key;
+		yassert(v == (void *)(intptr_t)(i + 1));
+		yassert(st[i] && !visited[i]);
+		visited[i] = 1;
+		/* Add some items. */
+		if (k < n) {
+			for (i = 0; i < 3 && k < n; i++, k++) {
+				if (st[k])
+					continue;
+				yhash_set(h, (void *)(intptr_t)k,
+					(void *)(intptr_t)(k + 1));
+				st[k] = 2;
+			}
+		}
+		/* Remove item that is probably next to cursor. */
+		if (!yhash_cursor_next(c2, &key, NULL)
+			&& (intptr_t)key != (intptr_t)k
+		) {
+			i = (int)(intptr_t)key;
+			if (!visited[i] && 1 != st[i]) {
+				yassert(1 == yhash_remove(h, key));
+				st[i] = 0;
+			}
+		}
+	}
+	yassert(-ENOENT == r);
+	for (i = 0; i < n; i++) {
+		/* Items in the hash for whole scan are visited */
+		if (1 == st[i])
+			yassert(visited[i]);
+		/* Removed items are not visited after removal. */
+		if (!st[i] && visited[i])
+			yassert(0);
+	}
+	yhash_cursor_destroy(c);
+	yhash_cursor_destroy(c2);
+
+	/* Remove most of items while scanning. Table shrinks. */
+	c = yhash_cursor_create(h);
+	yassert(!yhash_cursor_next(c, &key, NULL));
+	k = yhash_sz(h);
+	for (i = 0; i < n; i++) {
+		if ((intptr_t)key != i && (i % 100))
+			k -= yhash_remove(h, (void *)(intptr_t)i);
+	}
+	i = 1;
+	while (!yhash_cursor_next(c, &key, NULL)) {
+		yassert(!((intptr_t)key % 100));
+		i++;
+	}
+	yassert(k == i);
+
+	/* Reset moves cursor to the end. */
+	yhash_cursor_destroy(c);
+	c = yhash_cursor_create(h);
+	yhash_reset(h);
+	yhash_set(h, (void *)1, NULL);
+	yassert(-ENOENT == yhash_cursor_next(c, &key, NULL));
+	yhash_cursor_destroy(c);
+
+	yhash_destroy(h);
+	yfree(st);
+	yfree(visited);
+}
+
+/*
+ * Capacity is reserved before bulk load, and hash is shrunk after bulk
+ *   remove while cursor is opened.
+ */
+static void
+test_hash_reserve(int opt) {
+	int i, n;
+	void *v;
+	const void *key;
+	const int nkeys = 20000;
+	struct yhash *h = yhashi_create2(NULL, opt);
+	struct yhash_cursor *c;
+
+	yassert(!yhash_reserve(h, 4));
+	yassert(!yhash_reserve(h, nkeys));
+	for (i = 0; i < nkeys; i++)
+		yassert(1 == yhash_set(h, (void *)(intptr_t)i,
+			(void *)(intptr_t)(i + 1)));
+	/* Clear reservation. Then hash can be shrunk. */
+	yassert(!yhash_reserve(h, 0));
+	c = yhash_cursor_create(h);
+	for (i = 0; i < 10; i++)
+		yassert(!yhash_cursor_next(c, &key, NULL)
+			&& (intptr_t)key == i);
+	for (i = 0; i < nkeys; i++)
+		if (i % 1000)
+			yassert(1 == yhash_remove(h, (void *)(intptr_t)i));
+	yassert(nkeys / 1000 == yhash_sz(h));
+	/* Cursor is still valid after shrinking. */
+	n = 0;
+	while (!yhash_cursor_next(c, &key, &v)) {
+		yassert(!((intptr_t)key % 1000));
+		yassert((intptr_t)v == (intptr_t)key + 1);
+		n++;
+	}
+	yassert(nkeys / 1000 - 1 == n);
+	yhash_cursor_destroy(c);
+	for (i = 0; i < nkeys; i++)
+		yassert(yhash_has(h, (void *)(intptr_t)i) == !(i % 1000));
+	/* Hash is still usable. */
+	for (i = 0; i < nkeys; i++)
+		yhash_set(h, (void *)(intptr_t)i, NULL);
+	yassert(nkeys == yhash_sz(h));
+	yhash_destroy(h);
+}
+
+/* Batched operations should give same result with one-by-one */
+static void
+test_hash_many(int opt) {
+	int i, r;
+	char buf[32];
+	const int n = 1000;
+	void **keys = ymalloc(sizeof(*keys) * n * 2);
+	void **vs = ymalloc(sizeof(*vs) * n * 2);
+	struct yhash *hi = yhashi_create2(NULL, opt);
+	struct yhash *hs = yhashs_create2(YHASH_MEM_FREE, TRUE, opt);
+
+	for (i = 0; i < n * 2; i++) {
+		keys[i] = (void *)(intptr_t)i;
+		vs[i] = (void *)(intptr_t)(i + 1);
+	}
+	/* Only even keys are set. Key '0' is valid too. */
+	for (i = 0; i < n; i++)
+		keys[i] = (void *)(intptr_t)(i * 2);
+	yassert(n == yhash_set_many(hi, keys, vs, n));
+	yassert(n == yhash_sz(hi));
+	/* Overwrite half of them. */
+	yassert(0 == yhash_set_many(hi, keys, vs + n, n / 2));
+	for (i = 0; i < n * 2; i++)
+		keys[i] = (void *)(intptr_t)i;
+	yassert(n == yhash_get_many(hi, (const void *const *)keys,
+		n * 2, vs));
+	for (i = 0; i < n * 2; i++) {
+		if (i & 1)
+			yassert(!vs[i]);
+		else
+			yassert(vs[i] == (void *)(intptr_t)(i < n
+				? n + i / 2 + 1
+				: i / 2 + 1));
+	}
+
+	for (i = 0; i < n; i++) {
+		sprintf(buf, "key%d", i);
+		keys[i] = ystrdup(buf);
+		vs[i] = ystrdup(buf);
+	}
+	/* Same key is twice in one batch. */
+	keys[n] = keys[1];
+	vs[n] = ystrdup("dup");
+	yassert(n == yhash_set_many(hs, keys, vs, n + 1));
+	for (i = 0; i < n; i++)
+		yfree(keys[i]);
+	keys[0] = "nokey";
+	for (i = 1; i < n; i++) {
+		sprintf(buf, "key%d", i);
+		keys[i] = ystrdup(buf);
+	}
+	yassert(n - 1 == yhash_get_many(hs, (const void *const *)keys,
+		n, vs));
+	yassert(!vs[0]);
+	yassert(!strcmp("dup", vs[1]));
+	for (i = 2; i < n; i++) {
+		yassert(!strcmp(keys[i], vs[i]));
+		r = yhash_get(hs, keys[i], &vs[0]);
+		yassert(!r && vs[0] == vs[i]);
+		yfree(keys[i]);
+	}
+	yfree(keys[1]);
+	yassert(0 == yhash_get_many(hs, NULL, 0, NULL));
+
+	yhash_destroy(hi);
+	yhash_destroy(hs);
+	yfree(keys);
+	yfree(vs);
+}
+
+static int
+sum_cb(const void *key, unused void *v, void *user) {
+	intptr_t *sum = user;
+	*sum += (intptr_t)key;
+	/* Stop at the key 'stop' */
+	return (intptr_t)key == sum[1] ? -1 : 0;
+}
+
+static bool
+keep_even(const void *key, unused void *v, unused void *user) {
+	return !((intptr_t)key & 1);
+}
+
+static bool
+keep_none(unused const void *key, unused void *v, unused void *user) {
+	return FALSE;
+}
+
+static bool
+keep_short(const void *key, unused void *v, unused void *user) {
+	return strlen(key) < 3;
+}
+
+static void
+test_hash_filter(int opt) {
+	int i;
+	intptr_t sum[2];
+	const void *key;
+	char buf[32];
+	struct yhash_cursor *c;
+	const int n = 1000;
+	struct yhash *h = yhashi_create2(NULL, opt);
+	struct yhash *hs = yhashs_create2(YHASH_MEM_FREE, TRUE, opt);
+
+	for (i = 0; i < n; i++)
+		yhash_set(h, (void *)(intptr_t)i, NULL);
+	sum[0] = 0;
+	sum[1] = -1;
+	yassert(!yhash_foreach(h, &sum_cb, sum));
+	yassert(sum[0] == n * (n - 1) / 2);
+	/* Visited in insertion order. So, 0 ~ 10 are visited. */
+	sum[0] = 0;
+	sum[1] = 10;
+	yassert(-1 == yhash_foreach(h, &sum_cb, sum));
+	yassert(55 == sum[0]);
+
+	/* Cursor at removed item moves to the next one. */
+	c = yhash_cursor_create(h);
+	yassert(!yhash_cursor_next(c, &key, NULL) && (void *)0 == key);
+	yassert(n / 2 == yhash_filter(h, &keep_even, NULL));
+	yassert(n / 2 == yhash_sz(h));
+	yassert(!yhash_cursor_next(c, &key, NULL) && (void *)2 == key);
+	for (i = 0; i < n; i++)
+		yassert(yhash_has(h, (void *)(intptr_t)i) == !(i & 1));
+	yassert(n / 2 == yhash_filter(h, &keep_none, NULL));
+	yassert(!yhash_sz(h));
+	yassert(-ENOENT == yhash_cursor_next(c, &key, NULL));
+	yhash_cursor_destroy(c);
+	/* Hash is still usable after it is shrunk */
+	for (i = 0; i < n; i++)
+		yassert(1 == yhash_set(h, (void *)(intptr_t)i, NULL));
+	yassert(n == yhash_sz(h));
+
+	/* Keys and values are freed. Small table too. */
+	for (i = 0; i < 5; i++) {
+		sprintf(buf, "%d", i * 50);
+		yhash_set(hs, buf, ystrdup(buf));
+	}
+	yassert(3 == yhash_filter(hs, &keep_short, NULL));
+	yassert(2 == yhash_sz(hs) && yhash_has(hs, "0") && yhash_has(hs, "50"));
+	for (i = 0; i < n; i++) {
+		sprintf(buf, "%d", i);
+		yhash_set(hs, buf, ystrdup(buf));
+	}
+	yassert(n - 100 == yhash_filter(hs, &keep_short, NULL));
+	yassert(100 == yhash_sz(hs) && yhash_has(hs, "99"));
+
+	yhash_destroy(h);
+	yhash_destroy(hs);
+}
+
+static void
+test_hash_stat(int opt) {
+#ifdef CONFIG_HASH_STAT
+	int i, fd;
+	u32 j, nitems;
+	const int n = 1000;
+#endif /* CONFIG_HASH_STAT */
+	struct yhash_stat st;
+	struct yhash *h = yhashi_create2(NULL, opt);
+
+#ifndef CONFIG_HASH_STAT
+	yassert(-ENOTSUP == yhash_stat(h, &st));
+	yassert(-ENOTSUP == yhash_stat_print(h, 1));
+#else /* CONFIG_HASH_STAT */
+	yassert(!yhash_stat(h, &st));
+	yassert(!st.sz && !st.nset && !st.nrehash);
+	/* small table */
+	for (i = 0; i < 3; i++)
+		yhash_set(h, (void *)(intptr_t)i, NULL);
+	yassert(!yhash_stat(h, &st));
+	yassert(3 == st.sz && 3 == st.nset && !st.nrehash);
+	for (j = 0; j < 3; j++)
+		yassert(1 == st.probe[j]);
+
+	for (i = 3; i < n; i++)
+		yhash_set(h, (void *)(intptr_t)i, NULL);
+	yhash_set(h, (void *)0, NULL); /* replace */
+	for (i = 0; i < n * 2; i++)
+		yhash_get(h, (void *)(intptr_t)i, NULL);
+	yhash_get_many(h, (const void *const []){(void *)1, (void *)-1},
+		2, (void *[2]){});
+	for (i = 0; i < n / 2; i++)
+		yhash_remove(h, (void *)(intptr_t)i);
+	yhash_remove(h, (void *)-1); /* not in the hash */
+	yassert(!yhash_stat(h, &st));
+	yassert(n + 1 == st.nset
+		&& n * 2 + 2 == st.nget
+		&& n + 1 == st.nget_miss
+		&& n / 2 == st.nremove);
+	/* promotion and growths */
+	yassert(st.nrehash > 1 && st.rehash_max_ns <= st.rehash_ns);
+	yassert(n / 2 == st.sz && st.cap >= st.sz / 2
+		&& st.load == (double)st.sz / (double)st.cap);
+	nitems = 0;
+	for (j = 0; j < YHASH_STAT_HIST_SZ; j++) {
+		nitems += st.probe[j];
+		if (opt & YHASH_open_addressing)
+			yassert(!st.chain[j]);
+	}
+	yassert(nitems == st.sz);
+	/* Sequential integer keys should be spread over buckets. */
+	yassert(!st.chain[YHASH_STAT_HIST_SZ - 1]
+		&& !st.probe[YHASH_STAT_HIST_SZ - 1]);
+
+	fd = open("/dev/null", O_WRONLY);
+	yassert(fd >= 0);
+	yassert(!yhash_stat_print(h, fd));
+	yassert(-EINVAL == yhash_stat_print(h, -1));
+	close(fd);
+#endif /* CONFIG_HASH_STAT */
+	yhash_destroy(h);
+}
 
 static void
 test_hash(void) {
-	test_hasho();
-	test_hashs();
-	test_hashi();
+	int i;
+	const int opts[] = {
+		0,
+		YHASH_open_addressing,
+		YHASH_fast_hash,
+		YHASH_open_addressing | YHASH_fast_hash
+	};
+	for (i = 0; i < yut_arrsz(opts); i++) {
+		test_hasho(opts[i]);
+		test_hashs(opts[i]);
+		test_hashi(opts[i]);
+		test_hashb(opts[i]);
+		test_hash_many(opts[i]);
+		test_hash_grow(opts[i]);
+		test_hash_order(opts[i]);
+		test_hash_cursor(opts[i]);
+		test_hash_reserve(opts[i]);
+		test_hash_stat(opts[i]);
+		test_hash_filter(opts[i]);
+	}
+	test_hash_engines();
+	test_hash_sametype();
 }
 
 TESTFN(hash)
 
+
+#define PERF_NKEYS (1024 * 1024)
+#define PERF_BATCH 256
+
+static void
+perf_hash_run(
+	const char *label,
+	struct yhash *h,
+	void **keys,
+	int nkeys
+) {
+	int i;
+	void *v;
+	u64 t, t0, tmax;
+	void **vs;
+	double tset, tget, tmany, tmiss, tremove;
+
+	/* Worst-case latency of one insert */
+	tmax = 0;
+	t0 = t = yut_current_time_us();
+	for (i = 0; i < nkeys; i++) {
+		yhash_set(h, keys[i], keys[i]);
+		t = yut_current_time_us() - t;
+		if (unlikely(t > tmax))
+			tmax = t;
+		t = yut_current_time_us();
+	}
+	tset = (double)(yut_current_time_us() - t0);
+	t = yut_current_time_us();
+	for (i = 0; i < nkeys; i++)
+		yassert(!yhash_get(h, keys[i], &v));
+	tget = (double)(yut_current_time_us() - t);
+	/* Lookup in batches */
+	vs = ymalloc(sizeof(*vs) * PERF_BATCH);
+	t = yut_current_time_us();
+	for (i = 0; i < nkeys; i += PERF_BATCH)
+		yassert(PERF_BATCH == yhash_get_many(h,
+			(const void *const *)&keys[i], PERF_BATCH, vs));
+	tmany = (double)(yut_current_time_us() - t);
+	yfree(vs);
+	/* Keys at the 2nd half are removed and then looked up(miss). */
+	for (i = nkeys / 2; i < nkeys; i++)
+		yhash_remove(h, keys[i]);
+	t = yut_current_time_us();
+	for (i = nkeys / 2; i < nkeys; i++)
+		yassert(yhash_get(h, keys[i], &v));
+	tmiss = (double)(yut_current_time_us() - t) * 2;
+	t = yut_current_time_us();
+	for (i = 0; i < nkeys / 2; i++)
+		yhash_remove(h, keys[i]);
+	tremove = (double)(yut_current_time_us() - t) * 2;
+	yassert(0 == yhash_sz(h));
+	printf("%-16s %10.2f %10.2f %10.2f %10.2f %10.2f %10llu\n",
+		label,
+		nkeys / (tset ? tset : 1),
+		nkeys / (tget ? tget : 1),
+		nkeys / (tmany ? tmany : 1),
+		nkeys / (tmiss ? tmiss : 1),
+		nkeys / (tremove ? tremove : 1),
+		(unsigned long long)tmax);
+	yhash_destroy(h);
+}
+
+/* Create, fill with a few items and destroy lots of tiny tables */
+static void
+perf_hash_tiny(void) {
+	int i, j, k;
+	u64 t;
+	struct yhash *h;
+	const int ntables = 256 * 1024;
+	const int nitems[] = { 2, 8, 32 };
+
+	printf("hash: tiny tables. M tables/sec (%d tables)\n", ntables);
+	for (j = 0; j < yut_arrsz(nitems); j++) {
+		t = yut_current_time_us();
+		for (i = 0; i < ntables; i++) {
+			h = yhashi_create(NULL);
+			for (k = 0; k < nitems[j]; k++)
+				yhash_set(h, (void *)(intptr_t)k,
+					(void *)(intptr_t)k);
+			yassert(yhash_has(h, (void *)1));
+			yhash_destroy(h);
+		}
+		t = yut_current_time_us() - t;
+		printf("%-16d %10.2f\n", nitems[j],
+			(double)ntables / (t ? t : 1));
+	}
+}
+
+/* Bulk load with and without reserving capacity */
+static void
+perf_hash_reserve(void) {
+	int i, j, k;
+	u64 t;
+	double tm[2];
+	struct yhash *h;
+	const int opts[] = { 0, YHASH_open_addressing };
+	const char *names[] = { "chain", "oa" };
+
+	printf("hash: bulk load. M ops/sec (%d keys)\n", PERF_NKEYS);
+	printf("%-16s %10s %10s\n", "", "set", "reserved");
+	for (j = 0; j < yut_arrsz(opts); j++) {
+		for (k = 0; k < 2; k++) {
+			h = yhashi_create2(NULL, opts[j]);
+			t = yut_current_time_us();
+			if (k)
+				yassert(!yhash_reserve(h, PERF_NKEYS));
+			for (i = 0; i < PERF_NKEYS; i++)
+				yhash_set(h, (void *)((intptr_t)i * 2654435761U),
+					NULL);
+			tm[k] = (double)(yut_current_time_us() - t);
+			yhash_destroy(h);
+		}
+		printf("%-16s %10.2f %10.2f\n", names[j],
+			PERF_NKEYS / (tm[0] ? tm[0] : 1),
+			PERF_NKEYS / (tm[1] ? tm[1] : 1));
+	}
+}
+
+static void
+perf_hash(void) {
+	int i, j;
+	char buf[64];
+	void **keys = ymalloc(sizeof(*keys) * PERF_NKEYS);
+	const int opts[] = {
+		0,
+		YHASH_open_addressing,
+		YHASH_fast_hash,
+		YHASH_open_addressing | YHASH_fast_hash
+	};
+	const char *names[] = { "chain", "oa", "chain+fast", "oa+fast" };
+
+	printf("hash: M ops/sec (%d keys)\n", PERF_NKEYS);
+	printf("%-16s %10s %10s %10s %10s %10s %10s\n",
+		"", "set", "get", "get-many", "get-miss", "remove", "max-set(us)");
+	for (j = 0; j < yut_arrsz(opts); j++) {
+		for (i = 0; i < PERF_NKEYS; i++)
+			/* Sparse integer keys */
+			keys[i] = (void *)((intptr_t)i * 2654435761U);
+		snprintf(buf, sizeof(buf), "int/%s", names[j]);
+		perf_hash_run(buf, yhashi_create2(NULL, opts[j]),
+			keys, PERF_NKEYS);
+		for (i = 0; i < PERF_NKEYS; i++) {
+			snprintf(buf, sizeof(buf), "key-%d", i);
+			keys[i] = ystrdup(buf);
+		}
+		snprintf(buf, sizeof(buf), "str/%s", names[j]);
+		perf_hash_run(buf, yhashs_create2(NULL, TRUE, opts[j]),
+			keys, PERF_NKEYS);
+		for (i = 0; i < PERF_NKEYS; i++)
+			yfree(keys[i]);
+	}
+	yfree(keys);
+	perf_hash_tiny();
+	perf_hash_reserve();
+}
+
+PERFFN(hash)
+
 #endif /* CONFIG_TEST */
@@ -37,9 +37,13 @@
 #include "test.h"
 #ifdef CONFIG_TEST
 
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "yhashl.h"
+#include "ycrc.h"
+#include "yut.h"
 
 struct item {
 	struct yhashl_node hn;
@@ -47,13 +51,13 @@ struct item {
 };
 
 static void
-test_hashl(void) {
+test_hashl_basic(yhashl_hfunc_t hfunc) {
 	int i;
 	struct yhashl_node *rn, *tmp;
 	struct item *itm;
 	char sbuf[128];
 	struct yhashl *h = ymalloc(sizeof(*h));
-	yhashl_init(h, YHASHL_HFUNC_STR, YHASHL_KEYEQ_STR);
+	yhashl_init(h, hfunc, YHASHL_KEYEQ_STR);
 	for (i = 0; i < 1024; i++) {
 		itm = ymalloc(sizeof(*itm));
 		sprintf(sbuf, "item-%d", i);
@@ -80,6 +84,256 @@ test_hashl(void) {
 	yfree(h);
 }
 
+#define NR_ITEMS 4096
+
+static u32
+hfunc_int(const void *k) {
+	return (u32)(intptr_t)k * 2654435761U;
+}
+
+/* Check that hash has items 'i' where 'in[i]' is TRUE, and only them. */
+static void
+verify_items(struct yhashl *h, struct item **items, const bool *in) {
+	int i;
+	u32 cnt = 0;
+	struct yhashl_node *n;
+	for (i = 0; i < NR_ITEMS; i++) {
+		n = yhashl_get(h, (void *)(intptr_t)i);
+		yassert(in[i] ? n == &items[i]->hn : !n);
+	}
+	yhashl_foreach(h, n) {
+		yassert(in[containerof(n, struct item, hn)->v]);
+		cnt++;
+	}
+	yassert(cnt == yhashl_sz(h));
+}
+
+/* Histograms should be consistent with items in the hash. */
+static void
+verify_hist(const struct yhashl *h) {
+	u32 i, nb, nitems;
+	u32 chain[64], probe[64];
+	u32 below; /* number of buckets having less than i nodes */
+	nb = yhashl_hist(h, chain, probe, yut_arrsz(chain));
+	nitems = below = 0;
+	for (i = 0; i < yut_arrsz(chain); i++) {
+		/* i-th node exists at buckets having more than i nodes */
+		yassert(probe[i] == nb - below - chain[i]
+			|| i == yut_arrsz(chain) - 1);
+		below += chain[i];
+		nitems += probe[i];
+	}
+	yassert(nb == below);
+	yassert(nitems == yhashl_sz(h));
+	/* Last bin has all the rest. */
+	yassert(nb == yhashl_hist(h, NULL, probe, 1));
+	yassert(probe[0] == yhashl_sz(h));
+}
+
+/* Keep changing hash until remapping is done. */
+static void
+remap_and_verify(
+	struct yhashl *h,
+	u32 bits,
+	struct item **items,
+	bool *in,
+	int *next
+) {
+	int i;
+	yassert(!yhashl_hremap2(h, bits, TRUE));
+	yassert(yhashl_is_remapping(h));
+	yassert(bits == h->mapbits);
+	while (yhashl_is_remapping(h)) {
+		/* Remove one and add one. */
+		i = *next % NR_ITEMS;
+		if (in[i]) {
+			yassert(&items[i]->hn
+				== yhashl_remove(h, (void *)(intptr_t)i));
+			in[i] = FALSE;
+		}
+		i = (*next + NR_ITEMS / 2) % NR_ITEMS;
+		if (!in[i]) {
+			yassert(!yhashl_set(h, (void *)(intptr_t)i,
+				&items[i]->hn));
+			in[i] = TRUE;
+		}
+		(*next)++;
+		verify_items(h, items, in);
+		verify_hist(h);
+	}
+	verify_items(h, items, in);
+}
+
+static void
+test_hashl_remap(void) {
+	int i, next = 0;
+	u32 cnt;
+	struct yhashl_node *n, *tmp;
+	struct yhashl h;
+	struct item *items[NR_ITEMS];
+	bool in[NR_ITEMS];
+
+	yassert(!yhashl_init2(&h, &hfunc_int, YHASHL_KEYEQ_PTR, 4));
+	for (i = 0; i < NR_ITEMS; i++) {
+		items[i] = ymalloc(sizeof(*items[i]));
+		items[i]->v = i;
+		in[i] = i < NR_ITEMS / 2;
+		if (in[i])
+			yassert(!yhashl_set(&h, (void *)(intptr_t)i,
+				&items[i]->hn));
+	}
+	verify_items(&h, items, in);
+	/* grow */
+	remap_and_verify(&h, 10, items, in, &next);
+	/* shrink */
+	remap_and_verify(&h, 6, items, in, &next);
+
+	/* Remapping in progress is completed by next remapping */
+	yassert(!yhashl_hremap2(&h, 9, TRUE));
+	yassert(yhashl_hremap_step(&h, 1) > 0);
+	yassert(!yhashl_hremap(&h, 7));
+	yassert(!yhashl_is_remapping(&h));
+	yassert(7 == h.mapbits);
+	verify_items(&h, items, in);
+
+	/* Clean up in the middle of remapping */
+	yassert(!yhashl_hremap2(&h, 11, TRUE));
+	yhashl_hremap_step(&h, 3);
+	yassert(yhashl_is_remapping(&h));
+	verify_items(&h, items, in);
+
+	/* Removing current node while iterating doesn't move nodes. */
+	cnt = yhashl_sz(&h);
+	yhashl_foreach_safe(&h, n, tmp) {
+		i = containerof(n, struct item, hn)->v;
+		yassert(in[i]);
+		yassert(n == yhashl_remove(&h, (void *)(intptr_t)i));
+		in[i] = FALSE;
+		cnt--;
+	}
+	yassert(!cnt && !yhashl_sz(&h));
+	yassert(yhashl_is_remapping(&h));
+	verify_items(&h, items, in);
+	yhashl_clean(&h);
+	for (i = 0; i < NR_ITEMS; i++)
+		yfree(items[i]);
+}
+
+static void
+test_hashl_fast(void) {
+	int i, j;
+	u8 buf[256 + 8];
+	u64 hv[256];
+	u64 seed = yhashl_new_seed();
+
+	yassert(seed != yhashl_new_seed());
+	for (i = 0; i < yut_arrsz(buf); i++)
+		buf[i] = (u8)(i * 7 + 1);
+	for (i = 0; i < yut_arrsz(hv); i++) {
+		hv[i] = yhashl_fast(buf, i, seed);
+		/* deterministic and independent of alignment */
+		yassert(hv[i] == yhashl_fast(buf, i, seed));
+		memmove(buf + 3, buf, i);
+		yassert(hv[i] == yhashl_fast(buf + 3, i, seed));
+		memmove(buf, buf + 3, i);
+		yassert(hv[i] != yhashl_fast(buf, i, seed + 1));
+		/* every byte affects hash value */
+		for (j = 0; j < i; j++) {
+			buf[j] ^= 0x10;
+			yassert(hv[i] != yhashl_fast(buf, i, seed));
+			buf[j] ^= 0x10;
+		}
+		for (j = 0; j < i; j++)
+			yassert(hv[i] != hv[j]);
+	}
+	yassert(yhashl_fast_u64(1, seed) != yhashl_fast_u64(2, seed));
+	yassert(yhashl_fast_u64(1, seed) != yhashl_fast_u64(1, seed + 1));
+}
+
+static void
+test_hashl(void) {
+	test_hashl_basic(YHASHL_HFUNC_STR);
+	test_hashl_basic(YHASHL_HFUNC_FAST_STR);
+	test_hashl_remap();
+	test_hashl_fast();
+}
+
 TESTFN(hashl)
 
+
+static const u32 _perfszs[] = { 4, 8, 16, 32, 64, 256, 4096 };
+
+static void
+perf_hashl(void) {
+	int i, j;
+	u32 k, n, sz;
+	u64 t, hv = 0;
+	char sbuf[64];
+	char **keys;
+	struct yhashl h;
+	struct item *items;
+	const u32 total = 64 * 1024 * 1024;
+	const u32 nkeys = 1024 * 1024;
+	const yhashl_hfunc_t hfuncs[] = {
+		YHASHL_HFUNC_STR,
+		YHASHL_HFUNC_FAST_STR
+	};
+	u8 *buf = ymalloc(_perfszs[yut_arrsz(_perfszs) - 1]);
+
+	memset(buf, 0x5a, _perfszs[yut_arrsz(_perfszs) - 1]);
+	printf("hash functions: GB/s\n");
+	printf("%10s %10s %10s\n", "size", "ycrc32", "yhashl_fast");
+	for (i = 0; i < yut_arrsz(_perfszs); i++) {
+		sz = _perfszs[i];
+		n = total / sz;
+		printf("%10u", sz);
+		for (j = 0; j < 2; j++) {
+			t = yut_current_time_us();
+			for (k = 0; k < n; k++)
+				hv += j ? yhashl_fast(buf, sz, k)
+					: ycrc32(k, buf, sz);
+			t = yut_current_time_us() - t;
+			printf(" %10.3f", (double)total / (t ? t : 1) / 1000);
+		}
+		printf("\n");
+	}
+	yfree(buf);
+
+	keys = ymalloc(sizeof(*keys) * nkeys);
+	items = ymalloc(sizeof(*items) * nkeys);
+	for (k = 0; k < nkeys; k++) {
+		snprintf(sbuf, sizeof(sbuf), "/some/path/of/request/%u", k);
+		keys[k] = ystrdup(sbuf);
+	}
+	/* Lookup order should not be same with insertion order. */
+	for (k = nkeys - 1; k > 0; k--) {
+		char *tmp = keys[k];
+		n = (u32)(yhashl_fast_u64(k, 0) % (k + 1));
+		keys[k] = keys[n];
+		keys[n] = tmp;
+	}
+	printf("yhashl lookup(%u string keys): M ops/sec\n", nkeys);
+	for (j = 0; j < yut_arrsz(hfuncs); j++) {
+		yhashl_init2(&h, hfuncs[j], YHASHL_KEYEQ_STR, 20);
+		for (k = 0; k < nkeys; k++)
+			yhashl_set(&h, keys[k], &items[k].hn);
+		t = yut_current_time_us();
+		for (k = 0; k < nkeys; k++)
+			hv += !!yhashl_get(&h, keys[nkeys - 1 - k]);
+		t = yut_current_time_us() - t;
+		printf("%-16s %10.2f\n",
+			j ? "FAST_STR" : "STR(crc)",
+			(double)nkeys / (t ? t : 1));
+		yhashl_clean(&h);
+	}
+	for (k = 0; k < nkeys; k++)
+		yfree(keys[k]);
+	yfree(keys);
+	yfree(items);
+	/* To avoid that compiler optimizes out above loops. */
+	printf("(%llx)\n", (unsigned long long)hv);
+}
+
+PERFFN(hashl)
+
 #endif /* CONFIG_TEST */
@@ -37,9 +37,15 @@
 #include "test.h"
 #ifdef CONFIG_TEST
 
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
 
 #include "ylru.h"
+#include "yut.h"
+
+#define iptr(i) ((void *)(intptr_t)(i))
 
 
 unused static void
@@ -61,7 +67,7 @@ data_size(const void *d) {
 }
 
 static void
-test_lru(void) {
+test_lru_basic(void) {
 	int *pi;
 	struct ylru *lru = ylrus_create(
 		sizeof(int) * 3,
@@ -128,7 +134,242 @@ test_lru(void) {
 	ylru_destroy(lru);
 }
 
+static int *
+ivalue(int i) {
+	int *v = ymalloc(sizeof(*v));
+	*v = i;
+	return v;
+}
+
+static void
+test_lru_policy(int policy) {
+	int i, n, *pi;
+	void *v;
+	struct ylru *lru = ylrus_create2(
+		sizeof(int) * 10,
+		YLRU_PREDEFINED_FREE,
+		NULL,
+		&data_size,
+		policy);
+	char key[32];
+
+	for (i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%d", i);
+		yassert(!ylru_put(lru, key, ivalue(i)));
+		yassert(sizeof(int) * 10 >= ylru_sz(lru));
+		/* Newly put data is not evicted by itself. */
+		yassert(!ylru_peek(lru, (void **)&pi, key));
+		yassert(i == *pi);
+	}
+	n = 0;
+	for (i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%d", i);
+		if (!ylru_peek(lru, (void **)&pi, key)) {
+			yassert(i == *pi);
+			n++;
+		}
+	}
+	yassert(sizeof(int) * n == ylru_sz(lru));
+
+	/* Replace */
+	yassert(!ylru_put(lru, "k99", ivalue(999)));
+	yassert(sizeof(int) * n == ylru_sz(lru));
+	yassert(!ylru_peek(lru, (void **)&pi, "k99"));
+	yassert(999 == *pi);
+
+	/* Take out and put again */
+	yassert(!ylru_get(lru, (void **)&pi, "k99"));
+	yassert(999 == *pi);
+	yassert(sizeof(int) * (n - 1) == ylru_sz(lru));
+	yassert(1 == ylru_get(lru, &v, "k99"));
+	yassert(!ylru_put(lru, "k99", pi));
+	yassert(sizeof(int) * n == ylru_sz(lru));
+
+	ylru_reset(lru);
+	yassert(0 == ylru_sz(lru));
+	yassert(1 == ylru_peek(lru, &v, "k99"));
+	ylru_destroy(lru);
+
+	lru = ylrus_create2(
+		sizeof(int) * 3,
+		YLRU_PREDEFINED_FREE,
+		&data_create,
+		&data_size,
+		policy);
+	for (i = 0; i < 10; i++) {
+		snprintf(key, sizeof(key), "k%d", i);
+		yassert(0 == ylru_peek(lru, (void **)&pi, key));
+		yassert(10 == *pi);
+	}
+	yassert(sizeof(int) * 3 == ylru_sz(lru));
+	ylru_destroy(lru);
+}
+
+/*
+ * Hot keys are accessed several times, and then long scan follows.
+ * @return Number of hot keys surviving the scan.
+ */
+static int
+lru_scan_survivors(int policy) {
+	int i, j, n;
+	void *v;
+	struct ylru *lru = ylrui_create2(1000, NULL, NULL, NULL, policy);
+	for (j = 0; j < 10; j++) {
+		for (i = 0; i < 100; i++) {
+			if (ylru_peek(lru, &v, iptr(i)))
+				yassert(!ylru_put(lru, iptr(i), iptr(i)));
+		}
+	}
+	for (i = 1000; i < 100000; i++) {
+		if (ylru_peek(lru, &v, iptr(i)))
+			yassert(!ylru_put(lru, iptr(i), iptr(i)));
+	}
+	yassert(1000 == ylru_sz(lru));
+	n = 0;
+	for (i = 0; i < 100; i++)
+		n += !ylru_peek(lru, &v, iptr(i));
+	ylru_destroy(lru);
+	return n;
+}
+
+static void
+test_lru_scan(void) {
+	yassert(0 == lru_scan_survivors(YLRU_POLICY_LRU));
+	yassert(90 <= lru_scan_survivors(YLRU_POLICY_S3FIFO));
+	yassert(90 <= lru_scan_survivors(YLRU_POLICY_WTINYLFU));
+}
+
+static void
+test_lru(void) {
+	int i;
+	const int policies[] = {
+		YLRU_POLICY_LRU,
+		YLRU_POLICY_CLOCK,
+		YLRU_POLICY_S3FIFO,
+		YLRU_POLICY_WTINYLFU,
+	};
+	test_lru_basic();
+	for (i = 0; i < yut_arrsz(policies); i++)
+		test_lru_policy(policies[i]);
+	test_lru_scan();
+}
 
 TESTFN(lru)
 
+
+/*
+ * Trace replay benchmark.
+ * Trace is sequence of keys. Missed key is put to the cache.
+ */
+#define TRACE_LEN (2 * 1024 * 1024)
+#define TRACE_NKEYS (100 * 1000)
+#define TRACE_CACHESZ (10 * 1000)
+
+static INLINE u32
+xorshift(u32 *s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+/* Zipf(alpha = 0.99) over TRACE_NKEYS keys */
+static void
+trace_zipf(u32 *trace, u32 len) {
+	u32 i, lo, hi, mid, seed = 1;
+	double r;
+	double *cdf = ymalloc(sizeof(*cdf) * TRACE_NKEYS);
+	cdf[0] = 1;
+	for (i = 1; i < TRACE_NKEYS; i++)
+		cdf[i] = cdf[i - 1] + 1 / pow(i + 1, 0.99);
+	for (i = 0; i < len; i++) {
+		r = (double)xorshift(&seed) / UINT32_MAX * cdf[TRACE_NKEYS - 1];
+		lo = 0;
+		hi = TRACE_NKEYS - 1;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (cdf[mid] < r)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		trace[i] = lo;
+	}
+	yfree(cdf);
+}
+
+/* Zipf with periodic scans of keys that are never used again */
+static void
+trace_zipf_scan(u32 *trace, u32 len) {
+	u32 i, j, next = TRACE_NKEYS;
+	trace_zipf(trace, len);
+	for (i = 0; i + 300 * 1000 <= len; i += 300 * 1000)
+		for (j = 0; j < 50 * 1000; j++)
+			trace[i + j] = next++;
+}
+
+/* Loop slightly larger than cache */
+static void
+trace_loop(u32 *trace, u32 len) {
+	u32 i;
+	for (i = 0; i < len; i++)
+		trace[i] = i % (TRACE_CACHESZ * 6 / 5);
+}
+
+static void
+perf_lru(void) {
+	int i, j;
+	u32 k, nhits;
+	u64 t;
+	void *v;
+	struct ylru *lru;
+	u32 *trace = ymalloc(sizeof(*trace) * TRACE_LEN);
+	const struct {
+		const char *name;
+		void (*gen)(u32 *, u32);
+	} traces[] = {
+		{ "zipf", &trace_zipf },
+		{ "zipf+scan", &trace_zipf_scan },
+		{ "loop", &trace_loop },
+	};
+	const struct {
+		const char *name;
+		int policy;
+	} policies[] = {
+		{ "lru", YLRU_POLICY_LRU },
+		{ "clock", YLRU_POLICY_CLOCK },
+		{ "s3fifo", YLRU_POLICY_S3FIFO },
+		{ "wtinylfu", YLRU_POLICY_WTINYLFU },
+	};
+
+	printf("lru: trace replay (%d accesses, cache %d)\n",
+		TRACE_LEN, TRACE_CACHESZ);
+	printf("%10s %10s %8s %10s\n", "trace", "policy", "hit(%)", "M ops/s");
+	for (i = 0; i < yut_arrsz(traces); i++) {
+		(*traces[i].gen)(trace, TRACE_LEN);
+		for (j = 0; j < yut_arrsz(policies); j++) {
+			lru = ylrui_create2(TRACE_CACHESZ, NULL, NULL, NULL,
+				policies[j].policy);
+			nhits = 0;
+			t = yut_current_time_us();
+			for (k = 0; k < TRACE_LEN; k++) {
+				if (!ylru_peek(lru, &v, iptr(trace[k])))
+					nhits++;
+				else
+					ylru_put(lru, iptr(trace[k]),
+						iptr(trace[k]));
+			}
+			t = yut_current_time_us() - t;
+			printf("%10s %10s %8.2f %10.2f\n",
+				traces[i].name, policies[j].name,
+				(double)nhits * 100 / TRACE_LEN,
+				(double)TRACE_LEN / (t ? t : 1));
+			ylru_destroy(lru);
+		}
+	}
+	yfree(trace);
+}
+
+PERFFN(lru)
+
 #endif /* CONFIG_TEST */
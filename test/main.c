@@ -63,6 +63,7 @@ struct memblk {
 };
 
 static YLISTL_DEFINE_HEAD(_tstfnl);
+static YLISTL_DEFINE_HEAD(_perffnl);
 static YLISTL_DEFINE_HEAD(_memhd);
 static int _mem_count = 0;
 static pthread_mutex_t _mem_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -125,20 +126,20 @@ print_mem(void) {
  *
  *
  *****************************************************************************/
-void
-dregister_tstfn(void (*fn)(void), const char *mod) {
+static void
+register_fn(struct ylistl_link *hd, void (*fn)(void), const char *mod) {
 	/* malloc should be used instead of dmalloc */
 	struct tstfn* n = malloc(sizeof(*n));
 	n->fn = fn;
 	n->clear = NULL;
 	n->modname = mod;
-	ylistl_add_last(&_tstfnl, &n->lk);
+	ylistl_add_last(hd, &n->lk);
 }
 
-void
-dunregister_tstfn(void (*fn)(void), const char *mod) {
+static void
+unregister_fn(struct ylistl_link *hd, void (*fn)(void), const char *mod) {
 	struct tstfn *p, *n;
-	ylistl_foreach_item_safe(p, n, &_tstfnl, struct tstfn, lk) {
+	ylistl_foreach_item_safe(p, n, hd, struct tstfn, lk) {
 		if (p->fn == fn && !strcmp(p->modname, mod)) {
 			ylistl_remove(&p->lk);
 			free(p);
@@ -146,6 +147,26 @@ dunregister_tstfn(void (*fn)(void), const char *mod) {
 	}
 }
 
+void
+dregister_tstfn(void (*fn)(void), const char *mod) {
+	register_fn(&_tstfnl, fn, mod);
+}
+
+void
+dunregister_tstfn(void (*fn)(void), const char *mod) {
+	unregister_fn(&_tstfnl, fn, mod);
+}
+
+void
+dregister_perffn(void (*fn)(void), const char *mod) {
+	register_fn(&_perffnl, fn, mod);
+}
+
+void
+dunregister_perffn(void (*fn)(void), const char *mod) {
+	unregister_fn(&_perffnl, fn, mod);
+}
+
 void
 dregister_clearfn(void (*fn)(void), const char *mod) {
 	struct tstfn *p;
@@ -226,6 +247,7 @@ struct opt {
 	const char *mods[1024]; /* 1024 is large enough value */
 	int repeat_cnt;
 	int loglv;
+	bool perf;
 };
 
 static void
@@ -241,7 +263,10 @@ print_usage(const char *cmd) {
 "        if < 1 or invalid-value then 1 is set.\n"
 "    -l log-level: Default 4\n"
 "        0(verbose) ~ 4(err) ~ 6(disable).\n"
-"        if < 0 or invalid-value then 0, and > 6 then 6 is set.\n",
+"        if < 0 or invalid-value then 0, and > 6 then 6 is set.\n"
+"    -p\n"
+"        run performance measurements instead of tests.\n"
+"        each measurement is run only once.\n",
 	cmd);
 }
 
@@ -251,7 +276,7 @@ parse_optarg(struct opt *opt, int argc, char **argv) {
 	int i;
 	const char **pmod;
 	opterr = 0;
-	while (-1 != (c = getopt(argc, argv, "hc:l:"))) {
+	while (-1 != (c = getopt(argc, argv, "hc:l:p"))) {
 		switch (c) {
 		case 'h':
 			print_usage("y");
@@ -270,6 +295,9 @@ parse_optarg(struct opt *opt, int argc, char **argv) {
 				v = 6;
 			opt->loglv = v;
 		} break;
+		case 'p':
+			opt->perf = TRUE;
+			break;
 		case '?':
 			if (isprint (optopt))
 				fprintf(stderr,
@@ -330,6 +358,7 @@ int
 main(int argc, char *argv[]) {
 	struct opt opt;
 	const char **pmod;
+	struct ylistl_link *fnl;
 
 	/* Set default values */
 	memset(&opt, 0, sizeof(opt));
@@ -346,6 +375,11 @@ main(int argc, char *argv[]) {
 	yc.ylog_stdfd = yc.ylog_errfd = -1;
 	yc.ylog_level = opt.loglv;
 	ylib_init(&yc);
+	fnl = &_tstfnl;
+	if (opt.perf) {
+		fnl = &_perffnl;
+		opt.repeat_cnt = 1;
+	}
 	/* This mechanism is ineffective but simple - O(n^2).
 	 * If performance becomes matter, use hashmap!
 	 */
@@ -353,7 +387,7 @@ main(int argc, char *argv[]) {
 	if (!opt.mods[0]) {
 		struct tstfn *p;
 		pmod = &opt.mods[0];
-		ylistl_foreach_item(p, &_tstfnl, struct tstfn, lk) {
+		ylistl_foreach_item(p, fnl, struct tstfn, lk) {
 			*pmod++ = p->modname;
 		}
 		*pmod = NULL;
@@ -362,7 +396,7 @@ main(int argc, char *argv[]) {
 	while (*pmod) {
 		struct tstfn *tf, *p;
 		tf = NULL;
-		ylistl_foreach_item(p, &_tstfnl, struct tstfn, lk) {
+		ylistl_foreach_item(p, fnl, struct tstfn, lk) {
 			if (!strcmp(*pmod, p->modname)) {
 				tf = p;
 				break;
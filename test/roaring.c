@@ -0,0 +1,302 @@
+/******************************************************************************
+ * Copyright (C) 2026
+ * Younghyung Cho. <yhcting77@gmail.com>
+ * All rights reserved.
+ *
+ * This file is part of ylib
+ *
+ * This program is licensed under the FreeBSD license
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the FreeBSD Project.
+ *****************************************************************************/
+
+#include "test.h"
+#ifdef CONFIG_TEST
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "yroaring.h"
+#include "yset.h"
+#include "yut.h"
+
+/* Values are in [0, NCONT * 65536) */
+#define NCONT 5
+#define UNIV (NCONT * 65536)
+
+static u32 rseed = 0x2545f491;
+
+static u32
+rnd(void) {
+	/* xorshift32 */
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 17;
+	rseed ^= rseed << 5;
+	return rseed;
+}
+
+/* Build random set having containers of various density.
+ * Same values are set at reference array @p ref.
+ */
+static struct yroaring *
+build(u8 *ref) {
+	u32 k, i, n, lo, len, v;
+	struct yroaring *r = yroaring_create();
+	memset(ref, 0, UNIV);
+	for (k = 0; k < NCONT; k++) {
+		switch (rnd() % 5) {
+		case 0: /* empty */
+			continue;
+		case 1: /* array */
+			n = 1 + rnd() % 200;
+			break;
+		case 2: /* bitmap */
+			n = 5000 + rnd() % 30000;
+			break;
+		case 3: /* around boundary of array and bitmap */
+			n = 4000 + rnd() % 200;
+			break;
+		default: /* runs */
+			n = 1 + rnd() % 30;
+			for (i = 0; i < n; i++) {
+				lo = rnd() % 65536;
+				len = rnd() % 3000;
+				for (v = lo; v < lo + len && v < 65536; v++) {
+					yassert(0 <= yroaring_add(r, k * 65536 + v));
+					ref[k * 65536 + v] = 1;
+				}
+			}
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			v = k * 65536 + rnd() % 65536;
+			yassert((ref[v] ? 0 : 1) == yroaring_add(r, v));
+			ref[v] = 1;
+		}
+	}
+	if (rnd() & 1)
+		yassert(!yroaring_optimize(r));
+	return r;
+}
+
+static void
+verify(const struct yroaring *r, const u8 *ref) {
+	u32 i, n, card = 0;
+	u32 *vs = ymalloc(sizeof(*vs) * UNIV);
+	for (i = 0; i < UNIV; i++) {
+		card += ref[i];
+		yassert(ref[i] == yroaring_has(r, i));
+	}
+	yassert(card == yroaring_card(r));
+	n = yroaring_values(r, vs, UNIV);
+	yassert(n == card);
+	for (i = 0; i < n; i++) {
+		yassert(ref[vs[i]]);
+		yassert(!i || vs[i - 1] < vs[i]);
+	}
+	if (n > 1)
+		yassert(n / 2 == yroaring_values(r, vs, n / 2));
+	yfree(vs);
+}
+
+static void
+test_roaring_basic(void) {
+	u32 i;
+	u32 vs[8];
+	struct yroaring *r = yroaring_create();
+	struct yroaring *c;
+
+	yassert(!yroaring_card(r) && !yroaring_has(r, 0));
+	yassert(1 == yroaring_add(r, 0));
+	yassert(0 == yroaring_add(r, 0));
+	yassert(1 == yroaring_add(r, 0xffffffff));
+	yassert(yroaring_has(r, 0xffffffff) && !yroaring_has(r, 0xfffffffe));
+	yassert(2 == yroaring_values(r, vs, 8)
+		&& 0 == vs[0] && 0xffffffff == vs[1]);
+	yassert(1 == yroaring_remove(r, 0));
+	yassert(0 == yroaring_remove(r, 0));
+	yassert(1 == yroaring_card(r));
+	yroaring_clear(r);
+	yassert(!yroaring_card(r));
+
+	/* Run container: merge, extend and split */
+	for (i = 100; i < 200; i++)
+		yroaring_add(r, i);
+	for (i = 300; i < 400; i++)
+		yroaring_add(r, i);
+	yassert(!yroaring_optimize(r));
+	yassert(1 == yroaring_add(r, 200));
+	yassert(1 == yroaring_add(r, 99));
+	for (i = 201; i < 300; i++)
+		yassert(1 == yroaring_add(r, i));
+	yassert(301 == yroaring_card(r));
+	yassert(1 == yroaring_remove(r, 250));
+	yassert(0 == yroaring_remove(r, 250));
+	yassert(1 == yroaring_remove(r, 99));
+	yassert(1 == yroaring_remove(r, 399));
+	yassert(298 == yroaring_card(r));
+	yassert(!yroaring_has(r, 250) && yroaring_has(r, 251)
+		&& yroaring_has(r, 249) && !yroaring_has(r, 99)
+		&& yroaring_has(r, 100) && yroaring_has(r, 398));
+	c = yroaring_clone(r);
+	yassert(yroaring_equal(r, c));
+	/* Same values but different container type. */
+	yroaring_remove(c, 300);
+	yroaring_add(c, 300);
+	yassert(!yroaring_optimize(c));
+	yroaring_add(c, 70000);
+	yassert(!yroaring_equal(r, c));
+	yroaring_remove(c, 70000);
+	yassert(yroaring_equal(r, c));
+	yroaring_destroy(c);
+	yroaring_destroy(r);
+}
+
+static void
+test_roaring_ops(void) {
+	int t, op;
+	u32 i;
+	u8 *ra = ymalloc(UNIV);
+	u8 *rb = ymalloc(UNIV);
+	u8 *rr = ymalloc(UNIV);
+	struct yroaring *a, *b, *r;
+	u64 card;
+
+	for (t = 0; t < 40; t++) {
+		a = build(ra);
+		b = build(rb);
+		for (op = 0; op < 3; op++) {
+			card = 0;
+			for (i = 0; i < UNIV; i++) {
+				rr[i] = 0 == op ? ra[i] & rb[i]
+					: 1 == op ? ra[i] | rb[i]
+					: ra[i] & !rb[i];
+				card += rr[i];
+			}
+			r = 0 == op ? yroaring_and(a, b)
+				: 1 == op ? yroaring_or(a, b)
+				: yroaring_andnot(a, b);
+			verify(r, rr);
+			yroaring_destroy(r);
+			yassert(card == (0 == op ? yroaring_and_card(a, b)
+				: 1 == op ? yroaring_or_card(a, b)
+				: yroaring_andnot_card(a, b)));
+
+			r = yroaring_clone(a);
+			yassert(!(0 == op ? yroaring_and_inplace(r, b)
+				: 1 == op ? yroaring_or_inplace(r, b)
+				: yroaring_andnot_inplace(r, b)));
+			verify(r, rr);
+			yroaring_destroy(r);
+		}
+		/* with itself */
+		r = yroaring_clone(a);
+		yassert(!yroaring_and_inplace(r, a) && yroaring_equal(r, a));
+		yassert(!yroaring_or_inplace(r, a) && yroaring_equal(r, a));
+		yassert(!yroaring_andnot_inplace(r, a) && !yroaring_card(r));
+		yroaring_destroy(r);
+		yroaring_destroy(a);
+		yroaring_destroy(b);
+	}
+	yfree(ra);
+	yfree(rb);
+	yfree(rr);
+}
+
+static void
+test_roaring(void) {
+	test_roaring_basic();
+	test_roaring_ops();
+}
+
+TESTFN(roaring)
+
+
+#define PERF_NIDS (1024 * 1024)
+
+static void
+perf_roaring(void) {
+	u32 i;
+	u64 t, card;
+	double tys, tyr, tyrc, tyri;
+	yset_t s0 = yseti_create();
+	yset_t s1 = yseti_create();
+	yset_t s;
+	struct yroaring *r0 = yroaring_create();
+	struct yroaring *r1 = yroaring_create();
+	struct yroaring *r;
+
+	/* Dense ids. About half of ids in [0, 2 * PERF_NIDS) */
+	for (i = 0; i < PERF_NIDS; i++) {
+		yset_add(s0, (void *)(intptr_t)(rnd() % (PERF_NIDS * 2)));
+		yset_add(s1, (void *)(intptr_t)(rnd() % (PERF_NIDS * 2)));
+	}
+	for (i = 0; i < PERF_NIDS * 2; i++) {
+		if (yset_has(s0, (void *)(intptr_t)i))
+			yroaring_add(r0, i);
+		if (yset_has(s1, (void *)(intptr_t)i))
+			yroaring_add(r1, i);
+	}
+
+	t = yut_current_time_us();
+	s = yset_intersect(s0, s1);
+	tys = (double)(yut_current_time_us() - t);
+	card = yset_sz(s);
+	yset_destroy(s);
+
+	t = yut_current_time_us();
+	r = yroaring_and(r0, r1);
+	tyr = (double)(yut_current_time_us() - t);
+	yassert(card == yroaring_card(r));
+	yroaring_destroy(r);
+
+	t = yut_current_time_us();
+	yassert(card == yroaring_and_card(r0, r1));
+	tyrc = (double)(yut_current_time_us() - t);
+
+	t = yut_current_time_us();
+	yassert(!yroaring_and_inplace(r0, r1));
+	tyri = (double)(yut_current_time_us() - t);
+	yassert(card == yroaring_card(r0));
+
+	printf("roaring: intersection of two sets of %u dense ids(us)\n",
+		(u32)yset_sz(s0));
+	printf("  yset_intersect        : %10.0f\n", tys);
+	printf("  yroaring_and          : %10.0f\n", tyr);
+	printf("  yroaring_and_card     : %10.0f\n", tyrc);
+	printf("  yroaring_and_inplace  : %10.0f\n", tyri);
+
+	yset_destroy(s0);
+	yset_destroy(s1);
+	yroaring_destroy(r0);
+	yroaring_destroy(r1);
+}
+
+PERFFN(roaring)
+
+#endif /* CONFIG_TEST */
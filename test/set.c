@@ -39,12 +39,13 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 
 #include "yut.h"
 #include "yset.h"
 
 static void
-test_set(void) {
+test_set_basic(void) {
 	int i, r;
 	char buf[10];
 	int *elems[100];
@@ -90,6 +91,135 @@ test_set(void) {
 
 }
 
+static void
+test_set_ops(void) {
+	int i;
+	char buf[16];
+	yset_t a, b, s, sa, sb, ss;
+
+	/* a = [0, 100), b = [50, 300) */
+	a = yseti_create();
+	b = yseti_create();
+	sa = ysets_create();
+	sb = ysets_create();
+	for (i = 0; i < 300; i++) {
+		sprintf(buf, "%d", i);
+		if (i < 100) {
+			yset_add(a, (void *)(intptr_t)i);
+			yset_add(sa, buf);
+		}
+		if (i >= 50) {
+			yset_add(b, (void *)(intptr_t)i);
+			yset_add(sb, buf);
+		}
+	}
+	yassert(50 == yset_intersect_count(a, b));
+	yassert(50 == yset_intersect_count(b, a));
+	yassert(50 == yset_intersect_count(sa, sb));
+	yassert(100 == yset_intersect_count(a, a));
+	/* different type */
+	yassert(0 == yset_intersect_count(a, sa));
+	yassert(-EINVAL == yset_intersect_inplace(a, sa));
+	yassert(!yset_intersect(a, sa));
+
+	s = yset_intersect(a, b);
+	yassert(50 == yset_sz(s));
+	for (i = 50; i < 100; i++)
+		yassert(yset_has(s, (void *)(intptr_t)i));
+	yset_destroy(s);
+	s = yset_union(a, b);
+	yassert(300 == yset_sz(s));
+	yset_destroy(s);
+	s = yset_diff(b, a);
+	yassert(200 == yset_sz(s) && !yset_has(s, (void *)99)
+		&& yset_has(s, (void *)100));
+	yset_destroy(s);
+
+	/* deep-copied string elements */
+	ss = yset_intersect(sb, sa);
+	yassert(50 == yset_sz(ss) && yset_has(ss, "75") && !yset_has(ss, "5"));
+	yassert(!yset_union_inplace(ss, sa));
+	yassert(100 == yset_sz(ss) && yset_has(ss, "5"));
+	yassert(!yset_diff_inplace(ss, sb));
+	yassert(50 == yset_sz(ss) && !yset_has(ss, "75"));
+	yassert(!yset_intersect_inplace(ss, sb));
+	yassert(0 == yset_sz(ss));
+	yset_destroy(ss);
+
+	/* in-place */
+	s = yset_union(a, a);
+	yassert(!yset_intersect_inplace(s, b));
+	yassert(50 == yset_sz(s) && yset_has(s, (void *)50));
+	yassert(!yset_union_inplace(s, b));
+	yassert(250 == yset_sz(s));
+	/* larger s0 and smaller s1 */
+	yassert(!yset_diff_inplace(s, a));
+	yassert(200 == yset_sz(s) && !yset_has(s, (void *)50));
+	/* smaller s0 and larger s1 */
+	yassert(!yset_union_inplace(s, a));
+	yassert(!yset_diff_inplace(a, s));
+	yassert(0 == yset_sz(a));
+	yassert(!yset_union_inplace(s, s) && 300 == yset_sz(s));
+	yassert(!yset_intersect_inplace(s, s) && 300 == yset_sz(s));
+	yassert(!yset_diff_inplace(s, s) && 0 == yset_sz(s));
+	yset_destroy(s);
+
+	yset_destroy(a);
+	yset_destroy(b);
+	yset_destroy(sa);
+	yset_destroy(sb);
+}
+
+static void
+test_set(void) {
+	test_set_basic();
+	test_set_ops();
+}
+
 TESTFN(set)
 
+
+#define PERF_NELEMS (256 * 1024)
+#define PERF_NROUNDS 16
+
+/* Similarity scoring: only size of intersection is needed. */
+static void
+perf_set(void) {
+	int i, j;
+	u32 n0, n1;
+	u64 t;
+	double tsz, tcnt;
+	yset_t s0 = yseti_create();
+	yset_t s1 = yseti_create();
+	yset_t s;
+
+	for (i = 0; i < PERF_NELEMS; i++) {
+		yset_add(s0, (void *)(intptr_t)(i * 2));
+		yset_add(s1, (void *)(intptr_t)(i * 3));
+	}
+	n0 = n1 = 0;
+	t = yut_current_time_us();
+	for (j = 0; j < PERF_NROUNDS; j++) {
+		s = yset_intersect(s0, s1);
+		n0 += yset_sz(s);
+		yset_destroy(s);
+	}
+	tsz = (double)(yut_current_time_us() - t);
+	t = yut_current_time_us();
+	for (j = 0; j < PERF_NROUNDS; j++)
+		n1 += yset_intersect_count(s0, s1);
+	tcnt = (double)(yut_current_time_us() - t);
+	yassert(n0 == n1);
+	printf("set: size of intersection of two sets of %d elements(ms)\n",
+		PERF_NELEMS);
+	printf("  yset_sz(yset_intersect()) : %10.2f\n",
+		tsz / PERF_NROUNDS / 1000);
+	printf("  yset_intersect_count()    : %10.2f\n",
+		tcnt / PERF_NROUNDS / 1000);
+	yset_destroy(s0);
+	yset_destroy(s1);
+}
+
+PERFFN(set)
+
 #endif /* CONFIG_TEST */
@@ -43,6 +43,8 @@ void dregister_tstfn(void (*fn)(void), const char *mod);
 void dunregister_tstfn(void (*fn)(void), const char *mod);
 void dregister_clearfn(void (*fn)(void), const char *mod);
 void dunregister_clearfn(void (*fn)(void), const char *mod);
+void dregister_perffn(void (*fn)(void), const char *mod);
+void dunregister_perffn(void (*fn)(void), const char *mod);
 
 
 #define TESTFN(name)					\
@@ -55,6 +57,19 @@ void dunregister_clearfn(void (*fn)(void), const char *mod);
 		dunregister_tstfn(&test_##name, #name);	\
 	}
 
+/*
+ * Performance measurement. It is run only with '-p' option.
+ */
+#define PERFFN(name)					\
+	__attribute__ ((constructor))			\
+	static void __tst_register_perf_##name(void) {	\
+		dregister_perffn(&perf_##name, #name);	\
+	}						\
+	__attribute__ ((destructor))			\
+	static void __tst_unregister_perf_##name(void) {\
+		dunregister_perffn(&perf_##name, #name);\
+	}
+
 #define CLEARFN(name)					\
 	__attribute__ ((constructor))			\
 	static void __tst_register_clear_##name(void) {	\
@@ -37,16 +37,967 @@
 #include "test.h"
 #ifdef CONFIG_TEST
 
-#include "ycrc.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+#include <malloc.h>
+#endif
 
+#include "ytrie.h"
+#include "yut.h"
+
+#define NKEYS 1500
+#define MAXKSZ 12
+
+struct rkey {
+	u8 k[MAXKSZ];
+	u32 sz;
+	bool in; /* in the trie */
+};
+
+static u32 rseed = 0x1234567;
+
+static u32
+rnd(void) {
+	/* xorshift32 */
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 17;
+	rseed ^= rseed << 5;
+	return rseed;
+}
 
 static void
-test_trie(void) {
-	/* NOT IMPLEMENTED YET */
+vfree(void *v) {
+	yfree(v);
+}
+
+static void *
+vclone(unused void *tag, const void *v) {
+	int *nv = ymalloc(sizeof(*nv));
+	*nv = *(const int *)v;
+	return nv;
+}
+
+static int
+vcmp(const void *v0, const void *v1) {
+	return *(const int *)v0 - *(const int *)v1;
+}
+
+static void *
+pclone(unused void *tag, const void *v) {
+	return (void *)v;
+}
+
+static int
+pcmp(const void *v0, const void *v1) {
+	return v0 != v1;
+}
+
+static int
+rkey_cmp(const void *a, const void *b) {
+	const struct rkey *k0 = a, *k1 = b;
+	u32 sz = k0->sz < k1->sz ? k0->sz : k1->sz;
+	int r = memcmp(k0->k, k1->k, sz);
+	return r ? r : (int)k0->sz - (int)k1->sz;
+}
+
+/* Fails at the 'n'-th(1-based) call */
+static void *
+fclone(void *tag, const void *v) {
+	int *n = tag;
+	return --*n ? vclone(NULL, v) : NULL;
+}
+
+static void
+test_trie_clone_fail(int opt) {
+	struct ytrie *t, *t2;
+	char k[16];
+	int i, n;
+
+	t = ytrie_create2(&vfree, opt);
+	for (i = 0; i < 100; i++) {
+		sprintf(k, "k%d", i);
+		yassert(0 == ytrie_insert(t, (const u8 *)k, (u32)strlen(k),
+					  vclone(NULL, &i)));
+	}
+	n = 50;
+	yassert(!ytrie_clone(t, &n, &fclone));
+	t2 = ytrie_create2(&vfree, opt);
+	n = 50;
+	yassert(-ENOMEM == ytrie_copy(t2, t, &n, &fclone));
+	yassert(0 == ytrie_sz(t2));
+	n = 1000;
+	yassert(0 == ytrie_copy(t2, t, &n, &fclone));
+	yassert(100 == ytrie_sz(t2) && ytrie_equal(t, t2, &vcmp));
+	ytrie_destroy(t2);
+	ytrie_destroy(t);
+}
+
+/*
+ * Keys with small alphabet, to make lots of shared prefixes.
+ * Some keys use large alphabet, to make large nodes.
+ */
+static void
+make_keys(struct rkey *keys) {
+	int i, j;
+	for (i = 0; i < NKEYS; i++) {
+		struct rkey *k = &keys[i];
+	retry:
+		k->sz = 1 + rnd() % MAXKSZ;
+		for (j = 0; j < (int)k->sz; j++)
+			k->k[j] = i % 3
+				? 'a' + rnd() % 4
+				: (u8)rnd();
+		for (j = 0; j < i; j++)
+			if (!rkey_cmp(k, &keys[j]))
+				goto retry;
+		k->in = FALSE;
+	}
+	/* sorted to verify order of iteration */
+	qsort(keys, NKEYS, sizeof(*keys), &rkey_cmp);
+}
+
+struct iter_arg {
+	struct rkey *keys;
+	struct rkey prev;
+	u32 prefixsz;
+	u32 cnt;
+};
+
+static int
+iter_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct iter_arg *arg = tag;
+	struct rkey k;
+	yassert(sz + arg->prefixsz <= MAXKSZ);
+	memcpy(k.k, arg->prev.k, arg->prefixsz);
+	memcpy(k.k + arg->prefixsz, key, sz);
+	k.sz = arg->prefixsz + sz;
+	/* keys are visited in order */
+	if (arg->cnt)
+		yassert(0 < rkey_cmp(&k, &arg->prev));
+	yassert(arg->keys[*(int *)v].in
+		&& !rkey_cmp(&k, &arg->keys[*(int *)v]));
+	arg->prev = k;
+	arg->cnt++;
+	return 1;
+}
+
+static void
+verify(struct ytrie *t, struct rkey *keys) {
+	int i;
+	u32 n, npfx;
+	struct iter_arg arg;
+	const u8 *pfx = (const u8 *)"ab";
+
+	n = npfx = 0;
+	for (i = 0; i < NKEYS; i++) {
+		int *v = ytrie_get(t, keys[i].k, keys[i].sz);
+		if (keys[i].in) {
+			yassert(v && *v == i);
+			n++;
+			if (keys[i].sz >= 2 && !memcmp(keys[i].k, pfx, 2))
+				npfx++;
+		} else
+			yassert(!v);
+	}
+	yassert(n == ytrie_sz(t));
+
+	memset(&arg, 0, sizeof(arg));
+	arg.keys = keys;
+	yassert(1 == ytrie_iterate(t, &arg, (const u8 *)"", 0, &iter_cb));
+	yassert(n == arg.cnt);
+
+	memset(&arg, 0, sizeof(arg));
+	arg.keys = keys;
+	arg.prefixsz = 2;
+	memcpy(arg.prev.k, pfx, 2);
+	if (npfx)
+		yassert(1 == ytrie_iterate(t, &arg, pfx, 2, &iter_cb));
+	yassert(npfx == arg.cnt);
 }
 
+static void
+test_trie_random(int opt) {
+	int i, r;
+	struct ytrie *t, *t2;
+	struct rkey *keys = ymalloc(sizeof(*keys) * NKEYS);
+
+	make_keys(keys);
+	t = ytrie_create2(&vfree, opt);
+	for (i = 0; i < 20000; i++) {
+		int ki = rnd() % NKEYS;
+		struct rkey *k = &keys[ki];
+		int *v;
+		switch (rnd() % 3) {
+		case 0:
+			v = ymalloc(sizeof(*v));
+			*v = ki;
+			r = ytrie_insert(t, k->k, k->sz, v);
+			yassert(r == (k->in ? 1 : 0));
+			k->in = TRUE;
+			break;
+		case 1:
+			r = ytrie_remove(t, k->k, k->sz);
+			yassert(r == (k->in ? 1 : 0));
+			k->in = FALSE;
+			break;
+		default:
+			v = ytrie_get(t, k->k, k->sz);
+			yassert(k->in ? v && *v == ki : !v);
+		}
+		if (!(i % 5000))
+			verify(t, keys);
+	}
+	verify(t, keys);
+
+	t2 = ytrie_clone(t, NULL, &vclone);
+	verify(t2, keys);
+	yassert(ytrie_equal(t, t2, &vcmp));
+	for (i = 0; i < NKEYS && !keys[i].in; i++);
+	yassert(i < NKEYS);
+	*(int *)ytrie_get(t2, keys[i].k, keys[i].sz) = -1;
+	yassert(!ytrie_equal(t, t2, &vcmp));
+	yassert(1 == ytrie_remove(t2, keys[i].k, keys[i].sz));
+	yassert(!ytrie_equal(t, t2, &vcmp));
+	ytrie_destroy(t2);
+
+	/* remove all */
+	for (i = 0; i < NKEYS; i++) {
+		if (keys[i].in) {
+			yassert(1 == ytrie_remove(t, keys[i].k, keys[i].sz));
+			keys[i].in = FALSE;
+		}
+	}
+	verify(t, keys);
+	yassert(2 == ytrie_auto_complete(t, (const u8 *)"a", 1,
+					 (u8 *)&r, sizeof(r)));
+
+	/* reset */
+	for (i = 0; i < NKEYS; i += 2) {
+		int *v = ymalloc(sizeof(*v));
+		*v = i;
+		yassert(0 == ytrie_insert(t, keys[i].k, keys[i].sz, v));
+		keys[i].in = TRUE;
+	}
+	verify(t, keys);
+	ytrie_reset(t);
+	for (i = 0; i < NKEYS; i++)
+		keys[i].in = FALSE;
+	verify(t, keys);
+	ytrie_destroy(t);
+	yfree(keys);
+}
+
+struct range_arg {
+	struct rkey *keys;
+	const struct rkey *hi;
+	int next; /* index of next expected key */
+	int stop; /* callback returns 0 at this count */
+	u32 cnt;
+};
+
+/* Index of next key in trie and in range, from @i. NKEYS if none. */
+static int
+range_next_key(struct rkey *keys, int i, const struct rkey *hi) {
+	for (; i < NKEYS && !keys[i].in; i++);
+	if (i < NKEYS && hi && 0 <= rkey_cmp(&keys[i], hi))
+		return NKEYS;
+	return i;
+}
+
+static int
+range_cb(void *tag, const u8 *key, u32 sz, void *v) {
+	struct range_arg *arg = tag;
+	struct rkey k;
+	yassert(sz <= MAXKSZ);
+	memcpy(k.k, key, sz);
+	k.sz = sz;
+	yassert(arg->next < NKEYS
+		&& *(int *)v == arg->next
+		&& !rkey_cmp(&k, &arg->keys[arg->next]));
+	arg->next = range_next_key(arg->keys, arg->next + 1, arg->hi);
+	return ++arg->cnt != (u32)arg->stop;
+}
+
+static void
+rand_rkey(struct rkey *k) {
+	int j;
+	k->sz = 1 + rnd() % MAXKSZ;
+	for (j = 0; j < (int)k->sz; j++)
+		k->k[j] = 'a' + rnd() % 4;
+}
+
+static void
+test_trie_range(int opt) {
+	int i, j, n, lim;
+	u32 len;
+	void *v;
+	struct rkey lo, hi, q;
+	struct range_arg arg;
+	struct ytrie_cursor cur;
+	struct rkey *keys = ymalloc(sizeof(*keys) * NKEYS);
+	struct ytrie *t = ytrie_create2(&vfree, opt);
+
+	make_keys(keys);
+	/* Empty trie */
+	yassert(!ytrie_cursor_init(&cur, NULL, 0, NULL, 0));
+	yassert(0 == ytrie_cursor_next(t, &cur, NULL, 0, &range_cb));
+	yassert(!ytrie_longest_prefix(t, keys[0].k, keys[0].sz, &len));
+	for (i = 0; i < NKEYS; i++) {
+		if (rnd() % 2)
+			continue;
+		v = ymalloc(sizeof(int));
+		*(int *)v = i;
+		yassert(0 == ytrie_insert(t, keys[i].k, keys[i].sz, v));
+		keys[i].in = TRUE;
+	}
+
+	for (i = 0; i < 500; i++) {
+		struct rkey *plo = NULL, *phi = NULL;
+		/* Bound is key in the trie, key not in the trie, or none. */
+		switch (i % 4) {
+		case 0: lo = keys[rnd() % NKEYS]; plo = &lo; break;
+		case 1: rand_rkey(&lo); plo = &lo; break;
+		case 2: lo.sz = 0; plo = &lo; break;
+		}
+		switch ((i / 4) % 4) {
+		case 0: hi = keys[rnd() % NKEYS]; phi = &hi; break;
+		case 1: rand_rkey(&hi); phi = &hi; break;
+		case 2: hi.sz = 1; hi.k[0] = 'a' + rnd() % 4; phi = &hi; break;
+		}
+		yassert(!ytrie_cursor_init(&cur,
+					   plo ? plo->k : NULL,
+					   plo ? plo->sz : 0,
+					   phi ? phi->k : NULL,
+					   phi ? phi->sz : 0));
+		memset(&arg, 0, sizeof(arg));
+		arg.keys = keys;
+		arg.hi = phi;
+		if (plo)
+			for (; arg.next < NKEYS
+				     && 0 > rkey_cmp(&keys[arg.next], plo);
+			     arg.next++);
+		/* Callback stops in the middle, sometimes. */
+		arg.stop = i % 3 ? 0 : 1 + rnd() % 10;
+		lim = i % 2 ? 0 : 1 + rnd() % 20;
+		arg.next = range_next_key(keys, arg.next, phi);
+		do {
+			n = ytrie_cursor_next(t, &cur, &arg, lim, &range_cb);
+			yassert(n >= 0 && (!lim || n <= lim));
+		} while (n);
+		yassert(NKEYS == arg.next);
+		yassert(0 == ytrie_cursor_next(t, &cur, &arg, lim, &range_cb));
+	}
+
+	/* Longest prefix */
+	for (i = 0; i < 2000; i++) {
+		int best = -1;
+		rand_rkey(&q);
+		if (i % 2) {
+			/* Extend key in the trie */
+			q = keys[rnd() % NKEYS];
+			for (; q.sz < MAXKSZ; q.sz++)
+				q.k[q.sz] = 'a' + rnd() % 4;
+		}
+		for (j = 0; j < NKEYS; j++)
+			if (keys[j].in && keys[j].sz <= q.sz
+			    && !memcmp(keys[j].k, q.k, keys[j].sz)
+			    && (best < 0 || keys[j].sz > keys[best].sz))
+				best = j;
+		len = 0;
+		v = ytrie_longest_prefix(t, q.k, q.sz, &len);
+		if (best < 0)
+			yassert(!v);
+		else
+			yassert(v && *(int *)v == best
+				&& len == keys[best].sz);
+	}
+	ytrie_destroy(t);
+	yfree(keys);
+}
+
+/* Value of scored trie: score of key */
+static u32
+vscore(const void *v) {
+	return *(const u32 *)v;
+}
+
+struct top_arg {
+	struct rkey *keys;
+	const u8 *pfx;
+	u32 pfxsz;
+	u32 prev; /* score of previous key */
+	u32 scores[NKEYS];
+	u32 cnt;
+};
+
+static int
+top_cb(void *tag, const u8 *key, u32 sz, void *v, u32 score) {
+	struct top_arg *arg = tag;
+	struct rkey k, *f;
+	yassert(sz <= MAXKSZ && sz >= arg->pfxsz
+		&& !memcmp(key, arg->pfx, arg->pfxsz));
+	yassert(score == *(u32 *)v);
+	/* descending order */
+	yassert(!arg->cnt || arg->prev >= score);
+	memcpy(k.k, key, sz);
+	k.sz = sz;
+	f = bsearch(&k, arg->keys, NKEYS, sizeof(k), &rkey_cmp);
+	yassert(f && f->in);
+	arg->scores[arg->cnt++] = score;
+	arg->prev = score;
+	return 1;
+}
+
+static int
+u32_rcmp(const void *a, const void *b) {
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void
+verify_top(struct ytrie *t, struct rkey *keys, u32 *scores) {
+	int i, j;
+	u32 n, k, pfxsz;
+	static u32 expect[NKEYS];
+	static struct top_arg arg;
+	u8 pfx[MAXKSZ];
+
+	for (i = 0; i < 50; i++) {
+		/* Prefix of random key. Sometimes, empty prefix */
+		j = rnd() % NKEYS;
+		pfxsz = i ? rnd() % (keys[j].sz + 1) : 0;
+		memcpy(pfx, keys[j].k, pfxsz);
+		for (n = 0, j = 0; j < NKEYS; j++)
+			if (keys[j].in && keys[j].sz >= pfxsz
+			    && !memcmp(keys[j].k, pfx, pfxsz))
+				expect[n++] = scores[j];
+		qsort(expect, n, sizeof(*expect), &u32_rcmp);
+		k = 1 + rnd() % 20;
+		memset(&arg, 0, sizeof(arg));
+		arg.keys = keys;
+		arg.pfx = pfx;
+		arg.pfxsz = pfxsz;
+		yassert((int)(n < k ? n : k) == ytrie_auto_complete_top(
+				t, pfx, pfxsz, k, &arg, &top_cb));
+		/* Scores are same even if keys having same score differ. */
+		yassert(!memcmp(expect, arg.scores, sizeof(u32) * arg.cnt));
+	}
+}
+
+static void
+test_trie_scored(int opt) {
+	int i, r;
+	u32 *v;
+	u32 *scores = ymalloc(sizeof(*scores) * NKEYS);
+	struct rkey *keys = ymalloc(sizeof(*keys) * NKEYS);
+	struct ytrie *t2, *t = ytrie_create_scored(&vfree, opt, &vscore);
+
+	make_keys(keys);
+	yassert(0 == ytrie_auto_complete_top(t, (const u8 *)"a", 1, 10,
+					     NULL, &top_cb));
+	for (i = 0; i < 20000; i++) {
+		int ki = rnd() % NKEYS;
+		struct rkey *k = &keys[ki];
+		if (rnd() % 3) {
+			v = ymalloc(sizeof(*v));
+			/* Small range of score, to have same scores */
+			*v = rnd() % 1000;
+			r = ytrie_insert(t, k->k, k->sz, v);
+			yassert(r == (k->in ? 1 : 0));
+			k->in = TRUE;
+			scores[ki] = *v;
+		} else {
+			r = ytrie_remove(t, k->k, k->sz);
+			yassert(r == (k->in ? 1 : 0));
+			k->in = FALSE;
+		}
+		if (!(i % 2000))
+			verify_top(t, keys, scores);
+	}
+	verify_top(t, keys, scores);
 
+	t2 = ytrie_clone(t, NULL, &vclone);
+	verify_top(t2, keys, scores);
+	ytrie_destroy(t2);
+	/* Trie that isn't scored */
+	t2 = ytrie_create2(NULL, opt);
+	yassert(-EINVAL == ytrie_auto_complete_top(t2, (const u8 *)"a", 1,
+						   10, NULL, &top_cb));
+	ytrie_destroy(t2);
+
+	ytrie_destroy(t);
+	yfree(keys);
+	yfree(scores);
+}
+
+static void
+test_trie_auto_complete(int opt) {
+	u8 buf[YTRIE_MAX_KEY_LEN];
+	u8 lk[YTRIE_MAX_KEY_LEN];
+	struct ytrie *t2, *t = ytrie_create2(NULL, opt);
+
+#define ins(s) ytrie_insert(t, (const u8 *)(s), strlen(s), (void *)1)
+#define ac(s, bsz) ytrie_auto_complete(t, (const u8 *)(s), strlen(s),	\
+					buf, bsz)
+	yassert(0 == ins("abcdef"));
+	yassert(0 == ins("abcxyz"));
+	yassert(0 == ins("abcxyw"));
+	yassert(0 == ac("ab", sizeof(buf)) && !strcmp((char *)buf, "c"));
+	yassert(0 == ac("a", sizeof(buf)) && !strcmp((char *)buf, "bc"));
+	yassert(1 == ac("abcd", sizeof(buf))
+		&& !strcmp((char *)buf, "ef"));
+	yassert(1 == ac("abcdef", sizeof(buf)) && !buf[0]);
+	yassert(0 == ac("abcx", sizeof(buf)) && !strcmp((char *)buf, "y"));
+	yassert(2 == ac("abd", sizeof(buf)));
+	yassert(2 == ac("abcdefg", sizeof(buf)));
+	yassert(0 > ac("abcd", 2));
+	yassert(1 == ac("abcd", 3));
+	yassert(0 == ins("abcxy"));
+	yassert(1 == ins("abcxy"));
+	yassert(0 == ac("abcx", sizeof(buf)) && !strcmp((char *)buf, "y"));
+	yassert(0 == ac("abcxy", sizeof(buf)) && !buf[0]);
+	yassert(1 == ytrie_remove(t, (const u8 *)"abcdef", 6));
+	yassert(1 == ytrie_remove(t, (const u8 *)"abcxyw", 6));
+	yassert(0 == ytrie_remove(t, (const u8 *)"abcxyw", 6));
+	yassert(0 == ac("a", sizeof(buf))
+		&& !strcmp((char *)buf, "bcxy"));
+	yassert(1 == ytrie_remove(t, (const u8 *)"abcxy", 5));
+	yassert(1 == ac("a", sizeof(buf))
+		&& !strcmp((char *)buf, "bcxyz"));
+	yassert(1 == ytrie_sz(t));
+
+	/* long keys sharing long prefix */
+	memset(lk, 'k', sizeof(lk));
+	yassert(0 == ytrie_insert(t, lk, sizeof(lk) - 1, (void *)1));
+	yassert(0 == ytrie_insert(t, lk, sizeof(lk) - 2, (void *)1));
+	lk[500] = 'x';
+	yassert(0 == ytrie_insert(t, lk, sizeof(lk) - 1, (void *)1));
+	yassert(0 == ytrie_auto_complete(t, lk, 1, buf, sizeof(buf)));
+	yassert(strlen((char *)buf) == 499);
+	yassert(1 == ytrie_auto_complete(t, lk, 501, buf, sizeof(buf)));
+	yassert(strlen((char *)buf) == sizeof(lk) - 1 - 501);
+	yassert((void *)1 == ytrie_get(t, lk, sizeof(lk) - 1));
+	yassert(!ytrie_get(t, lk, sizeof(lk) - 2));
+	yassert(4 == ytrie_sz(t));
+	/* Deep trie is walked without recursion */
+	t2 = ytrie_clone(t, NULL, &pclone);
+	yassert(4 == ytrie_sz(t2) && ytrie_equal(t, t2, &pcmp));
+	yassert(1 == ytrie_remove(t2, lk, sizeof(lk) - 1));
+	yassert(!ytrie_equal(t, t2, &pcmp));
+	ytrie_destroy(t2);
+#undef ins
+#undef ac
+	ytrie_destroy(t);
+}
+
+#define MT_NKEYS 1024
+#define MT_ITER 20000
+
+struct mtarg {
+	struct ytrie *t;
+	int id;
+	int nthreads;
+};
+
+static void
+ivfree(void *v) {
+	/* Make use-after-free visible */
+	*(int *)v = -1;
+	yfree(v);
+}
+
+static void *
+ivalue(int i) {
+	int *v = ymalloc(sizeof(*v));
+	*v = i;
+	return v;
+}
+
+/* Keys share prefixes. So, nodes are split and merged frequently. */
+static u32
+mt_key(char *buf, int k) {
+	return (u32)sprintf(buf, "%x/%x/%d", k % 8, k % 3, k);
+}
+
+static int
+mt_iter_cb(unused void *tag, const u8 *key, u32 sz, void *v) {
+	char buf[32];
+	/* prefix is "1/" */
+	yassert(sz + 2 == mt_key(buf, *(int *)v)
+		&& !memcmp(buf + 2, key, sz));
+	return 1;
+}
+
+/*
+ * Keys in [0, MT_NKEYS / 2) are always in the trie. Their values are
+ *   replaced by writers. Others are inserted and removed by writers.
+ * Value of key 'k' is always 'k'.
+ */
+static void *
+mt_writer(void *arg) {
+	int i, k;
+	u32 sz;
+	char buf[32];
+	struct mtarg *a = arg;
+	for (i = 0; i < MT_ITER; i++) {
+		k = (i * a->nthreads + a->id) % MT_NKEYS;
+		sz = mt_key(buf, k);
+		if (k < MT_NKEYS / 2)
+			yassert(1 == ytrie_insert(a->t, (u8 *)buf, sz,
+						  ivalue(k)));
+		else if (ytrie_remove(a->t, (u8 *)buf, sz) <= 0)
+			ytrie_insert(a->t, (u8 *)buf, sz, ivalue(k));
+	}
+	return NULL;
+}
+
+static void *
+mt_reader(void *arg) {
+	int i, k;
+	u32 sz;
+	int *v;
+	char buf[32];
+	struct mtarg *a = arg;
+	for (i = 0; i < MT_ITER; i++) {
+		k = (i * 7 + a->id) % MT_NKEYS;
+		sz = mt_key(buf, k);
+		ytrie_read_begin();
+		if ((v = ytrie_get(a->t, (u8 *)buf, sz)))
+			yassert(k == *v);
+		else
+			yassert(k >= MT_NKEYS / 2);
+		if (!(i % 256))
+			yassert(1 == ytrie_iterate(a->t, NULL, (u8 *)"1/", 2,
+						   &mt_iter_cb));
+		ytrie_read_end();
+	}
+	return NULL;
+}
+
+static void
+test_trie_mt(void) {
+	int i;
+	u32 sz;
+	char buf[32];
+	const int nwriters = 2;
+	const int nreaders = 4;
+	pthread_t thds[nwriters + nreaders];
+	struct mtarg args[nwriters + nreaders];
+	struct ytrie *t = ytrie_create2(&ivfree, YTRIE_concurrent);
+
+	for (i = 0; i < MT_NKEYS / 2; i++) {
+		sz = mt_key(buf, i);
+		yassert(0 == ytrie_insert(t, (u8 *)buf, sz, ivalue(i)));
+	}
+	for (i = 0; i < nwriters + nreaders; i++) {
+		args[i].t = t;
+		args[i].id = i < nwriters ? i : i - nwriters;
+		args[i].nthreads = nwriters;
+		yassert(!pthread_create(&thds[i], NULL,
+			i < nwriters ? &mt_writer : &mt_reader, &args[i]));
+	}
+	for (i = 0; i < nwriters + nreaders; i++)
+		pthread_join(thds[i], NULL);
+	for (i = 0; i < MT_NKEYS / 2; i++) {
+		sz = mt_key(buf, i);
+		yassert(i == *(int *)ytrie_get(t, (u8 *)buf, sz));
+	}
+	ytrie_reset(t);
+	yassert(!ytrie_sz(t));
+	yassert(0 == ytrie_insert(t, (u8 *)"a", 1, ivalue(0)));
+	ytrie_destroy(t);
+}
+
+static void
+test_trie(void) {
+	test_trie_random(0);
+	test_trie_random(YTRIE_art);
+	test_trie_random(YTRIE_concurrent);
+	test_trie_auto_complete(0);
+	test_trie_auto_complete(YTRIE_art);
+	test_trie_auto_complete(YTRIE_concurrent);
+	test_trie_range(0);
+	test_trie_range(YTRIE_art);
+	test_trie_range(YTRIE_concurrent);
+	test_trie_scored(0);
+	test_trie_scored(YTRIE_concurrent);
+	test_trie_clone_fail(0);
+	test_trie_clone_fail(YTRIE_art);
+	test_trie_mt();
+}
 
 TESTFN(trie)
 
+
+#define PERF_NKEYS 200000
+
+static long
+perf_heapsz(void) {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+	return (long)mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+#define PERF_NSCANS 10000
+#define PERF_SCANSZ 100
+
+static int
+perf_scan_cb(unused void *tag, unused const u8 *key, unused u32 sz,
+	     unused void *v) {
+	return 1;
+}
+
+static void
+perf_trie_engine(const char *name, int opt, char (*keys)[64]) {
+	int i;
+	u64 tins, tget, tscan, tclone, tdestroy;
+	struct ytrie_cursor cur;
+	long msz;
+	u32 n = 0;
+	struct ytrie *t, *t2;
+
+	msz = perf_heapsz();
+	t = ytrie_create2(NULL, opt);
+	tins = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		ytrie_insert(t, (const u8 *)keys[i], strlen(keys[i]),
+			     (void *)(intptr_t)(i + 1));
+	tins = yut_current_time_us() - tins;
+	msz = perf_heapsz() - msz;
+	tget = yut_current_time_us();
+	for (i = 0; i < PERF_NKEYS; i++)
+		n += !!ytrie_get(t, (const u8 *)keys[i], strlen(keys[i]));
+	tget = yut_current_time_us() - tget;
+	yassert(n == PERF_NKEYS);
+	/* Short range scans from random keys */
+	tscan = yut_current_time_us();
+	for (i = 0; i < PERF_NSCANS; i++) {
+		const char *k = keys[(i * 7919) % PERF_NKEYS];
+		ytrie_cursor_init(&cur, (const u8 *)k, strlen(k), NULL, 0);
+		/* Scan from one of the last keys visits less keys. */
+		yassert(0 < ytrie_cursor_next(t, &cur, NULL, PERF_SCANSZ,
+					      &perf_scan_cb));
+	}
+	tscan = yut_current_time_us() - tscan;
+	tclone = yut_current_time_us();
+	t2 = ytrie_clone(t, NULL, &pclone);
+	tclone = yut_current_time_us() - tclone;
+	tdestroy = yut_current_time_us();
+	ytrie_destroy(t2);
+	tdestroy = yut_current_time_us() - tdestroy;
+	printf("  %-8s: insert %8.2f, get %8.2f, scan %8.2f, clone %8.2f,"
+	       " destroy %8.2f (ms), memory %8.2f (MB)\n",
+	       name, (double)tins / 1000, (double)tget / 1000,
+	       (double)tscan / 1000, (double)tclone / 1000,
+	       (double)tdestroy / 1000,
+	       (double)msz / (1024 * 1024));
+	ytrie_destroy(t);
+}
+
+#define PERF_TOTAL_OPS (4 * 1024 * 1024)
+
+struct perfarg {
+	struct ytrie *t;
+	pthread_rwlock_t *rwl; /* NULL at concurrent mode */
+	char (*keys)[64];
+	int nops;
+	u32 seed;
+	volatile int *stop;
+};
+
+static INLINE u32
+xorshift(u32 *s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+static void *
+perf_reader(void *arg) {
+	int i;
+	u32 k;
+	struct perfarg *a = arg;
+	for (i = 0; i < a->nops; i++) {
+		k = xorshift(&a->seed) % PERF_NKEYS;
+		if (a->rwl)
+			pthread_rwlock_rdlock(a->rwl);
+		ytrie_get(a->t, (const u8 *)a->keys[k], strlen(a->keys[k]));
+		if (a->rwl)
+			pthread_rwlock_unlock(a->rwl);
+	}
+	return NULL;
+}
+
+/* Rare updates by control thread */
+static void *
+perf_writer(void *arg) {
+	u32 k;
+	struct perfarg *a = arg;
+	while (!*a->stop) {
+		k = xorshift(&a->seed) % PERF_NKEYS;
+		if (a->rwl)
+			pthread_rwlock_wrlock(a->rwl);
+		ytrie_insert(a->t, (const u8 *)a->keys[k], strlen(a->keys[k]),
+			     (void *)(intptr_t)(k + 1));
+		if (a->rwl)
+			pthread_rwlock_unlock(a->rwl);
+		usleep(100);
+	}
+	return NULL;
+}
+
+static void
+perf_trie_readers(char (*keys)[64]) {
+	int i, j, m;
+	u64 t;
+	pthread_t thds[65];
+	struct perfarg args[65];
+	pthread_rwlock_t rwl;
+	volatile int stop;
+	const int nthds[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+	printf("trie: get M ops/sec with a writer (%d keys, %d ops)\n",
+	       PERF_NKEYS, PERF_TOTAL_OPS);
+	printf("%8s %16s %16s\n", "readers", "concurrent", "ART+rwlock");
+	pthread_rwlock_init(&rwl, NULL);
+	for (j = 0; j < yut_arrsz(nthds); j++) {
+		printf("%8d", nthds[j]);
+		for (m = 0; m < 2; m++) {
+			struct ytrie *tr = ytrie_create2(
+				NULL, m ? YTRIE_art : YTRIE_concurrent);
+			for (i = 0; i < PERF_NKEYS; i++)
+				ytrie_insert(tr, (const u8 *)keys[i],
+					     strlen(keys[i]),
+					     (void *)(intptr_t)(i + 1));
+			stop = 0;
+			for (i = 0; i <= nthds[j]; i++) {
+				args[i].t = tr;
+				args[i].rwl = m ? &rwl : NULL;
+				args[i].keys = keys;
+				args[i].nops = PERF_TOTAL_OPS / nthds[j];
+				args[i].seed = i * 7919 + 1;
+				args[i].stop = &stop;
+			}
+			yassert(!pthread_create(&thds[nthds[j]], NULL,
+						&perf_writer,
+						&args[nthds[j]]));
+			t = yut_current_time_us();
+			for (i = 0; i < nthds[j]; i++)
+				yassert(!pthread_create(&thds[i], NULL,
+							&perf_reader,
+							&args[i]));
+			for (i = 0; i < nthds[j]; i++)
+				pthread_join(thds[i], NULL);
+			t = yut_current_time_us() - t;
+			stop = 1;
+			pthread_join(thds[nthds[j]], NULL);
+			printf(" %16.2f", (double)PERF_TOTAL_OPS / (t ? t : 1));
+			ytrie_destroy(tr);
+		}
+		printf("\n");
+	}
+	pthread_rwlock_destroy(&rwl);
+}
+
+#define PERF_TOPK 10
+#define PERF_NQUERIES 100
+
+struct perf_top_arg {
+	u32 top[PERF_TOPK]; /* descending */
+	u32 n;
+};
+
+static int
+perf_top_cb(void *tag, unused const u8 *key, unused u32 sz,
+	    unused void *v, unused u32 score) {
+	struct perf_top_arg *arg = tag;
+	arg->n++;
+	return 1;
+}
+
+/* Naive top-k: visit all keys having prefix. */
+static int
+perf_naive_cb(void *tag, unused const u8 *key, unused u32 sz, void *v) {
+	struct perf_top_arg *arg = tag;
+	u32 i, s = *(u32 *)v;
+	if (arg->n < PERF_TOPK)
+		arg->n++;
+	else if (s <= arg->top[PERF_TOPK - 1])
+		return 1;
+	for (i = arg->n - 1; i > 0 && arg->top[i - 1] < s; i--)
+		arg->top[i] = arg->top[i - 1];
+	arg->top[i] = s;
+	return 1;
+}
+
+static void
+perf_trie_top(char (*keys)[64]) {
+	int i, j;
+	u32 seed = 1;
+	u64 ttop, tnaive;
+	struct perf_top_arg arg;
+	u32 *scores = ymalloc(sizeof(*scores) * PERF_NKEYS);
+	struct ytrie *t = ytrie_create_scored(NULL, 0, &vscore);
+	const char *pfxs[] = {
+		"https://www.example1",
+		"https://",
+	};
+
+	for (i = 0; i < PERF_NKEYS; i++) {
+		scores[i] = xorshift(&seed) % 1000000;
+		ytrie_insert(t, (const u8 *)keys[i], strlen(keys[i]),
+			     &scores[i]);
+	}
+	printf("trie: top-%d completion(ms per query)\n", PERF_TOPK);
+	for (j = 0; j < yut_arrsz(pfxs); j++) {
+		const u8 *pfx = (const u8 *)pfxs[j];
+		u32 pfxsz = strlen(pfxs[j]);
+		ttop = yut_current_time_us();
+		for (i = 0; i < PERF_NQUERIES; i++) {
+			arg.n = 0;
+			ytrie_auto_complete_top(t, pfx, pfxsz, PERF_TOPK,
+						&arg, &perf_top_cb);
+		}
+		ttop = yut_current_time_us() - ttop;
+		tnaive = yut_current_time_us();
+		for (i = 0; i < PERF_NQUERIES; i++) {
+			arg.n = 0;
+			ytrie_iterate(t, &arg, pfx, pfxsz, &perf_naive_cb);
+		}
+		tnaive = yut_current_time_us() - tnaive;
+		printf("  %-24s: top-k %8.3f, visiting all %8.3f\n",
+		       pfxs[j],
+		       (double)ttop / 1000 / PERF_NQUERIES,
+		       (double)tnaive / 1000 / PERF_NQUERIES);
+	}
+	ytrie_destroy(t);
+	yfree(scores);
+}
+
+static void
+perf_trie(void) {
+	int i;
+	char (*keys)[64] = ymalloc(sizeof(*keys) * PERF_NKEYS);
+	for (i = 0; i < PERF_NKEYS; i++)
+		sprintf(keys[i], "https://www.example%d.com/path/%d/item%d",
+			i % 97, i % 1013, i);
+	printf("trie: %d URL-like keys\n", PERF_NKEYS);
+	perf_trie_engine("4-bit", 0, keys);
+	perf_trie_engine("ART", YTRIE_art, keys);
+	perf_trie_top(keys);
+	perf_trie_readers(keys);
+	yfree(keys);
+}
+
+PERFFN(trie)
+
 #endif /* CONFIG_TEST */